@@ -10,20 +10,19 @@
 #include <sensor_msgs/image_encodings.h>
 #include <std_msgs/String.h>
 #include <opencv2/opencv.hpp>
+#include <memory>
 #include <string>
 
 #include <geometry_msgs/PoseArray.h>
 #include <geometry_msgs/PoseStamped.h>
-#include <message_filters/subscriber.h>
-#include <message_filters/sync_policies/approximate_time.h>
 #include <tf/transform_listener.h>
 
 #include <mir_barrier_tape_detection/BarrierTapeConfig.h>
 #include <mir_barrier_tape_detection/barrier_tape_detection.h>
+#include <mir_perception_utils/synchronized_frame_buffer.h>
 
-typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::PointCloud2,
-                                                        sensor_msgs::Image>
-    ImageSyncPolicy;
+typedef mir_perception_utils::SynchronizedFrameBuffer<sensor_msgs::PointCloud2, sensor_msgs::Image>
+    FrameBuffer;
 
 class BarrierTapeDetectionRos
 {
@@ -33,11 +32,6 @@ class BarrierTapeDetectionRos
   void dynamicReconfigCallback(mir_barrier_tape_detection::BarrierTapeConfig &config,
                                uint32_t level);
   void eventCallback(const std_msgs::String &event_command);
-  /**
-   * Get 3D pointcloud and RGB image at the same time
-   */
-  void synchronizedCallback(const sensor_msgs::PointCloud2::ConstPtr &pointcloud_msg,
-                            const sensor_msgs::Image::ConstPtr &rgb_image_msg);
   void states();
   void initState();
   void idleState();
@@ -68,11 +62,16 @@ class BarrierTapeDetectionRos
   ros::Subscriber event_sub_;
   ros::Subscriber pointcloud_sub_;
 
-  message_filters::Subscriber<sensor_msgs::PointCloud2> sub_pointcloud_;
-  message_filters::Subscriber<sensor_msgs::Image> sub_rgb_image_;
+  /**
+   * Synchronized 3D pointcloud and RGB image, always subscribed so that e_start
+   * does not wait for the subscription
+   */
+  std::unique_ptr<FrameBuffer> frame_buffer_;
   sensor_msgs::PointCloud2::ConstPtr pointcloud_msg_;
   sensor_msgs::Image::ConstPtr rgb_image_msg_;
-  boost::shared_ptr<message_filters::Synchronizer<ImageSyncPolicy>> sync_input_;
+  // only pairs stamped after it are processed: the settle time after e_start, then the last pair
+  ros::Time frame_min_stamp_;
+  double frame_settle_time_;
 
   image_transport::ImageTransport image_transporter_;
   image_transport::Publisher image_pub_;
@@ -92,7 +91,6 @@ class BarrierTapeDetectionRos
   pcl::PointCloud<pcl::PointXYZ>::Ptr barrier_tape_cloud_;
 
   bool is_debug_mode_;
-  bool has_image_data_;
   std::string target_frame_;
   int num_of_retrial_;
   int num_pixels_to_extrapolate_;
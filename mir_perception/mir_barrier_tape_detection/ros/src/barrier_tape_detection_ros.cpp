@@ -8,6 +8,7 @@ BarrierTapeDetectionRos::BarrierTapeDetectionRos(ros::NodeHandle &nh)
   nh.param<std::string>("target_frame", target_frame_, "/base_link");
   nh.param<int>("num_of_retrial", num_of_retrial_, 30);
   nh.param<int>("num_pixels_to_extrapolate", num_pixels_to_extrapolate_, 30);
+  nh.param<double>("frame_settle_time", frame_settle_time_, 0.0);
   dynamic_reconfigure_server_.setCallback(
       boost::bind(&BarrierTapeDetectionRos::dynamicReconfigCallback, this, _1, _2));
 
@@ -20,19 +21,9 @@ BarrierTapeDetectionRos::BarrierTapeDetectionRos(ros::NodeHandle &nh)
 
   event_sub_ =
       node_handler_.subscribe("event_in", 1, &BarrierTapeDetectionRos::eventCallback, this);
-  sub_pointcloud_.subscribe(node_handler_, "input_pointcloud", 1);
-  sub_rgb_image_.subscribe(node_handler_, "input_rgb_image", 1);
-
-  sub_pointcloud_.unsubscribe();
-  sub_rgb_image_.unsubscribe();
-
-  sync_input_ = boost::make_shared<message_filters::Synchronizer<ImageSyncPolicy>>(10);
-  sync_input_->connectInput(sub_pointcloud_, sub_rgb_image_);
-  sync_input_->registerCallback(
-      boost::bind(&BarrierTapeDetectionRos::synchronizedCallback, this, _1, _2));
+  frame_buffer_.reset(new FrameBuffer(node_handler_, "input_pointcloud", "input_rgb_image", 4, 10));
 
   current_state_ = INIT;
-  has_image_data_ = false;
 
   barrier_tape_cloud_ = boost::make_shared<pcl::PointCloud<pcl::PointXYZ>>();
 }
@@ -55,15 +46,6 @@ void BarrierTapeDetectionRos::dynamicReconfigCallback(
                               config.color_thresh_max_v);
 }
 
-void BarrierTapeDetectionRos::synchronizedCallback(
-    const sensor_msgs::PointCloud2::ConstPtr &pointcloud_msg,
-    const sensor_msgs::Image::ConstPtr &rgb_image_msg)
-{
-  pointcloud_msg_ = pointcloud_msg;
-  rgb_image_msg_ = rgb_image_msg;
-  has_image_data_ = true;
-}
-
 void BarrierTapeDetectionRos::eventCallback(const std_msgs::String &event_msg)
 {
   event_in_msg_ = event_msg;
@@ -91,8 +73,7 @@ void BarrierTapeDetectionRos::initState()
   if (event_in_msg_.data == "e_start") {
     current_state_ = IDLE;
     event_in_msg_.data = "";
-    sub_pointcloud_.subscribe();
-    sub_rgb_image_.subscribe();
+    frame_min_stamp_ = ros::Time::now() + ros::Duration(frame_settle_time_);
   } else {
     current_state_ = INIT;
   }
@@ -100,14 +81,14 @@ void BarrierTapeDetectionRos::initState()
 
 void BarrierTapeDetectionRos::idleState()
 {
+  ros::Time stamp;
   if (event_in_msg_.data == "e_stop") {
     current_state_ = INIT;
     event_in_msg_.data = "";
-    sub_pointcloud_.unsubscribe();
-    sub_rgb_image_.unsubscribe();
-  } else if (has_image_data_) {
+  } else if (frame_buffer_->getLatest(frame_min_stamp_, pointcloud_msg_, rgb_image_msg_, &stamp)) {
     current_state_ = RUNNING;
-    has_image_data_ = false;
+    // every pair is processed once
+    frame_min_stamp_ = stamp + ros::Duration(0, 1);
   } else {
     current_state_ = IDLE;
   }
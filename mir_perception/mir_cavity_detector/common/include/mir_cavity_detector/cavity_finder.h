@@ -4,6 +4,7 @@
 #include <pcl/PCLPointCloud2.h>
 #include <opencv2/core/core.hpp>
 #include <mas_perception_msgs/ImageList.h>
+#include <mir_perception_utils/artifact_recorder.h>
 
 /**
  * Finds 2D cavities after applying edge detection
@@ -126,6 +127,14 @@ public:
      */
     void setMinArea(double min_area_depth_image);
     void setMaxArea(double max_area_depth_image);
+
+    /**
+     * Save the depth image and the labeled cavity crops of every call as dataset
+     * frames, nothing is saved without recorder
+     * @param artifact_recorder
+     *          recorder with an open dataset, writes the frames in the background
+     */
+    void setArtifactRecorder(const mir_perception_utils::ArtifactRecorderPtr &artifact_recorder);
 private:
     /**
      * Copy constructor.
@@ -137,6 +146,11 @@ private:
      */
     CavityFinder &operator=(CavityFinder other);
 
+    /**
+     * Wall time stamp of the dataset frames
+     */
+    static uint64_t nowNanoseconds();
+
 
     cv::RNG rng;
 private:
@@ -168,5 +182,9 @@ private:
      * Max area for filtering cavities in DepthRGB image
      */
     double max_area_depth_image_;
+    /**
+     * Writes the debug frames, none are written if it is not set
+     */
+    mir_perception_utils::ArtifactRecorderPtr artifact_recorder_;
 };
 #endif
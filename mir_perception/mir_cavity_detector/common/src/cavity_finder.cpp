@@ -6,12 +6,12 @@
 #include <pcl/point_types.h>
 #include <pcl/filters/statistical_outlier_removal.h>
 #include <math.h>
+#include <chrono>
 #include <sys/time.h>
 #include <opencv2/imgproc/imgproc_c.h>
 
 #define PI 3.14159265
 
-#include <ros/ros.h>
 
 CavityFinder::CavityFinder() : rng(12345),canny_threshold_(220), canny_multiplier_(3),
     binary_threshold_(62),approx_poly_epsilon_(0.017),approx_poly_epsilon_finer_(0.009)
@@ -86,6 +86,9 @@ std::vector<std::string > CavityFinder::recognize2DCavities(const cv::Mat &image
     cv::blur(gray_image, gray_image, cv::Size(3, 3));
     small_image.copyTo(debug_image);
 
+    // debug frame with the labeled crops of the cavities
+    mir_perception_utils::DatasetFrame dataset_frame;
+
     cv::Size crop_size(120, 120);
     //After trials found that there is a shift of (20,10) between the rgbimage
     //and depth_rgb image
@@ -260,20 +263,28 @@ std::vector<std::string > CavityFinder::recognize2DCavities(const cv::Mat &image
 
         cv::putText( debug_image, label, centroids[i]+shift, 0, 0.8, color );
 
-        ////////////////////////////////DEbug images start
         cv::Rect rect_intersection = img_rect & crop_box[i];
         cv::Mat rgb_crop_image = small_image(rect_intersection);
-        unsigned long int sec= time(NULL);
-        std::string filename;//string which will contain the result
-        convert.str(""); //clearing the stringstream
-        convert <<"/tmp/crop_img_"<< cavities_name[i] << sec <<".jpg";//add the value of Number to the characters in the stream
-        filename = convert.str();//set Result to the content of the stream
 
         cropped_cavities.push_back(rgb_crop_image);
         // cv_image = cv_bridge::toCvCopy(*image, sensor_msgs::image_encodings::BGR8);
         // image_list.images[i] = img_msg;
-        cv::imwrite(filename, rgb_crop_image);
-        ////////////////////////////////DEbug images end
+
+        if (artifact_recorder_)
+        {
+            mir_perception_utils::DatasetObject object;
+            object.label = cavities_name[i];
+            object.image = rgb_crop_image;
+            dataset_frame.objects.push_back(object);
+        }
+    }
+
+    if (artifact_recorder_)
+    {
+        // written in the background, small_image is not modified afterwards
+        dataset_frame.stamp_ns = nowNanoseconds();
+        dataset_frame.image = small_image;
+        artifact_recorder_->recordFrame(dataset_frame);
     }
 
     return cavities_name;
@@ -304,14 +315,14 @@ std::vector<std::vector<cv::Point> > CavityFinder::find2DCavities(const cv::Mat
 
     cv::blur(gray_image, gray_image, cv::Size(3, 3));
 
-        ////////////////////////////////DEbug images start
-        unsigned long int sec= time(NULL);
-        std::string filename;//string which will contain the result
-        std::stringstream convert; // stringstream used for the conversion
-        convert <<"/tmp/depth_rgb_"<< sec<<".jpg";//add the value of Number to the characters in the stream
-        filename = convert.str();//set Result to the content of the stream
-        cv::imwrite(filename, small_image);
-        ////////////////////////////////DEbug images end
+        if (artifact_recorder_)
+        {
+            // written in the background, small_image is not modified afterwards
+            mir_perception_utils::DatasetFrame dataset_frame;
+            dataset_frame.stamp_ns = nowNanoseconds();
+            dataset_frame.image = small_image;
+            artifact_recorder_->recordFrame(dataset_frame);
+        }
     cv::Mat canny_output;
     cv::Mat threshold_output;
 
@@ -458,6 +469,17 @@ std::vector<pcl::PCLPointCloud2::Ptr> CavityFinder::get3DCavities(const std::vec
     return pcl_cavities;
 }
 
+void CavityFinder::setArtifactRecorder(const mir_perception_utils::ArtifactRecorderPtr &artifact_recorder)
+{
+    artifact_recorder_ = artifact_recorder;
+}
+
+uint64_t CavityFinder::nowNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
 void CavityFinder::setCannyThreshold(double canny_threshold)
 {
     canny_threshold_ = canny_threshold;
@@ -1,7 +1,10 @@
 #ifndef CONTOUR_FINDER_ROS_H_
 #define CONTOUR_FINDER_ROS_H_
 
+#include <memory>
+
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <mir_cavity_detector/cavity_finder.h>
 
 #include <image_transport/image_transport.h>
@@ -12,6 +15,8 @@
 #include <dynamic_reconfigure/server.h>
 #include <mir_cavity_detector/CavityFinderConfig.h>
 #include <tf/transform_listener.h>
+#include <mir_perception_utils/transform_cache.h>
+#include <mir_perception_utils/synchronized_frame_buffer.h>
 #include <geometry_msgs/PoseArray.h>
 #include <mas_perception_msgs/ImageList.h>
 #include <mas_perception_msgs/ObjectList.h>
@@ -19,7 +24,8 @@
 /**
  * ROS interface for cavity finder
  * Subscribes to:
- *  -pointcloud: pointcloud in which to find cavities
+ *  -pointcloud and image: synchronized, always subscribed. e_trigger uses the latest pair
+ *   stamped after e_trigger + frame_settle_time
  *
  * Publishes:
  *  -cavity pointclouds: array of cavities as pointclouds
@@ -31,14 +37,18 @@ class CavityFinderROS
 public:
     /**
      * Constructor
+     *
+     * @param nh
+     *          Private node handle of the node or nodelet
      */
-    CavityFinderROS();
+    explicit CavityFinderROS(const ros::NodeHandle &nh = ros::NodeHandle("~"));
     /**
      * Destructor
      */
     virtual ~CavityFinderROS();
     /**
-     * If pointcloud message has been received, the findCavities function is called.
+     * If a synchronized pointcloud and image have been received after the trigger,
+     * the findCavities function is called.
      * This function can be called once or periodically.
      */
     void update();
@@ -55,23 +65,6 @@ private:
      */
     CavityFinderROS &operator=(CavityFinderROS other);
 
-    /**
-     * Callback for pointcloud. Saves the pointcloud message.
-     *
-     * @param msg
-     *          sensor_msgs::PointCloud2 message
-     */
-    void pointcloudCallback(const sensor_msgs::PointCloud2::Ptr &msg);
-
-    /**
-     * Callback for rgb image
-     *
-     * @param msg
-     *          sensor_msgs::Image message
-     */
-    void imageCallback(const sensor_msgs::ImageConstPtr &msg);
-
-    void dummyImageCallback(const sensor_msgs::ImageConstPtr &msg);
     /**
      * Callback for cavities list
      *
@@ -81,7 +74,7 @@ private:
     void cavitiesCallback(const mas_perception_msgs::ObjectList &msg);
 
     /**
-     * Callback for event_in topic. Starts subscription to pointcloud if event_in is "e_trigger"
+     * Callback for event_in topic. Requests the next pointcloud and image if event_in is "e_trigger"
      */
     void eventInCallback(const std_msgs::String &msg);
 
@@ -123,19 +116,19 @@ private:
      */
     image_transport::ImageTransport it_;
     /**
-     * Subscriber for input pointcloud
+     * Latest synchronized input pointclouds and images
      */
-    ros::Subscriber sub_pointcloud_;
-
-    /**
-     * Subscriber for input image
-     */
-    image_transport::Subscriber sub_image_;
-    image_transport::Subscriber tmp_sub_image_;
+    typedef mir_perception_utils::SynchronizedFrameBuffer<sensor_msgs::PointCloud2, sensor_msgs::Image> FrameBuffer;
+    std::unique_ptr<FrameBuffer> frame_buffer_;
     /**
      * Subscriber for event_in topic
      */
     ros::Subscriber sub_event_in_;
+    /**
+     * Queue of the cavities name callback, served while findCavities waits for the names.
+     * Spinning the global queue would not reach the callback in a nodelet manager.
+     */
+    ros::CallbackQueue cavities_name_queue_;
     /**
     * Subscribe cavities name
     */
@@ -174,7 +167,7 @@ private:
     /**
      * Used to store pointcloud message received in callback
      */
-    sensor_msgs::PointCloud2::Ptr pointcloud_msg_;
+    sensor_msgs::PointCloud2::ConstPtr pointcloud_msg_;
 
     /**
      * Used to store rgb image message received in callback
@@ -186,13 +179,17 @@ private:
     dynamic_reconfigure::Server<mir_cavity_detector::CavityFinderConfig> dynamic_reconfigure_server_;
 
     /**
-     * Flag indicating whether pointcloud has been received
+     * Flag indicating whether a pointcloud and image are requested
      */
-    bool pointcloud_msg_received_;
+    bool frame_requested_;
     /**
-     * Flag indicating whether  has been received
+     * Minimum stamp of the requested pointcloud and image
      */
-    bool img_msg_received_;
+    ros::Time frame_min_stamp_;
+    /**
+     * Time after the trigger until the camera is considered settled
+     */
+    double frame_settle_time_;
 
     /**
     * int indicating cavities received
@@ -203,14 +200,6 @@ private:
      */
     double offset_in_z_;
 
-    /**
-     *  Hack Bug in Realsnese camera
-     *  https://mas.b-it-center.de/gitgate/mas-group/realsense_camera/issues/2
-     *  Need to receive the cloud image twice
-     */
-    int pointcloud_msg_received_count_;
-    int img_msg_received_count_ ;
-
     /**
      * Flag indicating whether debug image should be published
      */
@@ -234,6 +223,8 @@ private:
      * Object to TransformLister class handle frame transformations
      */
     tf::TransformListener listener_;
+    // transform of the cavity poses, resolved once per pointcloud
+    mir_perception_utils::TransformCache transform_cache_;
 
     /**
      * filter 2d cavities based on 3d cavities
@@ -0,0 +1,41 @@
+#include <memory>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+
+#include <mir_cavity_detector/cavity_finder_ros.h>
+
+namespace mir_cavity_detector
+{
+/**
+ * Runs the cavity finder in a nodelet manager, the pointcloud and image are then received
+ * from a camera driver nodelet without serialization.
+ * Parameters and topics are the same as for the cavity_finder node.
+ */
+class CavityFinderNodelet : public nodelet::Nodelet
+{
+private:
+    void onInit() override
+    {
+        ros::NodeHandle nh = getPrivateNodeHandle();
+        int frame_rate = 30;    // in Hz
+        nh.param<int>("frame_rate", frame_rate, 30);
+        cavity_finder_ros_.reset(new CavityFinderROS(nh));
+        update_timer_ = nh.createWallTimer(ros::WallDuration(1.0 / frame_rate),
+                                           &CavityFinderNodelet::updateCallback, this);
+        NODELET_INFO("[cavity_finder] nodelet started");
+    }
+
+    void updateCallback(const ros::WallTimerEvent &event)
+    {
+        cavity_finder_ros_->update();
+    }
+
+    std::unique_ptr<CavityFinderROS> cavity_finder_ros_;
+    ros::WallTimer update_timer_;
+};
+
+}  // namespace mir_cavity_detector
+
+PLUGINLIB_EXPORT_CLASS(mir_cavity_detector::CavityFinderNodelet, nodelet::Nodelet)
@@ -1,5 +1,7 @@
 #include <mir_cavity_detector/cavity_finder_ros.h>
 
+#include <algorithm>
+
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/image_encodings.h>
 #include <mas_perception_msgs/PointCloud2List.h>
@@ -27,10 +29,13 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <mas_perception_msgs/ImageList.h>
+#include <mir_perception_utils/principal_axes.h>
+
+namespace mpu = mir_perception_utils;
 
-CavityFinderROS::CavityFinderROS() : nh_("~"), it_(nh_),pointcloud_msg_received_(false), publish_debug_image_(true),
-                                     img_msg_received_(false), cavity_msg_received_count_(0), img_msg_received_count_(0),pointcloud_msg_received_count_(0),
-                                     offset_in_z_(0.055)
+CavityFinderROS::CavityFinderROS(const ros::NodeHandle &nh) : nh_(nh), it_(nh_), dynamic_reconfigure_server_(nh_), publish_debug_image_(true),
+                                     frame_requested_(false), frame_settle_time_(0.0), cavity_msg_received_count_(0),
+                                     offset_in_z_(0.055), transform_cache_(listener_)
 {
     dynamic_reconfigure_server_.setCallback(boost::bind(&CavityFinderROS::dynamicReconfigCallback, this, _1, _2));
     pub_cavity_pointclouds_ = nh_.advertise<mas_perception_msgs::PointCloud2List>("output/pointclouds", 1);
@@ -41,57 +46,59 @@ CavityFinderROS::CavityFinderROS() : nh_("~"), it_(nh_),pointcloud_msg_received_
     pub_cavity_ = nh_.advertise<mas_perception_msgs::Cavity>("output/cavity", 10);
     pub_cropped_cavities_ = nh_.advertise<mas_perception_msgs::ImageList>("output/cropped_cavities", 10);
     
-    sub_cavities_name = nh_.subscribe("output/cavities_list", 10, &CavityFinderROS::cavitiesCallback, this);
-    
+    ros::NodeHandle cavities_name_nh(nh_);
+    cavities_name_nh.setCallbackQueue(&cavities_name_queue_);
+    sub_cavities_name = cavities_name_nh.subscribe("output/cavities_list", 10, &CavityFinderROS::cavitiesCallback, this);
+
     sub_event_in_ = nh_.subscribe("input/event_in", 1, &CavityFinderROS::eventInCallback, this);
     pub_event_out_ = nh_.advertise<std_msgs::String>("output/event_out", 1 );
 
     nh_.param<std::string>("target_frame", target_frame_, "base_link");
     nh_.param<std::string>("source_frame", source_frame_, "arm_cam4d_rgb_optical_frame");
-}
 
-CavityFinderROS::~CavityFinderROS()
-{
-}
-
-void CavityFinderROS::update()
-{
-    //if (pointcloud_msg_received_ && img_msg_received_)
-    if (pointcloud_msg_received_count_ > 1 && img_msg_received_count_ > 1 )
+    // the inputs stay subscribed, so that e_trigger does not wait for the subscription
+    nh_.param<double>("frame_settle_time", frame_settle_time_, 0.0);
+    int frame_buffer_size;
+    nh_.param<int>("frame_buffer_size", frame_buffer_size, 4);
+    frame_buffer_.reset(new FrameBuffer(nh_, "input/pointcloud", "image", std::max(frame_buffer_size, 1)));
+
+    // the depth and cropped cavity images are only saved on request, in the background,
+    // into a dataset that can be read by the feature_extraction_from_dataset tool
+    bool save_debug_images;
+    nh_.param<bool>("save_debug_images", save_debug_images, false);
+    if (save_debug_images)
     {
-        pointcloud_msg_received_ = false;
-        img_msg_received_ = false;
-        pointcloud_msg_received_count_ = 0;
-        img_msg_received_count_ = 0;
-        sub_pointcloud_.shutdown();
-        sub_image_.shutdown();
-        tmp_sub_image_.shutdown();
-        findCavities();
-        /* sub_cavities_name.shutdown(); */
+        std::string logdir;
+        nh_.param<std::string>("logdir", logdir, "/tmp/");
+        if (!logdir.empty() && logdir[logdir.size() - 1] != '/')
+        {
+            logdir += "/";
+        }
+        const std::string dataset_dir = logdir + "cavity_dataset_" + std::to_string(ros::Time::now().sec);
+        mpu::ArtifactRecorderPtr artifact_recorder = std::make_shared<mpu::ArtifactRecorder>();
+        if (artifact_recorder->openDataset(dataset_dir))
+        {
+            cavity_finder_.setArtifactRecorder(artifact_recorder);
+            ROS_INFO_STREAM("Saving debug images to " << dataset_dir);
+        }
+        else
+        {
+            ROS_ERROR_STREAM("Cannot create dataset " << dataset_dir);
+        }
     }
 }
 
-void CavityFinderROS::pointcloudCallback(const sensor_msgs::PointCloud2::Ptr &msg)
+CavityFinderROS::~CavityFinderROS()
 {
-    if (! pointcloud_msg_received_ )
-    {
-        ROS_INFO("[cavity_finder_ros] Received pointcloud message");
-        pointcloud_msg_ = msg;
-        //pointcloud_msg_received_ = true;
-        pointcloud_msg_received_count_ += 1;
-        //sub_pointcloud_.shutdown();
-    }
 }
 
-void CavityFinderROS::imageCallback(const sensor_msgs::ImageConstPtr &msg)
+void CavityFinderROS::update()
 {
-    if (! img_msg_received_)
+    if (frame_requested_ && frame_buffer_->getLatest(frame_min_stamp_, pointcloud_msg_, rgb_image_))
     {
-        ROS_INFO("[cavity_finder_ros] Received rgb image ");
-        rgb_image_ = msg;
-        //img_msg_received_ = true; 
-        img_msg_received_count_ += 1;
-        //sub_image_.shutdown();
+        ROS_INFO("[cavity_finder_ros] Received pointcloud and rgb image");
+        frame_requested_ = false;
+        findCavities();
     }
 }
 
@@ -114,10 +121,12 @@ void CavityFinderROS::eventInCallback(const std_msgs::String &msg)
     {
         cavity_list_.objects.clear();
         cavity_msg_received_count_ = 0;
-        sub_pointcloud_ = nh_.subscribe("input/pointcloud", 1, &CavityFinderROS::pointcloudCallback, this);
-        /* sub_cavities_name = nh_.subscribe("output/cavities_list", 10, &CavityFinderROS::cavitiesCallback, this); */
-        sub_image_ = it_.subscribe("image", 1, &CavityFinderROS::imageCallback, this);
-        ROS_INFO("Subscribed to pointcloud and RGB image");
+        // names received before the trigger belong to an older request
+        cavities_name_queue_.clear();
+        // pointclouds and images captured before the camera settled are skipped
+        frame_min_stamp_ = ros::Time::now() + ros::Duration(frame_settle_time_);
+        frame_requested_ = true;
+        ROS_INFO("Waiting for pointcloud and RGB image");
     }
 }
 
@@ -226,12 +235,10 @@ void CavityFinderROS::findCavities()
     std::vector<std::string> cavities_name;
     // ROS_INFO_STREAM("cavity_msg value " << cavity_msg_received_count_);
     int frame_rate = 30;
-    ros::Rate loop_rate(frame_rate);
 
-    while (cavity_msg_received_count_ == 0){
+    while (cavity_msg_received_count_ == 0 && nh_.ok()){
 
-        loop_rate.sleep();
-        ros::spinOnce();
+        cavities_name_queue_.callAvailable(ros::WallDuration(1.0 / frame_rate));
 
     }
 
@@ -303,6 +310,7 @@ geometry_msgs::PoseArray CavityFinderROS::estimatePose(std::vector<pcl::PCLPoint
 {
     geometry_msgs::PoseArray pose_array;
 
+    std::vector<geometry_msgs::PoseStamped> poses;
     for (size_t i = 0; i < pcl_cavities.size(); i++)
     {
         //pcl::PCLPointCloud2::Ptr pcl_input_cloud(new pcl::PCLPointCloud2);
@@ -312,35 +320,17 @@ geometry_msgs::PoseArray CavityFinderROS::estimatePose(std::vector<pcl::PCLPoint
         pcl::PointCloud<pcl::PointXYZ>::Ptr xyz_input_cloud(new pcl::PointCloud<pcl::PointXYZ>);
         pcl::fromPCLPointCloud2(*(pcl_cavities[i]), *xyz_input_cloud);
 
-        Eigen::Vector4f centroid;
-        pcl::compute3DCentroid(*xyz_input_cloud, centroid);
-
-        Eigen::Matrix3f covariance;
-        pcl::computeCovarianceMatrixNormalized(*xyz_input_cloud, centroid, covariance);
-
-        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> eigen_solver(covariance, Eigen::ComputeEigenvectors);
-        Eigen::Matrix3f eigen_vectors = eigen_solver.eigenvectors();
-
-        // swap largest and second largest eigenvector so that y-axis aligns with largest eigenvector and z with the second largest
-        eigen_vectors.col(0).swap(eigen_vectors.col(2));
-        eigen_vectors.col(1) = eigen_vectors.col(2).cross(eigen_vectors.col(0));
-
-        Eigen::Matrix4f eigen_vector_transform(Eigen::Matrix4f::Identity());
-        eigen_vector_transform.block<3, 3>(0, 0) = eigen_vectors.transpose();
-        eigen_vector_transform.block<3, 1>(0, 3) = -(eigen_vector_transform.block<3, 3>(0, 0) * centroid.head<3>());
-
-        // transform cloud to eigenvector space
-        pcl::PointCloud<pcl::PointXYZ> transformed_cloud;
-        pcl::transformPointCloud(*xyz_input_cloud, transformed_cloud, eigen_vector_transform);
-
-        // find mean diagonal
-        pcl::PointXYZ min_point, max_point;
-        pcl::getMinMax3D(transformed_cloud, min_point, max_point);
-        Eigen::Vector3f mean_diag = (max_point.getVector3fMap() + min_point.getVector3fMap()) / 2.0;
-
-        // orientation and position of bounding box of cloud
-        Eigen::Quaternionf orientation(eigen_vectors);
-        Eigen::Vector3f position = eigen_vectors * mean_diag + centroid.head<3>();
+        // orientation and position of the box aligned with the principal axes
+        mpu::pointcloud::OrientedBox box;
+        if (!mpu::pointcloud::computeOrientedBox(*xyz_input_cloud, box))
+        {
+            // keep the pose array aligned with the cavity names
+            ROS_WARN("Cavity %zu has no valid points", i);
+            box.axes.setIdentity();
+            box.center.setZero();
+        }
+        Eigen::Quaternionf orientation(box.axes);
+        const Eigen::Vector3f &position = box.center;
 
         geometry_msgs::PoseStamped pose_stamped;
         pose_stamped.pose.position.x = position(0);
@@ -351,20 +341,21 @@ geometry_msgs::PoseArray CavityFinderROS::estimatePose(std::vector<pcl::PCLPoint
         pose_stamped.pose.orientation.y = orientation.y();
         pose_stamped.pose.orientation.z = orientation.z();
         pose_stamped.header = pointcloud_msg_->header;
-        //std::cout<<"frame id "<<pose_stamped.header.frame_id<<std::endl;
-        //Converting to baselink or provided link
-        geometry_msgs::PoseStamped pose_in_baselink_stamped;
-        std::cout<<"target frame "<<target_frame_<<std::endl;
-        try
-        {
-            listener_.waitForTransform(target_frame_, pose_stamped.header.frame_id, pose_stamped.header.stamp, ros::Duration(3.0));
-            listener_.transformPose(target_frame_, pose_stamped, pose_in_baselink_stamped);
-        }
-        catch (tf::TransformException ex)
-        {
-            ROS_ERROR("%s", ex.what());
-        }
+        poses.push_back(pose_stamped);
+    }
 
+    //Converting to baselink or provided link, one transform for all cavities of the cloud
+    ROS_DEBUG("Transforming %zu cavity poses to %s", poses.size(), target_frame_.c_str());
+    if (!transform_cache_.transformPoses(target_frame_, poses,
+                                         ros::WallTime::now() + ros::WallDuration(3.0)))
+    {
+        ROS_ERROR("No transform from %s to %s", pointcloud_msg_->header.frame_id.c_str(),
+                  target_frame_.c_str());
+    }
+
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+        geometry_msgs::PoseStamped &pose_in_baselink_stamped = poses[i];
         tf::Quaternion temp;
         tf::quaternionMsgToTF(pose_in_baselink_stamped.pose.orientation, temp);
         tf::Matrix3x3 m(temp);
@@ -4,24 +4,45 @@
 #include "opencv2/highgui/highgui.hpp"
 #include<dirent.h>
 #include<string.h>
+#include<mir_perception_utils/perception_dataset.h>
 
 using namespace std;
 using namespace cv;
 
 RNG rng(12345);
-void extract_features(string image_path, ofstream &output, string image_name);
-int main()
+void extract_features(const Mat &src, ofstream &output, string image_name, bool show);
+
+// Features of the labeled cavity crops of a dataset recorded by the cavity finder
+// (save_debug_images), one line per object
+int extract_from_dataset(const mir_perception_utils::DatasetReader &reader, ofstream &output, bool show)
 {
-    string dirName = "/home/deebuls/ros/indigo/src/unmerged_packages_for_testing/perception/mir_cavity_detector/tools/dataset_new/";
+    mir_perception_utils::DatasetObject object;
+    for (size_t i = 0; i < reader.getObjectCount(); i++)
+    {
+        if (!reader.readObject(i, object) || object.label.empty() || object.image.empty())
+            continue;
+        output << object.label << ",";
+        extract_features(object.image, output, object.label + "_" + to_string(i), show);
+    }
+    return 0;
+}
+
+// Features of the images of a directory with one sub directory per label
+int extract_from_image_dir(const string &image_dir, ofstream &output, bool show)
+{
+    string dirName = image_dir;
+    if (dirName[dirName.size() - 1] != '/')
+        dirName.append("/");
     DIR *dir;
     dir = opendir(dirName.c_str());
     string obj_name;
     string image_name;
     struct dirent *ent;
-    ofstream OutputFileName ;
-    OutputFileName.open("cavityFeatures_m20_100.csv");         //Opening file to print info to
-    OutputFileName << "Object_name,Contour1,contour2,contour3,radius,area,aspect_ratio,isConvex,hu0,hu1,hu2,hu3" << endl;          //Headings for file
-    if (dir != NULL) {
+    if (dir == NULL)
+    {
+        cout<<"not present"<<endl;
+        return 1;
+    }
     while ((ent = readdir (dir)) != NULL) {
         obj_name= ent->d_name;
         //I found some . and .. files here so I reject them.
@@ -33,6 +54,8 @@ int main()
             object_path.append(obj_name);
             DIR *obj_dir;
             obj_dir = opendir(object_path.c_str());
+            if (obj_dir == NULL)
+                continue;
             while ((image_ptr = readdir (obj_dir)) != NULL) {
 
                 image_name= image_ptr->d_name;
@@ -43,27 +66,61 @@ int main()
                     image_path.append(obj_name);
                     image_path.append("/");
                     image_path.append(image_name);
-                    OutputFileName << obj_name <<",";
-                    extract_features(image_path, OutputFileName, image_name);
-                    //Mat image= imread(image_path);
-                    //imshow(obj_name,image);
-                    //waitKey(0);
+                    cout << image_path << endl;
+                    /// Load source image
+                    Mat src = imread( image_path , CV_LOAD_IMAGE_COLOR);
+                    if  (! src.data)
+                    {
+                        cout<<"Read Failed" << endl;
+                        continue;
+                    }
+                    output << obj_name <<",";
+                    extract_features(src, output, image_name, show);
                 }
             }
             closedir (obj_dir);
         }
     }
     closedir (dir);
-    OutputFileName.close();
-} else {
-    cout<<"not present"<<endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        cout << "Usage: " << argv[0] << " <dataset_dir|image_dir> [output.csv] [--show]" << endl;
+        return 1;
+    }
+    const string input_dir = argv[1];
+    string output_file = "cavityFeatures.csv";
+    bool show = false;
+    for (int i = 2; i < argc; i++)
+    {
+        if (string(argv[i]) == "--show")
+            show = true;
+        else
+            output_file = argv[i];
     }
+
+    ofstream OutputFileName ;
+    OutputFileName.open(output_file.c_str());         //Opening file to print info to
+    OutputFileName << "Object_name,Contour1,contour2,contour3,radius,area,aspect_ratio,isConvex,hu0,hu1,hu2,hu3" << endl;          //Headings for file
+
+    int result;
+    // a dataset directory contains the chunk files of the dataset writer
+    mir_perception_utils::DatasetReader reader;
+    if (reader.open(input_dir))
+        result = extract_from_dataset(reader, OutputFileName, show);
+    else
+        result = extract_from_image_dir(input_dir, OutputFileName, show);
+    OutputFileName.close();
+    return result;
 }
 
-void extract_features(string image_path, ofstream &output, string image_name)
+void extract_features(const Mat &src, ofstream &output, string image_name, bool show)
 {
 
-    cout << image_path << endl;
     int thresh = 52;
     double epsilon_1 = 0.03;
     double epsilon_2 = 0.007;
@@ -73,14 +130,7 @@ void extract_features(string image_path, ofstream &output, string image_name)
     int morph_operator = 0;
     int operation = morph_operator + 2;
     /// Global variables
-    Mat src, dst, src_gray;
-    /// Load source image and convert it to gray
-    src = imread( image_path , CV_LOAD_IMAGE_COLOR);
-    if  (! src.data)
-    {
-        cout<<"Read Failed" << endl;
-        return;
-    }
+    Mat dst, src_gray;
 /// Convert image to gray and blur it
     cvtColor( src, src_gray, cv::COLOR_BGR2GRAY );
     blur( src_gray, src_gray, Size(3,3) );
@@ -173,6 +223,8 @@ void extract_features(string image_path, ofstream &output, string image_name)
     }
     output << endl;
 
+  if (!show)
+     return;
 
   Mat drawing ;
   src.copyTo(drawing) ;
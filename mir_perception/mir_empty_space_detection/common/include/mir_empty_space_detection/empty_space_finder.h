@@ -0,0 +1,60 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_EMPTY_SPACE_DETECTION_EMPTY_SPACE_FINDER_H
+#define MIR_EMPTY_SPACE_DETECTION_EMPTY_SPACE_FINDER_H
+
+#include <random>
+#include <vector>
+
+#include <pcl/filters/extract_indices.h>
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include <mir_perception_utils/aliases.h>
+
+/** \brief Samples empty spaces on a plane. A sample is accepted if the
+ * circle around it is covered well enough by plane points, the points of
+ * accepted samples are removed before the next sample is checked.
+ */
+class EmptySpaceFinder
+{
+ public:
+  /** \brief Constructor, the random generator is seeded with the current time */
+  EmptySpaceFinder();
+  /** \brief Destructor */
+  virtual ~EmptySpaceFinder();
+
+  /** \brief Set the parameters of a single empty space
+   * \param[in] Radius of an empty space
+   * \param[in] Expected number of plane points within the radius
+   * \param[in] Minimum ratio of found to expected points
+   * */
+  void setParams(float empty_space_radius, float expected_num_of_points,
+                 float point_count_percentage_threshold);
+
+  /** \brief Seed the random generator, e.g. for reproducible benchmarks */
+  void setSeed(unsigned int seed) { generator_.seed(seed); }
+
+  /** \brief Find empty spaces on the plane
+   * \param[in] Plane point cloud
+   * \param[in] Number of empty spaces required
+   * \param[in] Time budget in seconds for the attempts
+   * \param[out] Centers of the empty spaces
+   * \param[out] Number of attempts
+   * \return true if all the required empty spaces were found
+   * */
+  bool findEmptySpaces(const PointCloud::ConstPtr &plane, int num_of_empty_spaces,
+                       double trial_duration, std::vector<PointT> &empty_spaces, int &attempts);
+
+ private:
+  float empty_space_radius_;
+  float expected_num_of_points_;
+  float point_count_percentage_threshold_;
+
+  std::mt19937 generator_;
+  pcl::KdTreeFLANN<PointT> kdtree_;
+  pcl::ExtractIndices<PointT> extract_indices_;
+};
+
+#endif  // MIR_EMPTY_SPACE_DETECTION_EMPTY_SPACE_FINDER_H
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <chrono>
+#include <ctime>
+
+#include <mir_empty_space_detection/empty_space_finder.h>
+
+EmptySpaceFinder::EmptySpaceFinder()
+    : empty_space_radius_(0.05),
+      expected_num_of_points_(1.0),
+      point_count_percentage_threshold_(0.8),
+      generator_(static_cast<unsigned int>(time(NULL)))
+{
+}
+
+EmptySpaceFinder::~EmptySpaceFinder() {}
+
+void EmptySpaceFinder::setParams(float empty_space_radius, float expected_num_of_points,
+                                 float point_count_percentage_threshold)
+{
+  empty_space_radius_ = empty_space_radius;
+  expected_num_of_points_ = expected_num_of_points;
+  point_count_percentage_threshold_ = point_count_percentage_threshold;
+}
+
+bool EmptySpaceFinder::findEmptySpaces(const PointCloud::ConstPtr &plane, int num_of_empty_spaces,
+                                       double trial_duration, std::vector<PointT> &empty_spaces,
+                                       int &attempts)
+{
+  empty_spaces.clear();
+  attempts = 0;
+  if (plane->points.empty()) return false;
+
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point end_time =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(trial_duration));
+  std::uniform_int_distribution<size_t> distribution(0, plane->points.size() - 1);
+
+  PointCloud::Ptr new_plane(new PointCloud);
+  pcl::PointIndices::Ptr empty_space(new pcl::PointIndices());
+  std::vector<PointT> samples;
+  std::vector<int> ids;
+  std::vector<float> sq_distances;
+  while (Clock::now() < end_time) {
+    attempts++;
+    *new_plane = *plane;
+
+    samples.clear();
+    for (int i = 0; i < num_of_empty_spaces; ++i) {
+      samples.push_back(plane->points[distribution(generator_)]);
+    }
+
+    bool success = true;
+    for (const PointT &p : samples) {
+      kdtree_.setInputCloud(new_plane);
+      if (kdtree_.radiusSearch(p, empty_space_radius_, ids, sq_distances) > 0) {
+        if (((float)ids.size() / expected_num_of_points_) > point_count_percentage_threshold_) {
+          empty_space->indices = ids;
+          extract_indices_.setInputCloud(new_plane);
+          extract_indices_.setIndices(empty_space);
+          extract_indices_.setNegative(true);
+          extract_indices_.filter(*new_plane);
+        } else {
+          success = false;
+          break;
+        }
+      }
+    }
+    if (success) {
+      empty_spaces = samples;
+      return true;
+    }
+  }
+  return false;
+}
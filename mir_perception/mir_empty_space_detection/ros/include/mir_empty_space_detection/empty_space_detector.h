@@ -5,15 +5,13 @@
 
 #include <geometry_msgs/PoseArray.h>
 #include <pcl/ModelCoefficients.h>
-#include <pcl/PointIndices.h>
-#include <pcl/filters/extract_indices.h>
-#include <pcl/kdtree/kdtree_flann.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <std_msgs/String.h>
 
 #include <dynamic_reconfigure/server.h>
 #include <mir_empty_space_detection/EmptySpaceDetectionConfig.h>
 
+#include <mir_empty_space_detection/empty_space_finder.h>
 #include <mir_object_segmentation/cloud_accumulation.h>
 #include <mir_object_segmentation/scene_segmentation.h>
 #include <mir_perception_utils/pointcloud_utils_ros.h>
@@ -23,7 +21,10 @@ namespace mpu = mir_perception_utils;
 class EmptySpaceDetector
 {
  public:
-  EmptySpaceDetector();
+  /** \brief Constructor
+   * \param[in] Private NodeHandle of the node or nodelet
+   */
+  explicit EmptySpaceDetector(const ros::NodeHandle &nh = ros::NodeHandle("~"));
   virtual ~EmptySpaceDetector();
 
  private:
@@ -39,9 +40,6 @@ class EmptySpaceDetector
   std::string output_frame_;
   bool enable_debug_pc_pub_;
   bool add_to_octree_;
-  float empty_space_radius_;
-  float expected_num_of_points_;
-  float empty_space_pnt_cnt_perc_thresh_;
   bool find_empty_spaces_;
   /* int retry_attempts_; */
   /* int num_of_retries_; */
@@ -51,8 +49,7 @@ class EmptySpaceDetector
   SceneSegmentationSPtr scene_segmentation_;
   CloudAccumulation::UPtr cloud_accumulation_;
 
-  pcl::KdTreeFLANN<PointT> kdtree_;
-  pcl::ExtractIndices<PointT> extract_indices_;
+  EmptySpaceFinder empty_space_finder_;
 
   void pcCallback(const sensor_msgs::PointCloud2::ConstPtr &msg);
   void eventInCallback(const std_msgs::String::ConstPtr &msg);
@@ -1,10 +1,8 @@
 #include <geometry_msgs/Pose.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <mir_empty_space_detection/empty_space_detector.h>
-#include <stdlib.h>
-#include <time.h>
 
-EmptySpaceDetector::EmptySpaceDetector() : nh_("~")
+EmptySpaceDetector::EmptySpaceDetector(const ros::NodeHandle &nh) : nh_(nh), server_(nh_)
 {
   
   nh_.param<std::string>("output_frame", output_frame_, "base_link");
@@ -73,15 +71,18 @@ void EmptySpaceDetector::loadParams()
 
   float object_height_above_workspace_;
   int num_of_empty_spaces_required;
+  float empty_space_radius, empty_space_pnt_cnt_perc_thresh;
   nh_.param<float>("object_height_above_workspace", object_height_above_workspace_, 0.01);
-  nh_.param<float>("empty_space_point_count_percentage_threshold", empty_space_pnt_cnt_perc_thresh_,
+  nh_.param<float>("empty_space_point_count_percentage_threshold", empty_space_pnt_cnt_perc_thresh,
                    0.8);
   //add no of empty space locations as a parameter
   nh_.param<int>("num_of_empty_spaces_required", num_of_empty_spaces_required, 3);
 
-  nh_.param<float>("empty_space_radius", empty_space_radius_, 0.05);
-  expected_num_of_points_ =
-      (empty_space_radius_ * empty_space_radius_ * M_PI) / (voxel_leaf_size * voxel_leaf_size);
+  nh_.param<float>("empty_space_radius", empty_space_radius, 0.05);
+  float expected_num_of_points =
+      (empty_space_radius * empty_space_radius * M_PI) / (voxel_leaf_size * voxel_leaf_size);
+  empty_space_finder_.setParams(empty_space_radius, expected_num_of_points,
+                                empty_space_pnt_cnt_perc_thresh);
 }
 
 void EmptySpaceDetector::eventInCallback(const std_msgs::String::ConstPtr &msg)
@@ -112,13 +113,12 @@ void EmptySpaceDetector::eventInCallback(const std_msgs::String::ConstPtr &msg)
 void EmptySpaceDetector::pcCallback(const sensor_msgs::PointCloud2::ConstPtr &msg)
 {
   if (add_to_octree_) {
-    sensor_msgs::PointCloud2 msg_transformed;
-    if (!mpu::pointcloud::transformPointCloudMsg(tf_listener_, output_frame_, *msg,
-                                                 msg_transformed))
-      return;
-
     PointCloud::Ptr input_pc(new PointCloud);
-    pcl::fromROSMsg(msg_transformed, *input_pc);
+    mpu::pointcloud::ConversionFilter filter;
+    filter.remove_nans = true;
+    if (!mpu::pointcloud::transformPointCloudMsg(tf_listener_, output_frame_, *msg, *input_pc,
+                                                 filter))
+      return;
 
     cloud_accumulation_->addCloud(input_pc);
 
@@ -154,62 +154,31 @@ bool EmptySpaceDetector::findEmptySpaces()
 void EmptySpaceDetector::findEmptySpacesOnPlane(const PointCloud::Ptr &plane,
                                                 geometry_msgs::PoseArray &empty_space_poses)
 {
-  srand(time(NULL));
   int num_of_empty_spaces_required;
   nh_.param<int>("num_of_empty_spaces_required", num_of_empty_spaces_required, 3);
 
   float trial_duration_sec;
   nh_.param<float>("trial_duration", trial_duration_sec, 3.0);
-  ros::Duration trial_duration(trial_duration_sec);
-  ros::Time start_time = ros::Time::now();
 
   empty_space_poses.header.frame_id = output_frame_;
   empty_space_poses.header.stamp = ros::Time::now();
-  int attempts = 0;
 
-  while (ros::Time::now() - start_time < trial_duration) {
-    attempts++;
-    ROS_DEBUG_STREAM("Attempt: " << attempts);
-    PointCloud::Ptr new_plane(new PointCloud);
-    pcl::copyPointCloud(*plane, *new_plane);
-    pcl::PointIndices::Ptr empty_space(new pcl::PointIndices());
-
-    std::vector<PointT> samples;
-    for (int i = 0; i < num_of_empty_spaces_required; ++i) {
-      int random_index = rand() % new_plane->width;
-      samples.push_back(new_plane->points[random_index]);
-    }
+  std::vector<PointT> empty_spaces;
+  int attempts = 0;
+  if (!empty_space_finder_.findEmptySpaces(plane, num_of_empty_spaces_required,
+                                           trial_duration_sec, empty_spaces, attempts)) {
+    ROS_DEBUG_STREAM("No solution after " << attempts << " attempts");
+    return;
+  }
 
-    bool success = true;
-    for (PointT p : samples) {
-      std::vector<int> ids;
-      std::vector<float> sq_distances;
-      kdtree_.setInputCloud(new_plane);
-      if (kdtree_.radiusSearch(p, empty_space_radius_, ids, sq_distances) > 0) {
-        if (((float)ids.size() / expected_num_of_points_) > empty_space_pnt_cnt_perc_thresh_) {
-          empty_space->indices = ids;
-          extract_indices_.setInputCloud(new_plane);
-          extract_indices_.setIndices(empty_space);
-          extract_indices_.setNegative(true);
-          extract_indices_.filter(*new_plane);
-        } else {
-          success = false;
-          break;
-        }
-      }
-    }
-    if (success) {
-      ROS_INFO_STREAM("Found solution at attempt: " << attempts);
-      for (PointT p : samples) {
-        geometry_msgs::Pose pose;
-        pose.position.x = p.x;
-        pose.position.y = p.y;
-        pose.position.z = p.z;
-        pose.orientation.w = 1.0;
-        empty_space_poses.poses.push_back(pose);
-      }
-      break;
-    }
+  ROS_INFO_STREAM("Found solution at attempt: " << attempts);
+  for (const PointT &p : empty_spaces) {
+    geometry_msgs::Pose pose;
+    pose.position.x = p.x;
+    pose.position.y = p.y;
+    pose.position.z = p.z;
+    pose.orientation.w = 1.0;
+    empty_space_poses.poses.push_back(pose);
   }
 }
 
@@ -249,15 +218,3 @@ void EmptySpaceDetector::configCallback(mir_empty_space_detection::EmptySpaceDet
   scene_segmentation_->setCropBoxParams(config.enable_cropbox_filter, config.cropbox_filter_min_x, config.cropbox_filter_max_x,
       config.cropbox_filter_min_y, config.cropbox_filter_max_y, config.cropbox_filter_min_z, config.cropbox_filter_max_z);
 }
-
-int main(int argc, char *argv[])
-{
-  ros::init(argc, argv, "empty_space_detector");
-  EmptySpaceDetector es_detector;
-  ros::Rate loop_rate(30.0);
-  while (ros::ok()) {
-    ros::spinOnce();
-    loop_rate.sleep();
-  }
-  return 0;
-}
@@ -0,0 +1,13 @@
+#include <mir_empty_space_detection/empty_space_detector.h>
+
+int main(int argc, char *argv[])
+{
+  ros::init(argc, argv, "empty_space_detector");
+  EmptySpaceDetector es_detector;
+  ros::Rate loop_rate(30.0);
+  while (ros::ok()) {
+    ros::spinOnce();
+    loop_rate.sleep();
+  }
+  return 0;
+}
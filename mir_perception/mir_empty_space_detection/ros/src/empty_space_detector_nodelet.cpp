@@ -0,0 +1,28 @@
+#include <memory>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <mir_empty_space_detection/empty_space_detector.h>
+
+namespace mir_empty_space_detection
+{
+/** \brief Runs the empty space detector in a nodelet manager. It is always subscribed to the
+ * pointcloud, in the manager of the camera driver the pointclouds are passed as shared
+ * pointers instead of being serialized. Parameters and topics are the same as for the
+ * empty_space_detector node.
+ */
+class EmptySpaceDetectorNodelet : public nodelet::Nodelet
+{
+ private:
+  void onInit() override
+  {
+    es_detector_.reset(new EmptySpaceDetector(getPrivateNodeHandle()));
+  }
+
+  std::unique_ptr<EmptySpaceDetector> es_detector_;
+};
+
+}  // namespace mir_empty_space_detection
+
+PLUGINLIB_EXPORT_CLASS(mir_empty_space_detection::EmptySpaceDetectorNodelet, nodelet::Nodelet)
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_OBJECT_RECOGNITION_MULTIMODAL_OBJECT_RECOGNITION_H
+#define MIR_OBJECT_RECOGNITION_MULTIMODAL_OBJECT_RECOGNITION_H
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <cv_bridge/cv_bridge.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <mas_perception_msgs/ObjectList.h>
+
+#include <mir_object_recognition/SceneSegmentationConfig.h>
+#include <mir_object_recognition/multimodal_object_recognition_utils.h>
+#include <mir_object_segmentation/scene_segmentation_ros.h>
+#include <mir_perception_utils/aliases.h>
+
+struct Object
+{
+  std::string name;
+  std::string shape;
+  std::string color;
+};
+
+typedef std::vector<Object> ObjectInfo;
+
+/** \brief Recognizer, ROI and fusion parameters of the dynamic reconfigure config. Every frame
+ * keeps a copy, so a reconfigure does not change the parameters of a frame in flight */
+struct RecognitionParams
+{
+  bool enable_rgb_recognizer;
+  bool enable_pc_recognizer;
+  std::string obj_category;
+  double object_height_above_workspace;
+  double height_of_floor;
+  bool use_fixed_heights;
+  double container_height;
+  int rgb_roi_adjustment;
+  int rgb_bbox_min_diag;
+  int rgb_bbox_max_diag;
+  double rgb_cluster_filter_limit_min;
+  double rgb_cluster_filter_limit_max;
+  bool enable_roi;
+  double roi_base_link_to_laser_distance;
+  double roi_max_object_pose_x_to_base_link;
+  double roi_min_bbox_z;
+  bool rgb_cluster_remove_outliers;
+  double rgb_cluster_outlier_threshold;
+
+  RecognitionParams()
+    : enable_rgb_recognizer(true),
+      enable_pc_recognizer(true),
+      obj_category("atwork"),
+      object_height_above_workspace(0.0),
+      height_of_floor(0.0),
+      use_fixed_heights(false),
+      container_height(0.05),
+      rgb_roi_adjustment(2),
+      rgb_bbox_min_diag(21),
+      rgb_bbox_max_diag(250),
+      rgb_cluster_filter_limit_min(0.0),
+      rgb_cluster_filter_limit_max(0.0),
+      enable_roi(true),
+      roi_base_link_to_laser_distance(0.0),
+      roi_max_object_pose_x_to_base_link(0.0),
+      roi_min_bbox_z(0.03),
+      rgb_cluster_remove_outliers(true),
+      rgb_cluster_outlier_threshold(3.0)
+  {
+  }
+};
+
+/** \brief Data of one synchronized pointcloud and image pair on its way through recognition */
+struct RecognitionFrame
+{
+  // Request id used for the recognizers
+  uint32_t id;
+  // Parameters at the time the frame was segmented
+  RecognitionParams params;
+  sensor_msgs::ImageConstPtr image;
+  sensor_msgs::PointCloud2ConstPtr cloud_msg;
+  // Pointcloud in the target frame
+  PointCloud::Ptr cloud;
+  double workspace_height;
+  // 3D object list with unknown label and table top clusters
+  mas_perception_msgs::ObjectList cloud_object_list;
+  std::vector<PointCloud::Ptr> clusters_3d;
+  // Recognizer results
+  mas_perception_msgs::ObjectList recognized_cloud_list;
+  mas_perception_msgs::ObjectList recognized_image_list;
+  // 3D ROI of the rgb objects
+  mas_perception_msgs::ObjectList rgb_object_list;
+  std::vector<PointCloud::Ptr> clusters_2d;
+  std::vector<PointCloud::Ptr> filtered_clusters_2d;
+  cv_bridge::CvImagePtr cv_image;
+  // Merged object list
+  mas_perception_msgs::ObjectList combined_object_list;
+
+  RecognitionFrame() : id(0), workspace_height(0.0) {}
+};
+
+typedef std::shared_ptr<RecognitionFrame> RecognitionFramePtr;
+
+/** \brief Segmentation of the table top clusters and fusion of the cloud and rgb recognizer
+ * results, without any topics. Used by the multimodal_object_recognition node and the
+ * offline replay.
+ */
+class MultimodalObjectRecognition
+{
+  public:
+    MultimodalObjectRecognition();
+    virtual ~MultimodalObjectRecognition();
+
+    /** \brief Apply the segmentation, recognizer and fusion parameters
+     * \param[in] Dynamic reconfigure config, the multi view and sensor frame crop parameters
+     *     are ignored
+     * */
+    void setConfig(const mir_object_recognition::SceneSegmentationConfig &config);
+
+    /** \brief Load qualitative object info
+     * \param[in] Path to the xml object file
+     * */
+    void loadObjectInfo(const std::string &filename);
+
+    /** \brief Segment the accumulated pointcloud, find the plane, cluster the table top objects
+     * and find their heights
+     * \param[in,out] frame, results are stored in frame.cloud_object_list, frame.clusters_3d and
+     *     frame.workspace_height, the current parameters are copied into frame.params
+     * \param[in] Organized pointcloud of a single view used to find the plane,
+     *     the accumulated pointcloud is used if empty
+     * */
+    void segmentFrame(RecognitionFrame &frame,
+                      const PointCloud::ConstPtr &plane_cloud = PointCloud::ConstPtr());
+
+    /** \brief Find 3D ROI of the recognized 2D objects and estimate their pose
+     * \param[in,out] frame.recognized_image_list, frame.cloud, results are stored in the frame
+     * \return false if the image could not be converted
+     **/
+    bool processRecognizedImageList(RecognitionFrame &frame);
+
+    /** \brief Merge cloud and rgb objects, filter them by ROI and adjust their pose
+     * \param[in,out] frame, the result is stored in frame.combined_object_list
+     * \return false if there are no objects
+     **/
+    bool fuseObjects(RecognitionFrame &frame);
+
+    /** \brief Remove the object clouds and rename the containers to match the refbox naming
+     * \param[in,out] Object list to publish
+     **/
+    void prepareObjectList(mas_perception_msgs::ObjectList &object_list);
+
+    bool isRGBRecognizerEnabled() const { return params_.enable_rgb_recognizer; }
+    bool isPCRecognizerEnabled() const { return params_.enable_pc_recognizer; }
+
+    void setTargetFrameId(const std::string &target_frame_id) { target_frame_id_ = target_frame_id; }
+    const std::string &getTargetFrameId() const { return target_frame_id_; }
+
+    typedef std::shared_ptr<SceneSegmentationROS> SceneSegmentationROSSPtr;
+    SceneSegmentationROSSPtr getSceneSegmentation() { return scene_segmentation_ros_; }
+
+  protected:
+    /** \brief Adjust object pose, make it flat, adjust container, axis and bolt poses.
+     * \param[in] Object_list.pose, .name,
+     * \param[in] Workspace height of the frame the objects were found in
+     * \param[in] Parameters of the frame the objects were found in
+     **/
+    void adjustObjectPose(mas_perception_msgs::ObjectList &object_list, double workspace_height,
+                          const RecognitionParams &params);
+
+    /** \brief Transform a pose of a rgb object that is not in the target frame,
+     * the pose is kept as is without a transform listener
+     * \param[in] Pose in the pointcloud frame
+     * \param[out] Pose in the target frame
+     **/
+    virtual void transformPose(const geometry_msgs::PoseStamped &pose,
+                               geometry_msgs::PoseStamped &transformed_pose);
+
+    SceneSegmentationROSSPtr scene_segmentation_ros_;
+    typedef std::shared_ptr<MultimodalObjectRecognitionUtils> MultimodalObjectRecognitionUtilsSPtr;
+    MultimodalObjectRecognitionUtilsSPtr mm_object_recognition_utils_;
+
+    // Parameters
+    bool debug_mode_;
+    std::string target_frame_id_;
+    std::set<std::string> round_objects_;
+    std::set<std::string> flat_objects_;
+    ObjectInfo object_info_;
+
+    // Dynamic parameter, copied into each frame by segmentFrame
+    RecognitionParams params_;
+
+    //cluster
+    bool center_cluster_;
+    bool pad_cluster_;
+    unsigned int padded_cluster_size_;
+};
+
+#endif  // MIR_OBJECT_RECOGNITION_MULTIMODAL_OBJECT_RECOGNITION_H
@@ -8,6 +8,11 @@
 #define MIR_OBJECT_RECOGNITION_MULTIMODAL_OBJECT_RECOGNITION_ROS_H
 
 #include <Eigen/Dense>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -17,10 +22,6 @@
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/RegionOfInterest.h>
 
-#include <message_filters/subscriber.h>
-#include <message_filters/time_synchronizer.h>
-#include <message_filters/sync_policies/approximate_time.h>
-
 #include <pcl/PCLPointCloud2.h>
 #include <pcl_ros/transforms.h>
 #include <pcl_ros/point_cloud.h>
@@ -30,28 +31,48 @@
 #include <mas_perception_msgs/ObjectList.h>
 
 #include <mir_object_recognition/SceneSegmentationConfig.h>
-#include <mir_object_recognition/multimodal_object_recognition_utils.h>
+#include <mir_object_recognition/multimodal_object_recognition.h>
+#include <mir_object_recognition/recognizer_client.h>
 #include <mir_object_segmentation/scene_segmentation_ros.h>
+#include <mir_perception_utils/transform_cache.h>
+#include <mir_perception_utils/artifact_recorder.h>
+#include <mir_perception_utils/latency_diagnostics_ros.h>
 #include <mir_perception_utils/object_utils_ros.h>
+#include <mir_perception_utils/pointcloud_utils.h>
 #include <mir_perception_utils/pointcloud_utils_ros.h>
+#include <mir_perception_utils/spsc_queue.h>
+#include <mir_perception_utils/synchronized_frame_buffer.h>
 
 /** \brief This node subscribes to pointcloud and image_raw topics synchronously.
  * Inputs:
  * ~event_in:
- *      - e_start:  - starts subscribing to pointcloud and image topics simultaneously,
+ *      - e_start:  - takes the latest synchronized pointcloud and image stamped after
+ *                    e_start + frame_settle_time (the inputs are always subscribed),
  *              - segments pointcloud, recognize the table top clusters, estimate pose and workspace height
  *              - detects rgb object, find 3D ROI, estimate pose
  *              - adjusts object pose and publish them
- *      - e_stop:   - stop subscribing to the input topics and clear accumulated pointcloud
- *      - e_data_collection -  start dataset collection mode (save dir is defined in launch file).
+ *      - e_stop:   - cancel a pending request and clear accumulated pointcloud
+ *      - e_start_continuous: - process every synchronized pointcloud and image in a pipeline
+ *              (transform -> segmentation -> recognition -> fusion), each stage on its own thread
+ *      - e_stop_continuous: - stop the pipeline
+ *      - e_start_multi_view: - clear accumulated pointcloud and start a multi view recognition
+ *      - e_add_view: - capture one view, register it to the target frame with the transform at its
+ *              own stamp, optionally refine it with ICP and add it to the accumulated pointcloud.
+ *              Recognition runs once after num_views views.
+ *      - e_multi_view_done: - run recognition on the views captured so far
+ *      - e_data_collection -  start dataset collection mode, frames are written to <logdir>/dataset_<time>.
  *                   If enable, this node will not do any recognition.
  * Outputs:
  * ~event_out:
  *      - e_done:   - done recognizing pointcloud and image, done pose estimation and done publishing object_list
+ *      - e_failed:   - the pointcloud of a single shot request could not be transformed
  *      - e_stopped:  - done unsubscribing, done clearing accumulated point clouds
- *      - e_data_collection - data collection mode started
+ *      - e_data_collection_started, e_data_collection_failed, e_data_collection_stopped
+ *      - e_continuous_started, e_continuous_stopped
+ *      - e_multi_view_started, e_view_added, e_view_failed
  * 
  * Topics output: rgb, pointcloud and multimodal object_lists, workspace_height.
+ * Topics output in continuous mode: pipeline_status (frame drops and queue depth per stage)
  * Topics output for visualization: pose array, bounding boxes and labels for both rgb and point cloud
  * 
  * \author Mohammad Wasil
@@ -63,20 +84,12 @@ using mpu::visualization::ClusteredPointCloudVisualizer;
 using mpu::visualization::LabelVisualizer;
 using mpu::visualization::Color;
 
-struct Object
-{
-  std::string name;
-  std::string shape;
-  std::string color;
-};
-
-typedef std::vector<Object> ObjectInfo;
-
-class MultimodalObjectRecognitionROS
+class MultimodalObjectRecognitionROS : public MultimodalObjectRecognition
 {
   public:
     /** \brief Constructor
-     * \param[in] NodeHandle */
+     * \param[in] Private NodeHandle of the node or nodelet, all topics, parameters and the
+     *     dynamic reconfigure server are created in its namespace */
     MultimodalObjectRecognitionROS(ros::NodeHandle nh);
 
     /** \brief Destructor */
@@ -90,19 +103,27 @@ class MultimodalObjectRecognitionROS
   private:
     ros::NodeHandle nh_;
     ros::Subscriber sub_event_in_;
+    // Name of the workstation the robot is at, selects the cached plane
+    ros::Subscriber sub_workstation_;
     ros::Publisher pub_event_out_;
     ros::Subscriber sub_cloud_;
 
     boost::shared_ptr<tf::TransformListener> tf_listener_;
+    // transforms of the cloud and the rgb object poses, resolved once per frame
+    mpu::TransformCachePtr transform_cache_;
     
     dynamic_reconfigure::Server<mir_object_recognition::SceneSegmentationConfig> server_;
 
     // Publisher for clouds and images recognizer
     ros::Publisher pub_cloud_to_recognizer_;
     ros::Publisher pub_image_to_recognizer_;
-    // Subscriber for clouds and images recognizer
-    ros::Subscriber sub_recognized_image_list_;
-    ros::Subscriber sub_recognized_cloud_list_;
+    // Asynchronous clients for the clouds and images recognizer responses
+    std::unique_ptr<RecognizerClient> pc_recognizer_client_;
+    std::unique_ptr<RecognizerClient> rgb_recognizer_client_;
+    std::mutex recognizer_mutex_;
+    std::condition_variable recognizer_cv_;
+    // Set by stopPipeline to abort a recognition stage waiting for the recognizers
+    std::atomic<bool> recognition_cancelled_;
     // Publisher object list
     ros::Publisher pub_object_list_;
     ros::Publisher pub_workspace_height_;
@@ -111,51 +132,73 @@ class MultimodalObjectRecognitionROS
     ros::Publisher pub_rgb_object_pose_array_;
     // Publisher debug
     ros::Publisher pub_debug_cloud_plane_;
+    // Publisher continuous mode status
+    ros::Publisher pub_pipeline_status_;
+    ros::WallTimer pipeline_status_timer_;
+    // Publisher plane cache hits and misses, after every segmentation
+    ros::Publisher pub_plane_cache_status_;
+
+    // Stage latency percentiles on latency_diagnostics
+    std::unique_ptr<mpu::LatencyDiagnosticsROS> latency_diagnostics_;
+
     std::string horizontal_object_list[9];
 
-    // Synchronize callback for image and pointcloud
-    message_filters::Subscriber<sensor_msgs::Image> *image_sub_;
-    message_filters::Subscriber<sensor_msgs::PointCloud2> *cloud_sub_;
-    typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::Image, sensor_msgs::PointCloud2> msgSyncPolicy;
-    message_filters::Synchronizer<msgSyncPolicy> *msg_sync_;
+    // Latest synchronized images and pointclouds, always subscribed
+    typedef mpu::SynchronizedFrameBuffer<sensor_msgs::Image, sensor_msgs::PointCloud2> FrameBuffer;
+    std::unique_ptr<FrameBuffer> frame_buffer_;
+    // Called for every synchronized pair, feeds the continuous mode
     void synchronizeCallback(const sensor_msgs::ImageConstPtr &image, 
                  const sensor_msgs::PointCloud2ConstPtr &cloud);
 
-    // Recognize Clouds and Image callback
-    void recognizedImageCallback(const mas_perception_msgs::ObjectList &msg);
-    void recognizedCloudCallback(const mas_perception_msgs::ObjectList &msg);
+    // Called by the recognizer clients whenever a response arrives
+    void recognizerResponseCallback();
   
   protected:
-    typedef std::shared_ptr<SceneSegmentationROS> SceneSegmentationROSSPtr;
-    SceneSegmentationROSSPtr scene_segmentation_ros_;
-    typedef std::shared_ptr<MultimodalObjectRecognitionUtils> MultimodalObjectRecognitionUtilsSPtr;
-    MultimodalObjectRecognitionUtilsSPtr mm_object_recognition_utils_;
-
     // Used to store pointcloud and image received from callback
     sensor_msgs::PointCloud2ConstPtr pointcloud_msg_;
     sensor_msgs::ImageConstPtr image_msg_;
     PointCloud::Ptr cloud_;
 
-    // Flags for pointcloud and image subscription
-    int pointcloud_msg_received_count_;
-    int image_msg_received_count_;
-    
-    // rgb_object_id used to differentiate 2D and 3D objects
-    int rgb_object_id_;
+    // Pending single shot or multi view request, served by update() with the first
+    // synchronized pair stamped after frame_min_stamp_
+    bool frame_requested_;
+    ros::Time frame_min_stamp_;
+    // Time after the request until the sensor is considered settled, may be negative
+    // to accept pairs received before the request
+    double frame_settle_time_;
     
-    // Flags for object recognition
-    bool received_recognized_image_list_flag_;
-    bool received_recognized_cloud_list_flag_;
+    // Id of the last request sent to the recognizers
+    uint32_t recognition_request_id_;
+
+    // Guards scene_segmentation_ros_, shared by the single shot and continuous mode
+    std::mutex segmentation_mutex_;
+
+    // Continuous mode, one thread per stage connected by single producer single consumer queues
+    typedef mpu::SpscQueue<RecognitionFramePtr> FrameQueue;
+    std::unique_ptr<FrameQueue> transform_queue_;
+    std::unique_ptr<FrameQueue> segmentation_queue_;
+    std::unique_ptr<FrameQueue> recognition_queue_;
+    std::unique_ptr<FrameQueue> fusion_queue_;
+    std::vector<std::thread> pipeline_threads_;
+    std::atomic<bool> pipeline_running_;
+    std::atomic<unsigned long> pipeline_received_frames_;
+    std::atomic<unsigned long> pipeline_dropped_frames_;
+    std::atomic<unsigned long> pipeline_processed_frames_;
+    int pipeline_queue_size_;
+
+    // Multi view mode, views are accumulated until num_views_ have been captured
+    bool multi_view_active_;
+    int multi_view_count_;
+    int num_views_;
+    bool enable_multi_view_icp_;
+    double icp_voxel_size_;
+    double icp_max_correspondence_distance_;
+    int icp_max_iterations_;
 
     //Recognized image list
     mas_perception_msgs::ObjectList recognized_image_list_;
     mas_perception_msgs::ObjectList recognized_cloud_list_;
 
-    // Enable recognizer
-    bool enable_rgb_recognizer_;
-    bool enable_pc_recognizer_ ;
-    std::string obj_category_;
-
     // Visualization
     BoundingBoxVisualizer bounding_box_visualizer_pc_;
     ClusteredPointCloudVisualizer cluster_visualizer_rgb_;
@@ -165,70 +208,122 @@ class MultimodalObjectRecognitionROS
     LabelVisualizer label_visualizer_pc_;
 
     // Parameters
-    bool debug_mode_;
-    std::string target_frame_id_;
     std::string pointcloud_source_frame_id_;
-    std::set<std::string> round_objects_;
-    std::set<std::string> flat_objects_;
-    ObjectInfo object_info_;
     std::string object_info_path_;
 
     // Dynamic parameter
-    double object_height_above_workspace_;
-    double height_of_floor_;
-    bool use_fixed_heights_;
-    double container_height_;
-    int rgb_roi_adjustment_;
-    int rgb_bbox_min_diag_;
-    int rgb_bbox_max_diag_;
-    double rgb_cluster_filter_limit_min_;
-    double rgb_cluster_filter_limit_max_;
-    bool enable_roi_;
-    double roi_base_link_to_laser_distance_;
-    double roi_max_object_pose_x_to_base_link_;
-    double roi_min_bbox_z_;
-    bool rgb_cluster_remove_outliers_;
-
-    //cluster
-    bool center_cluster_;
-    bool pad_cluster_;
-    unsigned int padded_cluster_size_;
+    bool enable_sensor_frame_crop_;
+
+    // Plane cache, the base pose is looked up in the fixed frame, guarded by segmentation_mutex_
+    std::string plane_cache_fixed_frame_;
+    std::string workstation_name_;
 
      // logdir for saving debug image
     std::string logdir_;
+    mpu::ArtifactRecorderPtr artifact_recorder_;
     bool data_collection_;
+    // dataset of the current data collection
+    std::string dataset_dir_;
 
   private:
     /** \brief Event in callback
      * */
     void eventCallback(const std_msgs::String::ConstPtr &msg);
 
+    /** \brief Workstation callback, the plane of the workstation is cached
+     * */
+    void workstationCallback(const std_msgs::String::ConstPtr &msg);
+
     /** \brief Dynamic reconfigure callback
      * */
     void configCallback(mir_object_recognition::SceneSegmentationConfig &config, uint32_t level);
     
     /** \brief Transform pointcloud to the given frame id ("base_link" by default)
      * \param[in] PointCloud2 input
+     * \param[out] Transformed pointcloud, empty if the transform failed
+     * \param[in] Use the transform at the stamp of the pointcloud instead of the latest one
+    */
+    bool preprocessPointCloud(const sensor_msgs::PointCloud2ConstPtr &cloud_msg, PointCloud::Ptr &cloud,
+                              bool use_cloud_stamp = false);
+
+    /** \brief Label the pointcloud with pointcloud_source_frame_id. Within a nodelet manager the
+     * message is shared with the other subscribers, so it is copied instead of modified, and only
+     * if the frame id differs.
+     * \param[in] Received pointcloud
+     * \return Pointcloud in the source frame
     */
-    void preprocessPointCloud(const sensor_msgs::PointCloud2ConstPtr &cloud_msg);
+    sensor_msgs::PointCloud2ConstPtr setSourceFrame(const sensor_msgs::PointCloud2ConstPtr &cloud_msg);
 
-    /** \brief Add cloud accumulation, segment accumulated pointcloud, find the plane, 
-     *     clusters table top objects, find object heights.
-     * \param[out] 3D object list with unknown label
-     * \param[out] Table top pointcloud clusters
+    /** \brief Register the received pointcloud and add it to the accumulated pointcloud,
+     * runs recognition once the last view has been added
      **/
-    void segmentPointCloud(mas_perception_msgs::ObjectList &object_list, 
-                 std::vector<PointCloud::Ptr> &clusters,
-                 std::vector<BoundingBox> boxes);
+    void addView();
+
+    /** \brief Recognize objects in the accumulated pointcloud, reset the accumulation and publish e_done */
+    void finishRecognition();
+
+    /** \brief Segment accumulated pointcloud, find the plane, clusters table top objects,
+     *     find object heights and publish the workspace height.
+     * \param[out] frame.cloud_object_list, frame.clusters_3d and frame.workspace_height
+     * \param[in] Organized pointcloud of a single view used to find the plane,
+     *     the accumulated pointcloud is used if empty
+     **/
+    void segmentPointCloud(RecognitionFrame &frame,
+                 const PointCloud::ConstPtr &plane_cloud = PointCloud::ConstPtr());
 
     /** \brief Recognize 2D and 3D objects, estimate their pose, filter them, and publish the object_list*/
     void recognizeCloudAndImage();
 
-    /** \brief Adjust object pose, make it flat, adjust container, axis and bolt poses.
-     * \param[in] Object_list.pose, .name,
-     * 
+    /** \brief Queue a debug image or pointcloud for the artifact recorder
+     * \param[in] Image or pointcloud, not modified afterwards
+     * \param[in] File name prefix, the file is <logdir>/<prefix><stamp>[_<index>]
+     * \param[in] Stamp of the file name
+     * \param[in] Index of the cluster, appended to the file name
+     **/
+    void recordArtifact(const cv::Mat &image, const std::string &prefix, const ros::Time &stamp);
+    void recordArtifact(const PointCloud::ConstPtr &cloud, const std::string &prefix,
+                        const ros::Time &stamp, int index);
+    std::string artifactPath(const std::string &prefix, const ros::Time &stamp, int index,
+                             const std::string &extension) const;
+
+    /** \brief Queue the pointcloud, raw image, clusters and poses of the frame for the
+     * dataset opened by e_data_collection
+     * \param[in] Segmented frame
      **/
-    void adjustObjectPose(mas_perception_msgs::ObjectList &object_list);
+    void recordDatasetFrame(const RecognitionFrame &frame);
+
+    /** \brief Send the frame to the cloud and rgb recognizers and wait for both concurrently
+     * \param[in,out] frame.cloud_object_list, frame.image, results are stored in the frame
+     * \return false if the recognized image could not be processed or the pipeline was stopped
+     **/
+    bool recognizeObjects(RecognitionFrame &frame);
+
+    /** \brief Return a new non-zero recognizer request id */
+    uint32_t nextRequestId();
+
+    /** \brief Request the next synchronized pointcloud and image stamped after the settle time */
+    void requestFrame();
+
+    /** \brief Start and stop the continuous mode threads */
+    void startPipeline();
+    void stopPipeline();
+
+    /** \brief Pop a frame, waits until one is available or the pipeline is stopped */
+    bool popFrame(FrameQueue &queue, RecognitionFramePtr &frame);
+    /** \brief Push a frame, waits while the queue is full or until the pipeline is stopped */
+    void pushFrame(FrameQueue &queue, const RecognitionFramePtr &frame);
+
+    /** \brief Continuous mode stages */
+    void transformStage();
+    void segmentationStage();
+    void recognitionStage();
+    void fusionStage();
+
+    /** \brief Publish frame drops and queue depth of the continuous mode */
+    void publishPipelineStatus(const ros::WallTimerEvent &event);
+
+    /** \brief Publish the hits, misses and rejected planes of the plane cache */
+    void publishPlaneCacheStatus();
 
     /** \brief Publish object_list to object_list merger 
      * \param[in] Object list to publish
@@ -245,10 +340,10 @@ class MultimodalObjectRecognitionROS
               std::vector<PointCloud::Ptr> &clusters_2d,
               std::vector<PointCloud::Ptr> &filtered_clusters_2d);
 
-    /** \brief Load qualitative object info
-     * \param[in] Path to the xml object file
-     * */ 
-    void loadObjectInfo(const std::string &filename);        
+  protected:
+    /** \brief Transform the pose with the transform listener */
+    void transformPose(const geometry_msgs::PoseStamped &pose,
+                       geometry_msgs::PoseStamped &transformed_pose) override;
 };
 
 #endif  // MIR_OBJECT_RECOGNITION_MULTIMODAL_OBJECT_RECOGNITION_ROS_H
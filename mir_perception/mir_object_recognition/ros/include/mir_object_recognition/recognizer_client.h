@@ -0,0 +1,73 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_OBJECT_RECOGNITION_RECOGNIZER_CLIENT_H
+#define MIR_OBJECT_RECOGNITION_RECOGNIZER_CLIENT_H
+
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+
+#include <mas_perception_msgs/ObjectList.h>
+
+/** \brief Asynchronous request/response layer for the topic based recognizers.
+ *
+ * Responses are received on a dedicated callback queue served by its own spinner,
+ * so they are delivered while the caller is busy and independent of ros::spinOnce().
+ * Every request is identified by a request id which the recognizer echoes back in
+ * objects[i].pose.header.seq. A response without id (e.g. an empty object list) is
+ * assigned to the oldest pending request, responses for unknown ids are dropped.
+**/
+class RecognizerClient
+{
+  public:
+    typedef mas_perception_msgs::ObjectList Response;
+    typedef std::shared_future<Response> ResponseFuture;
+
+    /** \brief Constructor
+     * \param[in] NodeHandle used to subscribe to the response topic
+     * \param[in] Response topic of the recognizer
+     * \param[in] Name used in log messages
+     * \param[in] Function called from the spinner thread after a response has been stored
+     * */
+    RecognizerClient(ros::NodeHandle nh, const std::string &response_topic,
+                     const std::string &name, const std::function<void()> &on_response = nullptr);
+
+    /** \brief Destructor, stops the spinner and abandons pending requests */
+    virtual ~RecognizerClient();
+
+    /** \brief Register a request before publishing it to the recognizer
+     * \param[in] Request id, must be non-zero
+     * \return Future which becomes ready when the response arrives
+     * */
+    ResponseFuture addRequest(uint32_t request_id);
+
+    /** \brief Forget a pending request, e.g. after it timed out
+     * \param[in] Request id
+     * */
+    void cancelRequest(uint32_t request_id);
+
+    /** \brief Return true if the future holds a response */
+    static bool isReady(const ResponseFuture &future);
+
+  private:
+    void responseCallback(const mas_perception_msgs::ObjectList::ConstPtr &msg);
+
+    std::string name_;
+    std::function<void()> on_response_;
+
+    ros::CallbackQueue callback_queue_;
+    ros::AsyncSpinner spinner_;
+    ros::Subscriber sub_response_;
+
+    std::mutex mutex_;
+    std::map<uint32_t, std::promise<Response>> pending_requests_;
+};
+
+#endif  // MIR_OBJECT_RECOGNITION_RECOGNIZER_CLIENT_H
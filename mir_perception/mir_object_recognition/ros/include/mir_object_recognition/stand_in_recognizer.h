@@ -0,0 +1,63 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_OBJECT_RECOGNITION_STAND_IN_RECOGNIZER_H
+#define MIR_OBJECT_RECOGNITION_STAND_IN_RECOGNIZER_H
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <mas_perception_msgs/ObjectList.h>
+
+#include <mir_object_recognition/multimodal_object_recognition.h>
+
+/** \brief Replaces a cloud or rgb recognizer node when frames are replayed offline */
+class StandInRecognizer
+{
+  public:
+    virtual ~StandInRecognizer() {}
+
+    /** \brief Recognize the objects of a frame
+     * \param[in] Name of the recorded frame
+     * \param[in] Frame with the image and the segmented object list
+     * \param[out] Recognized objects, as published by the recognizer node
+     * \return false if there is no response, like a recognizer timeout
+     * */
+    virtual bool recognize(const std::string &frame_name, const RecognitionFrame &frame,
+                           mas_perception_msgs::ObjectList &response) = 0;
+};
+
+typedef std::shared_ptr<StandInRecognizer> StandInRecognizerPtr;
+
+/** \brief Responds with the object lists recorded from a recognizer node */
+class RecordedRecognizer : public StandInRecognizer
+{
+  public:
+    /** \brief Add the recorded response of a frame */
+    void addResponse(const std::string &frame_name, const mas_perception_msgs::ObjectList &response);
+
+    bool recognize(const std::string &frame_name, const RecognitionFrame &frame,
+                   mas_perception_msgs::ObjectList &response) override;
+
+    size_t size() const { return responses_.size(); }
+
+  private:
+    std::map<std::string, mas_perception_msgs::ObjectList> responses_;
+};
+
+/** \brief Cloud recognizer that returns the segmented objects with a fixed label */
+class EchoRecognizer : public StandInRecognizer
+{
+  public:
+    explicit EchoRecognizer(const std::string &label = "UNKNOWN");
+
+    bool recognize(const std::string &frame_name, const RecognitionFrame &frame,
+                   mas_perception_msgs::ObjectList &response) override;
+
+  private:
+    std::string label_;
+};
+
+#endif  // MIR_OBJECT_RECOGNITION_STAND_IN_RECOGNIZER_H
@@ -0,0 +1,528 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <cmath>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <pcl/common/common.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <tf/transform_datatypes.h>
+
+#include <mir_perception_utils/latency_profiler.h>
+#include <mir_perception_utils/object_utils_ros.h>
+#include <mir_perception_utils/pointcloud_msg_writer.h>
+#include <mir_perception_utils/pointcloud_utils_ros.h>
+
+#include <mir_object_recognition/multimodal_object_recognition.h>
+
+namespace mpu = mir_perception_utils;
+
+namespace
+{
+const mpu::LatencyStage SEGMENTATION_STAGE("multimodal_object_recognition/segmentation");
+const mpu::LatencyStage FUSION_STAGE("multimodal_object_recognition/fusion");
+const mpu::LatencyStage POSE_ADJUSTMENT_STAGE("multimodal_object_recognition/pose_adjustment");
+}  // namespace
+
+MultimodalObjectRecognition::MultimodalObjectRecognition():
+  debug_mode_(false),
+  target_frame_id_("base_link"),
+  center_cluster_(false),
+  pad_cluster_(false),
+  padded_cluster_size_(0)
+{
+  scene_segmentation_ros_ = SceneSegmentationROSSPtr(new SceneSegmentationROS());
+  mm_object_recognition_utils_ = MultimodalObjectRecognitionUtilsSPtr(new MultimodalObjectRecognitionUtils());
+}
+
+MultimodalObjectRecognition::~MultimodalObjectRecognition()
+{
+}
+
+void MultimodalObjectRecognition::setConfig(const mir_object_recognition::SceneSegmentationConfig &config)
+{
+  scene_segmentation_ros_->setVoxelGridParams(config.voxel_leaf_size, config.voxel_filter_field_name,
+      config.voxel_filter_limit_min, config.voxel_filter_limit_max);
+  scene_segmentation_ros_->setPassthroughParams(config.enable_passthrough_filter,
+      config.passthrough_filter_field_name,
+      config.passthrough_filter_limit_min,
+      config.passthrough_filter_limit_max);
+  scene_segmentation_ros_->setCropBoxParams(config.enable_cropbox_filter, config.cropbox_filter_min_x, config.cropbox_filter_max_x,
+      config.cropbox_filter_min_y, config.cropbox_filter_max_y, config.cropbox_filter_min_z, config.cropbox_filter_max_z);
+  scene_segmentation_ros_->setNormalParams(config.normal_radius_search, config.use_omp, config.num_cores);
+  Eigen::Vector3f axis(config.sac_x_axis, config.sac_y_axis, config.sac_z_axis);
+  scene_segmentation_ros_->setSACParams(config.sac_max_iterations, config.sac_distance_threshold,
+      config.sac_optimize_coefficients, axis, config.sac_eps_angle,
+      config.sac_normal_distance_weight);
+  scene_segmentation_ros_->setCoarsePlaneParams(config.use_coarse_plane_detection,
+      config.coarse_plane_leaf_size, config.coarse_plane_band_width);
+  scene_segmentation_ros_->setOrganizedPlaneParams(config.use_organized_plane_detection,
+      config.organized_max_depth_change_factor, config.organized_normal_smoothing_size,
+      config.organized_plane_min_inliers, config.organized_plane_angular_threshold);
+  scene_segmentation_ros_->setPlaneCacheParams(config.enable_plane_cache,
+      config.plane_cache_max_translation, config.plane_cache_max_rotation,
+      config.plane_cache_sample_size, config.plane_cache_min_inlier_ratio);
+  scene_segmentation_ros_->setPrismParams(config.prism_min_height, config.prism_max_height);
+  scene_segmentation_ros_->setHullMaskPrismParams(config.use_hull_mask_prism,
+      config.hull_mask_resolution, config.hull_mask_num_threads);
+  scene_segmentation_ros_->setOutlierParams(config.outlier_radius_search, config.outlier_min_neighbors);
+  scene_segmentation_ros_->setClusterParams(config.cluster_tolerance, config.cluster_min_size, config.cluster_max_size,
+      config.cluster_min_height, config.cluster_max_height, config.cluster_max_length,
+      config.cluster_min_distance_to_polygon, config.use_voxel_clustering);
+  scene_segmentation_ros_->setPaddingParams(config.padding_strategy, config.padding_voxel_size,
+      config.padding_seed);
+  // Object recognizer param
+  params_.enable_rgb_recognizer = config.enable_rgb_recognizer;
+  params_.enable_pc_recognizer = config.enable_pc_recognizer;
+  params_.obj_category = config.obj_category;
+
+  // Cluster param
+  center_cluster_ = config.center_cluster;
+  pad_cluster_ = config.pad_cluster;
+  padded_cluster_size_ = config.padded_cluster_size;
+  // Workspace and object height
+  params_.use_fixed_heights = config.use_fixed_heights;
+  params_.object_height_above_workspace = config.object_height_above_workspace;
+  params_.height_of_floor = config.height_of_floor;
+  params_.container_height = config.container_height;
+  // RGB proposal params
+  params_.rgb_roi_adjustment = config.rgb_roi_adjustment;
+  params_.rgb_bbox_min_diag = config.rgb_bbox_min_diag;
+  params_.rgb_bbox_max_diag = config.rgb_bbox_max_diag;
+  params_.rgb_cluster_filter_limit_min = config.rgb_cluster_filter_limit_min;
+  params_.rgb_cluster_filter_limit_max = config.rgb_cluster_filter_limit_max;
+  params_.rgb_cluster_remove_outliers = config.rgb_cluster_remove_outliers;
+  params_.rgb_cluster_outlier_threshold = config.rgb_cluster_outlier_threshold;
+  // ROI params
+  params_.enable_roi = config.enable_roi;
+  params_.roi_base_link_to_laser_distance = config.roi_base_link_to_laser_distance;
+  params_.roi_max_object_pose_x_to_base_link = config.roi_max_object_pose_x_to_base_link;
+  params_.roi_min_bbox_z = config.roi_min_bbox_z;
+}
+
+void MultimodalObjectRecognition::segmentFrame(RecognitionFrame &frame,
+                                               const PointCloud::ConstPtr &plane_cloud)
+{
+  mpu::ScopedLatencyTimer timer(SEGMENTATION_STAGE);
+  // the later stages of the frame only read this copy, setConfig may run concurrently
+  frame.params = params_;
+  PointCloud::Ptr cloud(new PointCloud);
+  cloud->header.frame_id = target_frame_id_;
+  scene_segmentation_ros_->getCloudAccumulation(cloud);
+
+  // if the cluster is centered,it looses the correct location of the object
+  std::vector<mpu::object::BoundingBox> boxes;
+  scene_segmentation_ros_->segmentCloud(cloud, frame.cloud_object_list, frame.clusters_3d, boxes,
+                      center_cluster_ = false, pad_cluster_, padded_cluster_size_, plane_cloud);
+  frame.workspace_height = scene_segmentation_ros_->getWorkspaceHeight();
+}
+
+bool MultimodalObjectRecognition::processRecognizedImageList(RecognitionFrame &frame)
+{
+  // rgb_object_id used to differentiate 2D and 3D objects
+  int rgb_object_id = 100;
+  if (frame.recognized_image_list.objects.size() > 0)
+  {
+    try
+    {
+      frame.cv_image = cv_bridge::toCvCopy(frame.image, sensor_msgs::image_encodings::BGR8);
+    }
+    catch (cv_bridge::Exception& e)
+    {
+      ROS_ERROR("cv_bridge exception: %s", e.what());
+      return false;
+    }
+
+    frame.rgb_object_list.objects.resize(frame.recognized_image_list.objects.size());
+
+    // Remove large 2d misdetected bbox (misdetection), the 3D ROIs of the remaining
+    // detections are extracted together in a single pass over the organized cloud
+    std::vector<sensor_msgs::RegionOfInterest> rois(frame.recognized_image_list.objects.size());
+    std::vector<bool> valid_size(rois.size(), false);
+    for (size_t i = 0; i < rois.size(); i++)
+    {
+      const mas_perception_msgs::Object &object = frame.recognized_image_list.objects[i];
+      double len_diag = sqrt(powf(object.roi.width, 2) + powf(object.roi.height, 2));
+
+      // check if object name has container
+      bool is_container = false;
+      if (object.name == "CONTAINER_BOX_BLUE" || object.name == "CONTAINER_BOX_RED")
+      {
+        ROS_INFO("Found container object %s", object.name.c_str());
+        is_container = true;
+      }
+      valid_size[i] = (len_diag > frame.params.rgb_bbox_min_diag &&
+                       len_diag < frame.params.rgb_bbox_max_diag) || is_container;
+      if (valid_size[i])
+      {
+        rois[i] = object.roi;
+      }
+    }
+    std::vector<PointCloud::Ptr> clouds_roi;
+    mpu::pointcloud::getPointCloudROIs(rois, frame.cloud, clouds_roi, frame.params.rgb_roi_adjustment,
+                                       frame.params.rgb_cluster_remove_outliers,
+                                       frame.params.rgb_cluster_outlier_threshold);
+
+    for (int i = 0; i < frame.recognized_image_list.objects.size(); i++)
+    {
+      mas_perception_msgs::Object object = frame.recognized_image_list.objects[i];
+      // Check qualitative info of the object
+      if (round_objects_.count(frame.recognized_image_list.objects[i].name))
+      {
+        object.shape.shape = object.shape.SPHERE;
+      }
+      else if (flat_objects_.count(frame.recognized_image_list.objects[i].name))
+      {
+        object.shape.shape = "flat";
+      }
+      else
+      {
+        object.shape.shape = object.shape.OTHER;
+      }
+      // Get ROI
+      sensor_msgs::RegionOfInterest roi_2d = object.roi;
+      const cv::Rect2d rect2d(roi_2d.x_offset, roi_2d.y_offset, roi_2d.width, roi_2d.height);
+
+      if (debug_mode_)
+      {
+        cv::Point pt1;
+        cv::Point pt2;
+
+        pt1.x = roi_2d.x_offset;
+        pt1.y = roi_2d.y_offset;
+        pt2.x = roi_2d.x_offset + roi_2d.width;
+        pt2.y = roi_2d.y_offset + roi_2d.height;
+
+        // draw bbox
+        cv::rectangle(frame.cv_image->image, pt1, pt2, cv::Scalar(0, 255, 0), 1, 8, 0);
+        // add label
+        cv::putText(frame.cv_image->image, object.name, cv::Point(pt1.x, pt2.y),
+              cv::FONT_HERSHEY_SIMPLEX, 0.3, cv::Scalar(0, 255, 0), 1);
+      }
+      if (valid_size[i])
+      {
+        PointCloud::Ptr cloud_roi = clouds_roi[i];
+        bool getROISuccess = static_cast<bool>(cloud_roi);
+        // ToDo: Filter big objects from 2d proposal, if the height is less than 3 mm
+        // pcl::PointXYZRGB min_pt;
+        // pcl::PointXYZRGB max_pt;
+        // pcl::getMinMax3D(*cloud_roi, min_pt, max_pt);
+        // float obj_height = max_pt.z - scene_segmentation_ros_->getWorkspaceHeight();
+        
+        if (getROISuccess)
+        {
+          // written directly into the view of the object, without an intermediate message
+          frame.rgb_object_list.objects[i].views.resize(1);
+          sensor_msgs::PointCloud2 &ros_pc2 = frame.rgb_object_list.objects[i].views[0].point_cloud;
+          mpu::pointcloud::toPointCloud2Msg(*cloud_roi, ros_pc2);
+          ros_pc2.header.frame_id = target_frame_id_;
+          ros_pc2.header.stamp = ros::Time::now();
+
+          frame.clusters_2d.push_back(cloud_roi);
+          // Get pose
+          geometry_msgs::PoseStamped pose;
+
+          // ************************************************
+          // Publish filtered point cloud from RGB recognizer
+          // ************************************************
+          
+          // PointCloud filtered_rgb_pointcloud;
+          PointCloud::Ptr filtered_rgb_pointcloud(new PointCloud);
+          *filtered_rgb_pointcloud = mpu::object::estimatePose(cloud_roi, pose, object, object.shape.shape,
+                                                              frame.params.rgb_cluster_filter_limit_min,
+                                                              frame.params.rgb_cluster_filter_limit_max,
+                                                              frame.params.obj_category);
+
+          // append filtered point cloud to filtered_clusters_2d
+          frame.filtered_clusters_2d.push_back(filtered_rgb_pointcloud);
+          
+          PointT min_pt;
+          PointT max_pt;
+          pcl::getMinMax3D(*filtered_rgb_pointcloud, min_pt, max_pt);
+
+          frame.rgb_object_list.objects[i].dimensions.vector.z = max_pt.z - min_pt.z;
+          ROS_INFO("[RGB Object Height] Object %s length: %f", object.name.c_str(), frame.rgb_object_list.objects[i].dimensions.vector.z);
+
+          if (max_pt.z > 0.09)
+          {
+            ROS_INFO("[RGB Object Height] Object %s length is greater than 9cm: %f", object.name.c_str(), max_pt.z);
+          }
+
+          //*********************************
+
+          // Transform pose
+          std::string frame_id = frame.cloud->header.frame_id;
+          // all objects of the frame share the stamp and thereby the transform
+          pcl_conversions::fromPCL(frame.cloud->header.stamp, pose.header.stamp);
+          pose.header.frame_id = frame_id;
+          if (frame_id != target_frame_id_)
+          {
+            transformPose(pose, frame.rgb_object_list.objects[i].pose);
+          }
+          else
+          {
+            frame.rgb_object_list.objects[i].pose = pose;
+          }
+          frame.rgb_object_list.objects[i].probability = frame.recognized_image_list.objects[i].probability;
+          frame.rgb_object_list.objects[i].database_id = rgb_object_id;
+          frame.rgb_object_list.objects[i].name = frame.recognized_image_list.objects[i].name;
+        }
+        else
+        {
+          ROS_DEBUG("[RGB] DECOY");
+          frame.rgb_object_list.objects[i].name = "DECOY";
+          frame.rgb_object_list.objects[i].database_id = rgb_object_id;
+        
+        }
+      }
+      else
+      {
+        ROS_WARN("[RGB] BBOX too big or too small");
+        ROS_DEBUG("[RGB] DECOY");
+        frame.rgb_object_list.objects[i].name = "DECOY";
+        frame.rgb_object_list.objects[i].database_id = rgb_object_id;
+      }
+      rgb_object_id++;
+    }
+  }
+  return true;
+}
+
+bool MultimodalObjectRecognition::fuseObjects(RecognitionFrame &frame)
+{
+  mpu::ScopedLatencyTimer timer(FUSION_STAGE);
+  // Merge recognized_cloud_list and rgb_object_list
+  frame.combined_object_list.objects.clear();
+  frame.combined_object_list.objects.insert(frame.combined_object_list.objects.end(),
+                    frame.recognized_cloud_list.objects.begin(),
+                    frame.recognized_cloud_list.objects.end());
+  frame.combined_object_list.objects.insert(frame.combined_object_list.objects.end(),
+                    frame.rgb_object_list.objects.begin(),
+                    frame.rgb_object_list.objects.end());
+  if (frame.combined_object_list.objects.empty())
+  {
+    return false;
+  }
+
+  if (frame.params.enable_roi)
+  {
+    for (int i = 0; i < frame.combined_object_list.objects.size(); i++)
+    {
+      double current_object_pose_x = frame.combined_object_list.objects[i].pose.pose.position.x;
+      if (current_object_pose_x < frame.params.roi_base_link_to_laser_distance ||
+          current_object_pose_x > frame.params.roi_max_object_pose_x_to_base_link)
+        /* frame.combined_object_list.objects[i].pose.pose.position.z < scene_segmentation_ros_ */
+        /* ->object_height_above_workspace_ - 0.05) */
+      {
+        ROS_WARN_STREAM("This object " << frame.combined_object_list.objects[i].name << " out of RoI");
+        frame.combined_object_list.objects[i].name = "DECOY";
+      }
+    }
+  }
+  // Adjust RPY to make pose flat, adjust container pose
+  // Adjust Axis and Bolt pose
+  adjustObjectPose(frame.combined_object_list, frame.workspace_height, frame.params);
+  return true;
+}
+
+void MultimodalObjectRecognition::prepareObjectList(mas_perception_msgs::ObjectList &object_list)
+{
+  for (int i = 0; i < object_list.objects.size(); i++)
+  {
+    // Empty cloud
+    sensor_msgs::PointCloud2 empty_ros_cloud;
+    object_list.objects[i].views.resize(1);
+    object_list.objects[i].views[0].point_cloud = empty_ros_cloud;
+    // Rename container to match refbox naming
+    if (object_list.objects[i].name == "BLUE_CONTAINER")
+    {
+      object_list.objects[i].name = "CONTAINER_BOX_BLUE";
+    }
+    else if (object_list.objects[i].name == "RED_CONTAINER")
+    {
+      object_list.objects[i].name = "CONTAINER_BOX_RED";
+    }
+  }
+}
+
+void MultimodalObjectRecognition::adjustObjectPose(mas_perception_msgs::ObjectList &object_list,
+                                                      double workspace_height,
+                                                      const RecognitionParams &params)
+{
+  mpu::ScopedLatencyTimer timer(POSE_ADJUSTMENT_STAGE);
+  for (int i = 0; i < object_list.objects.size(); i++)
+  {
+    tf::Quaternion q(
+        object_list.objects[i].pose.pose.orientation.x,
+        object_list.objects[i].pose.pose.orientation.y,
+        object_list.objects[i].pose.pose.orientation.z,
+        object_list.objects[i].pose.pose.orientation.w);
+    tf::Matrix3x3 m(q);
+    double roll, pitch, yaw;
+    m.getRPY(roll, pitch, yaw);
+    double change_in_pitch = 0.0;
+    if (round_objects_.count(object_list.objects[i].name))
+    {
+      ROS_INFO_STREAM("Setting yaw to zero for " << object_list.objects[i].name);
+      yaw = 0.0;
+    }
+
+    // Update container pose
+    if (object_list.objects[i].name == "CONTAINER_BOX_RED" ||
+        object_list.objects[i].name == "CONTAINER_BOX_BLUE")
+    {
+      if (object_list.objects[i].database_id >= 100)
+      {
+        ROS_INFO_STREAM("Updating RGB container pose for " << object_list.objects[i].name);
+        mm_object_recognition_utils_->adjustContainerPose(object_list.objects[i], params.container_height);
+      }
+    }
+    
+    if (object_list.objects[i].dimensions.vector.z > 0.09 and 
+        object_list.objects[i].name != "CONTAINER_BOX_RED" &&
+        object_list.objects[i].name != "CONTAINER_BOX_BLUE")
+    {
+      tf::Quaternion q2;
+      q2.setRPY(0.0, -1.57, 0.0);
+      object_list.objects[i].pose.pose.orientation.x = q2.x();
+      object_list.objects[i].pose.pose.orientation.y = q2.y();
+      object_list.objects[i].pose.pose.orientation.z = q2.z();
+      object_list.objects[i].pose.pose.orientation.w = q2.w();
+    }
+    else
+    {
+      // Make pose flat
+      tf::Quaternion q2 = tf::createQuaternionFromRPY(0.0, change_in_pitch , yaw);
+      object_list.objects[i].pose.pose.orientation.x = q2.x();
+      object_list.objects[i].pose.pose.orientation.y = q2.y();
+      object_list.objects[i].pose.pose.orientation.z = q2.z();
+      object_list.objects[i].pose.pose.orientation.w = q2.w(); 
+
+      double detected_object_height = object_list.objects[i].pose.pose.position.z;
+      if (params.obj_category == "cavity")
+      {
+           ROS_WARN_STREAM("PP01 workstation; not updating height");
+      }
+      else if (object_list.objects[i].name == "CONTAINER_BOX_RED" ||
+               object_list.objects[i].name == "CONTAINER_BOX_BLUE")
+      {
+           ROS_WARN_STREAM("Container; not updating height");
+      }
+      else if (params.use_fixed_heights or (std::fabs(detected_object_height - workspace_height) > 0.03))
+      {
+           if (params.use_fixed_heights)
+           {
+              ROS_WARN_STREAM("Assuming fixed platform heights of 0, 5, 10 and 15 cm");
+           }
+           else
+           {
+              ROS_WARN_STREAM("Difference between object height and workspace height is > 3cm");
+           }
+           // do something
+           bool is_0cm = std::fabs(detected_object_height - params.height_of_floor) < 0.01;
+           bool is_5cm = std::fabs(detected_object_height - (params.height_of_floor + 0.05)) < 0.01;
+           bool is_10cm = std::fabs(detected_object_height - (params.height_of_floor + 0.1)) < 0.01;
+           bool is_15cm = std::fabs(detected_object_height - (params.height_of_floor + 0.15)) < 0.01;
+           if (is_0cm)
+           {
+                ROS_WARN_STREAM("Updating height to 0cm");
+                object_list.objects[i].pose.pose.position.z = params.height_of_floor + params.object_height_above_workspace;      
+           }
+           if (is_5cm)
+           {
+                ROS_WARN_STREAM("Updating height to 5cm");
+                object_list.objects[i].pose.pose.position.z = params.height_of_floor + 0.05 + params.object_height_above_workspace;      
+           }
+           if (is_10cm)
+           {
+                ROS_WARN_STREAM("Updating height to 10cm");
+                object_list.objects[i].pose.pose.position.z = params.height_of_floor + 0.1 + params.object_height_above_workspace;      
+           }
+           if (is_15cm)
+           {
+                ROS_WARN_STREAM("Updating height to 15cm");
+                object_list.objects[i].pose.pose.position.z = params.height_of_floor + 0.15 + params.object_height_above_workspace;      
+           }
+
+      }
+      else
+      {
+          object_list.objects[i].pose.pose.position.z = workspace_height +
+                              params.object_height_above_workspace;      
+      }
+
+    }
+
+    /*
+    // Update workspace height
+    if (workspace_height != -1000.0)
+    {
+      if (object_list.objects[i].name == "CONTAINER_BOX_RED" ||
+          object_list.objects[i].name == "CONTAINER_BOX_BLUE")
+      {
+
+        object_list.objects[i].pose.pose.position.z = workspace_height +
+                              params.container_height;
+        ROS_WARN_STREAM("Updated container height: " << object_list.objects[i].pose.pose.position.z );
+      }
+    }
+    */
+    
+    // Update axis or bolt pose
+    if (object_list.objects[i].name == "M20_100" || object_list.objects[i].name == "AXIS" || object_list.objects[i].name == "SCREWDRIVER")
+    {
+      mm_object_recognition_utils_->adjustAxisBoltPose(object_list.objects[i]);
+    }
+  }
+}
+
+void MultimodalObjectRecognition::loadObjectInfo(const std::string &filename)
+{
+  if (boost::filesystem::is_regular_file(filename))
+  {
+    using boost::property_tree::ptree;
+    mas_perception_msgs::Object object;
+    ptree pt;
+    read_xml(filename, pt);
+
+    BOOST_FOREACH(ptree::value_type const& v, pt.get_child("object_info"))
+    {
+      if (v.first == "object") 
+      {
+        Object f;
+        f.name = v.second.get<std::string>("name");
+        f.shape = v.second.get<std::string>("shape");
+        f.color = v.second.get<std::string>("color");
+        if (f.shape == object.shape.SPHERE)
+        {
+          round_objects_.insert(f.name);
+        }
+        else if (f.shape == "flat")
+        {
+          flat_objects_.insert(f.name);
+        }
+        object_info_.push_back(f);
+      }
+    }
+    ROS_INFO("Object info is loaded!");
+  }
+  else
+  {
+    ROS_WARN("No object info is provided!");
+    return;
+  }
+}
+
+void MultimodalObjectRecognition::transformPose(const geometry_msgs::PoseStamped &pose,
+                                                geometry_msgs::PoseStamped &transformed_pose)
+{
+  ROS_WARN("[multimodal_object_recognition] No transform from %s to %s, keeping the pose",
+           pose.header.frame_id.c_str(), target_frame_id_.c_str());
+  transformed_pose = pose;
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright 2019 Bonn-Rhein-Sieg University
+ *
+ */
+#include <ros/ros.h>
+
+#include <mir_object_recognition/multimodal_object_recognition_node.h>
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "multimodal_object_recognition");
+  ros::NodeHandle nh("~");
+  // Initialize frame rate
+  int frame_rate = 30;
+  nh.param<int>("frame_rate", frame_rate, 30);
+  ros::Rate loop_rate(frame_rate);
+  // Create an object of multimodal object recognition
+  MultimodalObjectRecognitionROS mm_object_recognition(nh);
+  ROS_INFO_STREAM("\033[1;32m [multimodal_object_recognition] node started with rate "
+                  << frame_rate << " \033[0m\n");
+  // Run mm object recognition
+  while (ros::ok())
+  {
+    mm_object_recognition.update();
+    ros::spinOnce();
+    loop_rate.sleep();
+  }
+  return 0;
+}
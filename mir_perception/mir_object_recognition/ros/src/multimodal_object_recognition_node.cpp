@@ -5,10 +5,8 @@
  *
  */
 #include <algorithm>
-
-#include <boost/filesystem.hpp>
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
+#include <chrono>
+#include <utility>
 
 #include <cv_bridge/cv_bridge.h>
 #include <opencv2/core/core.hpp>
@@ -18,6 +16,7 @@
 #include <std_msgs/String.h>
 #include <std_msgs/Float64.h>
 #include <geometry_msgs/PoseArray.h>
+#include <diagnostic_msgs/DiagnosticStatus.h>
 
 #include <mas_perception_msgs/ImageList.h>
 #include <mas_perception_msgs/BoundingBoxList.h>
@@ -26,43 +25,58 @@
 #include <mir_perception_utils/bounding_box_visualizer.h>
 #include <mir_perception_utils/label_visualizer.h>
 #include <mir_perception_utils/bounding_box.h>
+#include <mir_perception_utils/latency_profiler.h>
+#include <mir_perception_utils/pointcloud_msg_writer.h>
 
 #include <mir_object_recognition/multimodal_object_recognition_node.h>
 
+namespace
+{
+const mpu::LatencyStage TRANSFORM_STAGE("multimodal_object_recognition/transform");
+const mpu::LatencyStage RECOGNITION_STAGE("multimodal_object_recognition/recognition");
+const mpu::LatencyStage PC_RECOGNIZER_WAIT_STAGE("multimodal_object_recognition/pc_recognizer_wait");
+const mpu::LatencyStage RGB_RECOGNIZER_WAIT_STAGE("multimodal_object_recognition/rgb_recognizer_wait");
+const mpu::LatencyStage TOTAL_STAGE("multimodal_object_recognition/total");
+}  // namespace
+
 MultimodalObjectRecognitionROS::MultimodalObjectRecognitionROS(ros::NodeHandle nh):
   nh_(nh),
-  pointcloud_msg_received_count_(0),
-  image_msg_received_count_(0),
-  received_recognized_cloud_list_flag_(false),
-  received_recognized_image_list_flag_(false),
-  rgb_object_id_(100),
-  container_height_(0.05),
-  rgb_roi_adjustment_(2),
-  rgb_bbox_min_diag_(21),
-  rgb_bbox_max_diag_(250),
-  roi_min_bbox_z_(0.03),
-  bounding_box_visualizer_pc_("output/bounding_boxes", Color(Color::IVORY)),
-  cluster_visualizer_rgb_("output/tabletop_cluster_rgb"),
-  cluster_visualizer_pc_("output/tabletop_cluster_pc"),
-  cluster_visualizer_filtered_rgb_("output/tabletop_cluster_filtered_rgb"),
-  label_visualizer_rgb_("output/rgb_labels", Color(Color::SEA_GREEN)),
-  label_visualizer_pc_("output/pc_labels", Color(Color::IVORY)),
+  server_(nh_),
+  frame_requested_(false),
+  frame_settle_time_(0.0),
+  recognition_request_id_(0),
+  pipeline_running_(false),
+  recognition_cancelled_(false),
+  pipeline_received_frames_(0),
+  pipeline_dropped_frames_(0),
+  pipeline_processed_frames_(0),
+  multi_view_active_(false),
+  multi_view_count_(0),
+  num_views_(1),
+  enable_multi_view_icp_(false),
+  icp_voxel_size_(0.005),
+  icp_max_correspondence_distance_(0.02),
+  icp_max_iterations_(30),
+  bounding_box_visualizer_pc_(&nh_, "output/bounding_boxes", Color(Color::IVORY)),
+  cluster_visualizer_rgb_(boost::make_shared<ros::NodeHandle>(nh_), "output/tabletop_cluster_rgb"),
+  cluster_visualizer_pc_(boost::make_shared<ros::NodeHandle>(nh_), "output/tabletop_cluster_pc"),
+  cluster_visualizer_filtered_rgb_(boost::make_shared<ros::NodeHandle>(nh_),
+                                   "output/tabletop_cluster_filtered_rgb"),
+  label_visualizer_rgb_(nh_, "output/rgb_labels", Color(Color::SEA_GREEN)),
+  label_visualizer_pc_(nh_, "output/pc_labels", Color(Color::IVORY)),
   data_collection_(false),
-  enable_roi_(true),
-  rgb_cluster_remove_outliers_(true),
-  enable_rgb_recognizer_(true),
-  enable_pc_recognizer_(true),
-  obj_category_("atwork")
+  enable_sensor_frame_crop_(false)
 {
   tf_listener_.reset(new tf::TransformListener);
-  scene_segmentation_ros_ = SceneSegmentationROSSPtr(new SceneSegmentationROS());
-  mm_object_recognition_utils_ = MultimodalObjectRecognitionUtilsSPtr(new MultimodalObjectRecognitionUtils());
+  transform_cache_ = std::make_shared<mpu::TransformCache>(tf_listener_);
 
   dynamic_reconfigure::Server<mir_object_recognition::SceneSegmentationConfig>::CallbackType f =
               boost::bind(&MultimodalObjectRecognitionROS::configCallback, this, _1, _2);
   server_.setCallback(f);
 
   sub_event_in_ = nh_.subscribe("event_in", 1, &MultimodalObjectRecognitionROS::eventCallback, this);
+  sub_workstation_ = nh_.subscribe("input/workstation", 1,
+                                   &MultimodalObjectRecognitionROS::workstationCallback, this);
   pub_event_out_ = nh_.advertise<std_msgs::String>("event_out", 1);
 
   // Publish cloud and images to cloud and rgb recognition topics
@@ -71,11 +85,12 @@ MultimodalObjectRecognitionROS::MultimodalObjectRecognitionROS(ros::NodeHandle n
   pub_image_to_recognizer_  = nh_.advertise<mas_perception_msgs::ImageList>(
                 "recognizer/rgb/input/images", 1);
 
-  // Subscribe to cloud and rgb recognition topics
-  sub_recognized_cloud_list_ = nh_.subscribe("recognizer/pc/output/object_list", 1,
-              &MultimodalObjectRecognitionROS::recognizedCloudCallback, this);
-  sub_recognized_image_list_ = nh_.subscribe("recognizer/rgb/output/object_list", 1,
-              &MultimodalObjectRecognitionROS::recognizedImageCallback, this);
+  // Receive cloud and rgb recognition results asynchronously
+  std::function<void()> on_response = std::bind(&MultimodalObjectRecognitionROS::recognizerResponseCallback, this);
+  pc_recognizer_client_.reset(new RecognizerClient(nh_, "recognizer/pc/output/object_list",
+              "Cloud", on_response));
+  rgb_recognizer_client_.reset(new RecognizerClient(nh_, "recognizer/rgb/output/object_list",
+              "RGB", on_response));
 
   // Pub combined object_list to object_list merger
   pub_object_list_  = nh_.advertise<mas_perception_msgs::ObjectList>("output/object_list", 10);
@@ -95,123 +110,233 @@ MultimodalObjectRecognitionROS::MultimodalObjectRecognitionROS(ros::NodeHandle n
   nh_.param<std::string>("target_frame_id", target_frame_id_, "base_link");
   ROS_WARN_STREAM("[multimodal_object_recognition] target frame: " <<target_frame_id_);
   nh_.param<std::string>("pointcloud_source_frame_id", pointcloud_source_frame_id_, "fixed_camera_link");
+  // The cached planes are stored with the pose of the target frame in this frame
+  nh_.param<std::string>("plane_cache_fixed_frame", plane_cache_fixed_frame_, "map");
 
   nh_.param<std::string>("logdir", logdir_, "/tmp");
+  // debug and data collection artifacts are written in the background, dropped when the queue is full
+  int artifact_queue_size;
+  nh_.param<int>("artifact_queue_size", artifact_queue_size, 32);
+  artifact_recorder_ = std::make_shared<mpu::ArtifactRecorder>(std::max(artifact_queue_size, 1));
+
+  // Continuous mode
+  nh_.param<int>("pipeline_queue_size", pipeline_queue_size_, 2);
+  pub_pipeline_status_ = nh_.advertise<diagnostic_msgs::DiagnosticStatus>("output/pipeline_status", 1);
+  pub_plane_cache_status_ = nh_.advertise<diagnostic_msgs::DiagnosticStatus>("output/plane_cache_status", 1);
   nh_.param<std::string>("object_info", object_info_path_, "None");
   loadObjectInfo(object_info_path_);
 
+  latency_diagnostics_.reset(new mpu::LatencyDiagnosticsROS(nh_, "multimodal_object_recognition"));
+
+  // The inputs stay subscribed, e_start takes a pair from the buffer instead of subscribing
+  nh_.param<double>("frame_settle_time", frame_settle_time_, 0.0);
+  int frame_buffer_size;
+  nh_.param<int>("frame_buffer_size", frame_buffer_size, 4);
+  int sync_queue_size;
+  nh_.param<int>("sync_queue_size", sync_queue_size, 5);
+  frame_buffer_.reset(new FrameBuffer(nh_, "input_image_topic", "input_cloud_topic",
+                                      std::max(frame_buffer_size, 1), std::max(sync_queue_size, 1)));
+  frame_buffer_->setCallback(boost::bind(&MultimodalObjectRecognitionROS::synchronizeCallback,
+                                         this, _1, _2));
+
 }
 
 MultimodalObjectRecognitionROS::~MultimodalObjectRecognitionROS()
 {
+  // no more synchronized pairs are handed to the pipeline
+  frame_buffer_.reset();
+  stopPipeline();
 }
 
 void MultimodalObjectRecognitionROS::synchronizeCallback(const sensor_msgs::ImageConstPtr &image,
                       const sensor_msgs::PointCloud2ConstPtr &cloud)
 {
-  ROS_INFO("[multimodal_object_recognition_ros] Received synchronized pointcloud and image");
-  if (pointcloud_msg_received_count_ < 1)
+  if (pipeline_running_)
   {
-    pointcloud_msg_ = cloud;
-    pointcloud_msg_->header.frame_id = pointcloud_source_frame_id_;
-    pointcloud_msg_received_count_ += 1;
-
-    image_msg_ = image;
-    image_msg_received_count_ += 1;
+    // Continuous mode, hand the frame to the pipeline and never block the callback
+    pipeline_received_frames_++;
+    RecognitionFramePtr frame(new RecognitionFrame);
+    frame->id = nextRequestId();
+    frame->image = image;
+    frame->cloud_msg = setSourceFrame(cloud);
+    if (!transform_queue_->push(frame))
+    {
+      pipeline_dropped_frames_++;
+      ROS_DEBUG("[multimodal_object_recognition_ros] Pipeline busy, dropping frame %u", frame->id);
+    }
   }
 }
 
-void MultimodalObjectRecognitionROS::recognizedCloudCallback(const mas_perception_msgs::ObjectList &msg)
+sensor_msgs::PointCloud2ConstPtr MultimodalObjectRecognitionROS::setSourceFrame(
+                      const sensor_msgs::PointCloud2ConstPtr &cloud_msg)
 {
-  ROS_INFO("Received recognized cloud callback ");
-  if (!received_recognized_cloud_list_flag_)
+  if (cloud_msg->header.frame_id == pointcloud_source_frame_id_)
   {
-    recognized_cloud_list_ = msg;
-    received_recognized_cloud_list_flag_ = true;
+    return cloud_msg;
   }
+  sensor_msgs::PointCloud2Ptr relabeled_msg(new sensor_msgs::PointCloud2(*cloud_msg));
+  relabeled_msg->header.frame_id = pointcloud_source_frame_id_;
+  return relabeled_msg;
 }
 
-void MultimodalObjectRecognitionROS::recognizedImageCallback(const mas_perception_msgs::ObjectList &msg)
+void MultimodalObjectRecognitionROS::recognizerResponseCallback()
 {
-  ROS_INFO("Received recognized image callback ");
-  if (!received_recognized_image_list_flag_)
-  {
-    recognized_image_list_ = msg;
-    received_recognized_image_list_flag_ = true;
-  }
+  // Lock so that the notification cannot slip in between the waiter's check and wait
+  std::lock_guard<std::mutex> lock(recognizer_mutex_);
+  recognizer_cv_.notify_all();
 }
 
 void MultimodalObjectRecognitionROS::update()
 {
-  if (pointcloud_msg_received_count_ > 0 && image_msg_received_count_ > 0)
+  sensor_msgs::ImageConstPtr image;
+  sensor_msgs::PointCloud2ConstPtr cloud;
+  ros::Time stamp;
+  if (frame_requested_ && frame_buffer_->getLatest(frame_min_stamp_, image, cloud, &stamp))
   {
-    ROS_WARN("Received %d images and pointclouds", pointcloud_msg_received_count_);
-    // Reset msg received flag
-    pointcloud_msg_received_count_ = 0;
-    image_msg_received_count_ = 0;
+    frame_requested_ = false;
+    ROS_INFO("[multimodal_object_recognition_ros] Received synchronized pointcloud and image, "
+             "stamped %.3f s after the settle time", (stamp - frame_min_stamp_).toSec());
+    pointcloud_msg_ = setSourceFrame(cloud);
+    image_msg_ = image;
 
-    image_sub_->unsubscribe();
-    cloud_sub_->unsubscribe();
+    if (multi_view_active_)
+    {
+      addView();
+      return;
+    }
 
     ROS_WARN_STREAM("Starting multimodal object recognition");
+    mpu::ScopedLatencyTimer timer(TOTAL_STAGE);
     double start_time = ros::Time::now().toSec();
     // transform pointcloud to the given frame_id
-    preprocessPointCloud(pointcloud_msg_);
-    scene_segmentation_ros_->addCloudAccumulation(cloud_);  // Extend this to work with multiple viewpoints
-    recognizeCloudAndImage();
+    if (!preprocessPointCloud(pointcloud_msg_, cloud_))
+    {
+      ROS_ERROR("[multimodal_object_recognition] Could not transform the pointcloud to %s",
+                target_frame_id_.c_str());
+      std_msgs::String event_out;
+      event_out.data = "e_failed";
+      pub_event_out_.publish(event_out);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(segmentation_mutex_);
+      scene_segmentation_ros_->addCloudAccumulation(cloud_);
+    }
+    finishRecognition();
     double end_time = ros::Time::now().toSec();
     ROS_INFO_STREAM("Total processing time: "<< end_time - start_time);
+  }
+}
 
-    // Reset received recognized cloud and image
-    received_recognized_cloud_list_flag_ = false;
-    received_recognized_image_list_flag_ = false;
+void MultimodalObjectRecognitionROS::addView()
+{
+  std_msgs::String event_out;
+  PointCloud::Ptr view;
+  // The camera moves between views, so each view is registered with the transform at its own stamp
+  if (!preprocessPointCloud(pointcloud_msg_, view, true))
+  {
+    ROS_ERROR("[multimodal_object_recognition] Could not register view %d", multi_view_count_ + 1);
+    event_out.data = "e_view_failed";
+    pub_event_out_.publish(event_out);
+    return;
+  }
 
-    // reset object id
-    rgb_object_id_ = 100;
-    scene_segmentation_ros_->resetPclObjectId();
+  {
+    std::lock_guard<std::mutex> lock(segmentation_mutex_);
+    if (enable_multi_view_icp_ && multi_view_count_ > 0)
+    {
+      // Refine the TF registration against the views accumulated so far
+      PointCloud::Ptr accumulated(new PointCloud);
+      scene_segmentation_ros_->getCloudAccumulation(accumulated);
+      Eigen::Matrix4f correction;
+      if (mpu::pointcloud::registerPointToPlane(view, accumulated, icp_voxel_size_,
+                                                icp_max_correspondence_distance_,
+                                                icp_max_iterations_, correction))
+      {
+        pcl::transformPointCloud(*view, *view, correction);
+      }
+      else
+      {
+        ROS_WARN("[multimodal_object_recognition] ICP did not converge, using TF registration only");
+      }
+    }
+    scene_segmentation_ros_->addCloudAccumulation(view);
+  }
+  // The RGB ROIs are computed on the organized cloud of the last view, which matches image_msg_
+  cloud_ = view;
+  multi_view_count_++;
+  ROS_INFO("[multimodal_object_recognition] Added view %d of %d", multi_view_count_, num_views_);
 
-    // clear recognized image and cloud list
-    recognized_image_list_.objects.clear();
-    recognized_cloud_list_.objects.clear();
+  event_out.data = "e_view_added";
+  pub_event_out_.publish(event_out);
 
-    scene_segmentation_ros_->resetCloudAccumulation();
-    // pub e_done
-    std_msgs::String event_out;
-    event_out.data = "e_done";
-    pub_event_out_.publish(event_out);
+  if (multi_view_count_ >= num_views_)
+  {
+    multi_view_active_ = false;
+    finishRecognition();
   }
 }
 
-void MultimodalObjectRecognitionROS::preprocessPointCloud(const sensor_msgs::PointCloud2ConstPtr &cloud_msg)
+void MultimodalObjectRecognitionROS::finishRecognition()
 {
-  sensor_msgs::PointCloud2 msg_transformed;
-  msg_transformed.header.frame_id = target_frame_id_;
-  if (!mpu::pointcloud::transformPointCloudMsg(tf_listener_, target_frame_id_, *cloud_msg, msg_transformed))
-    return;
+  recognizeCloudAndImage();
+  multi_view_count_ = 0;
 
-  pcl::PCLPointCloud2::Ptr pc2(new pcl::PCLPointCloud2);
-  pcl_conversions::toPCL(msg_transformed, *pc2);
-  pc2->header.frame_id = msg_transformed.header.frame_id;
+  // clear recognized image and cloud list
+  recognized_image_list_.objects.clear();
+  recognized_cloud_list_.objects.clear();
 
-  cloud_ = PointCloud::Ptr(new PointCloud);
-  pcl::fromPCLPointCloud2(*pc2, *cloud_);
+  {
+    std::lock_guard<std::mutex> lock(segmentation_mutex_);
+    // reset object id
+    scene_segmentation_ros_->resetPclObjectId();
+    scene_segmentation_ros_->resetCloudAccumulation();
+  }
+  // pub e_done
+  std_msgs::String event_out;
+  event_out.data = "e_done";
+  pub_event_out_.publish(event_out);
 }
 
-void MultimodalObjectRecognitionROS::segmentPointCloud(mas_perception_msgs::ObjectList &object_list,
-                             std::vector<PointCloud::Ptr> &clusters,
-                             std::vector<mpu::object::BoundingBox> boxes)
+bool MultimodalObjectRecognitionROS::preprocessPointCloud(const sensor_msgs::PointCloud2ConstPtr &cloud_msg,
+                                                          PointCloud::Ptr &cloud, bool use_cloud_stamp)
 {
-  PointCloud::Ptr cloud(new PointCloud);
-  cloud->header.frame_id = target_frame_id_;
-  scene_segmentation_ros_->getCloudAccumulation(cloud);
+  mpu::ScopedLatencyTimer timer(TRANSFORM_STAGE);
+  cloud = PointCloud::Ptr(new PointCloud);
 
-  // if the cluster is centered,it looses the correct location of the object
-  scene_segmentation_ros_->segmentCloud(cloud, object_list, clusters, boxes,
-                      center_cluster_ = false, pad_cluster_, padded_cluster_size_);
+  // Points outside the workspace are culled in the sensor frame before they are transformed
+  mpu::pointcloud::ConversionFilter filter;
+  if (enable_sensor_frame_crop_)
+  {
+    std::lock_guard<std::mutex> lock(segmentation_mutex_);
+    filter.enable_crop_box = scene_segmentation_ros_->getWorkspaceBounds(filter.crop_box_min,
+                                                                         filter.crop_box_max);
+  }
+
+  // NaNs are kept so that the cloud stays organized for the RGB ROIs
+  return mpu::pointcloud::transformPointCloudMsg(*transform_cache_, target_frame_id_, *cloud_msg,
+                                                 *cloud, filter, use_cloud_stamp);
+}
+
+void MultimodalObjectRecognitionROS::segmentPointCloud(RecognitionFrame &frame,
+                             const PointCloud::ConstPtr &plane_cloud)
+{
+  // The base does not move while perceiving, so the latest base pose selects the cached plane
+  Eigen::Affine3d base_pose;
+  if (transform_cache_->lookup(plane_cache_fixed_frame_, target_frame_id_, ros::Time(0), base_pose))
+  {
+    scene_segmentation_ros_->setPlaneCacheContext(workstation_name_, base_pose.cast<float>());
+  }
+  else
+  {
+    scene_segmentation_ros_->clearPlaneCacheContext();
+  }
+  segmentFrame(frame, plane_cloud);
+  publishPlaneCacheStatus();
 
   // get workspace height
   std_msgs::Float64 workspace_height_msg;
-  workspace_height_msg.data = scene_segmentation_ros_->getWorkspaceHeight();
+  workspace_height_msg.data = frame.workspace_height;
   pub_workspace_height_.publish(workspace_height_msg);
 
   if (debug_mode_)
@@ -219,7 +344,7 @@ void MultimodalObjectRecognitionROS::segmentPointCloud(mas_perception_msgs::Obje
     PointCloud::Ptr cloud_debug(new PointCloud);
     cloud_debug = scene_segmentation_ros_->getCloudDebug();
     sensor_msgs::PointCloud2 ros_pc2;
-    pcl::toROSMsg(*cloud_debug, ros_pc2);
+    mpu::pointcloud::toPointCloud2Msg(*cloud_debug, ros_pc2);
     ros_pc2.header.frame_id = target_frame_id_;
     pub_debug_cloud_plane_.publish(ros_pc2);
   }
@@ -227,387 +352,513 @@ void MultimodalObjectRecognitionROS::segmentPointCloud(mas_perception_msgs::Obje
 
 void MultimodalObjectRecognitionROS::recognizeCloudAndImage()
 {
-  mas_perception_msgs::ObjectList cloud_object_list;
-  std::vector<PointCloud::Ptr> clusters_3d;
-  std::vector<mpu::object::BoundingBox> boxes;
+  RecognitionFrame frame;
+  frame.id = nextRequestId();
+  frame.image = image_msg_;
+  frame.cloud_msg = pointcloud_msg_;
+  frame.cloud = cloud_;
 
-  segmentPointCloud(cloud_object_list, clusters_3d, boxes);
+  {
+    std::lock_guard<std::mutex> lock(segmentation_mutex_);
+    // The plane of a single view can be found on its organized pointcloud, only used if the
+    // organized plane detection is enabled
+    PointCloud::ConstPtr plane_cloud;
+    if (multi_view_count_ <= 1)
+      plane_cloud = frame.cloud;
+    segmentPointCloud(frame, plane_cloud);
+  }
 
   if (data_collection_)
   {
-    std::string filename;
-    
-    // Save PCD (point cloud) cluster 
-    for (auto& cluster : clusters_3d)
+    recordDatasetFrame(frame);
+    return;
+  }
+
+  if (!recognizeObjects(frame))
+  {
+    return;
+  }
+  // Keep the recognizer results for publishDebug
+  recognized_cloud_list_ = frame.recognized_cloud_list;
+  recognized_image_list_ = frame.recognized_image_list;
+
+  if (fuseObjects(frame))
+  {
+    // Publish object to object list merger
+    publishObjectList(frame.combined_object_list);
+  }
+  else
+  {
+    ROS_WARN("No objects to publish");
+    if (debug_mode_)
     {
-      filename = "";
-      filename.append("pcd_cluster_");
-      filename.append(std::to_string(ros::Time::now().toSec()));
-      mpu::object::savePcd(cluster, logdir_, filename);
-      ROS_INFO_STREAM("\033[1;35mSaving point cloud to \033[0m" << logdir_);
+      ros::Time time_now = ros::Time::now();
+      // Save raw image
+      cv_bridge::CvImagePtr raw_cv_image;
+      if (mpu::object::getCVImage(frame.image, raw_cv_image))
+      {
+        recordArtifact(raw_cv_image->image, "rgb_raw_", time_now);
+      }
+      else
+      {
+        ROS_ERROR("Cannot generate cv image...");
+      }
+    }
+    return;
+  }
+
+  if (debug_mode_)
+  {
+    ROS_DEBUG_STREAM("Debug mode: publishing object information");
+    publishDebug(frame.combined_object_list, frame.clusters_3d, frame.clusters_2d,
+                 frame.filtered_clusters_2d);
+
+    ros::Time time_now = ros::Time::now();
+
+    // Save debug image
+    if(frame.recognized_image_list.objects.size() > 0)
+    {
+      recordArtifact(frame.cv_image->image, "rgb_debug_", time_now);
+    }
+    else
+    {
+      ROS_WARN_STREAM("No Objects found. Cannot save debug image...");
     }
-    
     // Save raw image
     cv_bridge::CvImagePtr raw_cv_image;
-    if (mpu::object::getCVImage(image_msg_, raw_cv_image))
+    if (mpu::object::getCVImage(frame.image, raw_cv_image))
     {
-      std::string filename = "";
-      filename = "";
-      filename.append("rgb_raw_");
-      filename.append(std::to_string(ros::Time::now().toSec()));
-      mpu::object::saveCVImage(raw_cv_image, logdir_, filename);
-      ROS_DEBUG_STREAM("Image:" << filename << " saved to " << logdir_);
+      recordArtifact(raw_cv_image->image, "rgb_raw_", time_now);
     }
     else
     {
       ROS_ERROR("Cannot generate cv image...");
     }
 
-    return;
+    // Save pointcloud debug
+    for (size_t i = 0; i < frame.clusters_3d.size(); i++)
+    {
+      recordArtifact(frame.clusters_3d[i], "pcd_cluster_", time_now, i);
+    }
   }
+}
 
-  // Reset recognition callback flags
-  received_recognized_cloud_list_flag_ = false;
-  received_recognized_image_list_flag_ = false;
+std::string MultimodalObjectRecognitionROS::artifactPath(const std::string &prefix,
+                                                         const ros::Time &stamp, int index,
+                                                         const std::string &extension) const
+{
+  std::string path = logdir_;
+  if (!path.empty() && path.back() != '/')
+  {
+    path += "/";
+  }
+  path += prefix + std::to_string(stamp.toSec());
+  if (index >= 0)
+  {
+    path += "_" + std::to_string(index);
+  }
+  return path + extension;
+}
 
-  // Publish 3D object cluster for recognition
-  if (!cloud_object_list.objects.empty() && enable_pc_recognizer_)
+void MultimodalObjectRecognitionROS::recordArtifact(const cv::Mat &image, const std::string &prefix,
+                                                    const ros::Time &stamp)
+{
+  const std::string path = artifactPath(prefix, stamp, -1, ".jpg");
+  if (artifact_recorder_->recordImage(image, path))
   {
-    ROS_INFO_STREAM("Publishing clouds for recognition");
-    pub_cloud_to_recognizer_.publish(cloud_object_list);
+    ROS_DEBUG_STREAM("Image " << path << " queued");
   }
+  else
+  {
+    ROS_WARN_THROTTLE(1.0, "[multimodal_object_recognition] Artifact queue full, %lu dropped",
+                      artifact_recorder_->getStatistics().dropped);
+  }
+}
 
-  // Pub Image to recognizer
-  mas_perception_msgs::ImageList image_list;
-  image_list.images.resize(1);
-  image_list.images[0] = *image_msg_;
-  if (!image_list.images.empty() && enable_rgb_recognizer_)
+void MultimodalObjectRecognitionROS::recordArtifact(const PointCloud::ConstPtr &cloud,
+                                                    const std::string &prefix,
+                                                    const ros::Time &stamp, int index)
+{
+  const std::string path = artifactPath(prefix, stamp, index, ".pcd");
+  if (artifact_recorder_->recordPointCloud(cloud, path))
   {
-    ROS_INFO_STREAM("Publishing images for recognition");
-    pub_image_to_recognizer_.publish(image_list);
+    ROS_DEBUG_STREAM("Point cloud " << path << " queued");
   }
-  ROS_INFO_STREAM("Waiting for message from Cloud and Image recognizer");
-  // loop till it received the message from the 3d and rgb recognition
-  int loop_rate_hz = 30;
-  int timeout_wait = 10;  // secs
-  ros::Rate loop_rate(loop_rate_hz);
-  int loop_rate_count = 0;
-  if (cloud_object_list.objects.size() > 0 && enable_pc_recognizer_)
-  {
-    ROS_INFO_STREAM("[Cloud] Waiting message from PCL recognizer node");
-    while (!received_recognized_cloud_list_flag_)
-    {
-      loop_rate_count += 1;
-      ros::spinOnce();
-      loop_rate.sleep();
-      if (received_recognized_cloud_list_flag_ == true)
-      {
-        ROS_INFO("[Cloud] Received %d objects from pcl recognizer", recognized_cloud_list_.objects.size());
-      }
-      if (loop_rate_count > loop_rate_hz * timeout_wait)
-      {
-        received_recognized_cloud_list_flag_ = false;
-        ROS_WARN("[Cloud] No message received from PCL recognizer. ");
-        break;
-      }
-    }
+  else
+  {
+    ROS_WARN_THROTTLE(1.0, "[multimodal_object_recognition] Artifact queue full, %lu dropped",
+                      artifact_recorder_->getStatistics().dropped);
   }
+}
 
-  // Merge recognized_cloud_list and rgb_object_list
-  mas_perception_msgs::ObjectList combined_object_list;
-  if (!recognized_cloud_list_.objects.empty())
+void MultimodalObjectRecognitionROS::recordDatasetFrame(const RecognitionFrame &frame)
+{
+  mpu::DatasetFrame dataset_frame;
+  dataset_frame.stamp_ns = frame.cloud_msg->header.stamp.toNSec();
+  dataset_frame.frame_id = target_frame_id_;
+  dataset_frame.cloud = frame.cloud;
+
+  cv_bridge::CvImagePtr raw_cv_image;
+  if (mpu::object::getCVImage(frame.image, raw_cv_image))
+  {
+    dataset_frame.image = raw_cv_image->image;
+  }
+  else
   {
-    combined_object_list.objects.insert(combined_object_list.objects.end(),
-                    recognized_cloud_list_.objects.begin(),
-                    recognized_cloud_list_.objects.end());
+    ROS_ERROR("Cannot generate cv image...");
   }
 
-  loop_rate_count = 0;
-  timeout_wait = 3;  //  secs
-  if (image_list.images.size() > 0)
+  // The clusters are unlabeled, their poses are in the target frame
+  for (size_t i = 0; i < frame.clusters_3d.size(); i++)
   {
-  ROS_INFO_STREAM("[RGB] Waiting message from RGB recognizer node");
-    while (!received_recognized_image_list_flag_)
+    mpu::DatasetObject object;
+    object.cluster = frame.clusters_3d[i];
+    if (i < frame.cloud_object_list.objects.size())
     {
-      loop_rate_count += 1;
-      ros::spinOnce();
-      loop_rate.sleep();
-      if (received_recognized_image_list_flag_ == true)
-      {
-        ROS_INFO("[RGB] Received %d objects from rgb recognizer", (int)(recognized_image_list_.objects.size()));
-      }
-      if (loop_rate_count > loop_rate_hz * timeout_wait)
-      {
-        received_recognized_image_list_flag_ = false;
-        ROS_WARN("[RGB] No message received from RGB recognizer. ");
-        break;
-      }
+      const geometry_msgs::Pose &pose = frame.cloud_object_list.objects[i].pose.pose;
+      object.position = Eigen::Vector3d(pose.position.x, pose.position.y, pose.position.z);
+      object.orientation = Eigen::Quaterniond(pose.orientation.w, pose.orientation.x,
+                                              pose.orientation.y, pose.orientation.z);
     }
+    dataset_frame.objects.push_back(object);
   }
-  // Reset recognition callback flags
-  received_recognized_cloud_list_flag_ = false;
-  received_recognized_image_list_flag_ = false;
 
-  mas_perception_msgs::ObjectList rgb_object_list;
-  mas_perception_msgs::BoundingBoxList bounding_boxes;
-  std::vector<PointCloud::Ptr> clusters_2d;
-  std::vector<PointCloud::Ptr> filtered_clusters_2d;
+  // Sensor pose, the pointcloud was already transformed into the target frame
+  Eigen::Affine3d transform;
+  if (transform_cache_->lookup(target_frame_id_, frame.cloud_msg->header.frame_id,
+                               frame.cloud_msg->header.stamp, transform))
+  {
+    mpu::DatasetTransform dataset_transform;
+    dataset_transform.target_frame = target_frame_id_;
+    dataset_transform.source_frame = frame.cloud_msg->header.frame_id;
+    dataset_transform.translation = transform.translation();
+    dataset_transform.rotation = Eigen::Quaterniond(transform.rotation());
+    dataset_frame.transforms.push_back(dataset_transform);
+  }
 
-  cv_bridge::CvImagePtr cv_image;
-  if (recognized_image_list_.objects.size() > 0)
+  if (artifact_recorder_->recordFrame(dataset_frame))
   {
-    try
-    {
-      cv_image = cv_bridge::toCvCopy(image_msg_, sensor_msgs::image_encodings::BGR8);
-    }
-    catch (cv_bridge::Exception& e)
+    ROS_INFO_STREAM("\033[1;35mSaving frame with \033[0m" << dataset_frame.objects.size()
+                    << "\033[1;35m clusters to \033[0m" << dataset_dir_);
+  }
+  else
+  {
+    ROS_WARN_THROTTLE(1.0, "[multimodal_object_recognition] Dataset frame not recorded, %lu dropped",
+                      artifact_recorder_->getStatistics().dropped);
+  }
+}
+
+uint32_t MultimodalObjectRecognitionROS::nextRequestId()
+{
+  // 0 is reserved for responses that do not carry a request id
+  recognition_request_id_ = std::max(recognition_request_id_ + 1, 1u);
+  return recognition_request_id_;
+}
+
+bool MultimodalObjectRecognitionROS::recognizeObjects(RecognitionFrame &frame)
+{
+  // Both recognizers run concurrently, every response is post-processed as soon as it arrives
+  typedef std::chrono::steady_clock Clock;
+  mpu::ScopedLatencyTimer timer(RECOGNITION_STAGE);
+  const Clock::time_point request_time = Clock::now();
+  const int64_t request_time_ns = mpu::LatencyProfiler::now();
+  mpu::LatencyProfiler &profiler = mpu::LatencyProfiler::instance();
+
+  // Publish 3D object cluster for recognition
+  RecognizerClient::ResponseFuture pc_response;
+  Clock::time_point pc_deadline = request_time + std::chrono::seconds(10);
+  if (!frame.cloud_object_list.objects.empty() && frame.params.enable_pc_recognizer)
+  {
+    // The recognizer echoes the objects back, the pose header carries the request id
+    for (auto &object : frame.cloud_object_list.objects)
     {
-      ROS_ERROR("cv_bridge exception: %s", e.what());
-      return;
+      object.pose.header.seq = frame.id;
     }
+    pc_response = pc_recognizer_client_->addRequest(frame.id);
+    ROS_INFO_STREAM("Publishing clouds for recognition");
+    pub_cloud_to_recognizer_.publish(frame.cloud_object_list);
+  }
 
-    bounding_boxes.bounding_boxes.resize(recognized_image_list_.objects.size());
-    rgb_object_list.objects.resize(recognized_image_list_.objects.size());
+  // Pub Image to recognizer
+  RecognizerClient::ResponseFuture rgb_response;
+  // The rgb recognizer gets 3 s after the cloud recognizer is done, as when both were waited
+  // for one after the other, so a slow cloud recognizer does not use up its time
+  const std::chrono::seconds rgb_timeout(3);
+  Clock::time_point rgb_deadline = pc_response.valid() ? Clock::time_point::max() :
+                                   request_time + rgb_timeout;
+  if (frame.params.enable_rgb_recognizer)
+  {
+    mas_perception_msgs::ImageList image_list;
+    image_list.images.resize(1);
+    image_list.images[0] = *frame.image;
+    image_list.images[0].header.seq = frame.id;
+    rgb_response = rgb_recognizer_client_->addRequest(frame.id);
+    ROS_INFO_STREAM("Publishing images for recognition");
+    pub_image_to_recognizer_.publish(image_list);
+  }
 
-    for (int i = 0; i < recognized_image_list_.objects.size(); i++)
+  ROS_INFO_STREAM("Waiting for message from Cloud and Image recognizer");
+  bool wait_pc = pc_response.valid();
+  bool wait_rgb = rgb_response.valid();
+  while (wait_pc || wait_rgb)
+  {
+    Clock::time_point deadline = wait_pc && wait_rgb ? std::min(pc_deadline, rgb_deadline) :
+                                 wait_pc ? pc_deadline : rgb_deadline;
     {
-      mas_perception_msgs::Object object = recognized_image_list_.objects[i];
-      // Check qualitative info of the object
-      if (round_objects_.count(recognized_image_list_.objects[i].name))
-      {
-        object.shape.shape = object.shape.SPHERE;
-      }
-      else if (flat_objects_.count(recognized_image_list_.objects[i].name))
-      {
-        object.shape.shape = "flat";
-      }
-      else
-      {
-        object.shape.shape = object.shape.OTHER;
-      }
-      // Get ROI
-      sensor_msgs::RegionOfInterest roi_2d = object.roi;
-      const cv::Rect2d rect2d(roi_2d.x_offset, roi_2d.y_offset, roi_2d.width, roi_2d.height);
+      std::unique_lock<std::mutex> lock(recognizer_mutex_);
+      recognizer_cv_.wait_until(lock, deadline, [&] {
+        return recognition_cancelled_ ||
+               (wait_pc && RecognizerClient::isReady(pc_response)) ||
+               (wait_rgb && RecognizerClient::isReady(rgb_response));
+      });
+    }
 
-      if (debug_mode_)
+    if (recognition_cancelled_)
+    {
+      if (wait_pc)
       {
-        cv::Point pt1;
-        cv::Point pt2;
-
-        pt1.x = roi_2d.x_offset;
-        pt1.y = roi_2d.y_offset;
-        pt2.x = roi_2d.x_offset + roi_2d.width;
-        pt2.y = roi_2d.y_offset + roi_2d.height;
-
-        // draw bbox
-        cv::rectangle(cv_image->image, pt1, pt2, cv::Scalar(0, 255, 0), 1, 8, 0);
-        // add label
-        cv::putText(cv_image->image, object.name, cv::Point(pt1.x, pt2.y),
-              cv::FONT_HERSHEY_SIMPLEX, 0.3, cv::Scalar(0, 255, 0), 1);
+        pc_recognizer_client_->cancelRequest(frame.id);
       }
-      // Remove large 2d misdetected bbox (misdetection)
-      double len_diag = sqrt(powf(roi_2d.width, 2) + powf(roi_2d.height, 2));
-
-      // check if object name has container
-      bool is_container = false;
-      if (object.name == "CONTAINER_BOX_BLUE" || object.name == "CONTAINER_BOX_RED")
+      if (wait_rgb)
       {
-        ROS_INFO("Found container object %s", object.name.c_str());
-        is_container = true;
+        rgb_recognizer_client_->cancelRequest(frame.id);
       }
+      return false;
+    }
 
-      if ((len_diag > rgb_bbox_min_diag_ && len_diag < rgb_bbox_max_diag_) || is_container)
-      {
-        PointCloud::Ptr cloud_roi(new PointCloud);
-        bool getROISuccess = mpu::pointcloud::getPointCloudROI(roi_2d, cloud_, cloud_roi, 
-                                                         rgb_roi_adjustment_, 
-                                                         rgb_cluster_remove_outliers_);
-        // ToDo: Filter big objects from 2d proposal, if the height is less than 3 mm
-        // pcl::PointXYZRGB min_pt;
-        // pcl::PointXYZRGB max_pt;
-        // pcl::getMinMax3D(*cloud_roi, min_pt, max_pt);
-        // float obj_height = max_pt.z - scene_segmentation_ros_->getWorkspaceHeight();
-        
-        if (getROISuccess)
-        {
-          sensor_msgs::PointCloud2 ros_pc2;
-          pcl::PCLPointCloud2::Ptr pc2(new pcl::PCLPointCloud2);
-          pcl::toPCLPointCloud2(*cloud_roi, *pc2);
-          pcl_conversions::fromPCL(*pc2, ros_pc2);
-          ros_pc2.header.frame_id = target_frame_id_;
-          ros_pc2.header.stamp = ros::Time::now();
-
-          rgb_object_list.objects[i].views.resize(1);
-          rgb_object_list.objects[i].views[0].point_cloud = ros_pc2;
-
-          clusters_2d.push_back(cloud_roi);
-          // Get pose
-          geometry_msgs::PoseStamped pose;
-
-          // ************************************************
-          // Publish filtered point cloud from RGB recognizer
-          // ************************************************
-          
-          // PointCloud filtered_rgb_pointcloud;
-          PointCloud::Ptr filtered_rgb_pointcloud(new PointCloud);
-          *filtered_rgb_pointcloud = mpu::object::estimatePose(cloud_roi, pose, object, object.shape.shape,
-                                                              rgb_cluster_filter_limit_min_,
-                                                              rgb_cluster_filter_limit_max_,
-                                                              obj_category_);
-
-          // append filtered point cloud to filtered_clusters_2d
-          filtered_clusters_2d.push_back(filtered_rgb_pointcloud);
-          
-          PointT min_pt;
-          PointT max_pt;
-          pcl::getMinMax3D(*filtered_rgb_pointcloud, min_pt, max_pt);
-
-          rgb_object_list.objects[i].dimensions.vector.z = max_pt.z - min_pt.z;
-          ROS_INFO("[RGB Object Height] Object %s length: %f", object.name.c_str(), rgb_object_list.objects[i].dimensions.vector.z);
-
-          if (max_pt.z > 0.09)
-          {
-            ROS_INFO("[RGB Object Height] Object %s length is greater than 9cm: %f", object.name.c_str(), max_pt.z);
-          }
-
-          //*********************************
-
-          // Transform pose
-          std::string frame_id = cloud_->header.frame_id;
-          pose.header.stamp = ros::Time::now();
-          pose.header.frame_id = frame_id;
-          if (frame_id != target_frame_id_)
-          {
-            mpu::object::transformPose(tf_listener_, target_frame_id_,
-                           pose, rgb_object_list.objects[i].pose);
-          }
-          else
-          {
-            rgb_object_list.objects[i].pose = pose;
-          }
-          rgb_object_list.objects[i].probability = recognized_image_list_.objects[i].probability;
-          rgb_object_list.objects[i].database_id = rgb_object_id_;
-          rgb_object_list.objects[i].name = recognized_image_list_.objects[i].name;
-        }
-        else
-        {
-          ROS_DEBUG("[RGB] DECOY");
-          rgb_object_list.objects[i].name = "DECOY";
-          rgb_object_list.objects[i].database_id = rgb_object_id_;
-        
-        }
-      }
-      else
-      {
-        ROS_WARN("[RGB] BBOX too big or too small");
-        ROS_DEBUG("[RGB] DECOY");
-        rgb_object_list.objects[i].name = "DECOY";
-        rgb_object_list.objects[i].database_id = rgb_object_id_;
-      }
-      rgb_object_id_++;
+    if (wait_pc && RecognizerClient::isReady(pc_response))
+    {
+      wait_pc = false;
+      profiler.record(PC_RECOGNIZER_WAIT_STAGE.id(), request_time_ns, mpu::LatencyProfiler::now());
+      frame.recognized_cloud_list = pc_response.get();
+      ROS_INFO("[Cloud] Received %d objects from pcl recognizer", (int)(frame.recognized_cloud_list.objects.size()));
+      rgb_deadline = Clock::now() + rgb_timeout;
+    }
+    else if (wait_pc && Clock::now() >= pc_deadline)
+    {
+      wait_pc = false;
+      profiler.record(PC_RECOGNIZER_WAIT_STAGE.id(), request_time_ns, mpu::LatencyProfiler::now());
+      pc_recognizer_client_->cancelRequest(frame.id);
+      ROS_WARN("[Cloud] No message received from PCL recognizer. ");
+      rgb_deadline = Clock::now() + rgb_timeout;
     }
-    combined_object_list.objects.insert(combined_object_list.objects.end(),
-                    rgb_object_list.objects.begin(),
-                    rgb_object_list.objects.end());
-  }
 
-  if (!combined_object_list.objects.empty())
-  {
-    if (enable_roi_)
+    if (wait_rgb && RecognizerClient::isReady(rgb_response))
     {
-      for (int i = 0; i < combined_object_list.objects.size(); i++)
+      wait_rgb = false;
+      profiler.record(RGB_RECOGNIZER_WAIT_STAGE.id(), request_time_ns, mpu::LatencyProfiler::now());
+      frame.recognized_image_list = rgb_response.get();
+      ROS_INFO("[RGB] Received %d objects from rgb recognizer", (int)(frame.recognized_image_list.objects.size()));
+      if (!processRecognizedImageList(frame))
       {
-        double current_object_pose_x = combined_object_list.objects[i].pose.pose.position.x;
-        if (current_object_pose_x < roi_base_link_to_laser_distance_ ||
-            current_object_pose_x > roi_max_object_pose_x_to_base_link_)
-          /* combined_object_list.objects[i].pose.pose.position.z < scene_segmentation_ros_ */
-          /* ->object_height_above_workspace_ - 0.05) */
+        if (wait_pc)
         {
-          ROS_WARN_STREAM("This object " << combined_object_list.objects[i].name << " out of RoI");
-          combined_object_list.objects[i].name = "DECOY";
+          pc_recognizer_client_->cancelRequest(frame.id);
         }
+        return false;
       }
     }
-    // Adjust RPY to make pose flat, adjust container pose
-    // Adjust Axis and Bolt pose
-    adjustObjectPose(combined_object_list);
-    // Publish object to object list merger
-    publishObjectList(combined_object_list);
-  }
-  else
-  {
-    ROS_WARN("No objects to publish");
-    if (debug_mode_)
+    else if (wait_rgb && Clock::now() >= rgb_deadline)
     {
-      ros::Time time_now = ros::Time::now();
-      // Save raw image
-      cv_bridge::CvImagePtr raw_cv_image;
-      if (mpu::object::getCVImage(image_msg_, raw_cv_image))
-      {
-        std::string filename = "";
-        filename = "";
-        filename.append("rgb_raw_");
-        filename.append(std::to_string(time_now.toSec()));
-        mpu::object::saveCVImage(raw_cv_image, logdir_, filename);
-        ROS_DEBUG_STREAM("Image:" << filename << " saved to " << logdir_);
-      }
-      else
-      {
-        ROS_ERROR("Cannot generate cv image...");
-      }
+      wait_rgb = false;
+      profiler.record(RGB_RECOGNIZER_WAIT_STAGE.id(), request_time_ns, mpu::LatencyProfiler::now());
+      rgb_recognizer_client_->cancelRequest(frame.id);
+      ROS_WARN("[RGB] No message received from RGB recognizer. ");
     }
+  }
+  return true;
+}
+
+void MultimodalObjectRecognitionROS::requestFrame()
+{
+  // Pairs captured while the sensor was still moving are skipped
+  frame_min_stamp_ = ros::Time::now() + ros::Duration(frame_settle_time_);
+  frame_requested_ = true;
+}
+
+void MultimodalObjectRecognitionROS::startPipeline()
+{
+  if (pipeline_running_)
+  {
     return;
   }
+  transform_queue_.reset(new FrameQueue(pipeline_queue_size_));
+  segmentation_queue_.reset(new FrameQueue(pipeline_queue_size_));
+  recognition_queue_.reset(new FrameQueue(pipeline_queue_size_));
+  fusion_queue_.reset(new FrameQueue(pipeline_queue_size_));
+  pipeline_received_frames_ = 0;
+  pipeline_dropped_frames_ = 0;
+  pipeline_processed_frames_ = 0;
+
+  recognition_cancelled_ = false;
+  pipeline_running_ = true;
+  pipeline_threads_.emplace_back(&MultimodalObjectRecognitionROS::transformStage, this);
+  pipeline_threads_.emplace_back(&MultimodalObjectRecognitionROS::segmentationStage, this);
+  pipeline_threads_.emplace_back(&MultimodalObjectRecognitionROS::recognitionStage, this);
+  pipeline_threads_.emplace_back(&MultimodalObjectRecognitionROS::fusionStage, this);
+
+  pipeline_status_timer_ = nh_.createWallTimer(ros::WallDuration(1.0),
+                                               &MultimodalObjectRecognitionROS::publishPipelineStatus, this);
+  ROS_INFO_STREAM("[multimodal_object_recognition] Continuous mode started with queue size "
+                  << pipeline_queue_size_);
+}
 
-  if (debug_mode_)
+void MultimodalObjectRecognitionROS::stopPipeline()
+{
+  if (!pipeline_running_)
   {
-    ROS_DEBUG_STREAM("Debug mode: publishing object information");
-    publishDebug(combined_object_list, clusters_3d, clusters_2d, filtered_clusters_2d);
+    return;
+  }
+  pipeline_running_ = false;
+  pipeline_status_timer_.stop();
+  // Wake up the stages waiting for frames or for the recognizers, so the joins do not
+  // block the callback queue
+  transform_queue_->close();
+  segmentation_queue_->close();
+  recognition_queue_->close();
+  fusion_queue_->close();
+  {
+    std::lock_guard<std::mutex> lock(recognizer_mutex_);
+    recognition_cancelled_ = true;
+  }
+  recognizer_cv_.notify_all();
+  for (auto &thread : pipeline_threads_)
+  {
+    thread.join();
+  }
+  pipeline_threads_.clear();
+  // Single shot requests wait for the recognizers again
+  recognition_cancelled_ = false;
+  ROS_INFO("[multimodal_object_recognition] Continuous mode stopped, received %lu, processed %lu, dropped %lu frames",
+           pipeline_received_frames_.load(), pipeline_processed_frames_.load(), pipeline_dropped_frames_.load());
+}
 
-    ros::Time time_now = ros::Time::now();
+bool MultimodalObjectRecognitionROS::popFrame(FrameQueue &queue, RecognitionFramePtr &frame)
+{
+  return pipeline_running_ && queue.waitPop(frame);
+}
 
-    // Save debug image
-    if(recognized_image_list_.objects.size() > 0)
-    {
-      std::string filename = "";
-      filename.append("rgb_debug_");
-      filename.append(std::to_string(time_now.toSec()));
-      mpu::object::saveCVImage(cv_image, logdir_, filename);
-      ROS_DEBUG_STREAM("Image:" << filename << " saved to " << logdir_);
-    }
-    else
+void MultimodalObjectRecognitionROS::pushFrame(FrameQueue &queue, const RecognitionFramePtr &frame)
+{
+  // Stages apply back-pressure on each other, frames are only dropped at the pipeline entry
+  queue.waitPush(frame);
+}
+
+void MultimodalObjectRecognitionROS::transformStage()
+{
+  RecognitionFramePtr frame;
+  while (popFrame(*transform_queue_, frame))
+  {
+    if (!preprocessPointCloud(frame->cloud_msg, frame->cloud))
     {
-      ROS_WARN_STREAM("No Objects found. Cannot save debug image...");
+      pipeline_dropped_frames_++;
+      continue;
     }
-    // Save raw image
-    cv_bridge::CvImagePtr raw_cv_image;
-    if (mpu::object::getCVImage(image_msg_, raw_cv_image))
+    pushFrame(*segmentation_queue_, frame);
+  }
+}
+
+void MultimodalObjectRecognitionROS::segmentationStage()
+{
+  RecognitionFramePtr frame;
+  while (popFrame(*segmentation_queue_, frame))
+  {
     {
-      std::string filename = "";
-      filename = "";
-      filename.append("rgb_raw_");
-      filename.append(std::to_string(time_now.toSec()));
-      mpu::object::saveCVImage(raw_cv_image, logdir_, filename);
-      ROS_DEBUG_STREAM("Image:" << filename << " saved to " << logdir_);
+      std::lock_guard<std::mutex> lock(segmentation_mutex_);
+      scene_segmentation_ros_->addCloudAccumulation(frame->cloud);
+      segmentPointCloud(*frame, frame->cloud);
+      scene_segmentation_ros_->resetPclObjectId();
+      scene_segmentation_ros_->resetCloudAccumulation();
     }
-    else
+    pushFrame(*recognition_queue_, frame);
+  }
+}
+
+void MultimodalObjectRecognitionROS::recognitionStage()
+{
+  RecognitionFramePtr frame;
+  while (popFrame(*recognition_queue_, frame))
+  {
+    if (!recognizeObjects(*frame))
     {
-      ROS_ERROR("Cannot generate cv image...");
+      pipeline_dropped_frames_++;
+      continue;
     }
+    pushFrame(*fusion_queue_, frame);
+  }
+}
 
-    // Save pointcloud debug
-    for (auto& cluster : clusters_3d)
+void MultimodalObjectRecognitionROS::fusionStage()
+{
+  RecognitionFramePtr frame;
+  while (popFrame(*fusion_queue_, frame))
+  {
+    if (fuseObjects(*frame))
     {
-      std::string filename = "";
-      filename = "";
-      filename.append("pcd_cluster_");
-      filename.append(std::to_string(time_now.toSec()));
-      mpu::object::savePcd(cluster, logdir_, filename);
-      ROS_DEBUG_STREAM("Point cloud:" << filename << " saved to " << logdir_);
+      publishObjectList(frame->combined_object_list);
     }
+    pipeline_processed_frames_++;
   }
 }
 
+void MultimodalObjectRecognitionROS::publishPipelineStatus(const ros::WallTimerEvent &event)
+{
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "multimodal_object_recognition/pipeline";
+  status.level = pipeline_dropped_frames_ > 0 ? diagnostic_msgs::DiagnosticStatus::WARN :
+                                                diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = pipeline_dropped_frames_ > 0 ? "dropping frames" : "ok";
+
+  std::vector<std::pair<std::string, size_t>> values = {
+    {"received_frames", pipeline_received_frames_},
+    {"processed_frames", pipeline_processed_frames_},
+    {"dropped_frames", pipeline_dropped_frames_},
+    {"transform_queue_depth", transform_queue_->size()},
+    {"segmentation_queue_depth", segmentation_queue_->size()},
+    {"recognition_queue_depth", recognition_queue_->size()},
+    {"fusion_queue_depth", fusion_queue_->size()}
+  };
+  for (const auto &value : values)
+  {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = value.first;
+    key_value.value = std::to_string(value.second);
+    status.values.push_back(key_value);
+  }
+  pub_pipeline_status_.publish(status);
+
+  ROS_INFO("[multimodal_object_recognition] Pipeline received %s, processed %s, dropped %s, "
+           "queue depth transform %s, segmentation %s, recognition %s, fusion %s",
+           status.values[0].value.c_str(), status.values[1].value.c_str(), status.values[2].value.c_str(),
+           status.values[3].value.c_str(), status.values[4].value.c_str(), status.values[5].value.c_str(),
+           status.values[6].value.c_str());
+}
+
+void MultimodalObjectRecognitionROS::publishPlaneCacheStatus()
+{
+  if (pub_plane_cache_status_.getNumSubscribers() == 0) return;
+  const PlaneModelCacheStatistics statistics = scene_segmentation_ros_->getPlaneCacheStatistics();
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "multimodal_object_recognition/plane_cache";
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = workstation_name_;
+
+  std::vector<std::pair<std::string, uint64_t>> values = {
+    {"hits", statistics.hits},
+    {"misses", statistics.misses},
+    {"rejected", statistics.rejected},
+    {"entries", statistics.entries}
+  };
+  for (const auto &value : values)
+  {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = value.first;
+    key_value.value = std::to_string(value.second);
+    status.values.push_back(key_value);
+  }
+  pub_plane_cache_status_.publish(status);
+}
+
 void MultimodalObjectRecognitionROS::publishDebug(mas_perception_msgs::ObjectList &combined_object_list,
                           std::vector<PointCloud::Ptr> &clusters_3d,
                           std::vector<PointCloud::Ptr> &clusters_2d,
@@ -625,11 +876,12 @@ void MultimodalObjectRecognitionROS::publishDebug(mas_perception_msgs::ObjectLis
     {
       mas_perception_msgs::BoundingBoxList bounding_boxes;
       cluster_visualizer_pc_.publish<PointT>(clusters_3d, target_frame_id_);
-      bounding_boxes.bounding_boxes.resize(clusters_3d.size());
-      for (int i=0; i < clusters_3d.size(); i++)
+      std::vector<mpu::object::BoundingBox> boxes;
+      mpu::object::BoundingBox::create(clusters_3d, normal, boxes);
+      bounding_boxes.bounding_boxes.resize(boxes.size());
+      for (int i=0; i < boxes.size(); i++)
       {
-        mpu::object::BoundingBox bbox;
-        mpu::object::get3DBoundingBox(clusters_3d[i], normal, bbox, bounding_boxes.bounding_boxes[i]);
+        mpu::object::convertBboxToMsg(boxes[i], bounding_boxes.bounding_boxes[i]);
       }
       if (bounding_boxes.bounding_boxes.size() > 0)
       {
@@ -708,219 +960,113 @@ void MultimodalObjectRecognitionROS::publishDebug(mas_perception_msgs::ObjectLis
 
 void MultimodalObjectRecognitionROS::publishObjectList(mas_perception_msgs::ObjectList &object_list)
 {
-  for (int i = 0; i < object_list.objects.size(); i++)
-  {
-    // Empty cloud
-    sensor_msgs::PointCloud2 empty_ros_cloud;
-    object_list.objects[i].views.resize(1);
-    object_list.objects[i].views[0].point_cloud = empty_ros_cloud;
-    // Rename container to match refbox naming
-    if (object_list.objects[i].name == "BLUE_CONTAINER")
-    {
-      object_list.objects[i].name = "CONTAINER_BOX_BLUE";
-    }
-    else if (object_list.objects[i].name == "RED_CONTAINER")
-    {
-      object_list.objects[i].name = "CONTAINER_BOX_RED";
-    }
-  }
+  prepareObjectList(object_list);
   // Publish object list to object list merger
   pub_object_list_.publish(object_list);
 }
 
-void MultimodalObjectRecognitionROS::adjustObjectPose(mas_perception_msgs::ObjectList &object_list)
+void MultimodalObjectRecognitionROS::transformPose(const geometry_msgs::PoseStamped &pose,
+                                                   geometry_msgs::PoseStamped &transformed_pose)
 {
-  for (int i = 0; i < object_list.objects.size(); i++)
+  if (!transform_cache_->transformPose(target_frame_id_, pose, transformed_pose,
+                                       ros::WallTime::now() + ros::WallDuration(0.1)))
   {
-    tf::Quaternion q(
-        object_list.objects[i].pose.pose.orientation.x,
-        object_list.objects[i].pose.pose.orientation.y,
-        object_list.objects[i].pose.pose.orientation.z,
-        object_list.objects[i].pose.pose.orientation.w);
-    tf::Matrix3x3 m(q);
-    double roll, pitch, yaw;
-    m.getRPY(roll, pitch, yaw);
-    double change_in_pitch = 0.0;
-    if (round_objects_.count(object_list.objects[i].name))
-    {
-      ROS_INFO_STREAM("Setting yaw to zero for " << object_list.objects[i].name);
-      yaw = 0.0;
-    }
+    transformed_pose = pose;
+  }
+}
 
-    // Update container pose
-    if (object_list.objects[i].name == "CONTAINER_BOX_RED" ||
-        object_list.objects[i].name == "CONTAINER_BOX_BLUE")
-    {
-      if (object_list.objects[i].database_id >= 100)
-      {
-        ROS_INFO_STREAM("Updating RGB container pose for " << object_list.objects[i].name);
-        mm_object_recognition_utils_->adjustContainerPose(object_list.objects[i], container_height_);
-      }
-    }
-    
-    if (object_list.objects[i].dimensions.vector.z > 0.09 and 
-        object_list.objects[i].name != "CONTAINER_BOX_RED" &&
-        object_list.objects[i].name != "CONTAINER_BOX_BLUE")
-    {
-      tf::Quaternion q2;
-      q2.setRPY(0.0, -1.57, 0.0);
-      object_list.objects[i].pose.pose.orientation.x = q2.x();
-      object_list.objects[i].pose.pose.orientation.y = q2.y();
-      object_list.objects[i].pose.pose.orientation.z = q2.z();
-      object_list.objects[i].pose.pose.orientation.w = q2.w();
-    }
-    else
+void MultimodalObjectRecognitionROS::eventCallback(const std_msgs::String::ConstPtr &msg)
+{
+  std_msgs::String event_out;
+  if (msg->data == "e_start")
+  {
+    if (pipeline_running_)
     {
-      // Make pose flat
-      tf::Quaternion q2 = tf::createQuaternionFromRPY(0.0, change_in_pitch , yaw);
-      object_list.objects[i].pose.pose.orientation.x = q2.x();
-      object_list.objects[i].pose.pose.orientation.y = q2.y();
-      object_list.objects[i].pose.pose.orientation.z = q2.z();
-      object_list.objects[i].pose.pose.orientation.w = q2.w(); 
-
-      double detected_object_height = object_list.objects[i].pose.pose.position.z;
-      if (obj_category_ == "cavity")
-      {
-           ROS_WARN_STREAM("PP01 workstation; not updating height");
-      }
-      else if (object_list.objects[i].name == "CONTAINER_BOX_RED" ||
-               object_list.objects[i].name == "CONTAINER_BOX_BLUE")
-      {
-           ROS_WARN_STREAM("Container; not updating height");
-      }
-      else if (use_fixed_heights_ or (std::fabs(detected_object_height - scene_segmentation_ros_->getWorkspaceHeight()) > 0.03))
-      {
-           if (use_fixed_heights_)
-           {
-              ROS_WARN_STREAM("Assuming fixed platform heights of 0, 5, 10 and 15 cm");
-           }
-           else
-           {
-              ROS_WARN_STREAM("Difference between object height and workspace height is > 3cm");
-           }
-           // do something
-           bool is_0cm = std::fabs(detected_object_height - height_of_floor_) < 0.01;
-           bool is_5cm = std::fabs(detected_object_height - (height_of_floor_ + 0.05)) < 0.01;
-           bool is_10cm = std::fabs(detected_object_height - (height_of_floor_ + 0.1)) < 0.01;
-           bool is_15cm = std::fabs(detected_object_height - (height_of_floor_ + 0.15)) < 0.01;
-           if (is_0cm)
-           {
-                ROS_WARN_STREAM("Updating height to 0cm");
-                object_list.objects[i].pose.pose.position.z = height_of_floor_ + object_height_above_workspace_;      
-           }
-           if (is_5cm)
-           {
-                ROS_WARN_STREAM("Updating height to 5cm");
-                object_list.objects[i].pose.pose.position.z = height_of_floor_ + 0.05 + object_height_above_workspace_;      
-           }
-           if (is_10cm)
-           {
-                ROS_WARN_STREAM("Updating height to 10cm");
-                object_list.objects[i].pose.pose.position.z = height_of_floor_ + 0.1 + object_height_above_workspace_;      
-           }
-           if (is_15cm)
-           {
-                ROS_WARN_STREAM("Updating height to 15cm");
-                object_list.objects[i].pose.pose.position.z = height_of_floor_ + 0.15 + object_height_above_workspace_;      
-           }
-
-      }
-      else
-      {
-          object_list.objects[i].pose.pose.position.z = scene_segmentation_ros_->getWorkspaceHeight() +
-                              object_height_above_workspace_;      
-      }
-
+      ROS_WARN("[multimodal_object_recognition] Continuous mode is running, ignoring e_start");
+      return;
     }
-
-    /*
-    // Update workspace height
-    if (scene_segmentation_ros_->getWorkspaceHeight() != -1000.0)
+    requestFrame();
+  }
+  else if (msg->data == "e_start_continuous")
+  {
+    frame_requested_ = false;
+    startPipeline();
+    event_out.data = "e_continuous_started";
+    pub_event_out_.publish(event_out);
+  }
+  else if (msg->data == "e_stop_continuous")
+  {
+    stopPipeline();
+    event_out.data = "e_continuous_stopped";
+    pub_event_out_.publish(event_out);
+  }
+  else if (msg->data == "e_start_multi_view")
+  {
+    if (pipeline_running_)
     {
-      if (object_list.objects[i].name == "CONTAINER_BOX_RED" ||
-          object_list.objects[i].name == "CONTAINER_BOX_BLUE")
-      {
-
-        object_list.objects[i].pose.pose.position.z = scene_segmentation_ros_->getWorkspaceHeight() +
-                              container_height_;
-        ROS_WARN_STREAM("Updated container height: " << object_list.objects[i].pose.pose.position.z );
-      }
+      ROS_WARN("[multimodal_object_recognition] Continuous mode is running, ignoring e_start_multi_view");
+      return;
     }
-    */
-    
-    // Update axis or bolt pose
-    if (object_list.objects[i].name == "M20_100" || object_list.objects[i].name == "AXIS" || object_list.objects[i].name == "SCREWDRIVER")
+    multi_view_active_ = true;
+    multi_view_count_ = 0;
     {
-      mm_object_recognition_utils_->adjustAxisBoltPose(object_list.objects[i]);
+      std::lock_guard<std::mutex> lock(segmentation_mutex_);
+      scene_segmentation_ros_->resetCloudAccumulation();
     }
+    event_out.data = "e_multi_view_started";
+    pub_event_out_.publish(event_out);
   }
-}
-
-void MultimodalObjectRecognitionROS::loadObjectInfo(const std::string &filename)
-{
-  if (boost::filesystem::is_regular_file(filename))
+  else if (msg->data == "e_add_view")
   {
-    using boost::property_tree::ptree;
-    mas_perception_msgs::Object object;
-    ptree pt;
-    read_xml(filename, pt);
-
-    BOOST_FOREACH(ptree::value_type const& v, pt.get_child("object_info"))
+    if (!multi_view_active_)
     {
-      if (v.first == "object") 
-      {
-        Object f;
-        f.name = v.second.get<std::string>("name");
-        f.shape = v.second.get<std::string>("shape");
-        f.color = v.second.get<std::string>("color");
-        if (f.shape == object.shape.SPHERE)
-        {
-          round_objects_.insert(f.name);
-        }
-        else if (f.shape == "flat")
-        {
-          flat_objects_.insert(f.name);
-        }
-        object_info_.push_back(f);
-      }
+      ROS_WARN("[multimodal_object_recognition] Multi view mode is not started, ignoring e_add_view");
+      return;
     }
-    ROS_INFO("Object info is loaded!");
+    requestFrame();
   }
-  else
+  else if (msg->data == "e_multi_view_done")
   {
-    ROS_WARN("No object info is provided!");
-    return;
-  }
-
-}
-
-void MultimodalObjectRecognitionROS::eventCallback(const std_msgs::String::ConstPtr &msg)
-{
-  std_msgs::String event_out;
-  if (msg->data == "e_start")
-  {
-    // Synchronize callback
-    image_sub_ = new message_filters::Subscriber<sensor_msgs::Image> (nh_, "input_image_topic", 1);
-    cloud_sub_ = new message_filters::Subscriber<sensor_msgs::PointCloud2> (nh_, "input_cloud_topic", 1);
-    msg_sync_ = new message_filters::Synchronizer<msgSyncPolicy> (msgSyncPolicy(1), *image_sub_, *cloud_sub_);
-    msg_sync_->registerCallback(boost::bind(&MultimodalObjectRecognitionROS::synchronizeCallback, this, _1, _2));
+    if (!multi_view_active_ || multi_view_count_ == 0)
+    {
+      ROS_WARN("[multimodal_object_recognition] No views have been added, ignoring e_multi_view_done");
+      return;
+    }
+    multi_view_active_ = false;
+    finishRecognition();
   }
   else if (msg->data == "e_stop")
   {
+    stopPipeline();
+    frame_requested_ = false;
+    multi_view_active_ = false;
+    multi_view_count_ = 0;
+    std::lock_guard<std::mutex> lock(segmentation_mutex_);
     scene_segmentation_ros_->resetCloudAccumulation();
     event_out.data = "e_stopped";
     pub_event_out_.publish(event_out);
   }
   else if (msg->data == "e_data_collection")
   {
+    dataset_dir_ = artifactPath("dataset_", ros::Time::now(), -1, "");
+    if (!artifact_recorder_->openDataset(dataset_dir_))
+    {
+      ROS_ERROR_STREAM("Cannot create dataset " << dataset_dir_);
+      event_out.data = "e_data_collection_failed";
+      pub_event_out_.publish(event_out);
+      return;
+    }
     data_collection_ = true;
     event_out.data = "e_data_collection_started";
     pub_event_out_.publish(event_out);
-    ROS_INFO_STREAM("\033[1;35mData collection enabled\033[0m");
+    ROS_INFO_STREAM("\033[1;35mData collection enabled, writing to \033[0m" << dataset_dir_);
   }
   else if (msg->data == "e_stop_data_collection")
   {
     data_collection_ = false;
+    // writes the queued frames and the chunk index
+    artifact_recorder_->closeDataset();
+    std::lock_guard<std::mutex> lock(segmentation_mutex_);
     scene_segmentation_ros_->resetCloudAccumulation();
     event_out.data = "e_data_collection_stopped";
     pub_event_out_.publish(event_out);
@@ -932,72 +1078,22 @@ void MultimodalObjectRecognitionROS::eventCallback(const std_msgs::String::Const
   }
 }
 
+void MultimodalObjectRecognitionROS::workstationCallback(const std_msgs::String::ConstPtr &msg)
+{
+  std::lock_guard<std::mutex> lock(segmentation_mutex_);
+  workstation_name_ = msg->data;
+}
+
 void MultimodalObjectRecognitionROS::configCallback(mir_object_recognition::SceneSegmentationConfig &config, uint32_t level)
 {
-  scene_segmentation_ros_->setVoxelGridParams(config.voxel_leaf_size, config.voxel_filter_field_name,
-      config.voxel_filter_limit_min, config.voxel_filter_limit_max);
-  scene_segmentation_ros_->setPassthroughParams(config.enable_passthrough_filter,
-      config.passthrough_filter_field_name,
-      config.passthrough_filter_limit_min,
-      config.passthrough_filter_limit_max);
-  scene_segmentation_ros_->setCropBoxParams(config.enable_cropbox_filter, config.cropbox_filter_min_x, config.cropbox_filter_max_x,
-      config.cropbox_filter_min_y, config.cropbox_filter_max_y, config.cropbox_filter_min_z, config.cropbox_filter_max_z);
-  scene_segmentation_ros_->setNormalParams(config.normal_radius_search, config.use_omp, config.num_cores);
-  Eigen::Vector3f axis(config.sac_x_axis, config.sac_y_axis, config.sac_z_axis);
-  scene_segmentation_ros_->setSACParams(config.sac_max_iterations, config.sac_distance_threshold,
-      config.sac_optimize_coefficients, axis, config.sac_eps_angle,
-      config.sac_normal_distance_weight);
-  scene_segmentation_ros_->setPrismParams(config.prism_min_height, config.prism_max_height);
-  scene_segmentation_ros_->setOutlierParams(config.outlier_radius_search, config.outlier_min_neighbors);
-  scene_segmentation_ros_->setClusterParams(config.cluster_tolerance, config.cluster_min_size, config.cluster_max_size,
-      config.cluster_min_height, config.cluster_max_height, config.cluster_max_length,
-      config.cluster_min_distance_to_polygon);
-  // Object recognizer param
-  enable_rgb_recognizer_ = config.enable_rgb_recognizer;
-  enable_pc_recognizer_ = config.enable_pc_recognizer;
-  obj_category_ = config.obj_category;
-
-  // Cluster param
-  center_cluster_ = config.center_cluster;
-  pad_cluster_ = config.pad_cluster;
-  padded_cluster_size_ = config.padded_cluster_size;
-  // Workspace and object height
-  use_fixed_heights_ = config.use_fixed_heights;
-  object_height_above_workspace_ = config.object_height_above_workspace;
-  height_of_floor_ = config.height_of_floor;
-  container_height_ = config.container_height;
-  // RGB proposal params
-  rgb_roi_adjustment_ = config.rgb_roi_adjustment;
-  rgb_bbox_min_diag_ = config.rgb_bbox_min_diag;
-  rgb_bbox_max_diag_ = config.rgb_bbox_max_diag;
-  rgb_cluster_filter_limit_min_ = config.rgb_cluster_filter_limit_min;
-  rgb_cluster_filter_limit_max_ = config.rgb_cluster_filter_limit_max;
-  rgb_cluster_remove_outliers_ = config.rgb_cluster_remove_outliers;
-  // ROI params
-  enable_roi_ = config.enable_roi;
-  roi_base_link_to_laser_distance_ = config.roi_base_link_to_laser_distance;
-  roi_max_object_pose_x_to_base_link_ = config.roi_max_object_pose_x_to_base_link;
-  roi_min_bbox_z_ = config.roi_min_bbox_z;
-}
-
-int main(int argc, char **argv)
-{
-  ros::init(argc, argv, "multimodal_object_recognition");
-  ros::NodeHandle nh("~");
-  // Initialize frame rate
-  int frame_rate = 30;
-  nh.param<int>("frame_rate", frame_rate, 30);
-  ros::Rate loop_rate(frame_rate);
-  // Create an object of multimodal object recognition
-  MultimodalObjectRecognitionROS mm_object_recognition(nh);
-  ROS_INFO_STREAM("\033[1;32m [multimodal_object_recognition] node started with rate "
-                  << frame_rate << " \033[0m\n");
-  // Run mm object recognition
-  while (ros::ok())
-  {
-    mm_object_recognition.update();
-    ros::spinOnce();
-    loop_rate.sleep();
-  }
-  return 0;
+  // The segmentation stage of the continuous mode may be running concurrently
+  std::lock_guard<std::mutex> lock(segmentation_mutex_);
+  setConfig(config);
+  enable_sensor_frame_crop_ = config.enable_sensor_frame_crop;
+  // Multi view params
+  num_views_ = config.num_views;
+  enable_multi_view_icp_ = config.enable_multi_view_icp;
+  icp_voxel_size_ = config.icp_voxel_size;
+  icp_max_correspondence_distance_ = config.icp_max_correspondence_distance;
+  icp_max_iterations_ = config.icp_max_iterations;
 }
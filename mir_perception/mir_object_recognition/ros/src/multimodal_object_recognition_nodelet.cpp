@@ -0,0 +1,46 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <memory>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+
+#include <mir_object_recognition/multimodal_object_recognition_node.h>
+
+namespace mir_object_recognition
+{
+/** \brief Runs the multimodal object recognition in a nodelet manager. The synchronized
+ * pointcloud and image are then received as shared pointers from a camera driver nodelet in
+ * the same manager instead of being serialized. Parameters and topics are the same as for
+ * the multimodal_object_recognition node.
+ */
+class MultimodalObjectRecognitionNodelet : public nodelet::Nodelet
+{
+  private:
+    void onInit() override
+    {
+      ros::NodeHandle nh = getPrivateNodeHandle();
+      int frame_rate = 30;
+      nh.param<int>("frame_rate", frame_rate, 30);
+      mm_object_recognition_.reset(new MultimodalObjectRecognitionROS(nh));
+      // Same callback queue as the subscribers, so update() never runs concurrently with them
+      update_timer_ = nh.createWallTimer(ros::WallDuration(1.0 / frame_rate),
+                                         &MultimodalObjectRecognitionNodelet::updateCallback, this);
+      NODELET_INFO_STREAM("[multimodal_object_recognition] nodelet started with rate " << frame_rate);
+    }
+
+    void updateCallback(const ros::WallTimerEvent &event)
+    {
+      mm_object_recognition_->update();
+    }
+
+    std::unique_ptr<MultimodalObjectRecognitionROS> mm_object_recognition_;
+    ros::WallTimer update_timer_;
+};
+
+}  // namespace mir_object_recognition
+
+PLUGINLIB_EXPORT_CLASS(mir_object_recognition::MultimodalObjectRecognitionNodelet, nodelet::Nodelet)
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <chrono>
+
+#include <mir_object_recognition/recognizer_client.h>
+
+RecognizerClient::RecognizerClient(ros::NodeHandle nh, const std::string &response_topic,
+                                   const std::string &name, const std::function<void()> &on_response)
+  : name_(name),
+    on_response_(on_response),
+    spinner_(1, &callback_queue_)
+{
+  ros::SubscribeOptions options = ros::SubscribeOptions::create<mas_perception_msgs::ObjectList>(
+      response_topic, 5, boost::bind(&RecognizerClient::responseCallback, this, _1),
+      ros::VoidPtr(), &callback_queue_);
+  sub_response_ = nh.subscribe(options);
+  spinner_.start();
+}
+
+RecognizerClient::~RecognizerClient()
+{
+  spinner_.stop();
+  sub_response_.shutdown();
+}
+
+RecognizerClient::ResponseFuture RecognizerClient::addRequest(uint32_t request_id)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::promise<Response> &promise = pending_requests_[request_id];
+  return promise.get_future().share();
+}
+
+void RecognizerClient::cancelRequest(uint32_t request_id)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_requests_.erase(request_id);
+}
+
+bool RecognizerClient::isReady(const ResponseFuture &future)
+{
+  return future.valid() &&
+         future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void RecognizerClient::responseCallback(const mas_perception_msgs::ObjectList::ConstPtr &msg)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_requests_.empty())
+    {
+      ROS_WARN("[%s] Dropping response, no request pending", name_.c_str());
+      return;
+    }
+
+    uint32_t request_id = 0;
+    if (!msg->objects.empty())
+    {
+      request_id = msg->objects[0].pose.header.seq;
+    }
+
+    auto request = pending_requests_.begin();
+    if (request_id != 0)
+    {
+      request = pending_requests_.find(request_id);
+      if (request == pending_requests_.end())
+      {
+        ROS_WARN("[%s] Dropping response for unknown request %u", name_.c_str(), request_id);
+        return;
+      }
+    }
+
+    ROS_INFO("[%s] Received %d objects for request %u", name_.c_str(),
+             static_cast<int>(msg->objects.size()), request->first);
+    request->second.set_value(*msg);
+    pending_requests_.erase(request);
+  }
+
+  if (on_response_)
+  {
+    on_response_();
+  }
+}
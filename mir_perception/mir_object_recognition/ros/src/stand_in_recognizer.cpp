@@ -0,0 +1,39 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <mir_object_recognition/stand_in_recognizer.h>
+
+void RecordedRecognizer::addResponse(const std::string &frame_name,
+                                     const mas_perception_msgs::ObjectList &response)
+{
+  responses_[frame_name] = response;
+}
+
+bool RecordedRecognizer::recognize(const std::string &frame_name, const RecognitionFrame &frame,
+                                   mas_perception_msgs::ObjectList &response)
+{
+  auto it = responses_.find(frame_name);
+  if (it == responses_.end())
+  {
+    return false;
+  }
+  response = it->second;
+  return true;
+}
+
+EchoRecognizer::EchoRecognizer(const std::string &label) : label_(label)
+{
+}
+
+bool EchoRecognizer::recognize(const std::string &frame_name, const RecognitionFrame &frame,
+                               mas_perception_msgs::ObjectList &response)
+{
+  response = frame.cloud_object_list;
+  for (auto &object : response.objects)
+  {
+    object.name = label_;
+    object.probability = 1.0;
+  }
+  return true;
+}
@@ -0,0 +1,581 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ * Replays recorded pointcloud and image pairs through the segmentation and the
+ * fusion of the multimodal object recognition as fast as possible, without a
+ * ROS master or recognizer nodes. The recognizers are replaced by stand-ins
+ * that respond with recorded object lists. Reports throughput, per frame
+ * latency, stage latencies and the differences to golden results.
+ *
+ * Usage: multimodal_object_recognition_replay <data_dir> [--config=<yaml>]
+ *          [--object_info=<xml>] [--golden_dir=<directory>] [--write_golden]
+ *          [--repeat=<n>] [--position_tolerance=<m>]
+ *          [--pc_recognizer=recorded|echo|none] [--rgb_recognizer=recorded|none]
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <cv_bridge/cv_bridge.h>
+#include <dynamic_reconfigure/Config.h>
+#include <opencv2/highgui/highgui.hpp>
+#include <pcl/common/transforms.h>
+#include <pcl/io/pcd_io.h>
+#include <ros/time.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include <mir_object_recognition/multimodal_object_recognition.h>
+#include <mir_object_recognition/stand_in_recognizer.h>
+#include <mir_perception_utils/latency_profiler.h>
+
+namespace fs = boost::filesystem;
+namespace mpu = mir_perception_utils;
+
+namespace
+{
+// same stage names as the node, so that the latencies can be compared
+const mpu::LatencyStage TRANSFORM_STAGE("multimodal_object_recognition/transform");
+const mpu::LatencyStage RECOGNITION_STAGE("multimodal_object_recognition/recognition");
+const mpu::LatencyStage TOTAL_STAGE("multimodal_object_recognition/total");
+
+const std::string GOLDEN_TOPIC = "object_list";
+
+struct ReplayOptions
+{
+  std::string data_dir;
+  std::string golden_dir;
+  std::string config_file;
+  std::string object_info;
+  std::string pc_recognizer = "recorded";
+  std::string rgb_recognizer = "recorded";
+  int repeat = 1;
+  bool write_golden = false;
+  double position_tolerance = 0.005;
+};
+
+/** \brief Recorded pointcloud in the sensor frame and its image */
+struct ReplayFrame
+{
+  std::string name;
+  PointCloud::Ptr cloud;
+  sensor_msgs::ImagePtr image;
+};
+
+bool parseOptions(int argc, char **argv, ReplayOptions &options)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string arg = argv[i];
+    const size_t equal = arg.find('=');
+    const std::string key = arg.substr(0, equal);
+    const std::string value = equal == std::string::npos ? "" : arg.substr(equal + 1);
+    if (arg.compare(0, 2, "--") != 0)
+      options.data_dir = arg;
+    else if (key == "--config")
+      options.config_file = value;
+    else if (key == "--object_info")
+      options.object_info = value;
+    else if (key == "--golden_dir")
+      options.golden_dir = value;
+    else if (key == "--write_golden")
+      options.write_golden = true;
+    else if (key == "--repeat")
+      options.repeat = std::max(1, std::atoi(value.c_str()));
+    else if (key == "--position_tolerance")
+      options.position_tolerance = std::atof(value.c_str());
+    else if (key == "--pc_recognizer")
+      options.pc_recognizer = value;
+    else if (key == "--rgb_recognizer")
+      options.rgb_recognizer = value;
+    else
+    {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return false;
+    }
+  }
+  if (options.data_dir.empty())
+  {
+    std::cerr << "Usage: multimodal_object_recognition_replay <data_dir> [--config=<yaml>] "
+                 "[--object_info=<xml>] [--golden_dir=<directory>] [--write_golden] [--repeat=<n>] "
+                 "[--position_tolerance=<m>] [--pc_recognizer=recorded|echo|none] "
+                 "[--rgb_recognizer=recorded|none]" << std::endl;
+    return false;
+  }
+  if (options.golden_dir.empty())
+    options.golden_dir = (fs::path(options.data_dir) / "golden").string();
+  return true;
+}
+
+std::string trim(const std::string &text)
+{
+  const size_t begin = text.find_first_not_of(" \t\r'\"");
+  if (begin == std::string::npos)
+    return "";
+  const size_t end = text.find_last_not_of(" \t\r'\"");
+  return text.substr(begin, end - begin + 1);
+}
+
+/** \brief Apply the parameters of a flat yaml file such as scene_segmentation_constraints.yaml
+ * on top of the defaults of SceneSegmentation.cfg
+ */
+bool loadConfig(const std::string &filename, mir_object_recognition::SceneSegmentationConfig &config)
+{
+  std::ifstream file(filename.c_str());
+  if (!file)
+  {
+    std::cerr << "Could not read " << filename << std::endl;
+    return false;
+  }
+  std::map<std::string, std::string> values;
+  std::string line;
+  while (std::getline(file, line))
+  {
+    line = line.substr(0, line.find('#'));
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos)
+      continue;
+    values[trim(line.substr(0, colon))] = trim(line.substr(colon + 1));
+  }
+
+  dynamic_reconfigure::Config msg;
+  for (const auto &param : config.__getParamDescriptions__())
+  {
+    auto it = values.find(param->name);
+    if (it == values.end() || it->second.empty())
+      continue;
+    const std::string &value = it->second;
+    if (param->type == "bool")
+    {
+      dynamic_reconfigure::BoolParameter bool_param;
+      bool_param.name = param->name;
+      bool_param.value = value == "true" || value == "True" || value == "1";
+      msg.bools.push_back(bool_param);
+    }
+    else if (param->type == "int")
+    {
+      dynamic_reconfigure::IntParameter int_param;
+      int_param.name = param->name;
+      int_param.value = std::atoi(value.c_str());
+      msg.ints.push_back(int_param);
+    }
+    else if (param->type == "double")
+    {
+      dynamic_reconfigure::DoubleParameter double_param;
+      double_param.name = param->name;
+      double_param.value = std::atof(value.c_str());
+      msg.doubles.push_back(double_param);
+    }
+    else
+    {
+      dynamic_reconfigure::StrParameter str_param;
+      str_param.name = param->name;
+      str_param.value = value;
+      msg.strs.push_back(str_param);
+    }
+  }
+  if (!config.__fromMessage__(msg))
+  {
+    std::cerr << "Could not apply " << filename << std::endl;
+    return false;
+  }
+  config.__clamp__();
+  return true;
+}
+
+/** \brief Read "target_frame source_frame x y z qx qy qz qw" */
+bool loadStaticTransform(const fs::path &file, std::string &target_frame, Eigen::Affine3f &transform)
+{
+  std::ifstream stream(file.string().c_str());
+  std::string source_frame;
+  float x, y, z, qx, qy, qz, qw;
+  if (!(stream >> target_frame >> source_frame >> x >> y >> z >> qx >> qy >> qz >> qw))
+  {
+    std::cerr << "Could not read the static transform " << file.string() << std::endl;
+    return false;
+  }
+  transform = Eigen::Translation3f(x, y, z) * Eigen::Quaternionf(qw, qx, qy, qz).normalized();
+  return true;
+}
+
+bool endsWith(const std::string &text, const std::string &suffix)
+{
+  return text.size() >= suffix.size() &&
+         text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/** \brief Read the recognizer responses recorded from the recognizer output topics */
+bool loadResponses(const fs::path &file, const std::string &frame_name,
+                   RecordedRecognizer &pc_recognizer, RecordedRecognizer &rgb_recognizer)
+{
+  try
+  {
+    rosbag::Bag bag(file.string(), rosbag::bagmode::Read);
+    rosbag::View view(bag);
+    for (const rosbag::MessageInstance &message : view)
+    {
+      mas_perception_msgs::ObjectList::ConstPtr object_list =
+          message.instantiate<mas_perception_msgs::ObjectList>();
+      if (!object_list)
+        continue;
+      if (endsWith(message.getTopic(), "pc/output/object_list"))
+        pc_recognizer.addResponse(frame_name, *object_list);
+      else if (endsWith(message.getTopic(), "rgb/output/object_list"))
+        rgb_recognizer.addResponse(frame_name, *object_list);
+    }
+  }
+  catch (const rosbag::BagException &e)
+  {
+    std::cerr << "Could not read " << file.string() << ": " << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool loadFrames(const fs::path &directory, std::vector<ReplayFrame> &frames,
+                RecordedRecognizer &pc_recognizer, RecordedRecognizer &rgb_recognizer)
+{
+  std::vector<fs::path> clouds;
+  for (fs::directory_iterator it(directory); it != fs::directory_iterator(); ++it)
+  {
+    if (fs::is_regular_file(it->status()) && it->path().extension() == ".pcd")
+      clouds.push_back(it->path());
+  }
+  std::sort(clouds.begin(), clouds.end());
+
+  for (const fs::path &cloud_file : clouds)
+  {
+    ReplayFrame frame;
+    frame.name = cloud_file.stem().string();
+    frame.cloud.reset(new PointCloud);
+    if (pcl::io::loadPCDFile<PointT>(cloud_file.string(), *frame.cloud) == -1)
+    {
+      std::cerr << "Could not read " << cloud_file.string() << std::endl;
+      return false;
+    }
+
+    cv::Mat image;
+    for (const std::string extension : {".png", ".jpg"})
+    {
+      fs::path image_file = cloud_file;
+      image_file.replace_extension(extension);
+      if (fs::is_regular_file(image_file))
+      {
+        image = cv::imread(image_file.string(), cv::IMREAD_COLOR);
+        break;
+      }
+    }
+    if (image.empty())
+    {
+      std::cerr << "No image for " << cloud_file.string() << std::endl;
+      return false;
+    }
+    frame.image = cv_bridge::CvImage(std_msgs::Header(), "bgr8", image).toImageMsg();
+
+    fs::path responses_file = cloud_file;
+    responses_file.replace_extension(".bag");
+    if (fs::is_regular_file(responses_file) &&
+        !loadResponses(responses_file, frame.name, pc_recognizer, rgb_recognizer))
+      return false;
+    frames.push_back(frame);
+  }
+  return true;
+}
+
+bool readObjectList(const fs::path &file, mas_perception_msgs::ObjectList &object_list)
+{
+  try
+  {
+    rosbag::Bag bag(file.string(), rosbag::bagmode::Read);
+    rosbag::View view(bag, rosbag::TopicQuery(GOLDEN_TOPIC));
+    for (const rosbag::MessageInstance &message : view)
+    {
+      mas_perception_msgs::ObjectList::ConstPtr recorded =
+          message.instantiate<mas_perception_msgs::ObjectList>();
+      if (recorded)
+      {
+        object_list = *recorded;
+        return true;
+      }
+    }
+  }
+  catch (const rosbag::BagException &e)
+  {
+    std::cerr << "Could not read " << file.string() << ": " << e.what() << std::endl;
+  }
+  return false;
+}
+
+bool writeObjectList(const fs::path &file, const mas_perception_msgs::ObjectList &object_list)
+{
+  try
+  {
+    rosbag::Bag bag(file.string(), rosbag::bagmode::Write);
+    bag.write(GOLDEN_TOPIC, ros::TIME_MIN, object_list);
+  }
+  catch (const rosbag::BagException &e)
+  {
+    std::cerr << "Could not write " << file.string() << ": " << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+std::string formatObject(const mas_perception_msgs::Object &object)
+{
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(3) << object.name << " at ("
+         << object.pose.pose.position.x << ", " << object.pose.pose.position.y << ", "
+         << object.pose.pose.position.z << ")";
+  return stream.str();
+}
+
+/** \brief Differences to the golden objects, the objects are matched by name and nearest position */
+std::vector<std::string> diffObjectLists(const mas_perception_msgs::ObjectList &result,
+                                         const mas_perception_msgs::ObjectList &golden,
+                                         double position_tolerance)
+{
+  std::vector<std::string> differences;
+  std::vector<bool> matched(golden.objects.size(), false);
+  for (const auto &object : result.objects)
+  {
+    int best = -1;
+    double best_distance = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < golden.objects.size(); i++)
+    {
+      if (matched[i] || golden.objects[i].name != object.name)
+        continue;
+      const auto &a = object.pose.pose.position;
+      const auto &b = golden.objects[i].pose.pose.position;
+      const double distance =
+          std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+      if (distance < best_distance)
+      {
+        best = i;
+        best_distance = distance;
+      }
+    }
+    if (best < 0)
+    {
+      differences.push_back("+ " + formatObject(object));
+      continue;
+    }
+    matched[best] = true;
+    if (best_distance > position_tolerance)
+    {
+      std::ostringstream stream;
+      stream << "~ " << formatObject(object) << " moved by " << std::fixed << std::setprecision(4)
+             << best_distance << " m";
+      differences.push_back(stream.str());
+    }
+  }
+  for (size_t i = 0; i < golden.objects.size(); i++)
+  {
+    if (!matched[i])
+      differences.push_back("- " + formatObject(golden.objects[i]));
+  }
+  return differences;
+}
+
+/** \brief Run a frame through transform, segmentation, recognition and fusion like the
+ * single shot mode of the node
+ * \return false if the frame was dropped
+ */
+bool processFrame(MultimodalObjectRecognition &recognition, const ReplayFrame &replay_frame,
+                  uint32_t id, const Eigen::Affine3f &transform, StandInRecognizer *pc_recognizer,
+                  StandInRecognizer *rgb_recognizer, mas_perception_msgs::ObjectList &object_list)
+{
+  mpu::ScopedLatencyTimer timer(TOTAL_STAGE);
+  object_list.objects.clear();
+
+  RecognitionFrame frame;
+  frame.id = id;
+  frame.image = replay_frame.image;
+  {
+    mpu::ScopedLatencyTimer transform_timer(TRANSFORM_STAGE);
+    frame.cloud.reset(new PointCloud);
+    pcl::transformPointCloud(*replay_frame.cloud, *frame.cloud, transform);
+    frame.cloud->header.frame_id = recognition.getTargetFrameId();
+  }
+
+  MultimodalObjectRecognition::SceneSegmentationROSSPtr scene_segmentation =
+      recognition.getSceneSegmentation();
+  scene_segmentation->resetCloudAccumulation();
+  scene_segmentation->addCloudAccumulation(frame.cloud);
+  recognition.segmentFrame(frame, frame.cloud);
+  scene_segmentation->resetPclObjectId();
+
+  {
+    mpu::ScopedLatencyTimer recognition_timer(RECOGNITION_STAGE);
+    if (pc_recognizer && recognition.isPCRecognizerEnabled() &&
+        !frame.cloud_object_list.objects.empty())
+    {
+      pc_recognizer->recognize(replay_frame.name, frame, frame.recognized_cloud_list);
+    }
+    if (rgb_recognizer && recognition.isRGBRecognizerEnabled() &&
+        rgb_recognizer->recognize(replay_frame.name, frame, frame.recognized_image_list) &&
+        !recognition.processRecognizedImageList(frame))
+    {
+      return false;
+    }
+  }
+
+  if (recognition.fuseObjects(frame))
+  {
+    recognition.prepareObjectList(frame.combined_object_list);
+    object_list = frame.combined_object_list;
+  }
+  return true;
+}
+
+double percentile(std::vector<int64_t> values, double p)
+{
+  if (values.empty())
+    return 0.0;
+  const size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+  const size_t index = std::min(values.size() - 1, rank > 0 ? rank - 1 : 0);
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index] * 1e-6;
+}
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  ReplayOptions options;
+  if (!parseOptions(argc, argv, options))
+    return 1;
+
+  // ros::Time::now() is used by the fusion, no node or master is needed
+  ros::Time::init();
+
+  const fs::path data_dir(options.data_dir);
+  std::string target_frame;
+  Eigen::Affine3f transform;
+  if (!loadStaticTransform(data_dir / "static_tf.txt", target_frame, transform))
+    return 1;
+
+  mir_object_recognition::SceneSegmentationConfig config =
+      mir_object_recognition::SceneSegmentationConfig::__getDefault__();
+  if (!options.config_file.empty() && !loadConfig(options.config_file, config))
+    return 1;
+
+  RecordedRecognizer recorded_pc_recognizer;
+  RecordedRecognizer recorded_rgb_recognizer;
+  std::vector<ReplayFrame> frames;
+  if (!loadFrames(data_dir, frames, recorded_pc_recognizer, recorded_rgb_recognizer))
+    return 1;
+  if (frames.empty())
+  {
+    std::cerr << "No frames in " << options.data_dir << std::endl;
+    return 1;
+  }
+
+  EchoRecognizer echo_recognizer;
+  StandInRecognizer *pc_recognizer = nullptr;
+  if (options.pc_recognizer == "recorded")
+    pc_recognizer = &recorded_pc_recognizer;
+  else if (options.pc_recognizer == "echo")
+    pc_recognizer = &echo_recognizer;
+  StandInRecognizer *rgb_recognizer = nullptr;
+  if (options.rgb_recognizer == "recorded")
+    rgb_recognizer = &recorded_rgb_recognizer;
+
+  MultimodalObjectRecognition recognition;
+  recognition.setConfig(config);
+  recognition.setTargetFrameId(target_frame);
+  if (!options.object_info.empty())
+    recognition.loadObjectInfo(options.object_info);
+
+  std::cout << "Replaying " << frames.size() << " frames " << options.repeat << " times, "
+            << recorded_pc_recognizer.size() << " cloud and " << recorded_rgb_recognizer.size()
+            << " rgb recognizer responses" << std::endl;
+
+  mpu::LatencyProfiler &profiler = mpu::LatencyProfiler::instance();
+  profiler.setWindowSize(frames.size() * options.repeat);
+
+  std::vector<mpu::LatencyStatistics> statistics;
+  std::vector<int64_t> latencies;
+  std::vector<mas_perception_msgs::ObjectList> results(frames.size());
+  size_t dropped = 0;
+  uint32_t id = 0;
+  const int64_t start_ns = mpu::LatencyProfiler::now();
+  for (int repeat = 0; repeat < options.repeat; repeat++)
+  {
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+      const int64_t frame_start_ns = mpu::LatencyProfiler::now();
+      if (!processFrame(recognition, frames[i], ++id, transform, pc_recognizer, rgb_recognizer,
+                        results[i]))
+        dropped++;
+      latencies.push_back(mpu::LatencyProfiler::now() - frame_start_ns);
+      // drain the stage samples before the per thread buffers wrap around
+      if (id % 100 == 0)
+        profiler.getStatistics(statistics);
+    }
+  }
+  const double duration = (mpu::LatencyProfiler::now() - start_ns) * 1e-9;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Processed " << latencies.size() << " frames in " << duration << " s, "
+            << latencies.size() / duration << " frames/s, dropped " << dropped << std::endl;
+  std::cout << "Frame latency [ms] p50 " << percentile(latencies, 0.5) << " p95 "
+            << percentile(latencies, 0.95) << " p99 " << percentile(latencies, 0.99) << " max "
+            << percentile(latencies, 1.0) << std::endl;
+
+  profiler.getStatistics(statistics);
+  std::cout << "Stage latency [ms]" << std::endl;
+  for (const auto &stage : statistics)
+  {
+    std::cout << "  " << std::left << std::setw(52) << stage.stage << std::right << " p50 "
+              << std::setw(9) << stage.p50_ms << " p95 " << std::setw(9) << stage.p95_ms
+              << " p99 " << std::setw(9) << stage.p99_ms << " max " << std::setw(9)
+              << stage.max_ms << std::endl;
+  }
+
+  const fs::path golden_dir(options.golden_dir);
+  if (options.write_golden)
+  {
+    fs::create_directories(golden_dir);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+      if (!writeObjectList(golden_dir / (frames[i].name + ".bag"), results[i]))
+        return 1;
+    }
+    std::cout << "Wrote golden results to " << golden_dir.string() << std::endl;
+    return 0;
+  }
+
+  size_t num_differences = 0;
+  size_t num_missing = 0;
+  for (size_t i = 0; i < frames.size(); i++)
+  {
+    mas_perception_msgs::ObjectList golden;
+    if (!readObjectList(golden_dir / (frames[i].name + ".bag"), golden))
+    {
+      num_missing++;
+      continue;
+    }
+    for (const std::string &difference :
+         diffObjectLists(results[i], golden, options.position_tolerance))
+    {
+      std::cout << frames[i].name << ": " << difference << std::endl;
+      num_differences++;
+    }
+  }
+  std::cout << num_differences << " differences to the golden results";
+  if (num_missing > 0)
+    std::cout << ", " << num_missing << " frames without golden results";
+  std::cout << std::endl;
+  return num_differences > 0 || num_missing > 0 ? 1 : 0;
+}
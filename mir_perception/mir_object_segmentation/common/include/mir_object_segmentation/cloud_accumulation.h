@@ -9,23 +9,23 @@
 #define MIR_OBJECT_SEGMENTATION_CLOUD_ACCUMULATION_H
 
 #include <mir_perception_utils/aliases.h>
-#include <mir_perception_utils/octree_pointcloud_occupancy_colored.h>
-#include <pcl/octree/octree_pointcloud_occupancy.h>
+#include <mir_perception_utils/voxel_hash_accumulator.h>
 #include <memory>
 
-/** This class accumulates input point clouds in the occupancy octree with a
-  * given spatial resolution. */
+/** This class accumulates input point clouds in a voxel hash with a given
+  * spatial resolution. Each occupied voxel keeps the mean color of the points
+  * that fell into it. */
 class CloudAccumulation
 {
  public:
   typedef std::unique_ptr<CloudAccumulation> UPtr;
 
   /** \brief Constructor
-   * \param[in] Octree resolution
+   * \param[in] Voxel resolution
    * */
   explicit CloudAccumulation(double resolution = 0.0025);
 
-  /** \brief Add point cloud to octree
+  /** \brief Add point cloud to the voxel hash
    * \param[in] Point cloud
    * */
   void addCloud(const PointCloud::ConstPtr &cloud);
@@ -35,14 +35,13 @@ class CloudAccumulation
   void getAccumulatedCloud(PointCloud &cloud);
   /** \brief Return cloud count */
   int getCloudCount() const { return cloud_count_; }
-  /** \brief Reset octree and cloud count */
+  /** \brief Reset voxels and cloud count */
   void reset();
 
  private:
-  typedef OctreePointCloudOccupancyColored<PointT> Octree;
-  typedef std::unique_ptr<Octree> OctreeUPtr;
+  typedef mir_perception_utils::pointcloud::VoxelHashAccumulator<PointT> VoxelHash;
 
-  OctreeUPtr octree_;
+  VoxelHash voxels_;
 
   int cloud_count_;
   double resolution_;
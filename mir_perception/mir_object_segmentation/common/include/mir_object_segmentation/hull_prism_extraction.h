@@ -0,0 +1,77 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_OBJECT_SEGMENTATION_HULL_PRISM_EXTRACTION_H
+#define MIR_OBJECT_SEGMENTATION_HULL_PRISM_EXTRACTION_H
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <pcl/PointIndices.h>
+
+#include <mir_perception_utils/aliases.h>
+
+/** \brief Rasterized alternative to pcl::ExtractPolygonalPrismData.
+ *
+ * The plane is fitted to the hull and oriented towards the view point like
+ * ExtractPolygonalPrismData does. The hull is projected into a 2D basis of the
+ * plane and rasterized once into a mask with cells of the given resolution,
+ * a cell is inside if its center is inside the polygon. Each point then costs
+ * one plane distance, two coordinates in the plane and one mask lookup instead
+ * of a point in polygon test against every hull edge. The result differs from
+ * ExtractPolygonalPrismData only for points closer than a cell diagonal to the
+ * hull border, the indices are in ascending order like the ones of PCL.
+ */
+class HullPrismExtraction
+{
+ public:
+  /** \brief Constructor */
+  HullPrismExtraction();
+
+  /** \brief Set the minimum and maximum signed distance to the plane of the points kept */
+  void setHeightLimits(double min_height, double max_height)
+  {
+    min_height_ = min_height;
+    max_height_ = max_height;
+  }
+  /** \brief Set the view point, the positive side of the plane faces it */
+  void setViewPoint(float x, float y, float z) { view_point_ = Eigen::Vector3f(x, y, z); }
+  /** \brief Set the size of the mask cells, e.g. the voxel leaf size */
+  void setResolution(double resolution) { resolution_ = resolution; }
+  /** \brief Set the number of threads classifying the points, requires OpenMP */
+  void setNumberOfThreads(int num_threads) { num_threads_ = num_threads; }
+
+  /** \brief Find the points of the cloud inside the prism of the hull
+   * \param[in] Point cloud
+   * \param[in] Planar convex hull, e.g. from pcl::ConvexHull
+   * \param[out] Indices of the points inside the prism
+   * \return false if the hull has less than three points
+   * */
+  bool segment(const PointCloud &cloud, const PointCloud &hull, pcl::PointIndices &inliers);
+
+ private:
+  /** \brief Compute the plane and its basis and rasterize the hull into the mask */
+  bool rasterizeHull(const PointCloud &hull);
+
+  double min_height_;
+  double max_height_;
+  Eigen::Vector3f view_point_;
+  double resolution_;
+  int num_threads_;
+
+  // rows of the transform into the plane: normal, u, v, the last column the offsets
+  Eigen::Matrix<float, 3, 4> plane_transform_;
+  int mask_cols_;
+  int mask_rows_;
+  // buffers are kept between calls to avoid reallocation
+  std::vector<uint8_t> mask_;
+  std::vector<uint8_t> point_flags_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+#endif  // MIR_OBJECT_SEGMENTATION_HULL_PRISM_EXTRACTION_H
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_OBJECT_SEGMENTATION_PLANE_MODEL_CACHE_H
+#define MIR_OBJECT_SEGMENTATION_PLANE_MODEL_CACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <mir_perception_utils/aliases.h>
+
+/** \brief Counters of the PlaneModelCache */
+struct PlaneModelCacheStatistics
+{
+  PlaneModelCacheStatistics() : hits(0), misses(0), rejected(0), entries(0) {}
+  // cached planes that still fit the cloud, the plane estimation was skipped
+  uint64_t hits;
+  // lookups without a cached plane for the workstation and base pose
+  uint64_t misses;
+  // cached planes that did not fit the cloud anymore
+  uint64_t rejected;
+  // planes in the cache
+  uint64_t entries;
+};
+
+/** \brief Support planes of the workstations the robot has already perceived.
+ *
+ * A plane is stored in a fixed frame (e.g. map) together with the pose of the base
+ * and the name of the workstation it was perceived at, both are optional. A lookup
+ * returns the plane of the entry with the same name whose base pose is closest to the
+ * current one within the tolerances, transformed into the current base frame.
+ * The caller validates the plane with computeInlierRatio and reports the result.
+ * The least recently used entry is replaced when the cache is full.
+ * All methods are thread safe.
+ */
+class PlaneModelCache
+{
+ public:
+  /** \brief Constructor
+   * \param[in] Maximum number of planes
+   * */
+  explicit PlaneModelCache(size_t max_entries = 32);
+
+  /** \brief Set the maximum difference between the stored and the current base pose
+   * \param[in] Maximum translation in meters
+   * \param[in] Maximum rotation in radians
+   * */
+  void setPoseTolerance(double max_translation, double max_rotation);
+
+  /** \brief Find the plane of a workstation
+   * \param[in] Workstation name, may be empty
+   * \param[in] Pose of the base in the fixed frame
+   * \param[out] Plane coefficients in the base frame
+   * \param[out] Fraction of the points that were inliers when the plane was stored
+   * \return false if there is no plane for the name within the pose tolerance, counted as miss
+   * */
+  bool lookup(const std::string &key, const Eigen::Affine3f &base_pose, Eigen::Vector4f &plane,
+              float &inlier_ratio);
+
+  /** \brief Store the plane of a workstation, replaces the entry found by lookup
+   * \param[in] Workstation name, may be empty
+   * \param[in] Pose of the base in the fixed frame
+   * \param[in] Plane coefficients in the base frame
+   * \param[in] Fraction of the points that are inliers
+   * */
+  void insert(const std::string &key, const Eigen::Affine3f &base_pose,
+              const Eigen::Vector4f &plane, float inlier_ratio);
+
+  /** \brief Count the result of the validation of a plane returned by lookup */
+  void reportValidation(bool valid);
+
+  /** \brief Remove all planes, the statistics are kept */
+  void clear();
+
+  PlaneModelCacheStatistics getStatistics() const;
+
+  /** \brief Fraction of the points closer to the plane than the threshold, evaluated on
+   * evenly strided samples of the cloud
+   * \param[in] Point cloud
+   * \param[in] Plane coefficients
+   * \param[in] Distance threshold
+   * \param[in] Approximate number of samples, all points if <= 0
+   * */
+  static float computeInlierRatio(const PointCloud &cloud, const Eigen::Vector4f &plane,
+                                  double distance_threshold, int max_samples);
+
+ private:
+  struct Entry
+  {
+    std::string key;
+    Eigen::Affine3f base_pose;
+    // plane in the fixed frame
+    Eigen::Vector4f plane;
+    float inlier_ratio;
+    uint64_t last_used;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  /** \brief Index of the closest entry within the tolerance, -1 if there is none */
+  int find(const std::string &key, const Eigen::Affine3f &base_pose) const;
+
+  size_t max_entries_;
+  double max_translation_;
+  double max_rotation_;
+
+  mutable std::mutex mutex_;
+  std::vector<Entry, Eigen::aligned_allocator<Entry>> entries_;
+  uint64_t clock_;
+  PlaneModelCacheStatistics statistics_;
+};
+
+#endif  // MIR_OBJECT_SEGMENTATION_PLANE_MODEL_CACHE_H
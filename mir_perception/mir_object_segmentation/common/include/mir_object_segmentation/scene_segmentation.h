@@ -8,6 +8,7 @@
 #define MIR_OBJECT_SEGMENTATION_SCENE_SEGMENTATION_H
 
 #include <pcl/ModelCoefficients.h>
+#include <pcl/features/integral_image_normal.h>
 #include <pcl/features/normal_3d.h>
 #include <pcl/features/normal_3d_omp.h>
 #include <pcl/filters/passthrough.h>
@@ -21,9 +22,13 @@
 #include <pcl/sample_consensus/model_types.h>
 #include <pcl/segmentation/extract_clusters.h>
 #include <pcl/segmentation/extract_polygonal_prism_data.h>
+#include <pcl/segmentation/organized_multi_plane_segmentation.h>
 #include <pcl/segmentation/sac_segmentation.h>
 #include <pcl/surface/convex_hull.h>
 
+#include <mir_object_segmentation/plane_model_cache.h>
+#include <mir_object_segmentation/hull_prism_extraction.h>
+#include <mir_object_segmentation/voxel_cluster_extraction.h>
 #include <mir_perception_utils/aliases.h>
 #include <mir_perception_utils/bounding_box.h>
 
@@ -39,12 +44,19 @@ class SceneSegmentation
   pcl::NormalEstimationOMP<PointT, PointNT> normal_estimation_omp_;
 
   pcl::SACSegmentationFromNormals<PointT, PointNT> sac_;
+  pcl::VoxelGrid<PointT> coarse_voxel_grid_;
+  pcl::SACSegmentation<PointT> coarse_sac_;
+  pcl::IntegralImageNormalEstimation<PointT, PointNT> integral_image_normal_estimation_;
+  pcl::OrganizedMultiPlaneSegmentation<PointT, PointNT, pcl::Label> organized_plane_segmentation_;
   pcl::ProjectInliers<PointT> project_inliers_;
   pcl::ConvexHull<PointT> convex_hull_;
   pcl::ExtractPolygonalPrismData<PointT> extract_polygonal_prism_;
+  HullPrismExtraction hull_prism_extraction_;
 
   pcl::EuclideanClusterExtraction<PointT> cluster_extraction_;
+  VoxelClusterExtraction voxel_cluster_extraction_;
   pcl::RadiusOutlierRemoval<PointT> radius_outlier_;
+  PlaneModelCache plane_cache_;
 
  public:
   /** \brief Constructor */
@@ -58,12 +70,17 @@ class SceneSegmentation
    * \param[out] A list of bounding boxes
    * \param[out] Model coefficients
    * \param[out] Workspace height
+   * \param[in] Optional organized point cloud used to find the plane instead of the input point
+   * cloud if the organized plane detection is enabled, e.g. the camera cloud the input was
+   * accumulated from. It is ignored otherwise.
    * */
   PointCloud::Ptr segmentScene(const PointCloud::ConstPtr &cloud,
                                std::vector<PointCloud::Ptr> &clusters,
                                std::vector<BoundingBox> &boxes,
-                               pcl::ModelCoefficients::Ptr &coefficients, double &workspace_height);
-  /** \brief Find plane
+                               pcl::ModelCoefficients::Ptr &coefficients, double &workspace_height,
+                               const PointCloud::ConstPtr &plane_cloud = PointCloud::ConstPtr());
+  /** \brief Find plane. Organized point clouds are segmented directly on the image grid
+   * if the organized plane detection is enabled.
    * \param[in] Point cloud
    * \param[out] Convex hull
    * \param[out] Model coefficients
@@ -101,6 +118,13 @@ class SceneSegmentation
    * */
   void setCropBoxParams(bool enable_cropbox_filter, double min_x, double max_x, double min_y,
                         double max_y, double min_z, double max_z);                          
+  /** \brief Get the box kept by the voxel filter limits, the passthrough and the crop box
+   * filter, e.g. to crop the input before it is transformed. Axes without limits are unbounded.
+   * \param[out] Box min
+   * \param[out] Box max
+   * \return false if none of the filters limits the workspace
+   * */
+  bool getWorkspaceBounds(Eigen::Vector3f &min, Eigen::Vector3f &max) const;
   /** \brief Set Normal param using radius
    * \param[in] Radius search
    * \param[in] Use Open MP (OMP) for parallel normal estimation using cpu
@@ -120,6 +144,50 @@ class SceneSegmentation
    * */
   void setSACParams(int max_iterations, double distance_threshold, bool optimize_coefficients,
                     Eigen::Vector3f axis, double eps_angle, double normal_distance_weight);
+  /** \brief Set organized plane detection parameters, the distance threshold,
+   * axis and eps angle are shared with the SAC parameters
+   * \param[in] Use integral image normals and organized multi plane segmentation
+   * for organized point clouds
+   * \param[in] Depth change threshold for computing object borders
+   * \param[in] Normal smoothing size in pixels
+   * \param[in] The minimum number of inliers of a plane
+   * \param[in] The maximum allowed angle between the normals of neighbouring
+   * plane points in radians
+   * */
+  void setOrganizedPlaneParams(bool enable, double max_depth_change_factor,
+                               double normal_smoothing_size, int min_inliers,
+                               double angular_threshold);
+  /** \brief Set coarse to fine plane detection parameters. A plane perpendicular to the
+   * axis is found without normals on a subsampled cloud first, the normals are then only
+   * estimated for the points within a band around it and the SAC with normals is run on
+   * these points. The SAC parameters apply to both stages.
+   * \param[in] Enable the coarse to fine plane detection
+   * \param[in] Leaf size of the subsampled cloud of the coarse stage
+   * \param[in] Maximum distance of the points to the coarse plane which are refined
+   * */
+  void setCoarsePlaneParams(bool enable, double leaf_size, double band_width);
+  /** \brief Set plane cache parameters. The plane found at a workstation is reused when
+   * the robot perceives it again, if enough points of a subsample are still inliers,
+   * and the normal estimation and SAC are skipped. Only used by the SAC plane detection.
+   * \param[in] Enable the plane cache
+   * \param[in] Maximum translation of the base between two perceptions in meters
+   * \param[in] Maximum rotation of the base between two perceptions in radians
+   * \param[in] Number of points the cached plane is validated on
+   * \param[in] Minimum inlier ratio on the subsample, relative to the inlier ratio
+   * when the plane was cached
+   * */
+  void setPlaneCacheParams(bool enable, double max_translation, double max_rotation,
+                           int sample_size, double min_inlier_ratio);
+  /** \brief Set the workstation and the base pose of the next findPlane calls
+   * \param[in] Workstation name, may be empty to match by base pose only
+   * \param[in] Pose of the base, i.e. of the cloud frame, in a fixed frame
+   * */
+  void setPlaneCacheContext(const std::string &key, const Eigen::Affine3f &base_pose);
+  /** \brief Do not use the plane cache in the next findPlane calls, e.g. if the base pose
+   * is unknown */
+  void clearPlaneCacheContext();
+  /** \brief Get the plane cache hit and miss counters */
+  PlaneModelCacheStatistics getPlaneCacheStatistics() const;
   /** \brief Set prism parameters
    * \param[in] The minimum height above the plane from which to construct the
    * polygonal prism
@@ -127,6 +195,15 @@ class SceneSegmentation
    * polygonal prism
    * */
   void setPrismParams(double min_height, double max_height);
+  /** \brief Set hull mask prism parameters. The hull is rasterized into a mask in the
+   * plane and every point is classified by its height and a mask lookup instead of
+   * ExtractPolygonalPrismData, the prism heights apply to both. Points closer than a
+   * cell to the hull border may be classified differently.
+   * \param[in] Enable the hull mask prism extraction
+   * \param[in] Size of the mask cells, e.g. the voxel leaf size
+   * \param[in] Number of OMP threads classifying the points (default=1)
+   * */
+  void setHullMaskPrismParams(bool enable, double resolution, int num_threads = 1);
   /** \brief Set outliers parameters
    * \param[in] Radius of the sphere that will determine which points are
    * neighbors.
@@ -144,15 +221,64 @@ class SceneSegmentation
    * \param[in] The maximum height of the cluster above the given polygon
    * \param[in] The maximum length of the cluster
    * \param[in] The minimum height of the cluster above the given polygon
+   * \param[in] Cluster with voxel connected components instead of the KdTree based
+   * euclidean cluster extraction, the voxel size is the cluster tolerance
    * */
   void setClusterParams(double cluster_tolerance, int cluster_min_size, int cluster_max_size,
                         double cluster_min_height, double cluster_max_height, double max_length,
-                        double cluster_min_distance_to_polygon);
+                        double cluster_min_distance_to_polygon, bool use_voxel_clustering = false);
 
  private:
+  /** \brief Find plane on the image grid of an organized point cloud */
+  PointCloud::Ptr findPlaneOrganized(const PointCloud::ConstPtr &cloud, PointCloud::Ptr &hull,
+                                     PointCloud::Ptr &plane,
+                                     pcl::ModelCoefficients::Ptr &coefficients,
+                                     double &workspace_height);
+  /** \brief Find a plane perpendicular to the axis on the subsampled cloud and refine it
+   * with the SAC with normals on the points in a band around it
+   * \return false if the coarse stage does not find a plane
+   * */
+  bool findPlaneCoarseToFine(const PointCloud::ConstPtr &cloud, pcl::PointIndices::Ptr &inliers,
+                             pcl::ModelCoefficients::Ptr &coefficients);
+  /** \brief Validate the cached plane of the current context on a subsample of the cloud
+   * and collect its inliers
+   * \return false if there is no cached plane or it does not fit anymore
+   * */
+  bool findCachedPlane(const PointCloud::ConstPtr &cloud, pcl::PointIndices::Ptr &inliers,
+                       pcl::ModelCoefficients::Ptr &coefficients);
+  /** \brief Project the plane inliers, compute the convex hull and the workspace height */
+  void computePlaneHull(const PointCloud::ConstPtr &cloud, const pcl::PointIndices::Ptr &inliers,
+                        const pcl::ModelCoefficients::Ptr &coefficients, PointCloud::Ptr &hull,
+                        PointCloud::Ptr &plane, double &workspace_height);
+
   bool enable_passthrough_filter_;
   bool enable_cropbox_filter_;
+  std::string voxel_filter_field_name_;
+  double voxel_filter_limit_min_;
+  double voxel_filter_limit_max_;
+  std::string passthrough_field_name_;
+  double passthrough_limit_min_;
+  double passthrough_limit_max_;
   bool use_omp_;
+  bool use_organized_plane_detection_;
+  bool use_voxel_clustering_;
+  bool use_hull_mask_prism_;
+  Eigen::Vector3f sac_axis_;
+  double sac_eps_angle_;
+  bool sac_optimize_coefficients_;
+  double sac_distance_threshold_;
+  bool use_coarse_plane_detection_;
+  double coarse_plane_leaf_size_;
+  double coarse_plane_band_width_;
+  bool use_plane_cache_;
+  bool plane_cache_context_valid_;
+  std::string plane_cache_key_;
+  Eigen::Affine3f plane_cache_pose_;
+  int plane_cache_sample_size_;
+  double plane_cache_min_inlier_ratio_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
 #endif  // MIR_OBJECT_SEGMENTATION_SCENE_SEGMENTATION_H
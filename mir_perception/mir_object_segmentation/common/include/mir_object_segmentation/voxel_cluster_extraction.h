@@ -0,0 +1,73 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_OBJECT_SEGMENTATION_VOXEL_CLUSTER_EXTRACTION_H
+#define MIR_OBJECT_SEGMENTATION_VOXEL_CLUSTER_EXTRACTION_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <pcl/PointIndices.h>
+
+#include <mir_perception_utils/aliases.h>
+
+/** \brief Grid based alternative to pcl::EuclideanClusterExtraction.
+ *
+ * Points are binned into voxels of the voxel size (the leaf size of the
+ * downsampled input), shrunk if needed so that all points of a voxel are
+ * within the tolerance of each other. Occupied voxels within ceil(tolerance /
+ * voxel size) voxels are joined with union-find: directly if all their points
+ * are within the tolerance, after a point to point distance check otherwise.
+ * The clusters are the same as the ones of EuclideanClusterExtraction, they are
+ * filtered by their number of points and sorted by size in descending order.
+ */
+class VoxelClusterExtraction
+{
+ public:
+  /** \brief Constructor */
+  VoxelClusterExtraction();
+
+  /** \brief Set the spatial cluster tolerance */
+  void setClusterTolerance(double tolerance) { tolerance_ = tolerance; }
+  /** \brief Set the voxel size, usually the leaf size of the input cloud.
+   * The largest voxel size with all points of a voxel within the tolerance is used if 0 */
+  void setVoxelSize(double voxel_size) { voxel_size_ = voxel_size; }
+  /** \brief Set the minimum number of points of a cluster */
+  void setMinClusterSize(int min_cluster_size) { min_cluster_size_ = min_cluster_size; }
+  /** \brief Set the maximum number of points of a cluster */
+  void setMaxClusterSize(int max_cluster_size) { max_cluster_size_ = max_cluster_size; }
+
+  /** \brief Cluster the given points of the cloud
+   * \param[in] Point cloud
+   * \param[in] Indices of the points to cluster
+   * \param[out] Point indices of the clusters
+   * */
+  void extract(const PointCloud &cloud, const std::vector<int> &indices,
+               std::vector<pcl::PointIndices> &clusters);
+
+ private:
+  int findRoot(int voxel);
+  void join(int voxel_a, int voxel_b);
+  bool isWithinTolerance(int voxel_a, int voxel_b, float squared_tolerance) const;
+
+  double tolerance_;
+  double voxel_size_;
+  int min_cluster_size_;
+  int max_cluster_size_;
+
+  // buffers are kept between calls to avoid reallocation
+  std::unordered_map<uint64_t, int> voxel_ids_;
+  std::vector<uint64_t> voxel_keys_;
+  std::vector<int> point_voxels_;
+  // points sorted by voxel, the points of voxel v start at voxel_starts_[v]
+  std::vector<int> voxel_starts_;
+  std::vector<Eigen::Vector3f> voxel_points_;
+  std::vector<int> parents_;
+  std::vector<int> ranks_;
+};
+
+#endif  // MIR_OBJECT_SEGMENTATION_VOXEL_CLUSTER_EXTRACTION_H
@@ -5,26 +5,28 @@
  *
  */
 
-#include <pcl/octree/octree_impl.h>
-
 #include <mir_object_segmentation/cloud_accumulation.h>
 
-CloudAccumulation::CloudAccumulation(double resolution) : resolution_(resolution) { reset(); }
+CloudAccumulation::CloudAccumulation(double resolution)
+    : voxels_(resolution), resolution_(resolution)
+{
+  reset();
+}
 void CloudAccumulation::addCloud(const PointCloud::ConstPtr &cloud)
 {
-  octree_->setOccupiedVoxelsAtPointsFromCloud(cloud);
+  voxels_.addCloud(*cloud);
   cloud_count_++;
 }
 
 void CloudAccumulation::getAccumulatedCloud(PointCloud &cloud)
 {
-  octree_->getOccupiedVoxelCentersWithColor(cloud.points);
+  voxels_.getVoxelCentersWithColor(cloud.points);
   cloud.width = static_cast<uint32_t>(cloud.points.size());
   cloud.height = 1;
 }
 
 void CloudAccumulation::reset()
 {
-  octree_ = OctreeUPtr(new Octree(resolution_));
+  voxels_.clear();
   cloud_count_ = 0;
 }
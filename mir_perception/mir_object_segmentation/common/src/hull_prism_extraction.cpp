@@ -0,0 +1,162 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Eigenvalues>
+
+#include <pcl/common/point_tests.h>
+
+#include <mir_object_segmentation/hull_prism_extraction.h>
+
+namespace
+{
+// masks larger than this are rasterized with coarser cells
+const double MAX_MASK_CELLS = 16.0 * 1024.0 * 1024.0;
+}  // namespace
+
+HullPrismExtraction::HullPrismExtraction()
+    : min_height_(0.0),
+      max_height_(std::numeric_limits<float>::max()),
+      view_point_(0.0f, 0.0f, 0.0f),
+      resolution_(0.005),
+      num_threads_(1),
+      plane_transform_(Eigen::Matrix<float, 3, 4>::Zero()),
+      mask_cols_(0),
+      mask_rows_(0)
+{
+}
+
+bool HullPrismExtraction::rasterizeHull(const PointCloud &hull)
+{
+  std::vector<Eigen::Vector3d> vertices;
+  vertices.reserve(hull.points.size());
+  for (const PointT &point : hull.points) {
+    if (pcl::isFinite(point)) vertices.push_back(point.getVector3fMap().cast<double>());
+  }
+  if (vertices.size() < 3) return false;
+
+  // plane of the hull, the eigen vector of the smallest eigen value of the covariance
+  Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+  for (const Eigen::Vector3d &vertex : vertices) centroid += vertex;
+  centroid /= static_cast<double>(vertices.size());
+  Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+  for (const Eigen::Vector3d &vertex : vertices) {
+    const Eigen::Vector3d d = vertex - centroid;
+    covariance += d * d.transpose();
+  }
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+  Eigen::Vector3d normal = solver.eigenvectors().col(0);
+  double offset = -normal.dot(centroid);
+
+  // oriented like ExtractPolygonalPrismData, which compares the homogeneous view point
+  // (w = 0) relative to the first hull point (w = 1) with the plane coefficients
+  const double cos_theta = normal.dot(view_point_.cast<double>() - vertices[0]) - offset;
+  if (cos_theta < 0.0) {
+    normal = -normal;
+    offset = -offset;
+  }
+
+  // orthonormal basis of the plane
+  Eigen::Vector3d axis = Eigen::Vector3d::Zero();
+  Eigen::Index min_axis;
+  normal.cwiseAbs().minCoeff(&min_axis);
+  axis[min_axis] = 1.0;
+  const Eigen::Vector3d u = normal.cross(axis).normalized();
+  const Eigen::Vector3d v = normal.cross(u);
+
+  // hull in plane coordinates relative to the centroid
+  std::vector<Eigen::Vector2d> polygon(vertices.size());
+  Eigen::Vector2d min = Eigen::Vector2d::Constant(std::numeric_limits<double>::max());
+  Eigen::Vector2d max = Eigen::Vector2d::Constant(-std::numeric_limits<double>::max());
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    const Eigen::Vector3d d = vertices[i] - centroid;
+    polygon[i] = Eigen::Vector2d(u.dot(d), v.dot(d));
+    min = min.cwiseMin(polygon[i]);
+    max = max.cwiseMax(polygon[i]);
+  }
+
+  double resolution = resolution_ > 0.0 ? resolution_ : 0.005;
+  const Eigen::Vector2d extent = max - min;
+  const double cells = std::ceil(extent[0] / resolution) * std::ceil(extent[1] / resolution);
+  if (cells > MAX_MASK_CELLS) resolution *= std::sqrt(cells / MAX_MASK_CELLS);
+  mask_cols_ = std::max(static_cast<int>(std::ceil(extent[0] / resolution)), 1);
+  mask_rows_ = std::max(static_cast<int>(std::ceil(extent[1] / resolution)), 1);
+
+  // a cell is inside if its center is, even-odd rule along each row of cell centers
+  mask_.assign(static_cast<size_t>(mask_cols_) * mask_rows_, 0);
+  std::vector<double> crossings;
+  for (int row = 0; row < mask_rows_; ++row) {
+    const double y = min[1] + (row + 0.5) * resolution;
+    crossings.clear();
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+      const Eigen::Vector2d &a = polygon[i];
+      const Eigen::Vector2d &b = polygon[j];
+      if ((a[1] > y) == (b[1] > y)) continue;
+      crossings.push_back(a[0] + (y - a[1]) * (b[0] - a[0]) / (b[1] - a[1]));
+    }
+    std::sort(crossings.begin(), crossings.end());
+    uint8_t *mask_row = mask_.data() + static_cast<size_t>(row) * mask_cols_;
+    for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+      // cells whose center lies in [crossings[i], crossings[i + 1])
+      const int first =
+          std::max(static_cast<int>(std::ceil((crossings[i] - min[0]) / resolution - 0.5)), 0);
+      const int last = std::min(
+          static_cast<int>(std::ceil((crossings[i + 1] - min[0]) / resolution - 0.5)) - 1,
+          mask_cols_ - 1);
+      for (int col = first; col <= last; ++col) mask_row[col] = 1;
+    }
+  }
+
+  // a single affine map from a point to its height and its cell coordinates
+  plane_transform_.row(0) << normal.cast<float>().transpose(), static_cast<float>(offset);
+  const double scale = 1.0 / resolution;
+  plane_transform_.row(1) << (u * scale).cast<float>().transpose(),
+      static_cast<float>((-u.dot(centroid) - min[0]) * scale);
+  plane_transform_.row(2) << (v * scale).cast<float>().transpose(),
+      static_cast<float>((-v.dot(centroid) - min[1]) * scale);
+  return true;
+}
+
+bool HullPrismExtraction::segment(const PointCloud &cloud, const PointCloud &hull,
+                                  pcl::PointIndices &inliers)
+{
+  inliers.header = cloud.header;
+  inliers.indices.clear();
+  if (!rasterizeHull(hull)) return false;
+
+  const int num_points = static_cast<int>(cloud.points.size());
+  point_flags_.resize(num_points);
+
+  const Eigen::Matrix<float, 3, 4> t = plane_transform_;
+  const float min_height = static_cast<float>(min_height_);
+  const float max_height = static_cast<float>(max_height_);
+  const float cols = static_cast<float>(mask_cols_);
+  const float rows = static_cast<float>(mask_rows_);
+  const int mask_cols = mask_cols_;
+  const uint8_t *mask = mask_.data();
+  uint8_t *flags = point_flags_.data();
+
+  // no branches on the arithmetic, points with NaN coordinates fail all comparisons
+#pragma omp parallel for num_threads(num_threads_) schedule(static) if (num_threads_ > 1)
+  for (int i = 0; i < num_points; ++i) {
+    const PointT &point = cloud.points[i];
+    const float height = t(0, 0) * point.x + t(0, 1) * point.y + t(0, 2) * point.z + t(0, 3);
+    const float col = t(1, 0) * point.x + t(1, 1) * point.y + t(1, 2) * point.z + t(1, 3);
+    const float row = t(2, 0) * point.x + t(2, 1) * point.y + t(2, 2) * point.z + t(2, 3);
+    const bool in_mask = height >= min_height && height <= max_height && col >= 0.0f &&
+                         col < cols && row >= 0.0f && row < rows;
+    flags[i] =
+        in_mask && mask[static_cast<int>(row) * mask_cols + static_cast<int>(col)] ? 1 : 0;
+  }
+
+  // compacted serially to keep the indices in ascending order
+  inliers.indices.reserve(std::count(point_flags_.begin(), point_flags_.end(), 1));
+  for (int i = 0; i < num_points; ++i) {
+    if (flags[i]) inliers.indices.push_back(i);
+  }
+  return true;
+}
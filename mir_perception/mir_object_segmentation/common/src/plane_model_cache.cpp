@@ -0,0 +1,132 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <mir_object_segmentation/plane_model_cache.h>
+
+PlaneModelCache::PlaneModelCache(size_t max_entries)
+    : max_entries_(std::max<size_t>(max_entries, 1)),
+      max_translation_(0.3),
+      max_rotation_(0.3),
+      clock_(0)
+{
+}
+
+void PlaneModelCache::setPoseTolerance(double max_translation, double max_rotation)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_translation_ = max_translation;
+  max_rotation_ = max_rotation;
+}
+
+int PlaneModelCache::find(const std::string &key, const Eigen::Affine3f &base_pose) const
+{
+  int best = -1;
+  double best_distance = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    const Entry &entry = entries_[i];
+    if (entry.key != key) continue;
+    const double translation =
+        (entry.base_pose.translation() - base_pose.translation()).norm();
+    const double rotation =
+        Eigen::AngleAxisf(entry.base_pose.rotation().transpose() * base_pose.rotation()).angle();
+    if (translation > max_translation_ || rotation > max_rotation_) continue;
+    if (translation < best_distance) {
+      best_distance = translation;
+      best = static_cast<int>(i);
+    }
+  }
+  return best;
+}
+
+bool PlaneModelCache::lookup(const std::string &key, const Eigen::Affine3f &base_pose,
+                             Eigen::Vector4f &plane, float &inlier_ratio)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int index = find(key, base_pose);
+  if (index < 0) {
+    statistics_.misses++;
+    return false;
+  }
+  Entry &entry = entries_[index];
+  entry.last_used = ++clock_;
+  // planes transform with the transpose of the point transform
+  plane = base_pose.matrix().transpose() * entry.plane;
+  inlier_ratio = entry.inlier_ratio;
+  return true;
+}
+
+void PlaneModelCache::insert(const std::string &key, const Eigen::Affine3f &base_pose,
+                             const Eigen::Vector4f &plane, float inlier_ratio)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  int index = find(key, base_pose);
+  if (index < 0) {
+    if (entries_.size() < max_entries_) {
+      entries_.push_back(Entry());
+      index = static_cast<int>(entries_.size()) - 1;
+    } else {
+      index = static_cast<int>(
+          std::min_element(entries_.begin(), entries_.end(),
+                           [](const Entry &a, const Entry &b) { return a.last_used < b.last_used; }) -
+          entries_.begin());
+    }
+  }
+  Entry &entry = entries_[index];
+  entry.key = key;
+  entry.base_pose = base_pose;
+  entry.plane = base_pose.matrix().inverse().transpose() * plane;
+  entry.inlier_ratio = inlier_ratio;
+  entry.last_used = ++clock_;
+  statistics_.entries = entries_.size();
+}
+
+void PlaneModelCache::reportValidation(bool valid)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (valid) {
+    statistics_.hits++;
+  } else {
+    statistics_.rejected++;
+  }
+}
+
+void PlaneModelCache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  statistics_.entries = 0;
+}
+
+PlaneModelCacheStatistics PlaneModelCache::getStatistics() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+float PlaneModelCache::computeInlierRatio(const PointCloud &cloud, const Eigen::Vector4f &plane,
+                                          double distance_threshold, int max_samples)
+{
+  const size_t num_points = cloud.points.size();
+  if (num_points == 0) return 0.0f;
+  const size_t stride =
+      max_samples > 0 ? std::max<size_t>(num_points / static_cast<size_t>(max_samples), 1) : 1;
+  const float norm = plane.head<3>().norm();
+  if (norm <= 0.0f) return 0.0f;
+  const float threshold = static_cast<float>(distance_threshold) * norm;
+
+  size_t samples = 0;
+  size_t inliers = 0;
+  for (size_t i = 0; i < num_points; i += stride) {
+    const PointT &point = cloud.points[i];
+    if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) continue;
+    samples++;
+    const float distance = plane[0] * point.x + plane[1] * point.y + plane[2] * point.z + plane[3];
+    if (std::abs(distance) <= threshold) inliers++;
+  }
+  return samples > 0 ? static_cast<float>(inliers) / samples : 0.0f;
+}
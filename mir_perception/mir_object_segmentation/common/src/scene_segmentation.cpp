@@ -4,17 +4,85 @@
  * Author: Mohammad Wasil, Santosh Thoduka
  *
  */
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <vector>
 
+#include <pcl/sample_consensus/sac_model_plane.h>
+
 #include <mir_object_segmentation/scene_segmentation.h>
+#include <mir_perception_utils/latency_profiler.h>
+
+using mir_perception_utils::LatencyStage;
+using mir_perception_utils::ScopedLatencyTimer;
+
+namespace
+{
+const LatencyStage VOXEL_STAGE("scene_segmentation/voxel");
+const LatencyStage PASSTHROUGH_STAGE("scene_segmentation/passthrough");
+const LatencyStage CROP_STAGE("scene_segmentation/crop");
+const LatencyStage NORMALS_STAGE("scene_segmentation/normals");
+const LatencyStage SAC_STAGE("scene_segmentation/sac");
+const LatencyStage COARSE_PLANE_STAGE("scene_segmentation/coarse_plane");
+const LatencyStage PLANE_CACHE_STAGE("scene_segmentation/plane_cache");
+const LatencyStage ORGANIZED_PLANE_STAGE("scene_segmentation/organized_plane");
+const LatencyStage HULL_STAGE("scene_segmentation/hull");
+const LatencyStage PRISM_STAGE("scene_segmentation/prism");
+const LatencyStage CLUSTER_STAGE("scene_segmentation/cluster");
+const LatencyStage BOUNDING_BOX_STAGE("scene_segmentation/bounding_box");
+
+/** Limit the axis of the box the filter field refers to, other fields are ignored */
+void limitAxis(const std::string &field_name, double limit_min, double limit_max,
+               Eigen::Vector3f &min, Eigen::Vector3f &max, bool &limited)
+{
+  int axis = -1;
+  if (field_name == "x") axis = 0;
+  else if (field_name == "y") axis = 1;
+  else if (field_name == "z") axis = 2;
+  if (axis < 0) return;
+  min[axis] = std::max(min[axis], static_cast<float>(limit_min));
+  max[axis] = std::min(max[axis], static_cast<float>(limit_max));
+  limited = true;
+}
+}  // namespace
 
-SceneSegmentation::SceneSegmentation() : use_omp_(false)
+SceneSegmentation::SceneSegmentation()
+    : enable_passthrough_filter_(false),
+      enable_cropbox_filter_(false),
+      voxel_filter_limit_min_(0.0),
+      voxel_filter_limit_max_(0.0),
+      passthrough_limit_min_(0.0),
+      passthrough_limit_max_(0.0),
+      use_omp_(false),
+      use_organized_plane_detection_(false),
+      use_voxel_clustering_(false),
+      use_hull_mask_prism_(false),
+      sac_axis_(Eigen::Vector3f::UnitZ()),
+      sac_eps_angle_(0.0),
+      sac_optimize_coefficients_(false),
+      sac_distance_threshold_(0.0),
+      use_coarse_plane_detection_(false),
+      coarse_plane_leaf_size_(0.03),
+      coarse_plane_band_width_(0.02),
+      use_plane_cache_(false),
+      plane_cache_context_valid_(false),
+      plane_cache_pose_(Eigen::Affine3f::Identity()),
+      plane_cache_sample_size_(500),
+      plane_cache_min_inlier_ratio_(0.8)
 {
   cluster_extraction_.setSearchMethod(boost::make_shared<pcl::search::KdTree<PointT>>());
   normal_estimation_.setSearchMethod(boost::make_shared<pcl::search::KdTree<PointT>>());
   normal_estimation_omp_.setSearchMethod(boost::make_shared<pcl::search::KdTree<PointT>>());
+  integral_image_normal_estimation_.setNormalEstimationMethod(
+      pcl::IntegralImageNormalEstimation<PointT, PointNT>::AVERAGE_3D_GRADIENT);
+  coarse_voxel_grid_.setLeafSize(coarse_plane_leaf_size_, coarse_plane_leaf_size_,
+                                 coarse_plane_leaf_size_);
+  coarse_sac_.setModelType(pcl::SACMODEL_PERPENDICULAR_PLANE);
+  coarse_sac_.setMethodType(pcl::SAC_RANSAC);
+  coarse_sac_.setOptimizeCoefficients(false);
 };
 SceneSegmentation::~SceneSegmentation(){
 
@@ -24,7 +92,8 @@ PointCloud::Ptr SceneSegmentation::segmentScene(const PointCloud::ConstPtr &clou
                                                 std::vector<PointCloud::Ptr> &clusters,
                                                 std::vector<BoundingBox> &boxes,
                                                 pcl::ModelCoefficients::Ptr &coefficients,
-                                                double &workspace_height)
+                                                double &workspace_height,
+                                                const PointCloud::ConstPtr &plane_cloud)
 {
   PointCloud::Ptr filtered(new PointCloud);
   PointCloud::Ptr plane(new PointCloud);
@@ -32,20 +101,40 @@ PointCloud::Ptr SceneSegmentation::segmentScene(const PointCloud::ConstPtr &clou
   pcl::PointIndices::Ptr segmented_cloud_inliers(new pcl::PointIndices);
   std::vector<pcl::PointIndices> clusters_indices;
 
-  filtered = findPlane(cloud, hull, plane, coefficients, workspace_height);
+  // the plane cloud is only used by the organized plane detection, the voxel grid, normal
+  // estimation and SAC still run on the input cloud
+  const bool use_plane_cloud =
+      use_organized_plane_detection_ && plane_cloud && plane_cloud->isOrganized();
+  filtered = findPlane(use_plane_cloud ? plane_cloud : cloud, hull, plane, coefficients,
+                       workspace_height);
 
   if (coefficients->values.size() == 0) {
     return filtered;
   }
 
-  extract_polygonal_prism_.setInputPlanarHull(hull);
-  extract_polygonal_prism_.setInputCloud(cloud);
-  extract_polygonal_prism_.setViewPoint(0.0, 0.0, 2.0);
-  extract_polygonal_prism_.segment(*segmented_cloud_inliers);
+  {
+    ScopedLatencyTimer timer(PRISM_STAGE);
+    if (use_hull_mask_prism_) {
+      hull_prism_extraction_.setViewPoint(0.0, 0.0, 2.0);
+      hull_prism_extraction_.segment(*cloud, *hull, *segmented_cloud_inliers);
+    } else {
+      extract_polygonal_prism_.setInputPlanarHull(hull);
+      extract_polygonal_prism_.setInputCloud(cloud);
+      extract_polygonal_prism_.setViewPoint(0.0, 0.0, 2.0);
+      extract_polygonal_prism_.segment(*segmented_cloud_inliers);
+    }
+  }
 
-  cluster_extraction_.setInputCloud(cloud);
-  cluster_extraction_.setIndices(segmented_cloud_inliers);
-  cluster_extraction_.extract(clusters_indices);
+  {
+    ScopedLatencyTimer timer(CLUSTER_STAGE);
+    if (use_voxel_clustering_) {
+      voxel_cluster_extraction_.extract(*cloud, segmented_cloud_inliers->indices, clusters_indices);
+    } else {
+      cluster_extraction_.setInputCloud(cloud);
+      cluster_extraction_.setIndices(segmented_cloud_inliers);
+      cluster_extraction_.extract(clusters_indices);
+    }
+  }
 
   const Eigen::Vector3f normal(coefficients->values[0], coefficients->values[1],
                                coefficients->values[2]);
@@ -55,9 +144,9 @@ PointCloud::Ptr SceneSegmentation::segmentScene(const PointCloud::ConstPtr &clou
     PointCloud::Ptr cluster(new PointCloud);
     pcl::copyPointCloud(*cloud, cluster_indices, *cluster);
     clusters.push_back(cluster);
-    BoundingBox box = BoundingBox::create(cluster->points, normal);
-    boxes.push_back(box);
   }
+  ScopedLatencyTimer timer(BOUNDING_BOX_STAGE);
+  BoundingBox::create(*cloud, clusters_indices, normal, boxes);
   return filtered;
 }
 
@@ -66,49 +155,308 @@ PointCloud::Ptr SceneSegmentation::findPlane(const PointCloud::ConstPtr &cloud,
                                              pcl::ModelCoefficients::Ptr &coefficients,
                                              double &workspace_height)
 {
+  if (use_organized_plane_detection_ && cloud->isOrganized()) {
+    return findPlaneOrganized(cloud, hull, plane, coefficients, workspace_height);
+  }
+
   PointCloud::Ptr filtered(new PointCloud);
   pcl::PointIndices::Ptr segmented_cloud_inliers(new pcl::PointIndices);
 
   PointCloudN::Ptr normals(new PointCloudN);
 
-  voxel_grid_.setInputCloud(cloud);
-  voxel_grid_.filter(*filtered);
+  {
+    ScopedLatencyTimer timer(VOXEL_STAGE);
+    voxel_grid_.setInputCloud(cloud);
+    voxel_grid_.filter(*filtered);
+  }
 
   if (enable_passthrough_filter_) {
+    ScopedLatencyTimer timer(PASSTHROUGH_STAGE);
     pass_through_.setInputCloud(filtered);
     pass_through_.filter(*filtered);
   }
 
   // cropbox filter to include filters in XYZ
   if (enable_cropbox_filter_){
+    ScopedLatencyTimer timer(CROP_STAGE);
     crop_box_.setInputCloud(filtered);
     crop_box_.filter(*filtered);
   }
 
-  if (use_omp_) {
-    normal_estimation_omp_.setInputCloud(filtered);
-    normal_estimation_omp_.compute(*normals);
-  } else {
-    normal_estimation_.setInputCloud(filtered);
-    normal_estimation_.compute(*normals);
+  pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+
+  // the plane of a workstation perceived before skips the normal estimation and SAC
+  if (findCachedPlane(filtered, inliers, coefficients)) {
+    computePlaneHull(filtered, inliers, coefficients, hull, plane, workspace_height);
+    return filtered;
   }
 
-  pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+  // the full normal estimation is the fallback if the coarse stage does not find a plane
+  if (!use_coarse_plane_detection_ || !findPlaneCoarseToFine(filtered, inliers, coefficients)) {
+    {
+      ScopedLatencyTimer timer(NORMALS_STAGE);
+      if (use_omp_) {
+        normal_estimation_omp_.setInputCloud(filtered);
+        normal_estimation_omp_.compute(*normals);
+      } else {
+        normal_estimation_.setInputCloud(filtered);
+        normal_estimation_.compute(*normals);
+      }
+    }
 
-  sac_.setModelType(pcl::SACMODEL_NORMAL_PARALLEL_PLANE);
-  sac_.setMethodType(pcl::SAC_RANSAC);
+    {
+      ScopedLatencyTimer timer(SAC_STAGE);
+      sac_.setModelType(pcl::SACMODEL_NORMAL_PARALLEL_PLANE);
+      sac_.setMethodType(pcl::SAC_RANSAC);
 
-  sac_.setInputCloud(filtered);
-  sac_.setInputNormals(normals);
-  sac_.segment(*inliers, *coefficients);
+      sac_.setInputCloud(filtered);
+      sac_.setInputNormals(normals);
+      sac_.segment(*inliers, *coefficients);
+    }
+  }
 
   if (inliers->indices.size() == 0) {
     std::cout << "No plane inliers found " << std::endl;
     return filtered;
   }
 
+  if (use_plane_cache_ && plane_cache_context_valid_ && coefficients->values.size() == 4) {
+    const Eigen::Vector4f model(coefficients->values[0], coefficients->values[1],
+                                coefficients->values[2], coefficients->values[3]);
+    plane_cache_.insert(plane_cache_key_, plane_cache_pose_, model,
+                        static_cast<float>(inliers->indices.size()) / filtered->points.size());
+  }
+
+  computePlaneHull(filtered, inliers, coefficients, hull, plane, workspace_height);
+
+  return filtered;
+}
+
+bool SceneSegmentation::findPlaneCoarseToFine(const PointCloud::ConstPtr &cloud,
+                                              pcl::PointIndices::Ptr &inliers,
+                                              pcl::ModelCoefficients::Ptr &coefficients)
+{
+  Eigen::Vector4f model;
+  {
+    ScopedLatencyTimer timer(COARSE_PLANE_STAGE);
+    PointCloud::Ptr coarse(new PointCloud);
+    coarse_voxel_grid_.setInputCloud(cloud);
+    coarse_voxel_grid_.filter(*coarse);
+    if (coarse->points.size() < 3) return false;
+
+    // the voxel centroids deviate from the plane by up to half a leaf
+    pcl::PointIndices coarse_inliers;
+    pcl::ModelCoefficients coarse_coefficients;
+    coarse_sac_.setDistanceThreshold(
+        std::max(sac_distance_threshold_, 0.5 * coarse_plane_leaf_size_));
+    coarse_sac_.setInputCloud(coarse);
+    coarse_sac_.segment(coarse_inliers, coarse_coefficients);
+    if (coarse_inliers.indices.empty() || coarse_coefficients.values.size() != 4) return false;
+    model = Eigen::Vector4f(coarse_coefficients.values[0], coarse_coefficients.values[1],
+                            coarse_coefficients.values[2], coarse_coefficients.values[3]);
+    model /= model.head<3>().norm();
+  }
+
+  // only the points close to the coarse plane get normals, the objects above it are skipped
+  std::vector<int> band_indices;
+  PointCloud::Ptr band(new PointCloud);
+  band_indices.reserve(cloud->points.size());
+  for (size_t i = 0; i < cloud->points.size(); i++) {
+    const PointT &point = cloud->points[i];
+    if (!pcl::isFinite(point)) continue;
+    const float distance = model[0] * point.x + model[1] * point.y + model[2] * point.z + model[3];
+    if (std::abs(distance) <= coarse_plane_band_width_) band_indices.push_back(i);
+  }
+  if (band_indices.size() < 3) return false;
+  pcl::copyPointCloud(*cloud, band_indices, *band);
+
+  PointCloudN::Ptr normals(new PointCloudN);
+  {
+    ScopedLatencyTimer timer(NORMALS_STAGE);
+    if (use_omp_) {
+      normal_estimation_omp_.setInputCloud(band);
+      normal_estimation_omp_.compute(*normals);
+    } else {
+      normal_estimation_.setInputCloud(band);
+      normal_estimation_.compute(*normals);
+    }
+  }
+
+  // the SAC with normals confirms the orientation and refines the plane
+  pcl::PointIndices band_inliers;
+  {
+    ScopedLatencyTimer timer(SAC_STAGE);
+    sac_.setModelType(pcl::SACMODEL_NORMAL_PARALLEL_PLANE);
+    sac_.setMethodType(pcl::SAC_RANSAC);
+
+    sac_.setInputCloud(band);
+    sac_.setInputNormals(normals);
+    sac_.segment(band_inliers, *coefficients);
+  }
+  if (band_inliers.indices.empty()) return false;
+
+  inliers->indices.resize(band_inliers.indices.size());
+  for (size_t i = 0; i < band_inliers.indices.size(); i++) {
+    inliers->indices[i] = band_indices[band_inliers.indices[i]];
+  }
+  coefficients->header = cloud->header;
+  return true;
+}
+
+bool SceneSegmentation::findCachedPlane(const PointCloud::ConstPtr &cloud,
+                                        pcl::PointIndices::Ptr &inliers,
+                                        pcl::ModelCoefficients::Ptr &coefficients)
+{
+  if (!use_plane_cache_ || !plane_cache_context_valid_ || cloud->points.size() < 3) {
+    return false;
+  }
+  ScopedLatencyTimer timer(PLANE_CACHE_STAGE);
+  Eigen::Vector4f model;
+  float cached_inlier_ratio;
+  if (!plane_cache_.lookup(plane_cache_key_, plane_cache_pose_, model, cached_inlier_ratio)) {
+    return false;
+  }
+
+  // the base may have moved since, so the axis constraint of the SAC model is checked again
+  const Eigen::Vector3f normal = model.head<3>().normalized();
+  const double angle = std::acos(std::min(1.0f, std::abs(normal.dot(sac_axis_))));
+  bool valid = sac_eps_angle_ <= 0.0 || angle <= sac_eps_angle_;
+  if (valid) {
+    const float inlier_ratio = PlaneModelCache::computeInlierRatio(
+        *cloud, model, sac_distance_threshold_, plane_cache_sample_size_);
+    valid = inlier_ratio >= plane_cache_min_inlier_ratio_ * cached_inlier_ratio;
+  }
+
+  // inliers of the whole cloud by point to plane distance, refined like the SAC result
+  pcl::SampleConsensusModelPlane<PointT> plane_model(cloud);
+  Eigen::VectorXf model_coefficients = model / model.head<3>().norm();
+  if (valid) {
+    plane_model.selectWithinDistance(model_coefficients, sac_distance_threshold_,
+                                     inliers->indices);
+    valid = inliers->indices.size() >= 3;
+  }
+  if (valid && sac_optimize_coefficients_) {
+    Eigen::VectorXf refined_coefficients;
+    plane_model.optimizeModelCoefficients(inliers->indices, model_coefficients,
+                                          refined_coefficients);
+    model_coefficients = refined_coefficients;
+    plane_model.selectWithinDistance(model_coefficients, sac_distance_threshold_,
+                                     inliers->indices);
+    valid = inliers->indices.size() >= 3;
+  }
+  plane_cache_.reportValidation(valid);
+  if (!valid) {
+    inliers->indices.clear();
+    return false;
+  }
+
+  coefficients->header = cloud->header;
+  coefficients->values.assign(model_coefficients.data(), model_coefficients.data() + 4);
+  plane_cache_.insert(plane_cache_key_, plane_cache_pose_, model_coefficients.head<4>(),
+                      static_cast<float>(inliers->indices.size()) / cloud->points.size());
+  return true;
+}
+
+PointCloud::Ptr SceneSegmentation::findPlaneOrganized(const PointCloud::ConstPtr &cloud,
+                                                      PointCloud::Ptr &hull, PointCloud::Ptr &plane,
+                                                      pcl::ModelCoefficients::Ptr &coefficients,
+                                                      double &workspace_height)
+{
+  // The filters keep the image grid by replacing removed points with NaN,
+  // the voxel grid is skipped but its field limits are still applied
+  PointCloud::Ptr filtered(new PointCloud(*cloud));
+  const std::string field_name = voxel_grid_.getFilterFieldName();
+  if (!field_name.empty()) {
+    ScopedLatencyTimer timer(VOXEL_STAGE);
+    double limit_min, limit_max;
+    voxel_grid_.getFilterLimits(limit_min, limit_max);
+    pcl::PassThrough<PointT> field_filter(false);
+    field_filter.setKeepOrganized(true);
+    field_filter.setFilterFieldName(field_name);
+    field_filter.setFilterLimits(limit_min, limit_max);
+    field_filter.setInputCloud(filtered);
+    field_filter.filter(*filtered);
+  }
+
+  if (enable_passthrough_filter_) {
+    ScopedLatencyTimer timer(PASSTHROUGH_STAGE);
+    pass_through_.setKeepOrganized(true);
+    pass_through_.setInputCloud(filtered);
+    pass_through_.filter(*filtered);
+    pass_through_.setKeepOrganized(false);
+  }
+
+  if (enable_cropbox_filter_) {
+    ScopedLatencyTimer timer(CROP_STAGE);
+    crop_box_.setKeepOrganized(true);
+    crop_box_.setInputCloud(filtered);
+    crop_box_.filter(*filtered);
+    crop_box_.setKeepOrganized(false);
+  }
+
+  // flip the normals towards the side of the plane the axis points to
+  const Eigen::Vector3f view_point = sac_axis_ * 100.0f;
+  PointCloudN::Ptr normals(new PointCloudN);
+  {
+    ScopedLatencyTimer timer(NORMALS_STAGE);
+    integral_image_normal_estimation_.setViewPoint(view_point[0], view_point[1], view_point[2]);
+    integral_image_normal_estimation_.setInputCloud(filtered);
+    integral_image_normal_estimation_.compute(*normals);
+  }
+
+  std::vector<pcl::ModelCoefficients> planes_coefficients;
+  std::vector<pcl::PointIndices> planes_inliers;
+  {
+    ScopedLatencyTimer timer(ORGANIZED_PLANE_STAGE);
+    organized_plane_segmentation_.setInputCloud(filtered);
+    organized_plane_segmentation_.setInputNormals(normals);
+    organized_plane_segmentation_.segment(planes_coefficients, planes_inliers);
+  }
+
+  // select the largest plane perpendicular to the axis, like the SAC model does
+  int best_plane = -1;
+  for (size_t i = 0; i < planes_coefficients.size(); i++) {
+    Eigen::Vector3f normal(planes_coefficients[i].values[0], planes_coefficients[i].values[1],
+                           planes_coefficients[i].values[2]);
+    normal.normalize();
+    const double angle = std::acos(std::min(1.0f, std::abs(normal.dot(sac_axis_))));
+    if (sac_eps_angle_ > 0.0 && angle > sac_eps_angle_) {
+      continue;
+    }
+    if (best_plane < 0 ||
+        planes_inliers[i].indices.size() > planes_inliers[best_plane].indices.size()) {
+      best_plane = i;
+    }
+  }
+
+  if (best_plane < 0) {
+    std::cout << "No plane inliers found " << std::endl;
+    coefficients->values.clear();
+    return filtered;
+  }
+
+  *coefficients = planes_coefficients[best_plane];
+  coefficients->header = cloud->header;
+  Eigen::Vector3f normal(coefficients->values[0], coefficients->values[1], coefficients->values[2]);
+  if (normal.dot(sac_axis_) < 0.0f) {
+    for (auto &value : coefficients->values) value = -value;
+  }
+
+  pcl::PointIndices::Ptr inliers(new pcl::PointIndices(planes_inliers[best_plane]));
+  computePlaneHull(filtered, inliers, coefficients, hull, plane, workspace_height);
+
+  return filtered;
+}
+
+void SceneSegmentation::computePlaneHull(const PointCloud::ConstPtr &cloud,
+                                         const pcl::PointIndices::Ptr &inliers,
+                                         const pcl::ModelCoefficients::Ptr &coefficients,
+                                         PointCloud::Ptr &hull, PointCloud::Ptr &plane,
+                                         double &workspace_height)
+{
+  ScopedLatencyTimer timer(HULL_STAGE);
   project_inliers_.setModelType(pcl::SACMODEL_NORMAL_PARALLEL_PLANE);
-  project_inliers_.setInputCloud(filtered);
+  project_inliers_.setInputCloud(cloud);
   project_inliers_.setModelCoefficients(coefficients);
   project_inliers_.setIndices(inliers);
   project_inliers_.setCopyAllData(false);
@@ -126,16 +474,18 @@ PointCloud::Ptr SceneSegmentation::findPlane(const PointCloud::ConstPtr &cloud,
     z /= hull->points.size();
   }
   workspace_height = z;
-
-  return filtered;
 }
 
 void SceneSegmentation::setVoxelGridParams(double leaf_size, const std::string &filter_field,
                                            double limit_min, double limit_max)
 {
   voxel_grid_.setLeafSize(leaf_size, leaf_size, leaf_size);
+  voxel_cluster_extraction_.setVoxelSize(leaf_size);
   voxel_grid_.setFilterFieldName(filter_field);
   voxel_grid_.setFilterLimits(limit_min, limit_max);
+  voxel_filter_field_name_ = filter_field;
+  voxel_filter_limit_min_ = limit_min;
+  voxel_filter_limit_max_ = limit_max;
 }
 
 void SceneSegmentation::setPassthroughParams(bool enable_passthrough_filter,
@@ -145,6 +495,9 @@ void SceneSegmentation::setPassthroughParams(bool enable_passthrough_filter,
   enable_passthrough_filter_ = enable_passthrough_filter;
   pass_through_.setFilterFieldName(field_name);
   pass_through_.setFilterLimits(limit_min, limit_max);
+  passthrough_field_name_ = field_name;
+  passthrough_limit_min_ = limit_min;
+  passthrough_limit_max_ = limit_max;
 }
 
 void SceneSegmentation::setCropBoxParams(bool enable_cropbox_filter, double min_x, double max_x,
@@ -155,6 +508,25 @@ void SceneSegmentation::setCropBoxParams(bool enable_cropbox_filter, double min_
   crop_box_.setMax(Eigen::Vector4f(max_x, max_y, max_z, 1.0));
 }
 
+bool SceneSegmentation::getWorkspaceBounds(Eigen::Vector3f &min, Eigen::Vector3f &max) const
+{
+  min = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+  max = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+  bool limited = false;
+  limitAxis(voxel_filter_field_name_, voxel_filter_limit_min_, voxel_filter_limit_max_, min, max,
+            limited);
+  if (enable_passthrough_filter_) {
+    limitAxis(passthrough_field_name_, passthrough_limit_min_, passthrough_limit_max_, min, max,
+              limited);
+  }
+  if (enable_cropbox_filter_) {
+    min = min.cwiseMax(crop_box_.getMin().head<3>());
+    max = max.cwiseMin(crop_box_.getMax().head<3>());
+    limited = true;
+  }
+  return limited;
+}
+
 void SceneSegmentation::setNormalParams(double radius_search, bool use_omp, int num_cores)
 {
   use_omp_ = use_omp;
@@ -175,10 +547,72 @@ void SceneSegmentation::setSACParams(int max_iterations, double distance_thresho
   sac_.setEpsAngle(eps_angle);
   sac_.setOptimizeCoefficients(optimize_coefficients);
   sac_.setNormalDistanceWeight(normal_distance_weight);
+  organized_plane_segmentation_.setDistanceThreshold(distance_threshold);
+  if (axis.norm() > 0.0f) {
+    sac_axis_ = axis.normalized();
+  }
+  sac_eps_angle_ = eps_angle;
+  sac_optimize_coefficients_ = optimize_coefficients;
+  sac_distance_threshold_ = distance_threshold;
+  coarse_sac_.setMaxIterations(max_iterations);
+  coarse_sac_.setAxis(axis);
+  coarse_sac_.setEpsAngle(eps_angle);
+}
+
+void SceneSegmentation::setCoarsePlaneParams(bool enable, double leaf_size, double band_width)
+{
+  use_coarse_plane_detection_ = enable;
+  coarse_plane_leaf_size_ = leaf_size;
+  coarse_plane_band_width_ = band_width;
+  coarse_voxel_grid_.setLeafSize(leaf_size, leaf_size, leaf_size);
+}
+
+void SceneSegmentation::setPlaneCacheParams(bool enable, double max_translation,
+                                            double max_rotation, int sample_size,
+                                            double min_inlier_ratio)
+{
+  use_plane_cache_ = enable;
+  plane_cache_.setPoseTolerance(max_translation, max_rotation);
+  plane_cache_sample_size_ = sample_size;
+  plane_cache_min_inlier_ratio_ = min_inlier_ratio;
+}
+
+void SceneSegmentation::setPlaneCacheContext(const std::string &key,
+                                             const Eigen::Affine3f &base_pose)
+{
+  plane_cache_key_ = key;
+  plane_cache_pose_ = base_pose;
+  plane_cache_context_valid_ = true;
+}
+
+void SceneSegmentation::clearPlaneCacheContext() { plane_cache_context_valid_ = false; }
+
+PlaneModelCacheStatistics SceneSegmentation::getPlaneCacheStatistics() const
+{
+  return plane_cache_.getStatistics();
+}
+
+void SceneSegmentation::setOrganizedPlaneParams(bool enable, double max_depth_change_factor,
+                                                double normal_smoothing_size, int min_inliers,
+                                                double angular_threshold)
+{
+  use_organized_plane_detection_ = enable;
+  integral_image_normal_estimation_.setMaxDepthChangeFactor(max_depth_change_factor);
+  integral_image_normal_estimation_.setNormalSmoothingSize(normal_smoothing_size);
+  organized_plane_segmentation_.setMinInliers(min_inliers);
+  organized_plane_segmentation_.setAngularThreshold(angular_threshold);
 }
 void SceneSegmentation::setPrismParams(double min_height, double max_height)
 {
   extract_polygonal_prism_.setHeightLimits(min_height, max_height);
+  hull_prism_extraction_.setHeightLimits(min_height, max_height);
+}
+
+void SceneSegmentation::setHullMaskPrismParams(bool enable, double resolution, int num_threads)
+{
+  use_hull_mask_prism_ = enable;
+  hull_prism_extraction_.setResolution(resolution);
+  hull_prism_extraction_.setNumberOfThreads(num_threads);
 }
 
 void SceneSegmentation::setOutlierParams(double radius_search, int min_neighbors)
@@ -189,9 +623,14 @@ void SceneSegmentation::setOutlierParams(double radius_search, int min_neighbors
 void SceneSegmentation::setClusterParams(double cluster_tolerance, int cluster_min_size,
                                          int cluster_max_size, double cluster_min_height,
                                          double cluster_max_height, double max_length,
-                                         double cluster_min_distance_to_polygon)
+                                         double cluster_min_distance_to_polygon,
+                                         bool use_voxel_clustering)
 {
+  use_voxel_clustering_ = use_voxel_clustering;
   cluster_extraction_.setClusterTolerance(cluster_tolerance);
   cluster_extraction_.setMinClusterSize(cluster_min_size);
   cluster_extraction_.setMaxClusterSize(cluster_max_size);
+  voxel_cluster_extraction_.setClusterTolerance(cluster_tolerance);
+  voxel_cluster_extraction_.setMinClusterSize(cluster_min_size);
+  voxel_cluster_extraction_.setMaxClusterSize(cluster_max_size);
 }
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include <pcl/common/point_tests.h>
+
+#include <mir_object_segmentation/voxel_cluster_extraction.h>
+
+namespace
+{
+const int KEY_BITS = 21;
+const int64_t KEY_OFFSET = static_cast<int64_t>(1) << (KEY_BITS - 1);
+const uint64_t KEY_MASK = (static_cast<uint64_t>(1) << KEY_BITS) - 1;
+// the voxel size is not reduced further for small leaf sizes to bound the neighbours per voxel
+const double MAX_NEIGHBOUR_RANGE = 8.0;
+
+uint64_t packKey(int64_t x, int64_t y, int64_t z)
+{
+  return (static_cast<uint64_t>(x + KEY_OFFSET) & KEY_MASK) << (2 * KEY_BITS) |
+         (static_cast<uint64_t>(y + KEY_OFFSET) & KEY_MASK) << KEY_BITS |
+         (static_cast<uint64_t>(z + KEY_OFFSET) & KEY_MASK);
+}
+
+int64_t unpackKey(uint64_t key, int shift)
+{
+  return static_cast<int64_t>((key >> shift) & KEY_MASK) - KEY_OFFSET;
+}
+}  // namespace
+
+VoxelClusterExtraction::VoxelClusterExtraction()
+    : tolerance_(0.02),
+      voxel_size_(0.0),
+      min_cluster_size_(1),
+      max_cluster_size_(std::numeric_limits<int>::max())
+{
+}
+
+void VoxelClusterExtraction::extract(const PointCloud &cloud, const std::vector<int> &indices,
+                                     std::vector<pcl::PointIndices> &clusters)
+{
+  clusters.clear();
+  if (tolerance_ <= 0.0) return;
+
+  // all points of a voxel are within the tolerance, so voxels can be joined instead of points
+  const double max_voxel_size = tolerance_ / std::sqrt(3.0);
+  double voxel_size = voxel_size_ > 0.0 ? std::min(voxel_size_, max_voxel_size) : max_voxel_size;
+  voxel_size = std::max(voxel_size, tolerance_ / MAX_NEIGHBOUR_RANGE);
+  const int range = static_cast<int>(std::ceil(tolerance_ / voxel_size));
+
+  const size_t num_points = indices.size();
+  const double inverse_voxel_size = 1.0 / voxel_size;
+
+  voxel_ids_.clear();
+  voxel_ids_.reserve(num_points);
+  voxel_keys_.clear();
+  voxel_starts_.clear();
+  point_voxels_.assign(num_points, -1);
+
+  // bin the points into voxels and count the points per voxel
+  for (size_t i = 0; i < num_points; i++) {
+    const PointT &point = cloud.points[indices[i]];
+    if (!pcl::isFinite(point)) continue;
+    const uint64_t key = packKey(static_cast<int64_t>(std::floor(point.x * inverse_voxel_size)),
+                                 static_cast<int64_t>(std::floor(point.y * inverse_voxel_size)),
+                                 static_cast<int64_t>(std::floor(point.z * inverse_voxel_size)));
+    auto voxel = voxel_ids_.emplace(key, static_cast<int>(voxel_keys_.size()));
+    if (voxel.second) {
+      voxel_keys_.push_back(key);
+      voxel_starts_.push_back(0);
+    }
+    point_voxels_[i] = voxel.first->second;
+    voxel_starts_[voxel.first->second]++;
+  }
+
+  const int num_voxels = static_cast<int>(voxel_keys_.size());
+  parents_.resize(num_voxels);
+  ranks_.assign(num_voxels, 0);
+  for (int v = 0; v < num_voxels; v++) parents_[v] = v;
+
+  // sort the points by voxel for the point to point checks
+  int num_voxel_points = 0;
+  for (int v = 0; v < num_voxels; v++) {
+    const int count = voxel_starts_[v];
+    voxel_starts_[v] = num_voxel_points;
+    num_voxel_points += count;
+  }
+  voxel_starts_.push_back(num_voxel_points);
+  voxel_points_.resize(num_voxel_points);
+  std::vector<int> next_points(voxel_starts_.begin(), voxel_starts_.end() - 1);
+  for (size_t i = 0; i < num_points; i++) {
+    if (point_voxels_[i] < 0) continue;
+    voxel_points_[next_points[point_voxels_[i]]++] =
+        cloud.points[indices[i]].getVector3fMap();
+  }
+
+  // neighbour voxels which may contain points within the tolerance, every pair is visited
+  // once by only looking at the neighbours which come after the voxel in lexicographic order
+  const double squared_range = tolerance_ * tolerance_ * inverse_voxel_size * inverse_voxel_size;
+  std::vector<std::pair<Eigen::Vector3i, bool>> neighbours;
+  for (int dx = 0; dx <= range; dx++) {
+    for (int dy = -range; dy <= range; dy++) {
+      for (int dz = -range; dz <= range; dz++) {
+        if (dx == 0 && (dy < 0 || (dy == 0 && dz <= 0))) continue;
+        const Eigen::Vector3i offset(dx, dy, dz);
+        const Eigen::Vector3i gap = (offset.cwiseAbs().array() - 1).max(0).matrix();
+        const Eigen::Vector3i extent = offset.cwiseAbs().array() + 1;
+        if (gap.squaredNorm() > squared_range) continue;
+        // all points of both voxels are within the tolerance
+        const bool within_tolerance = extent.squaredNorm() <= squared_range;
+        neighbours.emplace_back(offset, within_tolerance);
+      }
+    }
+  }
+
+  const float squared_tolerance = static_cast<float>(tolerance_ * tolerance_);
+  for (int v = 0; v < num_voxels; v++) {
+    const int64_t x = unpackKey(voxel_keys_[v], 2 * KEY_BITS);
+    const int64_t y = unpackKey(voxel_keys_[v], KEY_BITS);
+    const int64_t z = unpackKey(voxel_keys_[v], 0);
+    for (const auto &neighbour : neighbours) {
+      const Eigen::Vector3i &offset = neighbour.first;
+      auto n = voxel_ids_.find(packKey(x + offset[0], y + offset[1], z + offset[2]));
+      if (n == voxel_ids_.end()) continue;
+      if (neighbour.second) {
+        join(v, n->second);
+      } else if (findRoot(v) != findRoot(n->second) &&
+                 isWithinTolerance(v, n->second, squared_tolerance)) {
+        join(v, n->second);
+      }
+    }
+  }
+
+  // collect the points of every connected component
+  std::vector<int> component_ids(num_voxels, -1);
+  std::vector<pcl::PointIndices> components;
+  for (size_t i = 0; i < num_points; i++) {
+    if (point_voxels_[i] < 0) continue;
+    const int root = findRoot(point_voxels_[i]);
+    if (component_ids[root] < 0) {
+      component_ids[root] = static_cast<int>(components.size());
+      components.emplace_back();
+    }
+    components[component_ids[root]].indices.push_back(indices[i]);
+  }
+
+  for (auto &component : components) {
+    const int size = static_cast<int>(component.indices.size());
+    if (size < min_cluster_size_ || size > max_cluster_size_) continue;
+    component.header = cloud.header;
+    clusters.push_back(std::move(component));
+  }
+
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const pcl::PointIndices &a, const pcl::PointIndices &b) {
+                     return a.indices.size() > b.indices.size();
+                   });
+}
+
+int VoxelClusterExtraction::findRoot(int voxel)
+{
+  while (parents_[voxel] != voxel) {
+    // path halving
+    parents_[voxel] = parents_[parents_[voxel]];
+    voxel = parents_[voxel];
+  }
+  return voxel;
+}
+
+void VoxelClusterExtraction::join(int voxel_a, int voxel_b)
+{
+  int root_a = findRoot(voxel_a);
+  int root_b = findRoot(voxel_b);
+  if (root_a == root_b) return;
+  if (ranks_[root_a] < ranks_[root_b]) std::swap(root_a, root_b);
+  parents_[root_b] = root_a;
+  if (ranks_[root_a] == ranks_[root_b]) ranks_[root_a]++;
+}
+
+bool VoxelClusterExtraction::isWithinTolerance(int voxel_a, int voxel_b,
+                                               float squared_tolerance) const
+{
+  for (int i = voxel_starts_[voxel_a]; i < voxel_starts_[voxel_a + 1]; i++) {
+    for (int j = voxel_starts_[voxel_b]; j < voxel_starts_[voxel_b + 1]; j++) {
+      if ((voxel_points_[i] - voxel_points_[j]).squaredNorm() <= squared_tolerance) return true;
+    }
+  }
+  return false;
+}
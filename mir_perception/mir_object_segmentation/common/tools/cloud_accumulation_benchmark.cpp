@@ -0,0 +1,89 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ * Compares the occupancy octree and the voxel hash used by CloudAccumulation
+ * on recorded point clouds.
+ *
+ * Usage: cloud_accumulation_benchmark <resolution> <iterations> <cloud.pcd> [<cloud.pcd> ...]
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/octree/octree_impl.h>
+
+#include <mir_perception_utils/aliases.h>
+#include <mir_perception_utils/octree_pointcloud_occupancy_colored.h>
+#include <mir_perception_utils/voxel_hash_accumulator.h>
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(const Clock::time_point &start, const Clock::time_point &end)
+{
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " <resolution> <iterations> <cloud.pcd> [<cloud.pcd> ...]"
+              << std::endl;
+    return 1;
+  }
+
+  double resolution = std::atof(argv[1]);
+  int iterations = std::max(1, std::atoi(argv[2]));
+
+  std::vector<PointCloud::Ptr> clouds;
+  for (int i = 3; i < argc; i++) {
+    PointCloud::Ptr cloud(new PointCloud);
+    if (pcl::io::loadPCDFile<PointT>(argv[i], *cloud) == -1) {
+      std::cerr << "Could not read " << argv[i] << std::endl;
+      return 1;
+    }
+    clouds.push_back(cloud);
+  }
+
+  double octree_add_ms = 0.0, octree_get_ms = 0.0;
+  double hash_add_ms = 0.0, hash_get_ms = 0.0;
+  size_t octree_voxels = 0, hash_voxels = 0;
+
+  for (int it = 0; it < iterations; it++) {
+    PointCloud octree_cloud;
+    OctreePointCloudOccupancyColored<PointT> octree(resolution);
+    Clock::time_point start = Clock::now();
+    for (const auto &cloud : clouds) octree.setOccupiedVoxelsAtPointsFromCloud(cloud);
+    Clock::time_point added = Clock::now();
+    octree.getOccupiedVoxelCentersWithColor(octree_cloud.points);
+    Clock::time_point end = Clock::now();
+    octree_add_ms += elapsedMs(start, added);
+    octree_get_ms += elapsedMs(added, end);
+    octree_voxels = octree_cloud.points.size();
+
+    PointCloud hash_cloud;
+    mir_perception_utils::pointcloud::VoxelHashAccumulator<PointT> voxels(resolution);
+    start = Clock::now();
+    for (const auto &cloud : clouds) voxels.addCloud(*cloud);
+    added = Clock::now();
+    voxels.getVoxelCentersWithColor(hash_cloud.points);
+    end = Clock::now();
+    hash_add_ms += elapsedMs(start, added);
+    hash_get_ms += elapsedMs(added, end);
+    hash_voxels = hash_cloud.points.size();
+  }
+
+  std::cout << "clouds: " << clouds.size() << ", resolution: " << resolution
+            << ", iterations: " << iterations << std::endl;
+  std::cout << "octree  add: " << octree_add_ms / iterations
+            << " ms, extract: " << octree_get_ms / iterations << " ms, voxels: " << octree_voxels
+            << std::endl;
+  std::cout << "hash    add: " << hash_add_ms / iterations << " ms, extract: " << hash_get_ms / iterations
+            << " ms, voxels: " << hash_voxels << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ * Compares the KdTree based euclidean cluster extraction and the voxel
+ * connected components used by SceneSegmentation on table top scenes.
+ * Without clouds, a dense synthetic scene with 8x8 box shaped objects
+ * sampled at 2.5 mm (like the accumulated cloud) is used. The voxel size is
+ * the leaf size the clouds were downsampled with. The number of points which
+ * are assigned to a different cluster than by EuclideanClusterExtraction is
+ * reported as well.
+ *
+ * Usage: cluster_extraction_benchmark <tolerance> <voxel_size> <iterations> [<cloud.pcd> ...]
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/segmentation/extract_clusters.h>
+
+#include <mir_object_segmentation/voxel_cluster_extraction.h>
+#include <mir_perception_utils/aliases.h>
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(const Clock::time_point &start, const Clock::time_point &end)
+{
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+PointCloud::Ptr createTabletopScene()
+{
+  const float resolution = 0.0025f;
+  const float object_size = 0.04f;
+  const float spacing = 0.1f;
+  PointCloud::Ptr cloud(new PointCloud);
+  for (int row = 0; row < 8; row++) {
+    for (int col = 0; col < 8; col++) {
+      // objects of different heights, sampled on their surfaces
+      const float height = 0.02f + 0.01f * ((row + col) % 4);
+      for (float x = 0.0f; x <= object_size; x += resolution) {
+        for (float y = 0.0f; y <= object_size; y += resolution) {
+          for (float z = 0.0f; z <= height; z += resolution) {
+            bool on_surface = x == 0.0f || y == 0.0f || x + resolution > object_size ||
+                              y + resolution > object_size || z + resolution > height;
+            if (!on_surface) continue;
+            PointT point;
+            point.x = 0.3f + row * spacing + x;
+            point.y = -0.3f + col * spacing + y;
+            point.z = 0.01f + z;
+            point.r = point.g = point.b = 128;
+            cloud->points.push_back(point);
+          }
+        }
+      }
+    }
+  }
+  cloud->width = cloud->points.size();
+  cloud->height = 1;
+  return cloud;
+}
+
+/** Number of points which are not in the same cluster with both extractions. The clusters
+ * are matched greedily, largest first, to the cluster of the other extraction most of their
+ * points are in, points of unmatched clusters count as different as well */
+int countDifferentAssignments(size_t num_points, const std::vector<pcl::PointIndices> &reference,
+                              const std::vector<pcl::PointIndices> &clusters)
+{
+  std::vector<int> reference_ids(num_points, -1);
+  for (size_t c = 0; c < reference.size(); c++) {
+    for (int index : reference[c].indices) reference_ids[index] = c;
+  }
+
+  int same = 0;
+  std::vector<bool> matched(reference.size(), false);
+  std::vector<int> counts(reference.size());
+  for (const auto &cluster : clusters) {
+    std::fill(counts.begin(), counts.end(), 0);
+    for (int index : cluster.indices) {
+      if (reference_ids[index] >= 0) counts[reference_ids[index]]++;
+    }
+    int best = -1;
+    for (size_t c = 0; c < counts.size(); c++) {
+      if (!matched[c] && counts[c] > 0 && (best < 0 || counts[c] > counts[best])) best = c;
+    }
+    if (best < 0) continue;
+    matched[best] = true;
+    same += counts[best];
+  }
+
+  int clustered = 0;
+  for (const auto &cluster : reference) clustered += cluster.indices.size();
+  for (const auto &cluster : clusters) clustered += cluster.indices.size();
+  // points in matched clusters are counted once, all others are different
+  return clustered - 2 * same;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " <tolerance> <voxel_size> <iterations> [<cloud.pcd> ...]"
+              << std::endl;
+    return 1;
+  }
+
+  double tolerance = std::atof(argv[1]);
+  double voxel_size = std::atof(argv[2]);
+  int iterations = std::max(1, std::atoi(argv[3]));
+
+  std::vector<PointCloud::Ptr> clouds;
+  for (int i = 4; i < argc; i++) {
+    PointCloud::Ptr cloud(new PointCloud);
+    if (pcl::io::loadPCDFile<PointT>(argv[i], *cloud) == -1) {
+      std::cerr << "Could not read " << argv[i] << std::endl;
+      return 1;
+    }
+    clouds.push_back(cloud);
+  }
+  if (clouds.empty()) clouds.push_back(createTabletopScene());
+
+  VoxelClusterExtraction voxel_cluster_extraction;
+  voxel_cluster_extraction.setClusterTolerance(tolerance);
+  voxel_cluster_extraction.setVoxelSize(voxel_size);
+  voxel_cluster_extraction.setMinClusterSize(25);
+  voxel_cluster_extraction.setMaxClusterSize(20000);
+
+  pcl::EuclideanClusterExtraction<PointT> cluster_extraction;
+  cluster_extraction.setSearchMethod(boost::make_shared<pcl::search::KdTree<PointT>>());
+  cluster_extraction.setClusterTolerance(tolerance);
+  cluster_extraction.setMinClusterSize(25);
+  cluster_extraction.setMaxClusterSize(20000);
+
+  for (const auto &cloud : clouds) {
+    pcl::PointIndices::Ptr indices(new pcl::PointIndices);
+    for (size_t i = 0; i < cloud->points.size(); i++) {
+      if (pcl::isFinite(cloud->points[i])) indices->indices.push_back(i);
+    }
+
+    double kdtree_ms = 0.0, voxel_ms = 0.0;
+    std::vector<pcl::PointIndices> kdtree_clusters, voxel_clusters;
+    for (int it = 0; it < iterations; it++) {
+      Clock::time_point start = Clock::now();
+      cluster_extraction.setInputCloud(cloud);
+      cluster_extraction.setIndices(indices);
+      cluster_extraction.extract(kdtree_clusters);
+      Clock::time_point end = Clock::now();
+      kdtree_ms += elapsedMs(start, end);
+
+      start = Clock::now();
+      voxel_cluster_extraction.extract(*cloud, indices->indices, voxel_clusters);
+      end = Clock::now();
+      voxel_ms += elapsedMs(start, end);
+    }
+
+    std::cout << "points: " << indices->indices.size() << ", tolerance: " << tolerance
+              << ", voxel size: " << voxel_size << ", iterations: " << iterations << std::endl;
+    std::cout << "kdtree  " << kdtree_ms / iterations << " ms, clusters: " << kdtree_clusters.size()
+              << std::endl;
+    std::cout << "voxel   " << voxel_ms / iterations << " ms, clusters: " << voxel_clusters.size()
+              << ", different assignments: "
+              << countDifferentAssignments(cloud->points.size(), kdtree_clusters, voxel_clusters)
+              << std::endl;
+  }
+
+  return 0;
+}
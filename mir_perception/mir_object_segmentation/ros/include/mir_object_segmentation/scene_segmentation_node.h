@@ -7,6 +7,7 @@
 #ifndef MIR_OBJECT_SEGMENTATION_SCENE_SEGMENTATION_NODE_H
 #define MIR_OBJECT_SEGMENTATION_SCENE_SEGMENTATION_NODE_H
 
+#include <memory>
 #include <string>
 
 #include <geometry_msgs/PoseStamped.h>
@@ -19,6 +20,7 @@
 
 #include <mir_object_segmentation/SceneSegmentationConfig.h>
 #include <mir_object_segmentation/scene_segmentation_ros.h>
+#include <mir_perception_utils/latency_diagnostics_ros.h>
 
 /** \brief This node subscribes to pointcloud topic.
  * Inputs:
@@ -52,7 +54,10 @@ using mpu::visualization::Color;
 class SceneSegmentationNode
 {
  public:
-  SceneSegmentationNode();
+  /** \brief Constructor
+   * \param[in] Private NodeHandle of the node or nodelet
+   */
+  explicit SceneSegmentationNode(const ros::NodeHandle &nh = ros::NodeHandle("~"));
   virtual ~SceneSegmentationNode();
 
  private:
@@ -75,6 +80,8 @@ class SceneSegmentationNode
   ClusteredPointCloudVisualizer cluster_visualizer_;
   LabelVisualizer label_visualizer_;
 
+  std::unique_ptr<mpu::LatencyDiagnosticsROS> latency_diagnostics_;
+
   // Parameters
   bool add_to_octree_;
   int object_id_;
@@ -91,7 +98,7 @@ class SceneSegmentationNode
   unsigned int padded_cluster_size_;
 
  private:
-  void pointcloudCallback(const sensor_msgs::PointCloud2::Ptr &msg);
+  void pointcloudCallback(const sensor_msgs::PointCloud2::ConstPtr &msg);
   void eventCallback(const std_msgs::String::ConstPtr &msg);
   void configCallback(mir_object_segmentation::SceneSegmentationConfig &config, uint32_t level);
 
@@ -24,8 +24,10 @@
 
 #include <mir_perception_utils/bounding_box.h>
 #include <mir_perception_utils/object_utils_ros.h>
+#include <mir_perception_utils/pointcloud_resampler.h>
 
 /** \brief This class is a wrapper for table top point cloud segmentation.
+ * It does not create a node handle and can be used without a ROS master.
  *
  * \author Mohammad Wasil, Santosh Thoduka
  */
@@ -43,9 +45,6 @@ class SceneSegmentationROS
   virtual ~SceneSegmentationROS();
 
  private:
-  ros::NodeHandle nh_;
-  ros::ServiceClient recognize_service;
-
   /** Create unique pointer object of cloud_accumulation */
   CloudAccumulation::UPtr cloud_accumulation_;
   /** Create unique pointer for object scene_segmentation */
@@ -53,12 +52,16 @@ class SceneSegmentationROS
   SceneSegmentationUPtr scene_segmentation_;
 
   pcl::ModelCoefficients::Ptr model_coefficients_;
-  boost::shared_ptr<tf::TransformListener> tf_listener_;
 
   bool add_to_octree_;
   int pcl_object_id_;
   double octree_resolution_;
   double workspace_height_;
+  /** Number of threads for the per cluster work in segmentCloud */
+  int num_threads_;
+  mir_perception_utils::pointcloud::PointCloudResampler::Strategy padding_strategy_;
+  double padding_voxel_size_;
+  int padding_seed_;
 
   PointCloud::Ptr cloud_debug_;
 
@@ -72,10 +75,12 @@ class SceneSegmentationROS
    * \param[in] Pad cluster so that the cluster does not have variable point
    * size
    * \param[in] Number of padded points
+   * \param[in] Optional organized point cloud used to find the plane
    * */
   void segmentCloud(const PointCloud::ConstPtr &cloud, mas_perception_msgs::ObjectList &obj_list,
                     std::vector<PointCloud::Ptr> &clusters, std::vector<BoundingBox> &boxes,
-                    bool center_cluster, bool pad_cluster, int num_points);
+                    bool center_cluster, bool pad_cluster, int num_points,
+                    const PointCloud::ConstPtr &plane_cloud = PointCloud::ConstPtr());
 
   /** \brief Find plane
    * \param[in] Input point cloud
@@ -135,11 +140,19 @@ class SceneSegmentationROS
    * */
   void setCropBoxParams(bool enable_cropbox_filter, double min_x, double max_x, double min_y,
                         double max_y, double min_z, double max_z);
+
+  /** \brief Get the box kept by the voxel filter limits, the passthrough and the crop box filter
+   * \param[out] Box min
+   * \param[out] Box max
+   * \return false if none of the filters limits the workspace
+   * */
+  bool getWorkspaceBounds(Eigen::Vector3f &min, Eigen::Vector3f &max);
   /** \brief Set Normal param using radius
    * \param[in] Radius search
    * \param[in] Use Open MP (OMP) for parallel normal estimation using cpu
    * (default False)
-   * \param[in] Number of cores to use for computing normal with OMP (default=4)
+   * \param[in] Number of cores to use for computing normal with OMP (default=4),
+   * also used to process the clusters in segmentCloud in parallel when OMP is enabled
    * */
   void setNormalParams(double normal_radius_search, bool use_omp = false, int num_cores = 4);
 
@@ -157,6 +170,49 @@ class SceneSegmentationROS
                     bool sac_optimize_coefficients, Eigen::Vector3f axis, double sac_eps_angle,
                     double sac_normal_distance_weight);
 
+  /** \brief Set organized plane detection parameters
+   * \param[in] Use integral image normals and organized multi plane segmentation
+   * for organized point clouds
+   * \param[in] Depth change threshold for computing object borders
+   * \param[in] Normal smoothing size in pixels
+   * \param[in] The minimum number of inliers of a plane
+   * \param[in] The maximum allowed angle between the normals of neighbouring
+   * plane points in radians
+   * */
+  void setOrganizedPlaneParams(bool enable, double max_depth_change_factor,
+                               double normal_smoothing_size, int min_inliers,
+                               double angular_threshold);
+
+  /** \brief Set coarse to fine plane detection parameters,
+   * see SceneSegmentation::setCoarsePlaneParams
+   * \param[in] Enable the coarse to fine plane detection
+   * \param[in] Leaf size of the subsampled cloud of the coarse stage
+   * \param[in] Maximum distance of the points to the coarse plane which are refined
+   * */
+  void setCoarsePlaneParams(bool enable, double leaf_size, double band_width);
+
+  /** \brief Set plane cache parameters, see SceneSegmentation::setPlaneCacheParams
+   * \param[in] Enable the plane cache
+   * \param[in] Maximum translation of the base between two perceptions in meters
+   * \param[in] Maximum rotation of the base between two perceptions in radians
+   * \param[in] Number of points the cached plane is validated on
+   * \param[in] Minimum inlier ratio on the subsample, relative to the cached one
+   * */
+  void setPlaneCacheParams(bool enable, double max_translation, double max_rotation,
+                           int sample_size, double min_inlier_ratio);
+
+  /** \brief Set the workstation and the base pose of the next segmentations
+   * \param[in] Workstation name, may be empty to match by base pose only
+   * \param[in] Pose of the base in a fixed frame
+   * */
+  void setPlaneCacheContext(const std::string &key, const Eigen::Affine3f &base_pose);
+
+  /** \brief Do not use the plane cache, e.g. if the base pose is unknown */
+  void clearPlaneCacheContext();
+
+  /** \brief Get the plane cache hit and miss counters */
+  PlaneModelCacheStatistics getPlaneCacheStatistics();
+
   /** \brief Set prism parameters
    * \param[in] The minimum height above the plane from which to construct the
    * polygonal prism
@@ -165,6 +221,13 @@ class SceneSegmentationROS
    * */
   void setPrismParams(double prism_min_height, double prism_max_height);
 
+  /** \brief Set hull mask prism parameters, see SceneSegmentation::setHullMaskPrismParams
+   * \param[in] Enable the hull mask prism extraction
+   * \param[in] Size of the mask cells
+   * \param[in] Number of OMP threads classifying the points
+   * */
+  void setHullMaskPrismParams(bool enable, double resolution, int num_threads = 1);
+
   /** \brief Set outliers parameters
    * \param[in] Radius of the sphere that will determine which points are
    * neighbors.
@@ -183,11 +246,22 @@ class SceneSegmentationROS
    * \param[in] The maximum height of the cluster above the given polygon
    * \param[in] The maximum length of the cluster
    * \param[in] The minimum height of the cluster above the given polygon
+   * \param[in] Cluster with voxel connected components instead of the KdTree based
+   * euclidean cluster extraction
    * */
   void setClusterParams(double cluster_tolerance, int cluster_min_size, int cluster_max_size,
                         double cluster_min_height, double cluster_max_height,
-                        double cluster_max_length, double cluster_min_distance_to_polygon);
+                        double cluster_max_length, double cluster_min_distance_to_polygon,
+                        bool use_voxel_clustering = false);
   
+  /** \brief Set the parameters used to pad the clusters to a fixed size
+   * \param[in] Subsampling strategy for larger clusters, see PointCloudResampler::Strategy
+   * \param[in] Voxel size of the voxel stratified subsampling
+   * \param[in] Seed of the random generator, the i-th cluster uses seed + i so that the
+   * result does not depend on the thread schedule. Negative for a random seed.
+   * */
+  void setPaddingParams(int strategy, double voxel_size, int seed);
+
   /** \brief Get debug cloud**/
   PointCloud::Ptr getCloudDebug();
 
@@ -0,0 +1,18 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ *
+ * Author: Mohammad Wasil, Santosh Thoduka
+ *
+ */
+#include <ros/ros.h>
+
+#include <mir_object_segmentation/scene_segmentation_node.h>
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "scene_segmentation_node");
+  SceneSegmentationNode scene_seg;
+  ROS_INFO_STREAM("\033[1;32m[scene_segmentation_node] node started \033[0m\n");
+  ros::spin();
+  return 0;
+}
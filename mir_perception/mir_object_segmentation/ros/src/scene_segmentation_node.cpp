@@ -27,11 +27,12 @@
 
 #include <mir_object_segmentation/scene_segmentation_node.h>
 
-SceneSegmentationNode::SceneSegmentationNode()
-    : nh_("~"),
-      bounding_box_visualizer_("output/bounding_boxes", Color(Color::SEA_GREEN)),
-      cluster_visualizer_("output/tabletop_clusters"),
-      label_visualizer_("output/labels", Color(Color::TEAL)),
+SceneSegmentationNode::SceneSegmentationNode(const ros::NodeHandle &nh)
+    : nh_(nh),
+      server_(nh_),
+      bounding_box_visualizer_(&nh_, "output/bounding_boxes", Color(Color::SEA_GREEN)),
+      cluster_visualizer_(boost::make_shared<ros::NodeHandle>(nh_), "output/tabletop_clusters"),
+      label_visualizer_(nh_, "output/labels", Color(Color::TEAL)),
       add_to_octree_(false),
       object_id_(0),
       scene_segmentation_ros_(0.0025)
@@ -50,21 +51,20 @@ SceneSegmentationNode::SceneSegmentationNode()
 
   nh_.param<std::string>("logdir", logdir_, "/tmp/");
   nh_.param<std::string>("target_frame_id", target_frame_id_, "base_link");
+
+  latency_diagnostics_.reset(new mpu::LatencyDiagnosticsROS(nh_, "scene_segmentation"));
 }
 
 SceneSegmentationNode::~SceneSegmentationNode() {}
-void SceneSegmentationNode::pointcloudCallback(const sensor_msgs::PointCloud2::Ptr &msg)
+void SceneSegmentationNode::pointcloudCallback(const sensor_msgs::PointCloud2::ConstPtr &msg)
 {
   if (add_to_octree_) {
-    sensor_msgs::PointCloud2 msg_transformed;
-    if (!mpu::pointcloud::transformPointCloudMsg(tf_listener_, target_frame_id_, *msg,
-                                                 msg_transformed))
-      return;
-
     PointCloud::Ptr cloud = boost::make_shared<PointCloud>();
-    pcl::PCLPointCloud2 pc2;
-    pcl_conversions::toPCL(msg_transformed, pc2);
-    pcl::fromPCLPointCloud2(pc2, *cloud);
+    mpu::pointcloud::ConversionFilter filter;
+    filter.remove_nans = true;
+    if (!mpu::pointcloud::transformPointCloudMsg(tf_listener_, target_frame_id_, *msg, *cloud,
+                                                 filter))
+      return;
 
     scene_segmentation_ros_.addCloudAccumulation(cloud);
 
@@ -82,7 +82,10 @@ void SceneSegmentationNode::segmentPointCloud()
   scene_segmentation_ros_.getCloudAccumulation(cloud);
 
   std::vector<PointCloud::Ptr> clusters;
-  mas_perception_msgs::ObjectList object_list;
+  // Published as shared pointer, subscribers in the same nodelet manager get the object clouds
+  // without serialization
+  mas_perception_msgs::ObjectListPtr object_list_msg(new mas_perception_msgs::ObjectList);
+  mas_perception_msgs::ObjectList &object_list = *object_list_msg;
   std::vector<BoundingBox> boxes;
   scene_segmentation_ros_.segmentCloud(cloud, object_list, clusters, boxes, center_cluster_,
                                        pad_cluster_, padded_cluster_size_);
@@ -103,7 +106,7 @@ void SceneSegmentationNode::segmentPointCloud()
     poses.poses.push_back(object_list.objects[i].pose.pose);
   }
   ROS_INFO_STREAM("Publishing object list and workspace height");
-  pub_object_list_.publish(object_list);
+  pub_object_list_.publish(object_list_msg);
   bounding_box_visualizer_.publish(bounding_boxes.bounding_boxes, target_frame_id_);
   cluster_visualizer_.publish<PointT>(clusters, target_frame_id_);
   label_visualizer_.publish(labels, poses);
@@ -126,7 +129,7 @@ void SceneSegmentationNode::findPlane()
   std_msgs::Float64 workspace_height_msg;
   workspace_height_msg.data = scene_segmentation_ros_.getWorkspaceHeight();
   pub_workspace_height_.publish(workspace_height_msg);
-  pub_debug_.publish(*cloud_debug);
+  pub_debug_.publish(cloud_debug);
 }
 
 void SceneSegmentationNode::eventCallback(const std_msgs::String::ConstPtr &msg)
@@ -177,13 +180,22 @@ void SceneSegmentationNode::configCallback(mir_object_segmentation::SceneSegment
   scene_segmentation_ros_.setSACParams(config.sac_max_iterations, config.sac_distance_threshold,
                                        config.sac_optimize_coefficients, axis, config.sac_eps_angle,
                                        config.sac_normal_distance_weight);
+  scene_segmentation_ros_.setCoarsePlaneParams(config.use_coarse_plane_detection,
+                                               config.coarse_plane_leaf_size,
+                                               config.coarse_plane_band_width);
   scene_segmentation_ros_.setPrismParams(config.prism_min_height, config.prism_max_height);
+  scene_segmentation_ros_.setHullMaskPrismParams(config.use_hull_mask_prism,
+                                                 config.hull_mask_resolution,
+                                                 config.hull_mask_num_threads);
   scene_segmentation_ros_.setOutlierParams(config.outlier_radius_search,
                                            config.outlier_min_neighbors);
   scene_segmentation_ros_.setClusterParams(config.cluster_tolerance, config.cluster_min_size,
                                            config.cluster_max_size, config.cluster_min_height,
                                            config.cluster_max_height, config.cluster_max_length,
-                                           config.cluster_min_distance_to_polygon);
+                                           config.cluster_min_distance_to_polygon,
+                                           config.use_voxel_clustering);
+  scene_segmentation_ros_.setPaddingParams(config.padding_strategy, config.padding_voxel_size,
+                                           config.padding_seed);
 
   center_cluster_ = config.center_cluster;
   pad_cluster_ = config.pad_cluster;
@@ -192,12 +204,3 @@ void SceneSegmentationNode::configCallback(mir_object_segmentation::SceneSegment
   octree_resolution_ = config.octree_resolution;
   object_height_above_workspace_ = config.object_height_above_workspace;
 }
-
-int main(int argc, char **argv)
-{
-  ros::init(argc, argv, "scene_segmentation_node");
-  SceneSegmentationNode scene_seg;
-  ROS_INFO_STREAM("\033[1;32m[scene_segmentation_node] node started \033[0m\n");
-  ros::spin();
-  return 0;
-}
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <memory>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <mir_object_segmentation/scene_segmentation_node.h>
+
+namespace mir_object_segmentation
+{
+/** \brief Runs the scene segmentation in a nodelet manager, the input pointcloud is then
+ * received from a camera driver nodelet without serialization. Parameters and topics are the
+ * same as for the scene_segmentation_node.
+ */
+class SceneSegmentationNodelet : public nodelet::Nodelet
+{
+ private:
+  void onInit() override
+  {
+    scene_segmentation_.reset(new SceneSegmentationNode(getPrivateNodeHandle()));
+    NODELET_INFO("[scene_segmentation] nodelet started");
+  }
+
+  std::unique_ptr<SceneSegmentationNode> scene_segmentation_;
+};
+
+}  // namespace mir_object_segmentation
+
+PLUGINLIB_EXPORT_CLASS(mir_object_segmentation::SceneSegmentationNodelet, nodelet::Nodelet)
@@ -4,24 +4,30 @@
  * Author: Mohammad Wasil, Santosh Thoduka
  *
  */
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
-#include <pcl/PCLPointCloud2.h>
+#include <pcl/common/centroid.h>
 #include <pcl/point_types.h>
-#include <pcl_conversions/pcl_conversions.h>
 #include <pcl_ros/point_cloud.h>
 
 #include <mir_object_segmentation/scene_segmentation_ros.h>
 #include <mir_perception_utils/impl/helpers.hpp>
 
 #include <mir_perception_utils/object_utils_ros.h>
+#include <mir_perception_utils/pointcloud_msg_writer.h>
 #include <mir_perception_utils/pointcloud_utils.h>
 
 namespace mpu = mir_perception_utils;
 
 SceneSegmentationROS::SceneSegmentationROS(double octree_resolution)
-    : octree_resolution_(octree_resolution), pcl_object_id_(0)
+    : octree_resolution_(octree_resolution),
+      pcl_object_id_(0),
+      num_threads_(1),
+      padding_strategy_(mpu::pointcloud::PointCloudResampler::RANDOM),
+      padding_voxel_size_(0.01),
+      padding_seed_(-1)
 {
   cloud_accumulation_ = CloudAccumulation::UPtr(new CloudAccumulation(octree_resolution_));
   scene_segmentation_ = SceneSegmentationUPtr(new SceneSegmentation());
@@ -34,43 +40,50 @@ void SceneSegmentationROS::segmentCloud(const PointCloud::ConstPtr &cloud,
                                         mas_perception_msgs::ObjectList &object_list,
                                         std::vector<PointCloud::Ptr> &clusters,
                                         std::vector<BoundingBox> &boxes, bool center_cluster,
-                                        bool pad_cluster, int num_points)
+                                        bool pad_cluster, int num_points,
+                                        const PointCloud::ConstPtr &plane_cloud)
 {
   std::string frame_id = cloud->header.frame_id;
-  cloud_debug_ = scene_segmentation_->segmentScene(cloud, clusters, boxes,
-                                                   model_coefficients_, workspace_height_);
+  cloud_debug_ = scene_segmentation_->segmentScene(cloud, clusters, boxes, model_coefficients_,
+                                                   workspace_height_, plane_cloud);
   cloud_debug_->header.frame_id = frame_id;
 
-  object_list.objects.resize(boxes.size());
+  // Every cluster only writes its own preallocated message, so the clusters
+  // can be processed in parallel while the order and ids stay the same.
+  const int num_clusters = static_cast<int>(clusters.size());
+  object_list.objects.resize(num_clusters);
+  const int first_object_id = pcl_object_id_;
+  pcl_object_id_ += num_clusters;
   ros::Time now = ros::Time::now();
-  for (int i = 0; i < clusters.size(); i++) {
-    sensor_msgs::PointCloud2 ros_cloud;
-    ros_cloud.header.frame_id = frame_id;
+#pragma omp parallel for num_threads(num_threads_) schedule(dynamic) if (num_threads_ > 1)
+  for (int i = 0; i < num_clusters; i++) {
+    mas_perception_msgs::Object &object = object_list.objects[i];
+    object.views.resize(1);
+    sensor_msgs::PointCloud2 &ros_cloud = object.views[0].point_cloud;
     if (pad_cluster) {
-      mpu::pointcloud::padPointCloud(clusters[i], num_points);
+      const int seed = padding_seed_ < 0 ? -1 : padding_seed_ + i;
+      mpu::pointcloud::padPointCloud(clusters[i], num_points, padding_strategy_,
+                                     padding_voxel_size_, seed);
     }
-    if (center_cluster) {
-      PointCloud::Ptr centered_cluster(new PointCloud);
-      mpu::pointcloud::centerPointCloud(*clusters[i], *centered_cluster);
-      pcl::toROSMsg(*centered_cluster, ros_cloud);
-    } else {
-      pcl::toROSMsg(*clusters[i], ros_cloud);
+    // the cluster is centered while it is written, without a centered copy
+    Eigen::Vector4f centroid = Eigen::Vector4f::Zero();
+    if (center_cluster && !clusters[i]->empty()) {
+      pcl::compute3DCentroid(*clusters[i], centroid);
     }
+    mpu::pointcloud::toPointCloud2Msg(*clusters[i], ros_cloud, centroid.head<3>());
+    ros_cloud.header.frame_id = frame_id;
 
     // Assign unknown name for every object by default then recognize it later
-    object_list.objects[i].views.resize(1);
-    object_list.objects[i].views[0].point_cloud = ros_cloud;
-    object_list.objects[i].name = "unknown";
-    object_list.objects[i].probability = 0.0;
+    object.name = "unknown";
+    object.probability = 0.0;
 
     geometry_msgs::PoseStamped pose;
     mpu::object::estimatePose(boxes[i], pose);
     pose.header.stamp = now;
     pose.header.frame_id = frame_id;
 
-    object_list.objects[i].pose = pose;
-    object_list.objects[i].database_id = pcl_object_id_;
-    pcl_object_id_++;
+    object.pose = pose;
+    object.database_id = first_object_id + i;
   }
 }
 
@@ -129,9 +142,15 @@ void SceneSegmentationROS::setCropBoxParams(bool enable_cropbox_filter, double m
   scene_segmentation_->setCropBoxParams(enable_cropbox_filter, min_x, max_x, min_y, max_y, min_z, max_z);
 }
 
+bool SceneSegmentationROS::getWorkspaceBounds(Eigen::Vector3f &min, Eigen::Vector3f &max)
+{
+  return scene_segmentation_->getWorkspaceBounds(min, max);
+}
+
 void SceneSegmentationROS::setNormalParams(double normal_radius_search, bool use_omp, int num_cores)
 {
   scene_segmentation_->setNormalParams(normal_radius_search, use_omp, num_cores);
+  num_threads_ = use_omp ? std::max(1, num_cores) : 1;
 }
 
 void SceneSegmentationROS::setSACParams(int sac_max_iterations, double sac_distance_threshold,
@@ -143,11 +162,54 @@ void SceneSegmentationROS::setSACParams(int sac_max_iterations, double sac_dista
                                     sac_normal_distance_weight);
 }
 
+void SceneSegmentationROS::setOrganizedPlaneParams(bool enable, double max_depth_change_factor,
+                                                   double normal_smoothing_size, int min_inliers,
+                                                   double angular_threshold)
+{
+  scene_segmentation_->setOrganizedPlaneParams(enable, max_depth_change_factor,
+                                               normal_smoothing_size, min_inliers,
+                                               angular_threshold);
+}
+
+void SceneSegmentationROS::setCoarsePlaneParams(bool enable, double leaf_size, double band_width)
+{
+  scene_segmentation_->setCoarsePlaneParams(enable, leaf_size, band_width);
+}
+
+void SceneSegmentationROS::setPlaneCacheParams(bool enable, double max_translation,
+                                               double max_rotation, int sample_size,
+                                               double min_inlier_ratio)
+{
+  scene_segmentation_->setPlaneCacheParams(enable, max_translation, max_rotation, sample_size,
+                                           min_inlier_ratio);
+}
+
+void SceneSegmentationROS::setPlaneCacheContext(const std::string &key,
+                                                const Eigen::Affine3f &base_pose)
+{
+  scene_segmentation_->setPlaneCacheContext(key, base_pose);
+}
+
+void SceneSegmentationROS::clearPlaneCacheContext()
+{
+  scene_segmentation_->clearPlaneCacheContext();
+}
+
+PlaneModelCacheStatistics SceneSegmentationROS::getPlaneCacheStatistics()
+{
+  return scene_segmentation_->getPlaneCacheStatistics();
+}
+
 void SceneSegmentationROS::setPrismParams(double prism_min_height, double prism_max_height)
 {
   scene_segmentation_->setPrismParams(prism_min_height, prism_max_height);
 }
 
+void SceneSegmentationROS::setHullMaskPrismParams(bool enable, double resolution, int num_threads)
+{
+  scene_segmentation_->setHullMaskPrismParams(enable, resolution, num_threads);
+}
+
 void SceneSegmentationROS::setOutlierParams(double outlier_radius_search,
                                             double outlier_min_neighbors)
 {
@@ -157,11 +219,19 @@ void SceneSegmentationROS::setOutlierParams(double outlier_radius_search,
 void SceneSegmentationROS::setClusterParams(double cluster_tolerance, int cluster_min_size,
                                             int cluster_max_size, double cluster_min_height,
                                             double cluster_max_height, double cluster_max_length,
-                                            double cluster_min_distance_to_polygon)
+                                            double cluster_min_distance_to_polygon,
+                                            bool use_voxel_clustering)
 {
   scene_segmentation_->setClusterParams(cluster_tolerance, cluster_min_size, cluster_max_size,
                                         cluster_min_height, cluster_max_height, cluster_max_length,
-                                        cluster_min_distance_to_polygon);
+                                        cluster_min_distance_to_polygon, use_voxel_clustering);
+}
+
+void SceneSegmentationROS::setPaddingParams(int strategy, double voxel_size, int seed)
+{
+  padding_strategy_ = static_cast<mpu::pointcloud::PointCloudResampler::Strategy>(strategy);
+  padding_voxel_size_ = voxel_size;
+  padding_seed_ = seed;
 }
 
 PointCloud::Ptr SceneSegmentationROS::getCloudDebug()
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_BENCHMARKS_BENCHMARK_DATA_H
+#define MIR_PERCEPTION_BENCHMARKS_BENCHMARK_DATA_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <sensor_msgs/LaserScan.h>
+
+#include <mir_perception_utils/aliases.h>
+
+namespace mir_perception_benchmarks
+{
+/** \brief A recorded or generated input of a benchmark */
+template <typename T>
+struct Sample
+{
+  /** File name without extension, <dataset>_<frame index>, or "synthetic" */
+  std::string name;
+  T data;
+};
+
+/** \brief Inputs of the perception benchmarks.
+ *
+ * The recordings are read from a directory with the layout
+ * \code
+ * scene/*.pcd         workstation clouds in the base_link frame (z up)
+ * ppt/*.pcd           organized clouds of the precision placement table
+ * cavity/*.{png,jpg}  depth rgb images of the precision placement table
+ * scan/*.txt          laser scans, "angle_min angle_increment" followed by the ranges
+ * dataset/*/          datasets of the data collection (see mir_perception_utils::DatasetReader),
+ *                     frames with a pointcloud are scene clouds, frames with only an image cavity images
+ * \endcode
+ * Kinds without recordings are replaced by one generated sample, so that all
+ * benchmarks run without any data.
+ */
+class BenchmarkData
+{
+ public:
+  /** \brief Load the recordings
+   * \param[in] Data directory, may be empty
+   * \return false if a recording could not be read
+   * */
+  bool load(const std::string &directory);
+
+  std::vector<Sample<PointCloud::Ptr>> scene_clouds;
+  std::vector<Sample<PointCloud::Ptr>> ppt_clouds;
+  std::vector<Sample<cv::Mat>> cavity_images;
+  std::vector<Sample<sensor_msgs::LaserScan::Ptr>> laser_scans;
+
+  /** \brief Table with a few objects on it */
+  static PointCloud::Ptr generateSceneCloud();
+  /** \brief Organized camera cloud of a tilted table with rectangular cavities */
+  static PointCloud::Ptr generatePPTCloud();
+  /** \brief Depth rgb image with dark cavity shapes on a bright table */
+  static cv::Mat generateCavityImage();
+  /** \brief Laser scan of walls with a few objects in front of them */
+  static sensor_msgs::LaserScan::Ptr generateLaserScan();
+};
+
+}  // namespace mir_perception_benchmarks
+
+#endif  // MIR_PERCEPTION_BENCHMARKS_BENCHMARK_DATA_H
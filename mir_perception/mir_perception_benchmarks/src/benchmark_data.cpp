@@ -0,0 +1,276 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include <boost/filesystem.hpp>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <pcl/io/pcd_io.h>
+
+#include <mir_perception_utils/perception_dataset.h>
+
+#include <mir_perception_benchmarks/benchmark_data.h>
+
+using namespace mir_perception_benchmarks;
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+/** \brief Sorted paths of the files with one of the extensions in the directory */
+std::vector<fs::path> listFiles(const fs::path &directory, const std::vector<std::string> &extensions)
+{
+  std::vector<fs::path> files;
+  if (!fs::is_directory(directory)) return files;
+  for (fs::directory_iterator it(directory); it != fs::directory_iterator(); ++it) {
+    if (!fs::is_regular_file(it->status())) continue;
+    const std::string extension = it->path().extension().string();
+    if (std::find(extensions.begin(), extensions.end(), extension) != extensions.end())
+      files.push_back(it->path());
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+/** \brief Sorted paths of the sub directories */
+std::vector<fs::path> listDirectories(const fs::path &directory)
+{
+  std::vector<fs::path> directories;
+  if (!fs::is_directory(directory)) return directories;
+  for (fs::directory_iterator it(directory); it != fs::directory_iterator(); ++it) {
+    if (fs::is_directory(it->status())) directories.push_back(it->path());
+  }
+  std::sort(directories.begin(), directories.end());
+  return directories;
+}
+
+bool loadCloud(const fs::path &file, std::vector<Sample<PointCloud::Ptr>> &samples)
+{
+  Sample<PointCloud::Ptr> sample;
+  sample.name = file.stem().string();
+  sample.data.reset(new PointCloud);
+  if (pcl::io::loadPCDFile<PointT>(file.string(), *sample.data) == -1) {
+    std::cerr << "Could not read " << file.string() << std::endl;
+    return false;
+  }
+  samples.push_back(sample);
+  return true;
+}
+
+bool loadImage(const fs::path &file, std::vector<Sample<cv::Mat>> &samples)
+{
+  Sample<cv::Mat> sample;
+  sample.name = file.stem().string();
+  sample.data = cv::imread(file.string(), cv::IMREAD_COLOR);
+  if (sample.data.empty()) {
+    std::cerr << "Could not read " << file.string() << std::endl;
+    return false;
+  }
+  samples.push_back(sample);
+  return true;
+}
+
+bool loadLaserScan(const fs::path &file, std::vector<Sample<sensor_msgs::LaserScan::Ptr>> &samples)
+{
+  std::ifstream stream(file.string());
+  Sample<sensor_msgs::LaserScan::Ptr> sample;
+  sample.name = file.stem().string();
+  sample.data.reset(new sensor_msgs::LaserScan);
+  sensor_msgs::LaserScan &scan = *sample.data;
+  if (!(stream >> scan.angle_min >> scan.angle_increment) || scan.angle_increment <= 0.0) {
+    std::cerr << "Could not read " << file.string() << std::endl;
+    return false;
+  }
+  float range;
+  while (stream >> range) scan.ranges.push_back(range);
+  if (scan.ranges.size() < 2) {
+    std::cerr << "Not enough ranges in " << file.string() << std::endl;
+    return false;
+  }
+  scan.angle_max = scan.angle_min + scan.angle_increment * (scan.ranges.size() - 1);
+  scan.range_min = 0.0;
+  scan.range_max = std::numeric_limits<float>::max();
+  samples.push_back(sample);
+  return true;
+}
+
+/** \brief Frames with a pointcloud are scene clouds, frames with only an image
+ * (cavity finder) are cavity images */
+bool loadDataset(const fs::path &directory, std::vector<Sample<PointCloud::Ptr>> &clouds,
+                 std::vector<Sample<cv::Mat>> &images)
+{
+  mir_perception_utils::DatasetReader reader;
+  if (!reader.open(directory.string())) {
+    std::cerr << "Could not read dataset " << directory.string() << std::endl;
+    return false;
+  }
+  mir_perception_utils::DatasetFrame frame;
+  for (size_t i = 0; i < reader.getFrameCount(); i++) {
+    if (!reader.readFrame(i, frame, true, false)) {
+      std::cerr << "Could not read frame " << i << " of " << directory.string() << std::endl;
+      return false;
+    }
+    const std::string name = directory.filename().string() + "_" + std::to_string(i);
+    if (frame.cloud) {
+      clouds.push_back({name, PointCloud::Ptr(new PointCloud(*frame.cloud))});
+    } else if (!frame.image.empty()) {
+      images.push_back({name, frame.image});
+    }
+  }
+  return true;
+}
+
+PointT makePoint(float x, float y, float z, uint8_t r, uint8_t g, uint8_t b)
+{
+  PointT point;
+  point.x = x;
+  point.y = y;
+  point.z = z;
+  point.r = r;
+  point.g = g;
+  point.b = b;
+  return point;
+}
+}  // namespace
+
+bool BenchmarkData::load(const std::string &directory)
+{
+  bool success = true;
+  if (!directory.empty()) {
+    const fs::path root(directory);
+    if (!fs::is_directory(root)) {
+      std::cerr << "Data directory " << directory << " does not exist" << std::endl;
+      return false;
+    }
+    for (const fs::path &file : listFiles(root / "scene", {".pcd"}))
+      success &= loadCloud(file, scene_clouds);
+    for (const fs::path &file : listFiles(root / "ppt", {".pcd"}))
+      success &= loadCloud(file, ppt_clouds);
+    for (const fs::path &file : listFiles(root / "cavity", {".png", ".jpg"}))
+      success &= loadImage(file, cavity_images);
+    for (const fs::path &file : listFiles(root / "scan", {".txt"}))
+      success &= loadLaserScan(file, laser_scans);
+    for (const fs::path &dataset : listDirectories(root / "dataset"))
+      success &= loadDataset(dataset, scene_clouds, cavity_images);
+  }
+
+  if (scene_clouds.empty()) scene_clouds.push_back({"synthetic", generateSceneCloud()});
+  if (ppt_clouds.empty()) ppt_clouds.push_back({"synthetic", generatePPTCloud()});
+  if (cavity_images.empty()) cavity_images.push_back({"synthetic", generateCavityImage()});
+  if (laser_scans.empty()) laser_scans.push_back({"synthetic", generateLaserScan()});
+  return success;
+}
+
+PointCloud::Ptr BenchmarkData::generateSceneCloud()
+{
+  std::mt19937 generator(42);
+  std::normal_distribution<float> noise(0.0f, 0.001f);
+  PointCloud::Ptr cloud(new PointCloud);
+
+  // table in front of the robot
+  const float table_height = 0.05f;
+  for (float x = 0.2f; x < 0.8f; x += 0.004f) {
+    for (float y = -0.3f; y < 0.3f; y += 0.004f) {
+      cloud->points.push_back(makePoint(x, y, table_height + noise(generator), 150, 150, 150));
+    }
+  }
+
+  // boxes on the table, top and sides facing the camera
+  const float boxes[4][3] = {
+      {0.35f, -0.15f, 0.04f}, {0.45f, 0.1f, 0.03f}, {0.6f, -0.05f, 0.05f}, {0.65f, 0.2f, 0.025f}};
+  for (const auto &box : boxes) {
+    const float size = 0.04f;
+    const float height = box[2];
+    for (float u = -size / 2; u <= size / 2; u += 0.002f) {
+      for (float v = -size / 2; v <= size / 2; v += 0.002f) {
+        cloud->points.push_back(makePoint(box[0] + u, box[1] + v,
+                                          table_height + height + noise(generator), 200, 30, 30));
+      }
+      for (float h = 0.0f; h <= height; h += 0.002f) {
+        cloud->points.push_back(makePoint(box[0] - size / 2 + noise(generator), box[1] + u,
+                                          table_height + h, 200, 30, 30));
+      }
+    }
+  }
+  cloud->width = cloud->points.size();
+  cloud->height = 1;
+  cloud->is_dense = true;
+  return cloud;
+}
+
+PointCloud::Ptr BenchmarkData::generatePPTCloud()
+{
+  std::mt19937 generator(42);
+  std::normal_distribution<float> noise(0.0f, 0.0005f);
+  const int width = 640, height = 480;
+  const float fx = 615.8f, fy = 615.6f, cx = 320.0f, cy = 245.1f;
+
+  PointCloud::Ptr cloud(new PointCloud(width, height));
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      const float x_bar = (col - cx) / fx;
+      const float y_bar = (row - cy) / fy;
+      // slightly tilted table in front of the camera
+      float depth = 0.45f + 0.05f * y_bar;
+      // 3 x 2 grid of rectangular cavities, 2cm deep
+      const int cell_col = col / 160, cell_row = row / 160;
+      const int local_col = col % 160, local_row = row % 160;
+      const bool inside_table = col >= 80 && col < 560 && row >= 80 && row < 400;
+      if (inside_table && cell_col >= 1 && cell_col <= 3 && cell_row >= 0 && cell_row <= 2 &&
+          local_col > 50 && local_col < 50 + 20 * cell_col && local_row > 60 && local_row < 100) {
+        depth += 0.02f;
+      }
+      if (!inside_table) depth = 0.6f;
+      depth += noise(generator);
+      cloud->at(col, row) =
+          makePoint(x_bar * depth, y_bar * depth, depth, inside_table ? 220 : 60, 220, 220);
+    }
+  }
+  cloud->is_dense = true;
+  return cloud;
+}
+
+cv::Mat BenchmarkData::generateCavityImage()
+{
+  cv::Mat image(480, 640, CV_8UC3, cv::Scalar(200, 200, 200));
+  cv::rectangle(image, cv::Point(100, 120), cv::Point(160, 150), cv::Scalar(20, 20, 20), -1);
+  cv::rectangle(image, cv::Point(250, 110), cv::Point(290, 190), cv::Scalar(20, 20, 20), -1);
+  cv::circle(image, cv::Point(420, 150), 25, cv::Scalar(20, 20, 20), -1);
+  cv::circle(image, cv::Point(150, 330), 15, cv::Scalar(20, 20, 20), -1);
+  const std::vector<cv::Point> triangle = {cv::Point(300, 300), cv::Point(360, 300),
+                                           cv::Point(330, 350)};
+  cv::fillConvexPoly(image, triangle, cv::Scalar(20, 20, 20));
+  cv::rectangle(image, cv::Point(450, 300), cv::Point(530, 320), cv::Scalar(20, 20, 20), -1);
+  return image;
+}
+
+sensor_msgs::LaserScan::Ptr BenchmarkData::generateLaserScan()
+{
+  std::mt19937 generator(42);
+  std::normal_distribution<float> noise(0.0f, 0.01f);
+  sensor_msgs::LaserScan::Ptr scan(new sensor_msgs::LaserScan);
+  const int num_ranges = 541;
+  scan->angle_min = -2.35619f;
+  scan->angle_increment = 2.0f * 2.35619f / (num_ranges - 1);
+  scan->angle_max = scan->angle_min + scan->angle_increment * (num_ranges - 1);
+  scan->range_min = 0.02f;
+  scan->range_max = 30.0f;
+  scan->ranges.resize(num_ranges);
+  for (int i = 0; i < num_ranges; i++) {
+    const float angle = scan->angle_min + i * scan->angle_increment;
+    // rectangular room, 2m to the front and the sides
+    float range = 2.0f / std::max(std::fabs(std::cos(angle)), std::fabs(std::sin(angle)));
+    // legs and boxes in front of the walls
+    if ((i / 15) % 6 == 0) range = 0.6f + 0.1f * ((i / 90) % 3);
+    scan->ranges[i] = range + noise(generator);
+  }
+  return scan;
+}
@@ -0,0 +1,403 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ * Micro benchmarks of the perception pipelines on recorded clouds, images
+ * and laser scans. Runs without a ROS master, only ros::Time is initialized.
+ *
+ * Usage: mir_perception_benchmarks [--data_dir=<directory>] [benchmark options]
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <pcl/segmentation/extract_polygonal_prism_data.h>
+#include <ros/time.h>
+
+#include <mir_cavity_detector/cavity_finder.h>
+#include <mir_empty_space_detection/empty_space_finder.h>
+#include <mir_object_segmentation/cloud_accumulation.h>
+#include <mir_object_segmentation/hull_prism_extraction.h>
+#include <mir_object_segmentation/laserscan_segmentation.h>
+#include <mir_object_segmentation/scene_segmentation.h>
+#include <mir_perception_benchmarks/benchmark_data.h>
+#include <mir_perception_utils/bounding_box.h>
+#include <mir_ppt_detection/ppt_cavity_detector.h>
+
+using namespace mir_perception_benchmarks;
+
+namespace
+{
+/** \brief Parameters of scene_segmentation_constraints.yaml */
+void configureSceneSegmentation(SceneSegmentation &scene_segmentation)
+{
+  scene_segmentation.setVoxelGridParams(0.009, "z", -0.15, 0.3);
+  scene_segmentation.setNormalParams(0.03, false, 1);
+  scene_segmentation.setSACParams(1000, 0.01, true, Eigen::Vector3f::UnitZ(), 0.09, 0.05);
+  scene_segmentation.setPrismParams(0.01, 0.1);
+  scene_segmentation.setOutlierParams(0.03, 20);
+  scene_segmentation.setClusterParams(0.02, 25, 20000, 0.011, 0.09, 0.25, 0.04);
+}
+
+void setPointsProcessed(benchmark::State &state, size_t num_points)
+{
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(num_points));
+}
+
+void BM_CloudAccumulation(benchmark::State &state, const std::vector<Sample<PointCloud::Ptr>> &clouds)
+{
+  size_t num_points = 0;
+  for (const auto &cloud : clouds) num_points += cloud.data->points.size();
+  PointCloud accumulated_cloud;
+  for (auto _ : state) {
+    CloudAccumulation cloud_accumulation(0.0025);
+    for (const auto &cloud : clouds) cloud_accumulation.addCloud(cloud.data);
+    cloud_accumulation.getAccumulatedCloud(accumulated_cloud);
+    benchmark::DoNotOptimize(accumulated_cloud.points.data());
+  }
+  setPointsProcessed(state, num_points);
+  state.counters["voxels"] = accumulated_cloud.points.size();
+}
+
+void BM_FindPlane(benchmark::State &state, PointCloud::Ptr cloud)
+{
+  SceneSegmentation scene_segmentation;
+  configureSceneSegmentation(scene_segmentation);
+  PointCloud::Ptr hull(new PointCloud);
+  PointCloud::Ptr plane(new PointCloud);
+  pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
+  double workspace_height = 0.0;
+  for (auto _ : state) {
+    PointCloud::Ptr debug =
+        scene_segmentation.findPlane(cloud, hull, plane, coefficients, workspace_height);
+    benchmark::DoNotOptimize(debug.get());
+  }
+  setPointsProcessed(state, cloud->points.size());
+  state.counters["plane_points"] = plane->points.size();
+}
+
+void BM_FindPlaneCoarseToFine(benchmark::State &state, PointCloud::Ptr cloud)
+{
+  SceneSegmentation scene_segmentation;
+  configureSceneSegmentation(scene_segmentation);
+  PointCloud::Ptr hull(new PointCloud);
+  PointCloud::Ptr plane(new PointCloud);
+  pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
+  double workspace_height = 0.0;
+  // plane of the full normal estimation, to report how much the planes differ
+  scene_segmentation.findPlane(cloud, hull, plane, coefficients, workspace_height);
+  const pcl::ModelCoefficients full_coefficients = *coefficients;
+  const double full_workspace_height = workspace_height;
+
+  scene_segmentation.setCoarsePlaneParams(true, 0.03, 0.02);
+  for (auto _ : state) {
+    PointCloud::Ptr debug =
+        scene_segmentation.findPlane(cloud, hull, plane, coefficients, workspace_height);
+    benchmark::DoNotOptimize(debug.get());
+  }
+  setPointsProcessed(state, cloud->points.size());
+  state.counters["plane_points"] = plane->points.size();
+  if (full_coefficients.values.size() == 4 && coefficients->values.size() == 4) {
+    const Eigen::Vector3f full_normal(full_coefficients.values[0], full_coefficients.values[1],
+                                      full_coefficients.values[2]);
+    const Eigen::Vector3f normal(coefficients->values[0], coefficients->values[1],
+                                 coefficients->values[2]);
+    const float cos_angle = std::abs(full_normal.normalized().dot(normal.normalized()));
+    state.counters["angle_to_full"] = std::acos(std::min(1.0f, cos_angle));
+    state.counters["height_to_full"] = std::abs(workspace_height - full_workspace_height);
+  }
+}
+
+void BM_SegmentScene(benchmark::State &state, PointCloud::Ptr cloud)
+{
+  SceneSegmentation scene_segmentation;
+  configureSceneSegmentation(scene_segmentation);
+  std::vector<PointCloud::Ptr> clusters;
+  std::vector<BoundingBox> boxes;
+  pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
+  double workspace_height = 0.0;
+  for (auto _ : state) {
+    clusters.clear();
+    boxes.clear();
+    PointCloud::Ptr debug =
+        scene_segmentation.segmentScene(cloud, clusters, boxes, coefficients, workspace_height);
+    benchmark::DoNotOptimize(debug.get());
+  }
+  setPointsProcessed(state, cloud->points.size());
+  state.counters["clusters"] = clusters.size();
+}
+
+/** \brief Hull of the plane of findPlane, false if there is no plane */
+bool findHull(const PointCloud::Ptr &cloud, PointCloud::Ptr &hull)
+{
+  SceneSegmentation scene_segmentation;
+  configureSceneSegmentation(scene_segmentation);
+  PointCloud::Ptr plane(new PointCloud);
+  pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
+  double workspace_height = 0.0;
+  scene_segmentation.findPlane(cloud, hull, plane, coefficients, workspace_height);
+  return coefficients->values.size() == 4 && hull->points.size() >= 3;
+}
+
+void BM_ExtractPolygonalPrism(benchmark::State &state, PointCloud::Ptr cloud)
+{
+  PointCloud::Ptr hull(new PointCloud);
+  if (!findHull(cloud, hull)) {
+    state.SkipWithError("No plane found");
+    return;
+  }
+  pcl::ExtractPolygonalPrismData<PointT> extract_polygonal_prism;
+  extract_polygonal_prism.setHeightLimits(0.01, 0.1);
+  extract_polygonal_prism.setViewPoint(0.0, 0.0, 2.0);
+  extract_polygonal_prism.setInputPlanarHull(hull);
+  extract_polygonal_prism.setInputCloud(cloud);
+  pcl::PointIndices inliers;
+  for (auto _ : state) {
+    extract_polygonal_prism.segment(inliers);
+    benchmark::DoNotOptimize(inliers.indices.data());
+  }
+  setPointsProcessed(state, cloud->points.size());
+  state.counters["inliers"] = inliers.indices.size();
+}
+
+void BM_HullPrismExtraction(benchmark::State &state, PointCloud::Ptr cloud)
+{
+  PointCloud::Ptr hull(new PointCloud);
+  if (!findHull(cloud, hull)) {
+    state.SkipWithError("No plane found");
+    return;
+  }
+  // indices of ExtractPolygonalPrismData, to report how many points are classified differently
+  pcl::ExtractPolygonalPrismData<PointT> extract_polygonal_prism;
+  extract_polygonal_prism.setHeightLimits(0.01, 0.1);
+  extract_polygonal_prism.setViewPoint(0.0, 0.0, 2.0);
+  extract_polygonal_prism.setInputPlanarHull(hull);
+  extract_polygonal_prism.setInputCloud(cloud);
+  pcl::PointIndices prism_inliers;
+  extract_polygonal_prism.segment(prism_inliers);
+
+  HullPrismExtraction hull_prism_extraction;
+  hull_prism_extraction.setHeightLimits(0.01, 0.1);
+  hull_prism_extraction.setViewPoint(0.0, 0.0, 2.0);
+  hull_prism_extraction.setResolution(0.009);
+  pcl::PointIndices inliers;
+  for (auto _ : state) {
+    hull_prism_extraction.segment(*cloud, *hull, inliers);
+    benchmark::DoNotOptimize(inliers.indices.data());
+  }
+  setPointsProcessed(state, cloud->points.size());
+  state.counters["inliers"] = inliers.indices.size();
+  std::vector<int> mismatches;
+  std::set_symmetric_difference(prism_inliers.indices.begin(), prism_inliers.indices.end(),
+                                inliers.indices.begin(), inliers.indices.end(),
+                                std::back_inserter(mismatches));
+  state.counters["mismatches"] = mismatches.size();
+}
+
+void BM_BoundingBoxCreate(benchmark::State &state, PointCloud::Ptr cloud)
+{
+  SceneSegmentation scene_segmentation;
+  configureSceneSegmentation(scene_segmentation);
+  std::vector<PointCloud::Ptr> clusters;
+  std::vector<BoundingBox> boxes;
+  pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
+  double workspace_height = 0.0;
+  scene_segmentation.segmentScene(cloud, clusters, boxes, coefficients, workspace_height);
+  if (clusters.empty() || coefficients->values.size() < 3) {
+    state.SkipWithError("No clusters found");
+    return;
+  }
+  const Eigen::Vector3f normal(coefficients->values[0], coefficients->values[1],
+                               coefficients->values[2]);
+
+  size_t num_points = 0;
+  for (const auto &cluster : clusters) num_points += cluster->points.size();
+  for (auto _ : state) {
+    boxes.clear();
+    BoundingBox::create(clusters, normal, boxes);
+    benchmark::DoNotOptimize(boxes.data());
+  }
+  setPointsProcessed(state, num_points);
+  state.counters["clusters"] = clusters.size();
+}
+
+void BM_PPTDetectCavities(benchmark::State &state, PointCloud::Ptr cloud)
+{
+  PPTCavityDetector detector;
+  mir_ppt_detection::Cavities cavities;
+  PointCloudRGBA::Ptr non_planar_cloud(new PointCloudRGBA);
+  PointCloudRGBA::Ptr planar_cloud(new PointCloudRGBA);
+  PointCloudRGBA::Ptr cavity_cloud(new PointCloudRGBA);
+  for (auto _ : state) {
+    cavities.cavities.clear();
+    detector.detectCavities(cloud, cavities, non_planar_cloud, planar_cloud, cavity_cloud);
+  }
+  setPointsProcessed(state, cloud->points.size());
+  state.counters["cavities"] = cavities.cavities.size();
+}
+
+/** \brief Parameters of CavityFinder.cfg */
+void configureCavityFinder(CavityFinder &cavity_finder)
+{
+  cavity_finder.setCannyThreshold(220);
+  cavity_finder.setCannyMultiplier(3);
+  cavity_finder.setBinaryThreshold(62);
+  cavity_finder.setEpsilonApproxPoly(0.03);
+  cavity_finder.setEpsilonFinerPoly(0.012);
+  cavity_finder.setMinArea(450);
+  cavity_finder.setMaxArea(12000);
+}
+
+void BM_Find2DCavities(benchmark::State &state, cv::Mat image)
+{
+  CavityFinder cavity_finder;
+  configureCavityFinder(cavity_finder);
+  cv::Mat debug_image;
+  std::vector<cv::Point2f> centroids;
+  std::vector<std::vector<cv::Point>> cavities;
+  for (auto _ : state) {
+    centroids.clear();
+    cavities = cavity_finder.find2DCavities(image, debug_image, centroids);
+  }
+  state.counters["cavities"] = cavities.size();
+}
+
+void BM_Recognize2DCavities(benchmark::State &state, cv::Mat image)
+{
+  CavityFinder cavity_finder;
+  configureCavityFinder(cavity_finder);
+  cv::Mat debug_image;
+  std::vector<cv::Point2f> centroids;
+  cavity_finder.find2DCavities(image, debug_image, centroids);
+  if (centroids.empty()) {
+    state.SkipWithError("No cavities found");
+    return;
+  }
+  std::vector<cv::Mat> cropped_cavities;
+  std::vector<std::string> names;
+  for (auto _ : state) {
+    cropped_cavities.clear();
+    names = cavity_finder.recognize2DCavities(image, debug_image, cropped_cavities, centroids);
+  }
+  state.counters["cavities"] = names.size();
+}
+
+void BM_FindEmptySpacesOnPlane(benchmark::State &state, PointCloud::Ptr cloud)
+{
+  // parameters of the empty space detector params.yaml
+  const float voxel_leaf_size = 0.01f, empty_space_radius = 0.065f;
+  SceneSegmentation scene_segmentation;
+  configureSceneSegmentation(scene_segmentation);
+  scene_segmentation.setVoxelGridParams(voxel_leaf_size, "z", -0.15, 0.3);
+  PointCloud::Ptr hull(new PointCloud);
+  PointCloud::Ptr plane(new PointCloud);
+  pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
+  double workspace_height = 0.0;
+  scene_segmentation.findPlane(cloud, hull, plane, coefficients, workspace_height);
+  if (plane->points.empty()) {
+    state.SkipWithError("No plane found");
+    return;
+  }
+
+  EmptySpaceFinder empty_space_finder;
+  empty_space_finder.setParams(
+      empty_space_radius,
+      (empty_space_radius * empty_space_radius * M_PI) / (voxel_leaf_size * voxel_leaf_size), 0.8);
+  empty_space_finder.setSeed(42);
+
+  std::vector<PointT> empty_spaces;
+  int attempts = 0, total_attempts = 0, found = 0;
+  for (auto _ : state) {
+    found += empty_space_finder.findEmptySpaces(plane, 2, 3.0, empty_spaces, attempts);
+    total_attempts += attempts;
+  }
+  state.counters["attempts"] =
+      benchmark::Counter(total_attempts, benchmark::Counter::kAvgIterations);
+  state.counters["found"] = benchmark::Counter(found, benchmark::Counter::kAvgIterations);
+}
+
+void BM_LaserScanGetSegments(benchmark::State &state, sensor_msgs::LaserScan::Ptr scan)
+{
+  LaserScanSegmentation segmentation(0.04, 10);
+  mas_perception_msgs::LaserScanSegmentList segments;
+  for (auto _ : state) {
+    segments = segmentation.getSegments(scan);
+    benchmark::DoNotOptimize(segments.segments.data());
+  }
+  setPointsProcessed(state, scan->ranges.size());
+  state.counters["segments"] = segments.segments.size();
+}
+
+template <typename T, typename Function>
+void registerSamples(const std::string &name, const std::vector<Sample<T>> &samples,
+                     Function function)
+{
+  for (const auto &sample : samples) {
+    benchmark::RegisterBenchmark((name + "/" + sample.name).c_str(), function, sample.data)
+        ->Unit(benchmark::kMillisecond);
+  }
+}
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  // the data directory is not a benchmark option, remove it before the
+  // benchmark library parses the arguments
+  std::string data_dir;
+  if (const char *env = std::getenv("MIR_PERCEPTION_BENCHMARK_DATA")) data_dir = env;
+  const char data_dir_option[] = "--data_dir=";
+  int num_args = 0;
+  for (int i = 0; i < argc; i++) {
+    if (std::strncmp(argv[i], data_dir_option, sizeof(data_dir_option) - 1) == 0)
+      data_dir = argv[i] + sizeof(data_dir_option) - 1;
+    else
+      argv[num_args++] = argv[i];
+  }
+  argc = num_args;
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+  // ros::Time::now() is used by the pipelines, no node or master is needed
+  ros::Time::init();
+
+  BenchmarkData data;
+  if (!data.load(data_dir)) return 1;
+
+  benchmark::RegisterBenchmark("CloudAccumulation/all", BM_CloudAccumulation, data.scene_clouds)
+      ->Unit(benchmark::kMillisecond);
+  registerSamples("SceneSegmentation/findPlane", data.scene_clouds, BM_FindPlane);
+  registerSamples("SceneSegmentation/findPlaneCoarseToFine", data.scene_clouds,
+                  BM_FindPlaneCoarseToFine);
+  // the multimodal object recognition finds the plane on the accumulated views
+  std::vector<Sample<PointCloud::Ptr>> accumulated_clouds(1);
+  accumulated_clouds[0].name = "accumulated";
+  accumulated_clouds[0].data.reset(new PointCloud);
+  {
+    CloudAccumulation cloud_accumulation(0.0025);
+    for (const auto &cloud : data.scene_clouds) cloud_accumulation.addCloud(cloud.data);
+    cloud_accumulation.getAccumulatedCloud(*accumulated_clouds[0].data);
+  }
+  registerSamples("SceneSegmentation/findPlane", accumulated_clouds, BM_FindPlane);
+  registerSamples("SceneSegmentation/findPlaneCoarseToFine", accumulated_clouds,
+                  BM_FindPlaneCoarseToFine);
+  registerSamples("SceneSegmentation/segmentScene", data.scene_clouds, BM_SegmentScene);
+  registerSamples("ExtractPolygonalPrismData/segment", data.scene_clouds, BM_ExtractPolygonalPrism);
+  registerSamples("HullPrismExtraction/segment", data.scene_clouds, BM_HullPrismExtraction);
+  registerSamples("BoundingBox/create", data.scene_clouds, BM_BoundingBoxCreate);
+  registerSamples("PPTDetector/detectCavities", data.ppt_clouds, BM_PPTDetectCavities);
+  registerSamples("CavityFinder/find2DCavities", data.cavity_images, BM_Find2DCavities);
+  registerSamples("CavityFinder/recognize2DCavities", data.cavity_images, BM_Recognize2DCavities);
+  registerSamples("EmptySpaceDetector/findEmptySpacesOnPlane", data.scene_clouds,
+                  BM_FindEmptySpacesOnPlane);
+  registerSamples("LaserScanSegmentation/getSegments", data.laser_scans, BM_LaserScanGetSegments);
+
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ * Nodelets of the transport benchmark, which compares the perception nodes running as
+ * separate processes with the perception nodelets running in the manager of the camera
+ * driver. A camera frame source publishes organized pointclouds and images like the camera
+ * driver, latency monitors subscribe to them like the perception nodes. Both run either
+ * with "nodelet standalone" (one process each, messages are serialized) or in one manager
+ * (messages are passed as shared pointers), see launch/transport_benchmark.launch.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <std_msgs/UInt32.h>
+
+namespace mir_perception_benchmarks
+{
+/** \brief Publishes num_frames organized XYZRGB pointclouds and bgr8 images at a fixed rate,
+ * then the number of published frames on ~frames_published. Every frame is copied into a new
+ * message, as the camera driver does, and stamped right before it is published.
+ */
+class CameraFrameSource : public nodelet::Nodelet
+{
+ private:
+  void onInit() override
+  {
+    ros::NodeHandle &nh = getPrivateNodeHandle();
+    int width, height;
+    double rate, start_delay;
+    nh.param<int>("width", width, 640);
+    nh.param<int>("height", height, 480);
+    nh.param<double>("rate", rate, 30.0);
+    nh.param<int>("num_frames", num_frames_, 300);
+    // time for the monitors to connect
+    nh.param<double>("start_delay", start_delay, 2.0);
+    nh.param<std::string>("frame_id", frame_id_, "camera_color_optical_frame");
+
+    createTemplates(width, height);
+
+    pub_cloud_ = nh.advertise<sensor_msgs::PointCloud2>("points", 1);
+    pub_image_ = nh.advertise<sensor_msgs::Image>("image", 1);
+    pub_frames_published_ = nh.advertise<std_msgs::UInt32>("frames_published", 1, true);
+
+    frames_published_ = 0;
+    start_timer_ = nh.createWallTimer(ros::WallDuration(start_delay),
+                                      [this, rate](const ros::WallTimerEvent &) {
+                                        frame_timer_ = getPrivateNodeHandle().createWallTimer(
+                                            ros::WallDuration(1.0 / rate),
+                                            &CameraFrameSource::publishFrame, this);
+                                      },
+                                      true);
+    NODELET_INFO("[camera_frame_source] %d frames of %dx%d at %.1f Hz", num_frames_, width,
+                 height, rate);
+  }
+
+  void createTemplates(int width, int height)
+  {
+    cloud_template_.header.frame_id = frame_id_;
+    sensor_msgs::PointCloud2Modifier modifier(cloud_template_);
+    modifier.setPointCloud2FieldsByString(2, "xyz", "rgb");
+    modifier.resize(width * height);
+    cloud_template_.height = height;
+    cloud_template_.width = width;
+    cloud_template_.row_step = width * cloud_template_.point_step;
+    cloud_template_.is_dense = false;
+
+    // tilted table in front of the camera
+    sensor_msgs::PointCloud2Iterator<float> iter_x(cloud_template_, "x");
+    sensor_msgs::PointCloud2Iterator<float> iter_y(cloud_template_, "y");
+    sensor_msgs::PointCloud2Iterator<float> iter_z(cloud_template_, "z");
+    sensor_msgs::PointCloud2Iterator<uint8_t> iter_rgb(cloud_template_, "rgb");
+    for (int row = 0; row < height; row++) {
+      for (int col = 0; col < width; col++, ++iter_x, ++iter_y, ++iter_z, ++iter_rgb) {
+        const float depth = 0.5f + 0.3f * row / height;
+        *iter_z = depth;
+        *iter_x = (col - 0.5f * width) * depth / 615.0f;
+        *iter_y = (row - 0.5f * height) * depth / 615.0f;
+        iter_rgb[0] = static_cast<uint8_t>(col);
+        iter_rgb[1] = static_cast<uint8_t>(row);
+        iter_rgb[2] = 128;
+      }
+    }
+
+    image_template_.header.frame_id = frame_id_;
+    image_template_.height = height;
+    image_template_.width = width;
+    image_template_.encoding = sensor_msgs::image_encodings::BGR8;
+    image_template_.step = 3 * width;
+    image_template_.data.resize(image_template_.step * height);
+    for (size_t i = 0; i < image_template_.data.size(); i++) {
+      image_template_.data[i] = static_cast<uint8_t>(i % 251);
+    }
+  }
+
+  void publishFrame(const ros::WallTimerEvent &event)
+  {
+    if (frames_published_ >= num_frames_) {
+      frame_timer_.stop();
+      std_msgs::UInt32 frames_published;
+      frames_published.data = frames_published_;
+      pub_frames_published_.publish(frames_published);
+      // give the monitors time to write their results, the launch file ends with this nodelet
+      shutdown_timer_ = getPrivateNodeHandle().createWallTimer(
+          ros::WallDuration(2.0), [](const ros::WallTimerEvent &) { ros::shutdown(); }, true);
+      return;
+    }
+
+    // published messages must not be modified, a new message is filled for every frame
+    sensor_msgs::PointCloud2Ptr cloud(new sensor_msgs::PointCloud2(cloud_template_));
+    sensor_msgs::ImagePtr image(new sensor_msgs::Image(image_template_));
+    const ros::Time stamp = ros::Time::now();
+    cloud->header.stamp = stamp;
+    image->header.stamp = stamp;
+    pub_cloud_.publish(cloud);
+    pub_image_.publish(image);
+    frames_published_++;
+  }
+
+  sensor_msgs::PointCloud2 cloud_template_;
+  sensor_msgs::Image image_template_;
+  std::string frame_id_;
+  int num_frames_;
+  int frames_published_;
+
+  ros::Publisher pub_cloud_;
+  ros::Publisher pub_image_;
+  ros::Publisher pub_frames_published_;
+  ros::WallTimer start_timer_;
+  ros::WallTimer frame_timer_;
+  ros::WallTimer shutdown_timer_;
+};
+
+/** \brief Subscribes to the pointcloud and image of the CameraFrameSource like a perception
+ * node and measures the latency from the stamp of each message to its callback. When the
+ * number of published frames arrives, the received count and the latency percentiles are
+ * logged and appended as one line to ~result_file.
+ */
+class FrameLatencyMonitor : public nodelet::Nodelet
+{
+ private:
+  void onInit() override
+  {
+    ros::NodeHandle &nh = getPrivateNodeHandle();
+    int queue_size;
+    nh.param<int>("queue_size", queue_size, 1);
+    nh.param<std::string>("configuration", configuration_, "unknown");
+    nh.param<std::string>("result_file", result_file_, "");
+
+    sub_cloud_ = nh.subscribe("points", queue_size, &FrameLatencyMonitor::cloudCallback, this);
+    sub_image_ = nh.subscribe("image", queue_size, &FrameLatencyMonitor::imageCallback, this);
+    sub_frames_published_ = nh.subscribe("frames_published", 1,
+                                         &FrameLatencyMonitor::framesPublishedCallback, this);
+  }
+
+  void cloudCallback(const sensor_msgs::PointCloud2::ConstPtr &msg)
+  {
+    cloud_latencies_ms_.push_back((ros::Time::now() - msg->header.stamp).toSec() * 1e3);
+  }
+
+  void imageCallback(const sensor_msgs::Image::ConstPtr &msg)
+  {
+    image_latencies_ms_.push_back((ros::Time::now() - msg->header.stamp).toSec() * 1e3);
+  }
+
+  void framesPublishedCallback(const std_msgs::UInt32::ConstPtr &msg)
+  {
+    report("points", msg->data, cloud_latencies_ms_);
+    report("image", msg->data, image_latencies_ms_);
+  }
+
+  void report(const std::string &topic, uint32_t published, std::vector<double> latencies_ms)
+  {
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(3) << configuration_ << " " << getName() << " "
+         << topic << " " << published << " " << latencies_ms.size();
+    if (latencies_ms.empty()) {
+      line << " - - - - -";
+    } else {
+      // nearest rank percentiles, as in mpu::LatencyProfiler
+      const size_t n = latencies_ms.size();
+      auto percentile = [&latencies_ms, n](double p) {
+        const size_t rank = static_cast<size_t>(std::ceil(p * n));
+        const size_t index = std::min(n - 1, rank > 0 ? rank - 1 : 0);
+        std::nth_element(latencies_ms.begin(), latencies_ms.begin() + index, latencies_ms.end());
+        return latencies_ms[index];
+      };
+      double sum = 0.0;
+      for (double latency : latencies_ms) sum += latency;
+      line << " " << sum / n << " " << percentile(0.5) << " " << percentile(0.95) << " "
+           << percentile(0.99) << " " << *std::max_element(latencies_ms.begin(), latencies_ms.end());
+    }
+    NODELET_INFO_STREAM("[frame_latency_monitor] " << line.str());
+
+    if (result_file_.empty()) return;
+    // the monitors of the nodelet configuration share one process
+    static std::mutex file_mutex;
+    std::lock_guard<std::mutex> lock(file_mutex);
+    std::ofstream file(result_file_, std::ios::app);
+    file << line.str() + "\n";
+    if (!file) NODELET_ERROR_STREAM("Could not write " << result_file_);
+  }
+
+  std::string configuration_;
+  std::string result_file_;
+  std::vector<double> cloud_latencies_ms_;
+  std::vector<double> image_latencies_ms_;
+
+  ros::Subscriber sub_cloud_;
+  ros::Subscriber sub_image_;
+  ros::Subscriber sub_frames_published_;
+};
+
+}  // namespace mir_perception_benchmarks
+
+PLUGINLIB_EXPORT_CLASS(mir_perception_benchmarks::CameraFrameSource, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(mir_perception_benchmarks::FrameLatencyMonitor, nodelet::Nodelet)
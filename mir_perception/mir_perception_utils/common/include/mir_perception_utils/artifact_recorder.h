@@ -0,0 +1,133 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_ARTIFACT_RECORDER_H
+#define MIR_PERCEPTION_UTILS_ARTIFACT_RECORDER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <opencv2/core/core.hpp>
+
+#include <mir_perception_utils/aliases.h>
+#include <mir_perception_utils/perception_dataset.h>
+
+namespace mir_perception_utils
+{
+/** \brief Counters of the ArtifactRecorder */
+struct ArtifactRecorderStatistics
+{
+  ArtifactRecorderStatistics() : queued(0), written(0), dropped(0), failed(0) {}
+  // artifacts accepted into the queue
+  uint64_t queued;
+  // artifacts written to disk
+  uint64_t written;
+  // artifacts rejected because the queue was full
+  uint64_t dropped;
+  // artifacts that could not be written
+  uint64_t failed;
+};
+
+/** \brief Writes debug and data collection artifacts (pointclouds and images)
+ * in a background thread, so that the perception callbacks never touch the disk.
+ *
+ * Artifacts are queued without copying their data, the queue is bounded and
+ * new artifacts are dropped while it is full. Pointclouds are written as binary
+ * compressed PCD, images as PNG or JPEG depending on the file extension, and
+ * frames are appended to the open dataset (see DatasetWriter).
+ * The queued artifacts are written before the recorder is destroyed.
+ */
+class ArtifactRecorder
+{
+ public:
+  /** \brief Constructor, starts the writer thread
+   * \param[in] Maximum number of queued artifacts
+   * \param[in] JPEG quality (0-100)
+   * \param[in] PNG compression level (0-9), low levels are faster
+   * */
+  explicit ArtifactRecorder(size_t max_queue_size = 32, int jpeg_quality = 95,
+                            int png_compression = 1);
+  /** \brief Destructor, writes the queued artifacts and stops the writer thread */
+  virtual ~ArtifactRecorder();
+
+  /** \brief Queue a pointcloud
+   * \param[in] Pointcloud, must not be modified afterwards
+   * \param[in] File path, e.g. /tmp/pcd_cluster_0.pcd
+   * \return false if the queue is full and the pointcloud is dropped
+   * */
+  bool recordPointCloud(const PointCloud::ConstPtr &cloud, const std::string &filename);
+
+  /** \brief Queue an image, the data is shared with the caller
+   * \param[in] Image, must not be modified afterwards, otherwise pass a clone
+   * \param[in] File path with .png or .jpg extension
+   * \return false if the queue is full and the image is dropped
+   * */
+  bool recordImage(const cv::Mat &image, const std::string &filename);
+
+  /** \brief Open a dataset directory, the queued frames are appended to it
+   * \param[in] Dataset directory, created if needed
+   * \param[in] Size in bytes after which a new chunk is started
+   * \param[in] Image encoding, ".jpg" or ".png"
+   * \return false if the directory can not be created
+   * */
+  bool openDataset(const std::string &directory, uint64_t max_chunk_size = 256ull << 20,
+                   const std::string &image_format = ".jpg");
+
+  /** \brief Write the queued frames and close the dataset */
+  void closeDataset();
+
+  /** \brief Queue a frame for the open dataset
+   * \param[in] Frame, its pointclouds and images must not be modified afterwards
+   * \return false if no dataset is open or the queue is full and the frame is dropped
+   * */
+  bool recordFrame(const DatasetFrame &frame);
+
+  /** \brief Block until all queued artifacts are written */
+  void flush();
+
+  ArtifactRecorderStatistics getStatistics() const;
+
+ private:
+  struct Artifact
+  {
+    std::string filename;
+    PointCloud::ConstPtr cloud;
+    cv::Mat image;
+    std::shared_ptr<DatasetFrame> frame;
+  };
+
+  bool push(Artifact &&artifact);
+  void run();
+  bool write(const Artifact &artifact);
+
+  size_t max_queue_size_;
+  int jpeg_quality_;
+  int png_compression_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable queue_condition_;
+  std::condition_variable idle_condition_;
+  std::deque<Artifact> queue_;
+  bool writing_;
+  bool stop_;
+  ArtifactRecorderStatistics statistics_;
+
+  // only used by the writer thread while a dataset is open
+  std::mutex dataset_mutex_;
+  std::unique_ptr<DatasetWriter> dataset_writer_;
+  bool dataset_open_;
+
+  std::thread writer_;
+};
+
+typedef std::shared_ptr<ArtifactRecorder> ArtifactRecorderPtr;
+
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_ARTIFACT_RECORDER_H
@@ -8,6 +8,8 @@
 #ifndef MIR_PERCEPTION_UTILS_BOUNDING_BOX_H
 #define MIR_PERCEPTION_UTILS_BOUNDING_BOX_H
 
+#include <pcl/PointIndices.h>
+
 #include <mir_perception_utils/aliases.h>
 #include <vector>
 
@@ -41,9 +43,41 @@ class BoundingBox
   static BoundingBox create(const typename PointCloud::VectorType &points,
                             const Eigen::Vector3f &normal);
 
+  /** \brief Create a bounding box around a subset of the cloud, restricting it
+   * to be parallel to the plane defined by the normal.
+   * \param[in] Point cloud
+   * \param[in] Indices of the points in the box
+   * \param[in] Normal
+   * */
+  static BoundingBox create(const PointCloud &cloud, const std::vector<int> &indices,
+                            const Eigen::Vector3f &normal);
+
+  /** \brief Create the bounding boxes of all clusters of a scene, the plane
+   * frame and the scratch buffers are shared by all clusters.
+   * \param[in] Clusters
+   * \param[in] Normal
+   * \param[out] One bounding box per cluster
+   * */
+  static void create(const std::vector<PointCloud::Ptr> &clusters, const Eigen::Vector3f &normal,
+                     std::vector<BoundingBox> &boxes);
+
+  /** \brief Create the bounding boxes of all clusters of a scene given as
+   * indices into the scene cloud, without copying the clusters.
+   * \param[in] Point cloud
+   * \param[in] Point indices of the clusters
+   * \param[in] Normal
+   * \param[out] One bounding box per cluster
+   * */
+  static void create(const PointCloud &cloud, const std::vector<pcl::PointIndices> &clusters,
+                     const Eigen::Vector3f &normal, std::vector<BoundingBox> &boxes);
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
  private:
+  // Projects points into the plane frame and fits the boxes, defined in
+  // bounding_box.cpp
+  class Fitter;
+
   Point center_;
   Points vertices_;
   Eigen::Vector3f dimensions_;
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_LATENCY_PROFILER_H
+#define MIR_PERCEPTION_UTILS_LATENCY_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mir_perception_utils
+{
+/** \brief Latency percentiles of a stage over the rolling window */
+struct LatencyStatistics
+{
+  std::string stage;
+  /** Number of samples recorded since the start */
+  uint64_t count;
+  /** Number of samples in the window */
+  size_t window;
+  double p50_ms;
+  double p95_ms;
+  double p99_ms;
+  double max_ms;
+};
+
+/** \brief Process wide collector of stage latencies.
+ *
+ * Every thread records into its own ring buffer without locks, the buffers are
+ * drained when the statistics are requested. If a thread records faster than
+ * the buffers are drained, its oldest samples are overwritten and counted as
+ * lost. Recording is a relaxed atomic load when the profiler is disabled and
+ * two clock reads and a few relaxed stores when it is enabled.
+ */
+class LatencyProfiler
+{
+ public:
+  /** \brief The profiler of the process */
+  static LatencyProfiler &instance();
+
+  /** \brief Enable or disable recording, enabled by default */
+  void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+  bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  /** \brief Register a stage, stages with the same name share the id
+   * \param[in] Stage name, e.g. scene_segmentation/voxel
+   * \return Stage id
+   * */
+  int registerStage(const std::string &name);
+
+  /** \brief Record a sample of the calling thread
+   * \param[in] Stage id
+   * \param[in] Start time in nanoseconds, see now()
+   * \param[in] End time in nanoseconds
+   * */
+  void record(int stage, int64_t start_ns, int64_t end_ns);
+
+  /** \brief Number of samples per stage the percentiles are computed on */
+  void setWindowSize(size_t window_size);
+  /** \brief Number of samples kept for the Chrome trace, 0 disables the trace */
+  void setTraceCapacity(size_t trace_capacity);
+
+  /** \brief Drain the thread buffers and compute the percentiles of all stages with samples
+   * \param[out] Statistics per stage
+   * */
+  void getStatistics(std::vector<LatencyStatistics> &statistics);
+
+  /** \brief Number of samples overwritten before they were drained */
+  uint64_t getLostSamples() const { return lost_samples_.load(std::memory_order_relaxed); }
+
+  /** \brief Drain the thread buffers and write the traced samples as Chrome trace JSON,
+   * which can be opened in chrome://tracing or Perfetto
+   * \param[in] Output file
+   * \return false if the file could not be written
+   * */
+  bool writeChromeTrace(const std::string &filename);
+
+  /** \brief Monotonic time in nanoseconds */
+  static int64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+ private:
+  LatencyProfiler();
+  LatencyProfiler(const LatencyProfiler &) = delete;
+  LatencyProfiler &operator=(const LatencyProfiler &) = delete;
+
+  class ThreadBuffer;
+  ThreadBuffer &threadBuffer();
+  void collect();
+
+  struct TraceEvent
+  {
+    int stage;
+    int thread;
+    int64_t start_ns;
+    int64_t duration_ns;
+  };
+
+  std::atomic<bool> enabled_;
+  std::atomic<uint64_t> lost_samples_;
+
+  // stage names and thread buffers, only locked when they are added or collected
+  std::mutex registry_mutex_;
+  std::vector<std::string> stages_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+
+  // collected samples, guarded by collect_mutex_
+  std::mutex collect_mutex_;
+  size_t window_size_;
+  size_t trace_capacity_;
+  struct StageWindow
+  {
+    std::vector<int64_t> durations;
+    size_t next;
+    uint64_t count;
+  };
+  std::vector<StageWindow> windows_;
+  std::deque<TraceEvent> trace_;
+  std::vector<int64_t> scratch_;
+};
+
+/** \brief Registers a stage once, e.g. as a static in the instrumented code */
+class LatencyStage
+{
+ public:
+  explicit LatencyStage(const std::string &name)
+      : id_(LatencyProfiler::instance().registerStage(name))
+  {
+  }
+  int id() const { return id_; }
+
+ private:
+  int id_;
+};
+
+/** \brief Records the time from construction to destruction or stop() */
+class ScopedLatencyTimer
+{
+ public:
+  explicit ScopedLatencyTimer(const LatencyStage &stage)
+      : stage_(stage.id()),
+        start_ns_(LatencyProfiler::instance().isEnabled() ? LatencyProfiler::now() : -1)
+  {
+  }
+  ~ScopedLatencyTimer() { stop(); }
+
+  /** \brief Record the sample now instead of at the end of the scope */
+  void stop()
+  {
+    if (start_ns_ < 0) return;
+    LatencyProfiler::instance().record(stage_, start_ns_, LatencyProfiler::now());
+    start_ns_ = -1;
+  }
+
+ private:
+  ScopedLatencyTimer(const ScopedLatencyTimer &) = delete;
+  ScopedLatencyTimer &operator=(const ScopedLatencyTimer &) = delete;
+
+  int stage_;
+  int64_t start_ns_;
+};
+
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_LATENCY_PROFILER_H
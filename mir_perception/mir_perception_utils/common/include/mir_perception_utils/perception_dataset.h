@@ -0,0 +1,202 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_PERCEPTION_DATASET_H
+#define MIR_PERCEPTION_UTILS_PERCEPTION_DATASET_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <opencv2/core/core.hpp>
+
+#include <mir_perception_utils/aliases.h>
+
+namespace mir_perception_utils
+{
+/** \brief Rigid transform between two frames, e.g. from the camera to base_link */
+struct DatasetTransform
+{
+  std::string target_frame;
+  std::string source_frame;
+  Eigen::Vector3d translation;
+  Eigen::Quaterniond rotation;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/** \brief Object of a frame, all fields are optional */
+struct DatasetObject
+{
+  DatasetObject() : position(Eigen::Vector3d::Zero()), orientation(Eigen::Quaterniond::Identity()) {}
+  // class label, empty if the object is not labeled
+  std::string label;
+  // pose in the frame of the frame
+  Eigen::Vector3d position;
+  Eigen::Quaterniond orientation;
+  // segmented cluster
+  PointCloud::ConstPtr cluster;
+  // crop of the object in the image of the frame
+  cv::Mat image;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/** \brief One recorded frame, all fields except the stamp are optional */
+struct DatasetFrame
+{
+  DatasetFrame() : stamp_ns(0) {}
+  uint64_t stamp_ns;
+  // frame of the pointcloud and the object poses
+  std::string frame_id;
+  PointCloud::ConstPtr cloud;
+  cv::Mat image;
+  std::vector<DatasetObject, Eigen::aligned_allocator<DatasetObject>> objects;
+  std::vector<DatasetTransform, Eigen::aligned_allocator<DatasetTransform>> transforms;
+};
+
+/** \brief Appends frames to a dataset directory of chunk files.
+ *
+ * A chunk is a sequence of records (a frame record with its labels, poses and
+ * transforms, followed by the records of its pointcloud, image, clusters and object
+ * images), terminated by an index of all records when the chunk is closed.
+ * Pointclouds are stored as packed x, y, z, rgba floats, images encoded as
+ * PNG or JPEG. A new chunk is started when the current one exceeds the maximum
+ * size, the chunks of an existing dataset are never modified.
+ */
+class DatasetWriter
+{
+ public:
+  /** \brief Constructor
+   * \param[in] Size in bytes after which a new chunk is started
+   * \param[in] Image encoding, ".jpg" or ".png"
+   * \param[in] JPEG quality (0-100)
+   * */
+  explicit DatasetWriter(uint64_t max_chunk_size = 256ull << 20,
+                         const std::string &image_format = ".jpg", int jpeg_quality = 95);
+  /** \brief Destructor, closes the current chunk */
+  virtual ~DatasetWriter();
+
+  /** \brief Open a dataset directory for appending, it is created if needed
+   * \return false if the directory can not be created
+   * */
+  bool open(const std::string &directory);
+
+  /** \brief Append a frame
+   * \return false if the frame could not be written
+   * */
+  bool append(const DatasetFrame &frame);
+
+  /** \brief Write the index of the current chunk and close it */
+  bool close();
+
+  bool isOpen() const { return !directory_.empty(); }
+  uint64_t getFrameCount() const { return frame_count_; }
+
+ private:
+  struct IndexEntry
+  {
+    uint32_t kind;
+    uint32_t object_index;
+    // offset of the payload in the chunk
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  bool openChunk();
+  bool closeChunk();
+  bool writeRecord(uint32_t kind, uint32_t object_index, const std::vector<uint8_t> &payload);
+
+  uint64_t max_chunk_size_;
+  std::string image_format_;
+  std::vector<int> image_params_;
+  std::string directory_;
+  int next_chunk_;
+  FILE *chunk_;
+  uint64_t chunk_size_;
+  std::vector<IndexEntry> index_;
+  uint64_t frame_count_;
+};
+
+/** \brief Random access to the frames and objects of a dataset directory.
+ *
+ * The chunks are memory mapped and only their indices are read when the dataset
+ * is opened. Chunks without index, e.g. of a writer that did not close, are
+ * scanned record by record up to the first incomplete record.
+ */
+class DatasetReader
+{
+ public:
+  DatasetReader();
+  virtual ~DatasetReader();
+
+  /** \brief Open all chunks of a dataset directory
+   * \return false if the directory has no readable chunk
+   * */
+  bool open(const std::string &directory);
+
+  size_t getFrameCount() const { return frames_.size(); }
+  size_t getObjectCount() const { return objects_.size(); }
+
+  /** \brief Read a frame
+   * \param[in] Frame index, 0 to getFrameCount() - 1
+   * \param[out] Frame
+   * \param[in] Read the pointcloud and the image of the frame
+   * \param[in] Read the clusters and images of the objects
+   * */
+  bool readFrame(size_t frame_index, DatasetFrame &frame, bool read_data = true,
+                 bool read_object_data = true) const;
+
+  /** \brief Read an object
+   * \param[in] Object index over all frames, 0 to getObjectCount() - 1
+   * \param[out] Object
+   * \param[out] Index of the frame of the object (optional)
+   * */
+  bool readObject(size_t object_index, DatasetObject &object, size_t *frame_index = NULL) const;
+
+ private:
+  struct MappedChunk;
+  struct Record
+  {
+    Record() : chunk(0), offset(0), size(0) {}
+    size_t chunk;
+    uint64_t offset;
+    uint64_t size;
+  };
+  struct FrameEntry
+  {
+    FrameEntry() : first_object(0), object_count(0) {}
+    Record frame;
+    Record cloud;
+    Record image;
+    size_t first_object;
+    size_t object_count;
+  };
+  struct ObjectEntry
+  {
+    ObjectEntry() : frame(0), index(0) {}
+    size_t frame;
+    uint32_t index;
+    Record cluster;
+    Record image;
+  };
+
+  bool addChunk(const std::string &path);
+  void addRecord(uint32_t kind, uint32_t object_index, const Record &record);
+  const uint8_t *data(const Record &record) const;
+  bool readFrameRecord(const FrameEntry &entry, DatasetFrame &frame) const;
+
+  std::vector<std::unique_ptr<MappedChunk>> chunks_;
+  std::vector<FrameEntry> frames_;
+  std::vector<ObjectEntry> objects_;
+  // the last frame record was rejected, its data records are dropped as well
+  bool skip_frame_data_;
+};
+
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_PERCEPTION_DATASET_H
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_POINTCLOUD_RESAMPLER_H
+#define MIR_PERCEPTION_UTILS_POINTCLOUD_RESAMPLER_H
+
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include <mir_perception_utils/aliases.h>
+
+namespace mir_perception_utils
+{
+namespace pointcloud
+{
+/** \brief Resamples point clouds to a fixed number of points, e.g. as input
+ * for the point cloud recognizer.
+ *
+ * Clouds with more points are subsampled without replacement with one of the
+ * strategies. Clouds with fewer points are kept completely and padded with
+ * duplicates drawn from a random permutation, so no point is duplicated
+ * twice before every point has been duplicated once.
+ * The output buffer and all intermediate buffers are reused between calls.
+ */
+class PointCloudResampler
+{
+ public:
+  enum Strategy
+  {
+    /** Uniform subset, reservoir sampling */
+    RANDOM = 0,
+    /** Round robin over voxels, one random point per voxel and round */
+    VOXEL_STRATIFIED = 1,
+    /** Farthest point sampling, accelerated with a coarse grid */
+    FARTHEST_POINT = 2
+  };
+
+  /** \brief Constructor
+   * \param[in] Sampling strategy
+   * */
+  explicit PointCloudResampler(Strategy strategy = RANDOM);
+
+  /** \brief Set the sampling strategy */
+  void setStrategy(Strategy strategy) { strategy_ = strategy; }
+  /** \brief Set the voxel size of the voxel stratified sampling */
+  void setVoxelSize(float voxel_size) { voxel_size_ = voxel_size; }
+  /** \brief Seed the random generator, the same seed and input give the same output */
+  void setSeed(uint32_t seed) { generator_.seed(seed); }
+  /** \brief Seed the random generator from std::random_device */
+  void setRandomSeed();
+
+  /** \brief Resample the cloud to the given number of points
+   * \param[in] Input point cloud
+   * \param[in] Number of output points
+   * \param[out] Output point cloud, its buffer is reused
+   * \return false if the input has no points
+   * */
+  bool resample(const PointCloud &cloud_in, int num_points, PointCloud &cloud_out);
+
+ private:
+  void sampleRandom(size_t num_input, size_t num_points);
+  void sampleVoxelStratified(const PointCloud &cloud_in, size_t num_points);
+  void sampleFarthestPoint(const PointCloud &cloud_in, size_t num_points);
+  void padIndices(size_t num_input, size_t num_points);
+
+  Strategy strategy_;
+  float voxel_size_;
+  std::mt19937 generator_;
+
+  // buffers are kept between calls to avoid reallocation
+  std::vector<int> finite_indices_;
+  std::vector<int> indices_;
+  std::vector<int> permutation_;
+  std::vector<std::pair<uint64_t, int>> voxel_points_;
+  std::vector<int> voxel_begins_;
+  std::vector<float> distances_;
+
+  struct Cell
+  {
+    int begin;
+    int end;
+    Eigen::Vector3f min;
+    Eigen::Vector3f max;
+    float max_distance;
+    int farthest;
+  };
+  std::vector<Cell, Eigen::aligned_allocator<Cell>> cells_;
+};
+
+}  // namespace pointcloud
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_POINTCLOUD_RESAMPLER_H
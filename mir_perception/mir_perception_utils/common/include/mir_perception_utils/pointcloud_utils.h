@@ -8,7 +8,10 @@
 #ifndef MIR_PERCCEPTION_UTILS_POINTCLOUD_UTILS_H
 #define MIR_PERCCEPTION_UTILS_POINTCLOUD_UTILS_H
 
+#include <Eigen/Core>
+
 #include <mir_perception_utils/aliases.h>
+#include <mir_perception_utils/pointcloud_resampler.h>
 
 namespace mir_perception_utils
 {
@@ -22,12 +25,31 @@ namespace pointcloud
  * as the number of input points
  */
 unsigned int centerPointCloud(const PointCloud &cloud_in, PointCloud &centered_cloud);
-/** \brief Pad point cloud
-  * \param[in] Normalized PointCloud input
+/** \brief Resample point cloud to a fixed number of points, larger clouds are
+  * subsampled without replacement, smaller ones padded with duplicates
+  * \param[in,out] Normalized PointCloud input
   * \param[in] Number of points
+  * \param[in] Subsampling strategy
+  * \param[in] Voxel size of the voxel stratified subsampling
+  * \param[in] Seed of the random generator, negative for a random seed
   * \return The number of padded points
   */
-unsigned int padPointCloud(PointCloud::Ptr &cloud_in, int num_points);
+unsigned int padPointCloud(PointCloud::Ptr &cloud_in, int num_points,
+                           PointCloudResampler::Strategy strategy = PointCloudResampler::RANDOM,
+                           float voxel_size = 0.01, int seed = -1);
+/** \brief Refine the alignment of two roughly registered clouds with point-to-plane ICP.
+  * Both clouds are downsampled with the given voxel size before normals are estimated.
+  * \param[in] Source PointCloud, e.g. a new view
+  * \param[in] Target PointCloud, e.g. the accumulated map
+  * \param[in] Voxel size used for downsampling
+  * \param[in] Maximum distance between corresponding points
+  * \param[in] Maximum number of ICP iterations
+  * \param[out] Correction to apply to the source cloud, identity if ICP did not converge
+  * \return True if ICP converged
+  */
+bool registerPointToPlane(const PointCloud::ConstPtr &source, const PointCloud::ConstPtr &target,
+                          float voxel_size, float max_correspondence_distance, int max_iterations,
+                          Eigen::Matrix4f &transform);
 }
 };
 
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_PRINCIPAL_AXES_H
+#define MIR_PERCEPTION_UTILS_PRINCIPAL_AXES_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <Eigen/StdVector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/PointIndices.h>
+#include <pcl/point_cloud.h>
+
+namespace mir_perception_utils
+{
+namespace pointcloud
+{
+/** \brief Centroid, normalized covariance and eigen decomposition of a set of points */
+struct PrincipalAxes
+{
+  Eigen::Vector3f centroid;
+  Eigen::Matrix3f covariance;
+  /** Eigen values in increasing order */
+  Eigen::Vector3f eigen_values;
+  /** Eigen vectors as columns, in the order of the eigen values */
+  Eigen::Matrix3f eigen_vectors;
+  /** Number of finite points */
+  size_t size;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/** \brief Box aligned with the principal axes of a set of points.
+ * The first axis is the major axis, the third one the minor axis.
+ */
+struct OrientedBox
+{
+  /** Axes of the box as columns, a right handed rotation matrix */
+  Eigen::Matrix3f axes;
+  Eigen::Vector3f center;
+  /** Extents along the axes */
+  Eigen::Vector3f dimensions;
+  PrincipalAxes principal_axes;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+typedef std::vector<OrientedBox, Eigen::aligned_allocator<OrientedBox>> OrientedBoxes;
+
+namespace detail
+{
+/** \brief Accumulates the first and second moments in a single pass.
+ *
+ * The points are shifted by the first point before accumulation, which keeps
+ * the single pass covariance accurate far away from the origin. The sums are
+ * kept in 4-vectors of doubles so that Eigen can vectorize the updates.
+ */
+class MomentAccumulator
+{
+ public:
+  MomentAccumulator() : count_(0), shift_(Eigen::Vector4d::Zero()), sum_(Eigen::Vector4d::Zero()),
+                        sum_squares_(Eigen::Matrix4d::Zero())
+  {
+  }
+
+  inline void add(float x, float y, float z)
+  {
+    if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z)) return;
+    if (count_ == 0) shift_ << x, y, z, 0.0;
+    const Eigen::Vector4d d = Eigen::Vector4d(x, y, z, 0.0) - shift_;
+    sum_ += d;
+    sum_squares_.noalias() += d * d.transpose();
+    count_++;
+  }
+
+  bool compute(PrincipalAxes &axes) const
+  {
+    axes.size = count_;
+    if (count_ == 0) return false;
+    const Eigen::Vector4d mean = sum_ / static_cast<double>(count_);
+    const Eigen::Matrix4d covariance =
+        sum_squares_ / static_cast<double>(count_) - mean * mean.transpose();
+    axes.centroid = (mean + shift_).head<3>().cast<float>();
+    axes.covariance = covariance.topLeftCorner<3, 3>().cast<float>();
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> eigen_solver(axes.covariance,
+                                                                Eigen::ComputeEigenvectors);
+    axes.eigen_values = eigen_solver.eigenvalues();
+    axes.eigen_vectors = eigen_solver.eigenvectors();
+    return true;
+  }
+
+ private:
+  size_t count_;
+  Eigen::Vector4d shift_;
+  Eigen::Vector4d sum_;
+  Eigen::Matrix4d sum_squares_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+template <typename PointT, typename PointAt>
+bool computePrincipalAxes(size_t size, const PointAt &point_at, PrincipalAxes &axes)
+{
+  MomentAccumulator accumulator;
+  for (size_t i = 0; i < size; i++) {
+    const PointT &point = point_at(i);
+    accumulator.add(point.x, point.y, point.z);
+  }
+  return accumulator.compute(axes);
+}
+
+template <typename PointT, typename PointAt>
+bool computeOrientedBox(size_t size, const PointAt &point_at, OrientedBox &box)
+{
+  if (!computePrincipalAxes<PointT>(size, point_at, box.principal_axes)) return false;
+  const PrincipalAxes &principal_axes = box.principal_axes;
+
+  // major axis first, minor axis last, right handed
+  box.axes.col(0) = principal_axes.eigen_vectors.col(2);
+  box.axes.col(2) = principal_axes.eigen_vectors.col(0);
+  box.axes.col(1) = box.axes.col(2).cross(box.axes.col(0));
+
+  // extents in the eigen basis, the points are projected on the fly
+  const Eigen::Matrix3f rotation = box.axes.transpose();
+  Eigen::Vector3f min_point = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+  Eigen::Vector3f max_point = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+  for (size_t i = 0; i < size; i++) {
+    const PointT &point = point_at(i);
+    if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) continue;
+    const Eigen::Vector3f projected =
+        rotation * (Eigen::Vector3f(point.x, point.y, point.z) - principal_axes.centroid);
+    min_point = min_point.cwiseMin(projected);
+    max_point = max_point.cwiseMax(projected);
+  }
+  box.dimensions = max_point - min_point;
+  box.center = box.axes * ((min_point + max_point) / 2.0f) + principal_axes.centroid;
+  return true;
+}
+}  // namespace detail
+
+/** \brief Compute centroid, normalized covariance and principal axes in a single pass.
+ * Non finite points are skipped.
+ * \param[in] Point cloud
+ * \param[out] Principal axes
+ * \return false if the cloud has no finite points
+ * */
+template <typename PointT>
+bool computePrincipalAxes(const pcl::PointCloud<PointT> &cloud, PrincipalAxes &axes)
+{
+  return detail::computePrincipalAxes<PointT>(
+      cloud.points.size(), [&cloud](size_t i) -> const PointT & { return cloud.points[i]; }, axes);
+}
+
+/** \brief Compute centroid, normalized covariance and principal axes of a
+ * subset of the cloud in a single pass.
+ * \param[in] Point cloud
+ * \param[in] Indices of the points
+ * \param[out] Principal axes
+ * \return false if there are no finite points
+ * */
+template <typename PointT>
+bool computePrincipalAxes(const pcl::PointCloud<PointT> &cloud, const std::vector<int> &indices,
+                          PrincipalAxes &axes)
+{
+  return detail::computePrincipalAxes<PointT>(
+      indices.size(),
+      [&cloud, &indices](size_t i) -> const PointT & { return cloud.points[indices[i]]; }, axes);
+}
+
+/** \brief Compute the box aligned with the principal axes of the cloud.
+ * The moments are accumulated in one pass and the extents in the eigen basis
+ * in a second one, without creating a transformed copy of the cloud.
+ * \param[in] Point cloud
+ * \param[out] Oriented box
+ * \return false if the cloud has no finite points
+ * */
+template <typename PointT>
+bool computeOrientedBox(const pcl::PointCloud<PointT> &cloud, OrientedBox &box)
+{
+  return detail::computeOrientedBox<PointT>(
+      cloud.points.size(), [&cloud](size_t i) -> const PointT & { return cloud.points[i]; }, box);
+}
+
+/** \brief Compute the box aligned with the principal axes of a subset of the cloud.
+ * \param[in] Point cloud
+ * \param[in] Indices of the points
+ * \param[out] Oriented box
+ * \return false if there are no finite points
+ * */
+template <typename PointT>
+bool computeOrientedBox(const pcl::PointCloud<PointT> &cloud, const std::vector<int> &indices,
+                        OrientedBox &box)
+{
+  return detail::computeOrientedBox<PointT>(
+      indices.size(),
+      [&cloud, &indices](size_t i) -> const PointT & { return cloud.points[indices[i]]; }, box);
+}
+
+/** \brief Compute the oriented boxes of all clusters of a scene
+ * \param[in] Point cloud
+ * \param[in] Point indices of the clusters
+ * \param[out] One box per cluster, empty clusters get a zero sized box
+ * */
+template <typename PointT>
+void computeOrientedBoxes(const pcl::PointCloud<PointT> &cloud,
+                          const std::vector<pcl::PointIndices> &clusters, OrientedBoxes &boxes)
+{
+  boxes.resize(clusters.size());
+  for (size_t i = 0; i < clusters.size(); i++) {
+    if (!computeOrientedBox(cloud, clusters[i].indices, boxes[i])) {
+      boxes[i].axes.setIdentity();
+      boxes[i].center.setZero();
+      boxes[i].dimensions.setZero();
+    }
+  }
+}
+
+/** \brief Compute the oriented boxes of a list of clusters
+ * \param[in] Clusters
+ * \param[out] One box per cluster, empty clusters get a zero sized box
+ * */
+template <typename PointT>
+void computeOrientedBoxes(const std::vector<boost::shared_ptr<pcl::PointCloud<PointT>>> &clusters,
+                          OrientedBoxes &boxes)
+{
+  boxes.resize(clusters.size());
+  for (size_t i = 0; i < clusters.size(); i++) {
+    if (!computeOrientedBox(*clusters[i], boxes[i])) {
+      boxes[i].axes.setIdentity();
+      boxes[i].center.setZero();
+      boxes[i].dimensions.setZero();
+    }
+  }
+}
+
+}  // namespace pointcloud
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_PRINCIPAL_AXES_H
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_SPSC_QUEUE_H
+#define MIR_PERCEPTION_UTILS_SPSC_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace mir_perception_utils
+{
+/** \brief Bounded lock-free queue for exactly one producer and one consumer thread.
+ *
+ * push() and waitPush() are only called by the producer, pop() and waitPop() only by
+ * the consumer. push() and pop() never block: push() returns false if the queue is
+ * full and pop() returns false if it is empty, so the caller decides whether to drop,
+ * retry or back off. waitPush() and waitPop() sleep until there is space or an item,
+ * or until the queue is closed.
+ */
+template <typename T>
+class SpscQueue
+{
+ public:
+  /** \brief Constructor
+   * \param[in] Maximum number of queued items
+   * */
+  explicit SpscQueue(size_t capacity) : buffer_(capacity + 1), head_(0), tail_(0), closed_(false)
+  {
+  }
+
+  /** \brief Append an item (producer only)
+   * \param[in] Item
+   * \return false if the queue is full
+   * */
+  bool push(T item)
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = increment(tail);
+    if (next == head_.load(std::memory_order_acquire)) return false;
+    buffer_[tail] = std::move(item);
+    tail_.store(next, std::memory_order_release);
+    notify(not_empty_);
+    return true;
+  }
+
+  /** \brief Remove the oldest item (consumer only)
+   * \param[out] Item
+   * \return false if the queue is empty
+   * */
+  bool pop(T &item)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    item = std::move(buffer_[head]);
+    buffer_[head] = T();
+    head_.store(increment(head), std::memory_order_release);
+    notify(not_full_);
+    return true;
+  }
+
+  /** \brief Append an item, waits while the queue is full (producer only)
+   * \param[in] Item
+   * \return false if the queue was closed
+   * */
+  bool waitPush(T item)
+  {
+    while (!push(item)) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_full_.wait(lock, [this] { return closed_ || !full(); });
+      if (closed_) return false;
+    }
+    return true;
+  }
+
+  /** \brief Remove the oldest item, waits while the queue is empty (consumer only)
+   * \param[out] Item
+   * \return false if the queue was closed
+   * */
+  bool waitPop(T &item)
+  {
+    while (!pop(item)) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [this] { return closed_ || size() > 0; });
+      if (closed_) return false;
+    }
+    return true;
+  }
+
+  /** \brief Wake up and return false from all waiting and later waitPush() and waitPop()
+   * calls, safe to call from any thread */
+  void close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+  /** \brief Approximate number of queued items, safe to call from any thread */
+  size_t size() const
+  {
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return tail >= head ? tail - head : tail + buffer_.size() - head;
+  }
+
+  /** \brief Maximum number of queued items */
+  size_t capacity() const { return buffer_.size() - 1; }
+
+ private:
+  size_t increment(size_t index) const { return index + 1 == buffer_.size() ? 0 : index + 1; }
+  bool full() const { return size() == capacity(); }
+
+  void notify(std::condition_variable &condition)
+  {
+    // the waiter checks its predicate under the mutex, taking it here prevents a lost wakeup
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    condition.notify_one();
+  }
+
+  std::vector<T> buffer_;
+  // keep producer and consumer indices on separate cache lines
+  char pad_head_[64];
+  std::atomic<size_t> head_;
+  char pad_tail_[64];
+  std::atomic<size_t> tail_;
+
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  bool closed_;
+};
+
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_SPSC_QUEUE_H
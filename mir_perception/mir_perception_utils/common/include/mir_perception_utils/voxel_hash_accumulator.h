@@ -0,0 +1,204 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_VOXEL_HASH_ACCUMULATOR_H
+#define MIR_PERCEPTION_UTILS_VOXEL_HASH_ACCUMULATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <pcl/common/point_tests.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+namespace mir_perception_utils
+{
+namespace pointcloud
+{
+/** \brief Accumulates colored points into a fixed resolution voxel grid.
+ *
+ * Voxels are stored in a flat open addressing hash table (linear probing,
+ * power of two capacity). Every slot keeps the packed voxel key, the running
+ * color mean and the number of points that fell into the voxel, so adding a
+ * point is one hash plus a short probe and extracting the accumulated cloud
+ * is a single linear pass over the table.
+ *
+ * Voxel indices are packed into 21 bits per axis, i.e. the grid covers
+ * +-2^20 voxels around the origin (about +-2.6 km at 2.5 mm resolution).
+ */
+template <typename PointT = pcl::PointXYZRGB>
+class VoxelHashAccumulator
+{
+ public:
+  /** \brief Constructor
+   * \param[in] Voxel resolution in meters
+   * \param[in] Initial number of slots, rounded up to a power of two
+   * */
+  explicit VoxelHashAccumulator(double resolution, size_t initial_capacity = 1 << 16)
+      : resolution_(resolution), inverse_resolution_(1.0 / resolution), size_(0)
+  {
+    size_t capacity = 16;
+    while (capacity < initial_capacity) capacity <<= 1;
+    slots_.assign(capacity, Voxel());
+    mask_ = capacity - 1;
+  }
+
+  /** \brief Add a single point, non-finite points are ignored
+   * \param[in] Point
+   * */
+  void addPoint(const PointT &point)
+  {
+    if (!pcl::isFinite(point)) return;
+    if ((size_ + 1) * 2 > slots_.size()) rehash(slots_.size() * 2);
+
+    const uint64_t key = computeKey(point);
+    size_t index = hash(key) & mask_;
+    while (slots_[index].key != EMPTY_KEY && slots_[index].key != key) {
+      index = (index + 1) & mask_;
+    }
+
+    Voxel &voxel = slots_[index];
+    if (voxel.key == EMPTY_KEY) {
+      voxel.key = key;
+      ++size_;
+    }
+    // running mean keeps the color stable no matter how many views are added
+    ++voxel.count;
+    const float weight = 1.0f / static_cast<float>(voxel.count);
+    voxel.r += (static_cast<float>(point.r) - voxel.r) * weight;
+    voxel.g += (static_cast<float>(point.g) - voxel.g) * weight;
+    voxel.b += (static_cast<float>(point.b) - voxel.b) * weight;
+  }
+
+  /** \brief Add all finite points of a cloud
+   * \param[in] Point cloud
+   * */
+  void addCloud(const pcl::PointCloud<PointT> &cloud)
+  {
+    for (const auto &point : cloud.points) addPoint(point);
+  }
+
+  /** \brief Get voxel centers with their mean color
+   * \param[out] Voxel centers, previous content is replaced
+   * */
+  void getVoxelCentersWithColor(typename pcl::PointCloud<PointT>::VectorType &points) const
+  {
+    points.clear();
+    points.reserve(size_);
+    for (const auto &voxel : slots_) {
+      if (voxel.key == EMPTY_KEY) continue;
+      PointT point;
+      point.x = static_cast<float>((unpack(voxel.key, 42) + 0.5) * resolution_);
+      point.y = static_cast<float>((unpack(voxel.key, 21) + 0.5) * resolution_);
+      point.z = static_cast<float>((unpack(voxel.key, 0) + 0.5) * resolution_);
+      point.r = static_cast<uint8_t>(voxel.r + 0.5f);
+      point.g = static_cast<uint8_t>(voxel.g + 0.5f);
+      point.b = static_cast<uint8_t>(voxel.b + 0.5f);
+      point.a = 255;
+      points.push_back(point);
+    }
+  }
+
+  /** \brief Get number of points accumulated in the voxel containing the point
+   * \param[in] Query point
+   * \return Hit count, 0 if the voxel is not occupied
+   * */
+  uint32_t getVoxelCountAtPoint(const PointT &point) const
+  {
+    if (!pcl::isFinite(point)) return 0;
+    const uint64_t key = computeKey(point);
+    size_t index = hash(key) & mask_;
+    while (slots_[index].key != EMPTY_KEY) {
+      if (slots_[index].key == key) return slots_[index].count;
+      index = (index + 1) & mask_;
+    }
+    return 0;
+  }
+
+  /** \brief Remove all voxels while keeping the allocated table */
+  void clear()
+  {
+    std::fill(slots_.begin(), slots_.end(), Voxel());
+    size_ = 0;
+  }
+
+  /** \brief Number of occupied voxels */
+  size_t size() const { return size_; }
+  /** \brief Voxel resolution */
+  double getResolution() const { return resolution_; }
+
+ private:
+  struct Voxel
+  {
+    uint64_t key = EMPTY_KEY;
+    float r = 0.0f;
+    float g = 0.0f;
+    float b = 0.0f;
+    uint32_t count = 0;
+  };
+
+  static constexpr uint64_t EMPTY_KEY = ~static_cast<uint64_t>(0);
+  static constexpr int KEY_BITS = 21;
+  static constexpr int64_t KEY_OFFSET = static_cast<int64_t>(1) << (KEY_BITS - 1);
+  static constexpr uint64_t KEY_MASK = (static_cast<uint64_t>(1) << KEY_BITS) - 1;
+
+  uint64_t computeKey(const PointT &point) const
+  {
+    const int64_t ix = static_cast<int64_t>(std::floor(point.x * inverse_resolution_));
+    const int64_t iy = static_cast<int64_t>(std::floor(point.y * inverse_resolution_));
+    const int64_t iz = static_cast<int64_t>(std::floor(point.z * inverse_resolution_));
+    return (static_cast<uint64_t>(ix + KEY_OFFSET) & KEY_MASK) << 42 |
+           (static_cast<uint64_t>(iy + KEY_OFFSET) & KEY_MASK) << 21 |
+           (static_cast<uint64_t>(iz + KEY_OFFSET) & KEY_MASK);
+  }
+
+  static int64_t unpack(uint64_t key, int shift)
+  {
+    return static_cast<int64_t>((key >> shift) & KEY_MASK) - KEY_OFFSET;
+  }
+
+  static size_t hash(uint64_t key)
+  {
+    // 64 bit finalizer of MurmurHash3, spreads neighbouring voxels over the table
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb3fe1a85ec53ULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key);
+  }
+
+  void rehash(size_t capacity)
+  {
+    std::vector<Voxel> old_slots(capacity, Voxel());
+    old_slots.swap(slots_);
+    mask_ = capacity - 1;
+    for (const auto &voxel : old_slots) {
+      if (voxel.key == EMPTY_KEY) continue;
+      size_t index = hash(voxel.key) & mask_;
+      while (slots_[index].key != EMPTY_KEY) index = (index + 1) & mask_;
+      slots_[index] = voxel;
+    }
+  }
+
+  double resolution_;
+  double inverse_resolution_;
+  size_t size_;
+  std::vector<Voxel> slots_;
+  size_t mask_;
+};
+
+template <typename PointT>
+constexpr uint64_t VoxelHashAccumulator<PointT>::EMPTY_KEY;
+template <typename PointT>
+constexpr int64_t VoxelHashAccumulator<PointT>::KEY_OFFSET;
+template <typename PointT>
+constexpr uint64_t VoxelHashAccumulator<PointT>::KEY_MASK;
+
+}  // namespace pointcloud
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_VOXEL_HASH_ACCUMULATOR_H
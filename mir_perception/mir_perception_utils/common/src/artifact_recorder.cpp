@@ -0,0 +1,171 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <vector>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <pcl/io/pcd_io.h>
+
+#include <mir_perception_utils/artifact_recorder.h>
+
+using namespace mir_perception_utils;
+
+ArtifactRecorder::ArtifactRecorder(size_t max_queue_size, int jpeg_quality, int png_compression)
+    : max_queue_size_(max_queue_size),
+      jpeg_quality_(jpeg_quality),
+      png_compression_(png_compression),
+      writing_(false),
+      stop_(false),
+      dataset_open_(false)
+{
+  writer_ = std::thread(&ArtifactRecorder::run, this);
+}
+
+ArtifactRecorder::~ArtifactRecorder()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queue_condition_.notify_one();
+  writer_.join();
+  std::lock_guard<std::mutex> lock(dataset_mutex_);
+  if (dataset_writer_) dataset_writer_->close();
+}
+
+bool ArtifactRecorder::recordPointCloud(const PointCloud::ConstPtr &cloud,
+                                        const std::string &filename)
+{
+  if (!cloud) return false;
+  Artifact artifact;
+  artifact.filename = filename;
+  artifact.cloud = cloud;
+  return push(std::move(artifact));
+}
+
+bool ArtifactRecorder::recordImage(const cv::Mat &image, const std::string &filename)
+{
+  if (image.empty()) return false;
+  Artifact artifact;
+  artifact.filename = filename;
+  artifact.image = image;
+  return push(std::move(artifact));
+}
+
+bool ArtifactRecorder::openDataset(const std::string &directory, uint64_t max_chunk_size,
+                                   const std::string &image_format)
+{
+  closeDataset();
+  std::lock_guard<std::mutex> dataset_lock(dataset_mutex_);
+  dataset_writer_.reset(new DatasetWriter(max_chunk_size, image_format));
+  if (!dataset_writer_->open(directory)) {
+    dataset_writer_.reset();
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  dataset_open_ = true;
+  return true;
+}
+
+void ArtifactRecorder::closeDataset()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!dataset_open_) return;
+    dataset_open_ = false;
+  }
+  // frames queued before are still appended
+  flush();
+  std::lock_guard<std::mutex> dataset_lock(dataset_mutex_);
+  if (dataset_writer_) dataset_writer_->close();
+  dataset_writer_.reset();
+}
+
+bool ArtifactRecorder::recordFrame(const DatasetFrame &frame)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!dataset_open_) return false;
+  }
+  Artifact artifact;
+  artifact.frame = std::make_shared<DatasetFrame>(frame);
+  return push(std::move(artifact));
+}
+
+bool ArtifactRecorder::push(Artifact &&artifact)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() >= max_queue_size_) {
+      statistics_.dropped++;
+      return false;
+    }
+    queue_.push_back(std::move(artifact));
+    statistics_.queued++;
+  }
+  queue_condition_.notify_one();
+  return true;
+}
+
+void ArtifactRecorder::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_condition_.wait(lock, [this] { return queue_.empty() && !writing_; });
+}
+
+ArtifactRecorderStatistics ArtifactRecorder::getStatistics() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+void ArtifactRecorder::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queue_condition_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) break;  // stopped and drained
+
+    Artifact artifact = std::move(queue_.front());
+    queue_.pop_front();
+    writing_ = true;
+    lock.unlock();
+    const bool success = write(artifact);
+    // release the data before the next artifact is taken
+    artifact = Artifact();
+    lock.lock();
+    writing_ = false;
+    if (success) {
+      statistics_.written++;
+    } else {
+      statistics_.failed++;
+    }
+    if (queue_.empty()) idle_condition_.notify_all();
+  }
+  idle_condition_.notify_all();
+}
+
+bool ArtifactRecorder::write(const Artifact &artifact)
+{
+  try {
+    if (artifact.frame) {
+      std::lock_guard<std::mutex> lock(dataset_mutex_);
+      return dataset_writer_ && dataset_writer_->append(*artifact.frame);
+    }
+    if (artifact.cloud) {
+      return pcl::io::savePCDFileBinaryCompressed(artifact.filename, *artifact.cloud) == 0;
+    }
+    std::vector<int> params;
+    const std::string &name = artifact.filename;
+    if (name.size() >= 4 && name.compare(name.size() - 4, 4, ".png") == 0) {
+      params = {cv::IMWRITE_PNG_COMPRESSION, png_compression_};
+    } else {
+      params = {cv::IMWRITE_JPEG_QUALITY, jpeg_quality_};
+    }
+    return cv::imwrite(artifact.filename, artifact.image, params);
+  } catch (const std::exception &e) {
+    // pcl::IOException and cv::Exception, the recorder has no logger
+    return false;
+  }
+}
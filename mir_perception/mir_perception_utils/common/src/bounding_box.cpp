@@ -6,12 +6,9 @@
  *
  */
 
-#include <limits>
 #include <algorithm>
-#include <opencv2/core/core.hpp>
-#include <opencv2/core/types_c.h>
-#include <opencv2/core/core_c.h>
-#include <opencv2/imgproc/imgproc_c.h>
+#include <cmath>
+#include <limits>
 
 #include <pcl/common/transforms.h>
 
@@ -19,75 +16,211 @@
 
 using namespace mir_perception_utils::object;
 
-BoundingBox BoundingBox::create(const PointCloud::ConstPtr &cloud, const Eigen::Vector3f &normal)
+namespace
+{
+typedef std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f>> Points2D;
+
+inline float cross(const Eigen::Vector2f &o, const Eigen::Vector2f &a, const Eigen::Vector2f &b)
+{
+  return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+}
+
+/** \brief Andrew's monotone chain. Sorts the points in place and writes the
+ * hull in counter clockwise order without collinear points. */
+void convexHull(Points2D &points, Points2D &hull)
+{
+  std::sort(points.begin(), points.end(), [](const Eigen::Vector2f &a, const Eigen::Vector2f &b) {
+    return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
+  });
+  hull.resize(2 * points.size());
+  size_t k = 0;
+  // lower hull
+  for (size_t i = 0; i < points.size(); i++) {
+    while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0.0f) k--;
+    hull[k++] = points[i];
+  }
+  // upper hull
+  for (size_t i = points.size() - 1, lower = k + 1; i > 0; i--) {
+    while (k >= lower && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0.0f) k--;
+    hull[k++] = points[i - 1];
+  }
+  // the last point equals the first one
+  hull.resize(k > 1 ? k - 1 : k);
+}
+
+/** \brief Minimum area rectangle of a convex polygon with rotating calipers.
+ * \param[in] Hull in counter clockwise order
+ * \param[out] Origin of the rectangle
+ * \param[out] Unit vectors along its sides
+ * \param[out] Extents along the sides
+ * */
+void minAreaRect(const Points2D &hull, Eigen::Vector2f &origin, Eigen::Vector2f &u,
+                 Eigen::Vector2f &v, Eigen::Vector2f &size)
 {
-  BoundingBox box;
-
-  // Step 1: transform the cloud so that z-axis as aligned with plane normal.
-  Eigen::Vector3f perpendicular(-normal[1], normal[0], normal[2]);
-  Eigen::Affine3f transform = pcl::getTransFromUnitVectorsZY(normal, perpendicular);
-  Eigen::Affine3f inverse_transform = transform.inverse(Eigen::Isometry);
-  PointCloud cloud_transformed;
-  pcl::transformPointCloud(*cloud, cloud_transformed, transform);
-
-  // Step 2: project cloud onto the plane and calculate bounding box for the
-  // projected points.
-  // Have no idea how this "mem storage" and "seq" beasts work.
-  // Initialization example taken from:
-  // http://opencv.willowgarage.com/documentation/dynamic_structures.html#seqsort
-  CvMemStorage *storage = cvCreateMemStorage(0);
-  CvSeq *points = cvCreateSeq(CV_32SC2, sizeof(CvSeq), sizeof(CvPoint), storage);
-
-  // CvPoints are made of integers, so we will need to scale our points (which
-  // are in meters).
-  const float SCALE = 1000.0;
-  float min_z = std::numeric_limits<float>::max();
-  float max_z = -1 * std::numeric_limits<float>::max();
-
-  for (size_t i = 0; i < cloud_transformed.points.size(); i++) {
-    const PointT &pt = cloud_transformed.points[i];
-    if (!std::isnan(pt.z)) {
-      CvPoint p;
-      p.x = pt.x * SCALE;
-      p.y = pt.y * SCALE;
-      cvSeqPush(points, &p);
-      if (pt.z > max_z) max_z = pt.z;
-      if (pt.z < min_z) min_z = pt.z;
+  const size_t n = hull.size();
+  origin = hull[0];
+  u = Eigen::Vector2f::UnitX();
+  v = Eigen::Vector2f::UnitY();
+  size.setZero();
+  if (n < 2) return;
+
+  if (n == 2) {
+    const Eigen::Vector2f edge = hull[1] - hull[0];
+    u = edge.normalized();
+    v = Eigen::Vector2f(-u[1], u[0]);
+    size[0] = edge.norm();
+    return;
+  }
+
+  // All points are on the left of a counter clockwise edge, so the edge is
+  // one side of the rectangle and three calipers track the other sides.
+  size_t right = 1, top = 1, left = 1;
+  float best_area = std::numeric_limits<float>::max();
+  for (size_t i = 0; i < n; i++) {
+    const Eigen::Vector2f &p = hull[i];
+    const Eigen::Vector2f edge = hull[(i + 1) % n] - p;
+    const float length = edge.norm();
+    if (length <= 0.0f) continue;
+    const Eigen::Vector2f edge_u = edge / length;
+    const Eigen::Vector2f edge_v(-edge_u[1], edge_u[0]);
+
+    while (edge_u.dot(hull[(right + 1) % n] - p) > edge_u.dot(hull[right] - p))
+      right = (right + 1) % n;
+    if (i == 0) top = right;
+    while (edge_v.dot(hull[(top + 1) % n] - p) > edge_v.dot(hull[top] - p)) top = (top + 1) % n;
+    if (i == 0) left = top;
+    while (edge_u.dot(hull[(left + 1) % n] - p) < edge_u.dot(hull[left] - p))
+      left = (left + 1) % n;
+
+    const float min_u = edge_u.dot(hull[left] - p);
+    const float max_u = edge_u.dot(hull[right] - p);
+    const float max_v = edge_v.dot(hull[top] - p);
+    const float area = (max_u - min_u) * max_v;
+    if (area < best_area) {
+      best_area = area;
+      origin = p + min_u * edge_u;
+      u = edge_u;
+      v = edge_v;
+      size << max_u - min_u, max_v;
     }
   }
+}
+}  // namespace
 
-  CvBox2D box2d = cvMinAreaRect2(points);
-  cvReleaseMemStorage(&storage);
-  box.dimensions_[0] = max_z - min_z;
-  box.dimensions_[1] = std::max(box2d.size.width, box2d.size.height) / SCALE;
-  box.dimensions_[2] = std::min(box2d.size.width, box2d.size.height) / SCALE;
-  box.center_[0] = box2d.center.x / SCALE;
-  box.center_[1] = box2d.center.y / SCALE;
-  box.center_[2] = min_z + box.dimensions_[0] / 2.0;
-  box.center_ = inverse_transform * box.center_;
-
-  cv::Point2f vertices[4];
-  cv::RotatedRect(box2d).points(vertices);
-  for (size_t i = 0; i < 4; i++) {
-    const cv::Point2f &pt = vertices[i];
-    Eigen::Vector3f p;
-    p << pt.x / SCALE, pt.y / SCALE, min_z;
-    box.vertices_.push_back(inverse_transform * p);
+class BoundingBox::Fitter
+{
+ public:
+  explicit Fitter(const Eigen::Vector3f &normal)
+  {
+    // z-axis of the plane frame is aligned with the plane normal
+    Eigen::Vector3f perpendicular(-normal[1], normal[0], normal[2]);
+    Eigen::Affine3f transform = pcl::getTransFromUnitVectorsZY(normal, perpendicular);
+    rotation_ = transform.linear();
+    translation_ = transform.translation();
+    inverse_transform_ = transform.inverse(Eigen::Isometry);
   }
-  for (size_t i = 0; i < 4; i++) {
-    const cv::Point2f &pt = vertices[i];
-    Eigen::Vector3f p;
-    p << pt.x / SCALE, pt.y / SCALE, max_z;
-    box.vertices_.push_back(inverse_transform * p);
+
+  /** \brief Fit a box around the points given by a point accessor */
+  template <typename PointAt>
+  BoundingBox fit(size_t size, const PointAt &point_at)
+  {
+    points_.clear();
+    points_.reserve(size);
+    float min_z = std::numeric_limits<float>::max();
+    float max_z = -1 * std::numeric_limits<float>::max();
+    for (size_t i = 0; i < size; i++) {
+      const PointT &pt = point_at(i);
+      if (std::isnan(pt.z)) continue;
+      const Eigen::Vector3f p = rotation_ * pt.getVector3fMap() + translation_;
+      points_.emplace_back(p[0], p[1]);
+      if (p[2] > max_z) max_z = p[2];
+      if (p[2] < min_z) min_z = p[2];
+    }
+
+    // degenerate box in the origin of the plane frame, still with 8 vertices
+    if (points_.empty()) {
+      points_.emplace_back(0.0f, 0.0f);
+      min_z = max_z = 0.0f;
+    }
+
+    BoundingBox box;
+    convexHull(points_, hull_);
+    Eigen::Vector2f origin, u, v, size2d;
+    minAreaRect(hull_, origin, u, v, size2d);
+
+    box.dimensions_[0] = max_z - min_z;
+    box.dimensions_[1] = size2d.maxCoeff();
+    box.dimensions_[2] = size2d.minCoeff();
+    const Eigen::Vector2f center = origin + 0.5f * size2d[0] * u + 0.5f * size2d[1] * v;
+    box.center_ << center[0], center[1], min_z + box.dimensions_[0] / 2.0;
+    box.center_ = inverse_transform_ * box.center_;
+
+    const Eigen::Vector2f corners[4] = {origin, origin + size2d[0] * u,
+                                        origin + size2d[0] * u + size2d[1] * v,
+                                        origin + size2d[1] * v};
+    box.vertices_.reserve(8);
+    for (const float z : {min_z, max_z}) {
+      for (size_t i = 0; i < 4; i++) {
+        box.vertices_.push_back(inverse_transform_ *
+                                Eigen::Vector3f(corners[i][0], corners[i][1], z));
+      }
+    }
+    return box;
   }
-  return box;
+
+ private:
+  Eigen::Matrix3f rotation_;
+  Eigen::Vector3f translation_;
+  Eigen::Affine3f inverse_transform_;
+  // scratch buffers, reused for all clusters of a batch
+  Points2D points_;
+  Points2D hull_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+BoundingBox BoundingBox::create(const PointCloud::ConstPtr &cloud, const Eigen::Vector3f &normal)
+{
+  return create(cloud->points, normal);
 }
 
 BoundingBox BoundingBox::create(const PointCloud::VectorType &points, const Eigen::Vector3f &normal)
 {
-  PointCloud::Ptr cloud(new PointCloud);
-  cloud->points = points;
-  cloud->width = points.size();
-  cloud->height = 1;
-  return create(cloud, normal);
+  Fitter fitter(normal);
+  return fitter.fit(points.size(), [&points](size_t i) -> const PointT & { return points[i]; });
+}
+
+BoundingBox BoundingBox::create(const PointCloud &cloud, const std::vector<int> &indices,
+                                const Eigen::Vector3f &normal)
+{
+  Fitter fitter(normal);
+  return fitter.fit(indices.size(), [&cloud, &indices](size_t i) -> const PointT & {
+    return cloud.points[indices[i]];
+  });
+}
+
+void BoundingBox::create(const std::vector<PointCloud::Ptr> &clusters,
+                         const Eigen::Vector3f &normal, std::vector<BoundingBox> &boxes)
+{
+  Fitter fitter(normal);
+  boxes.reserve(boxes.size() + clusters.size());
+  for (const auto &cluster : clusters) {
+    const PointCloud::VectorType &points = cluster->points;
+    boxes.push_back(
+        fitter.fit(points.size(), [&points](size_t i) -> const PointT & { return points[i]; }));
+  }
+}
+
+void BoundingBox::create(const PointCloud &cloud, const std::vector<pcl::PointIndices> &clusters,
+                         const Eigen::Vector3f &normal, std::vector<BoundingBox> &boxes)
+{
+  Fitter fitter(normal);
+  boxes.reserve(boxes.size() + clusters.size());
+  for (const auto &cluster : clusters) {
+    const std::vector<int> &indices = cluster.indices;
+    boxes.push_back(fitter.fit(indices.size(), [&cloud, &indices](size_t i) -> const PointT & {
+      return cloud.points[indices[i]];
+    }));
+  }
 }
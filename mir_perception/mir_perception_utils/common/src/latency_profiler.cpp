@@ -0,0 +1,271 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+#include <mir_perception_utils/latency_profiler.h>
+
+using namespace mir_perception_utils;
+
+/** \brief Ring buffer written by exactly one thread and drained by the collector.
+ *
+ * The writer claims a slot before it overwrites it, so the collector can tell
+ * whether a slot it has read was reused in the meantime, like a seqlock.
+ */
+class LatencyProfiler::ThreadBuffer
+{
+ public:
+  static const uint64_t CAPACITY = 4096;
+
+  explicit ThreadBuffer(int id)
+      : id_(id), in_use(true), slots_(new Slot[CAPACITY]), claimed_(0), head_(0), read_(0)
+  {
+  }
+
+  int id() const { return id_; }
+
+  /** \brief Append a sample (owning thread only) */
+  void push(int stage, int64_t start_ns, int64_t duration_ns)
+  {
+    const uint64_t index = head_.load(std::memory_order_relaxed);
+    claimed_.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot &slot = slots_[index % CAPACITY];
+    slot.stage.store(stage, std::memory_order_relaxed);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(duration_ns, std::memory_order_relaxed);
+    head_.store(index + 1, std::memory_order_release);
+  }
+
+  /** \brief Append the samples written since the last call (collector only)
+   * \param[out] Samples
+   * \return Number of samples that were overwritten before they could be read
+   * */
+  uint64_t drain(std::vector<TraceEvent> &events)
+  {
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t begin = read_;
+    uint64_t lost = 0;
+    if (head - begin > CAPACITY) {
+      lost += head - CAPACITY - begin;
+      begin = head - CAPACITY;
+    }
+    const size_t first = events.size();
+    for (uint64_t i = begin; i < head; i++) {
+      const Slot &slot = slots_[i % CAPACITY];
+      TraceEvent event;
+      event.stage = slot.stage.load(std::memory_order_relaxed);
+      event.thread = id_;
+      event.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+      event.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+      events.push_back(event);
+    }
+    read_ = head;
+
+    // samples whose slot has been claimed again since may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t claimed = claimed_.load(std::memory_order_relaxed);
+    if (claimed > begin + CAPACITY) {
+      const uint64_t torn = std::min<uint64_t>(claimed - begin - CAPACITY, head - begin);
+      events.erase(events.begin() + first, events.begin() + first + torn);
+      lost += torn;
+    }
+    return lost;
+  }
+
+ private:
+  struct Slot
+  {
+    std::atomic<int> stage;
+    std::atomic<int64_t> start_ns;
+    std::atomic<int64_t> duration_ns;
+  };
+
+  int id_;
+
+ public:
+  /** false once the owning thread has exited, the buffer is then reused */
+  std::atomic<bool> in_use;
+
+ private:
+  std::unique_ptr<Slot[]> slots_;
+  // written by the owning thread only
+  char pad_writer_[64];
+  std::atomic<uint64_t> claimed_;
+  std::atomic<uint64_t> head_;
+  // read by the collector only
+  char pad_reader_[64];
+  uint64_t read_;
+};
+
+LatencyProfiler::LatencyProfiler()
+    : enabled_(true), lost_samples_(0), window_size_(1000), trace_capacity_(0)
+{
+}
+
+LatencyProfiler &LatencyProfiler::instance()
+{
+  static LatencyProfiler profiler;
+  return profiler;
+}
+
+int LatencyProfiler::registerStage(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  const auto it = std::find(stages_.begin(), stages_.end(), name);
+  if (it != stages_.end()) return static_cast<int>(it - stages_.begin());
+  stages_.push_back(name);
+  return static_cast<int>(stages_.size()) - 1;
+}
+
+LatencyProfiler::ThreadBuffer &LatencyProfiler::threadBuffer()
+{
+  // releases the buffer for reuse when the thread exits
+  struct Handle
+  {
+    std::shared_ptr<ThreadBuffer> buffer;
+    ~Handle()
+    {
+      if (buffer) buffer->in_use.store(false, std::memory_order_release);
+    }
+  };
+  thread_local Handle handle;
+  if (handle.buffer) return *handle.buffer;
+
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  for (const auto &buffer : buffers_) {
+    bool in_use = false;
+    if (buffer->in_use.compare_exchange_strong(in_use, true)) {
+      handle.buffer = buffer;
+      return *buffer;
+    }
+  }
+  handle.buffer = std::make_shared<ThreadBuffer>(static_cast<int>(buffers_.size()));
+  buffers_.push_back(handle.buffer);
+  return *handle.buffer;
+}
+
+void LatencyProfiler::record(int stage, int64_t start_ns, int64_t end_ns)
+{
+  if (stage < 0 || !isEnabled()) return;
+  threadBuffer().push(stage, start_ns, end_ns - start_ns);
+}
+
+void LatencyProfiler::setWindowSize(size_t window_size)
+{
+  std::lock_guard<std::mutex> lock(collect_mutex_);
+  window_size_ = std::max<size_t>(1, window_size);
+  for (auto &window : windows_) {
+    window.durations.clear();
+    window.next = 0;
+  }
+}
+
+void LatencyProfiler::setTraceCapacity(size_t trace_capacity)
+{
+  std::lock_guard<std::mutex> lock(collect_mutex_);
+  trace_capacity_ = trace_capacity;
+  while (trace_.size() > trace_capacity_) trace_.pop_front();
+}
+
+void LatencyProfiler::collect()
+{
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  size_t num_stages = 0;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    buffers = buffers_;
+    num_stages = stages_.size();
+  }
+  if (windows_.size() < num_stages) windows_.resize(num_stages, StageWindow{{}, 0, 0});
+
+  std::vector<TraceEvent> events;
+  for (const auto &buffer : buffers) {
+    events.clear();
+    lost_samples_.fetch_add(buffer->drain(events), std::memory_order_relaxed);
+    for (const TraceEvent &event : events) {
+      if (event.stage < 0 || static_cast<size_t>(event.stage) >= windows_.size()) continue;
+      StageWindow &window = windows_[event.stage];
+      if (window.durations.size() < window_size_) {
+        window.durations.push_back(event.duration_ns);
+      } else {
+        window.durations[window.next] = event.duration_ns;
+      }
+      window.next = (window.next + 1) % window_size_;
+      window.count++;
+
+      if (trace_capacity_ > 0) {
+        if (trace_.size() >= trace_capacity_) trace_.pop_front();
+        trace_.push_back(event);
+      }
+    }
+  }
+}
+
+void LatencyProfiler::getStatistics(std::vector<LatencyStatistics> &statistics)
+{
+  std::vector<std::string> stages;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    stages = stages_;
+  }
+
+  std::lock_guard<std::mutex> lock(collect_mutex_);
+  collect();
+  statistics.clear();
+  for (size_t i = 0; i < windows_.size() && i < stages.size(); i++) {
+    const StageWindow &window = windows_[i];
+    if (window.durations.empty()) continue;
+
+    // nearest rank percentiles on a copy of the window
+    scratch_ = window.durations;
+    const size_t n = scratch_.size();
+    auto percentile = [this, n](double p) {
+      const size_t rank = static_cast<size_t>(std::ceil(p * n));
+      const size_t index = std::min(n - 1, rank > 0 ? rank - 1 : 0);
+      std::nth_element(scratch_.begin(), scratch_.begin() + index, scratch_.end());
+      return scratch_[index] * 1e-6;
+    };
+    LatencyStatistics stage_statistics;
+    stage_statistics.stage = stages[i];
+    stage_statistics.count = window.count;
+    stage_statistics.window = n;
+    stage_statistics.p50_ms = percentile(0.5);
+    stage_statistics.p95_ms = percentile(0.95);
+    stage_statistics.p99_ms = percentile(0.99);
+    stage_statistics.max_ms = *std::max_element(scratch_.begin(), scratch_.end()) * 1e-6;
+    statistics.push_back(stage_statistics);
+  }
+}
+
+bool LatencyProfiler::writeChromeTrace(const std::string &filename)
+{
+  std::vector<std::string> stages;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    stages = stages_;
+  }
+
+  std::lock_guard<std::mutex> lock(collect_mutex_);
+  collect();
+  std::ofstream file(filename.c_str());
+  if (!file) return false;
+
+  // complete events with microsecond timestamps, one track per thread
+  file << "{\"traceEvents\":[";
+  file << std::fixed << std::setprecision(3);
+  bool first = true;
+  for (const TraceEvent &event : trace_) {
+    if (event.stage < 0 || static_cast<size_t>(event.stage) >= stages.size()) continue;
+    file << (first ? "\n" : ",\n") << "{\"name\":\"" << stages[event.stage]
+         << "\",\"cat\":\"perception\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+         << ",\"ts\":" << event.start_ns * 1e-3 << ",\"dur\":" << event.duration_ns * 1e-3 << "}";
+    first = false;
+  }
+  file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return static_cast<bool>(file);
+}
@@ -0,0 +1,594 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <mir_perception_utils/perception_dataset.h>
+
+using namespace mir_perception_utils;
+
+namespace fs = boost::filesystem;
+
+/* Chunk layout, all numbers little endian:
+ *   "MPUDSET1"
+ *   records: header {u32 magic, u32 kind, u32 object index, u32 reserved, u64 size}, payload
+ *   index record: {u32 kind, u32 object index, u64 payload offset, u64 size} per record
+ *   trailer: {u64 offset of the index payload, "MPUDIDX1"}
+ */
+namespace
+{
+const char CHUNK_MAGIC[8] = {'M', 'P', 'U', 'D', 'S', 'E', 'T', '1'};
+const char INDEX_MAGIC[8] = {'M', 'P', 'U', 'D', 'I', 'D', 'X', '1'};
+const uint32_t RECORD_MAGIC = 0x5244504d;  // "MPDR"
+const size_t RECORD_HEADER_SIZE = 24;
+const size_t INDEX_ENTRY_SIZE = 24;
+const size_t TRAILER_SIZE = 16;
+// size of a packed point, x, y, z and rgba
+const size_t POINT_SIZE = 16;
+// smallest object entry of a frame record, an empty label and the pose
+const uint64_t MIN_OBJECT_ENTRY_SIZE = sizeof(uint32_t) + 7 * sizeof(double);
+
+enum RecordKind
+{
+  FRAME = 1,
+  CLOUD = 2,
+  IMAGE = 3,
+  CLUSTER = 4,
+  OBJECT_IMAGE = 5,
+  INDEX = 6
+};
+
+const std::string CHUNK_PREFIX = "chunk_";
+const std::string CHUNK_EXTENSION = ".mpd";
+
+class BufferWriter
+{
+ public:
+  explicit BufferWriter(std::vector<uint8_t> &buffer) : buffer_(buffer) {}
+
+  template <typename T>
+  void put(const T &value)
+  {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    buffer_.insert(buffer_.end(), bytes, bytes + sizeof(T));
+  }
+
+  void putString(const std::string &value)
+  {
+    put<uint32_t>(value.size());
+    buffer_.insert(buffer_.end(), value.begin(), value.end());
+  }
+
+  void putPose(const Eigen::Vector3d &position, const Eigen::Quaterniond &orientation)
+  {
+    for (int i = 0; i < 3; i++) put<double>(position[i]);
+    put<double>(orientation.x());
+    put<double>(orientation.y());
+    put<double>(orientation.z());
+    put<double>(orientation.w());
+  }
+
+ private:
+  std::vector<uint8_t> &buffer_;
+};
+
+/** \brief Bounds checked reads, every read fails after the first overflow */
+class BufferReader
+{
+ public:
+  BufferReader(const uint8_t *data, uint64_t size) : data_(data), size_(size), position_(0), ok_(true)
+  {
+  }
+
+  template <typename T>
+  T get()
+  {
+    T value = T();
+    if (!ok_ || position_ + sizeof(T) > size_) {
+      ok_ = false;
+      return value;
+    }
+    std::memcpy(&value, data_ + position_, sizeof(T));
+    position_ += sizeof(T);
+    return value;
+  }
+
+  std::string getString()
+  {
+    const uint32_t length = get<uint32_t>();
+    if (!ok_ || position_ + length > size_) {
+      ok_ = false;
+      return std::string();
+    }
+    std::string value(reinterpret_cast<const char *>(data_ + position_), length);
+    position_ += length;
+    return value;
+  }
+
+  void getPose(Eigen::Vector3d &position, Eigen::Quaterniond &orientation)
+  {
+    for (int i = 0; i < 3; i++) position[i] = get<double>();
+    const double x = get<double>();
+    const double y = get<double>();
+    const double z = get<double>();
+    const double w = get<double>();
+    orientation = Eigen::Quaterniond(w, x, y, z);
+  }
+
+  bool ok() const { return ok_; }
+
+  /** \brief Number of bytes not read yet, 0 after an overflow */
+  uint64_t remaining() const { return ok_ ? size_ - position_ : 0; }
+
+ private:
+  const uint8_t *data_;
+  uint64_t size_;
+  uint64_t position_;
+  bool ok_;
+};
+
+void encodeCloud(const PointCloud &cloud, std::vector<uint8_t> &payload)
+{
+  BufferWriter writer(payload);
+  writer.put<uint32_t>(cloud.width);
+  writer.put<uint32_t>(cloud.height);
+  writer.put<uint32_t>(cloud.is_dense ? 1 : 0);
+  writer.put<uint32_t>(cloud.points.size());
+  const size_t header_size = payload.size();
+  payload.resize(header_size + cloud.points.size() * POINT_SIZE);
+  uint8_t *dst = payload.data() + header_size;
+  for (const PointT &point : cloud.points) {
+    std::memcpy(dst, point.data, 3 * sizeof(float));
+    std::memcpy(dst + 3 * sizeof(float), &point.rgba, sizeof(uint32_t));
+    dst += POINT_SIZE;
+  }
+}
+
+PointCloud::Ptr decodeCloud(const uint8_t *data, uint64_t size)
+{
+  BufferReader reader(data, size);
+  const uint32_t width = reader.get<uint32_t>();
+  const uint32_t height = reader.get<uint32_t>();
+  const bool is_dense = reader.get<uint32_t>() != 0;
+  const uint32_t num_points = reader.get<uint32_t>();
+  const uint64_t header_size = 4 * sizeof(uint32_t);
+  if (!reader.ok() || header_size + static_cast<uint64_t>(num_points) * POINT_SIZE > size ||
+      static_cast<uint64_t>(width) * height != num_points) {
+    return PointCloud::Ptr();
+  }
+  PointCloud::Ptr cloud(new PointCloud);
+  cloud->points.resize(num_points);
+  const uint8_t *src = data + header_size;
+  for (PointT &point : cloud->points) {
+    std::memcpy(point.data, src, 3 * sizeof(float));
+    point.data[3] = 1.0f;
+    std::memcpy(&point.rgba, src + 3 * sizeof(float), sizeof(uint32_t));
+    src += POINT_SIZE;
+  }
+  cloud->width = width;
+  cloud->height = height;
+  cloud->is_dense = is_dense;
+  return cloud;
+}
+
+cv::Mat decodeImage(const uint8_t *data, uint64_t size)
+{
+  const cv::Mat buffer(1, static_cast<int>(size), CV_8UC1, const_cast<uint8_t *>(data));
+  return cv::imdecode(buffer, cv::IMREAD_UNCHANGED);
+}
+
+/** \brief Chunk number of a chunk file name, -1 for other files */
+int chunkNumber(const fs::path &path)
+{
+  const std::string name = path.filename().string();
+  if (name.size() <= CHUNK_PREFIX.size() + CHUNK_EXTENSION.size() ||
+      name.compare(0, CHUNK_PREFIX.size(), CHUNK_PREFIX) != 0 ||
+      path.extension().string() != CHUNK_EXTENSION) {
+    return -1;
+  }
+  const std::string number = name.substr(
+      CHUNK_PREFIX.size(), name.size() - CHUNK_PREFIX.size() - CHUNK_EXTENSION.size());
+  if (number.find_first_not_of("0123456789") != std::string::npos) return -1;
+  return std::stoi(number);
+}
+
+/** \brief Chunk files of the directory, ordered by their number */
+std::vector<fs::path> listChunks(const fs::path &directory)
+{
+  std::vector<std::pair<int, fs::path>> chunks;
+  if (!fs::is_directory(directory)) return std::vector<fs::path>();
+  for (fs::directory_iterator it(directory); it != fs::directory_iterator(); ++it) {
+    const int number = chunkNumber(it->path());
+    if (number >= 0 && fs::is_regular_file(it->status())) chunks.emplace_back(number, it->path());
+  }
+  std::sort(chunks.begin(), chunks.end());
+  std::vector<fs::path> paths;
+  for (const auto &chunk : chunks) paths.push_back(chunk.second);
+  return paths;
+}
+}  // namespace
+
+DatasetWriter::DatasetWriter(uint64_t max_chunk_size, const std::string &image_format,
+                             int jpeg_quality)
+    : max_chunk_size_(max_chunk_size),
+      image_format_(image_format),
+      next_chunk_(0),
+      chunk_(NULL),
+      chunk_size_(0),
+      frame_count_(0)
+{
+  if (image_format_ == ".png") {
+    // fast compression, the images are written while recording
+    image_params_ = {cv::IMWRITE_PNG_COMPRESSION, 1};
+  } else {
+    image_format_ = ".jpg";
+    image_params_ = {cv::IMWRITE_JPEG_QUALITY, jpeg_quality};
+  }
+}
+
+DatasetWriter::~DatasetWriter() { close(); }
+
+bool DatasetWriter::open(const std::string &directory)
+{
+  close();
+  boost::system::error_code error;
+  fs::create_directories(directory, error);
+  if (!fs::is_directory(directory)) return false;
+
+  // existing chunks are kept, new frames go into new chunks
+  const std::vector<fs::path> chunks = listChunks(directory);
+  next_chunk_ = chunks.empty() ? 0 : chunkNumber(chunks.back()) + 1;
+  directory_ = directory;
+  frame_count_ = 0;
+  return true;
+}
+
+bool DatasetWriter::append(const DatasetFrame &frame)
+{
+  if (!isOpen()) return false;
+  if (chunk_ && chunk_size_ >= max_chunk_size_ && !closeChunk()) return false;
+  if (!chunk_ && !openChunk()) return false;
+
+  std::vector<uint8_t> payload;
+  BufferWriter writer(payload);
+  writer.put<uint64_t>(frame.stamp_ns);
+  writer.put<uint32_t>(frame.objects.size());
+  writer.put<uint32_t>(frame.transforms.size());
+  writer.putString(frame.frame_id);
+  for (const DatasetTransform &transform : frame.transforms) {
+    writer.putString(transform.target_frame);
+    writer.putString(transform.source_frame);
+    writer.putPose(transform.translation, transform.rotation);
+  }
+  for (const DatasetObject &object : frame.objects) {
+    writer.putString(object.label);
+    writer.putPose(object.position, object.orientation);
+  }
+  if (!writeRecord(FRAME, 0, payload)) return false;
+
+  if (frame.cloud) {
+    payload.clear();
+    encodeCloud(*frame.cloud, payload);
+    if (!writeRecord(CLOUD, 0, payload)) return false;
+  }
+  if (!frame.image.empty()) {
+    payload.clear();
+    if (!cv::imencode(image_format_, frame.image, payload, image_params_)) return false;
+    if (!writeRecord(IMAGE, 0, payload)) return false;
+  }
+  for (size_t i = 0; i < frame.objects.size(); i++) {
+    const DatasetObject &object = frame.objects[i];
+    if (object.cluster) {
+      payload.clear();
+      encodeCloud(*object.cluster, payload);
+      if (!writeRecord(CLUSTER, i, payload)) return false;
+    }
+    if (!object.image.empty()) {
+      payload.clear();
+      if (!cv::imencode(image_format_, object.image, payload, image_params_)) return false;
+      if (!writeRecord(OBJECT_IMAGE, i, payload)) return false;
+    }
+  }
+  frame_count_++;
+  // complete frames can be read back even if the writer does not close
+  return std::fflush(chunk_) == 0;
+}
+
+bool DatasetWriter::close()
+{
+  const bool success = closeChunk();
+  directory_.clear();
+  return success;
+}
+
+bool DatasetWriter::openChunk()
+{
+  std::ostringstream name;
+  name << CHUNK_PREFIX << std::setw(6) << std::setfill('0') << next_chunk_++ << CHUNK_EXTENSION;
+  const fs::path path = fs::path(directory_) / name.str();
+  chunk_ = std::fopen(path.string().c_str(), "wb");
+  if (!chunk_) return false;
+  chunk_size_ = 0;
+  index_.clear();
+  if (std::fwrite(CHUNK_MAGIC, 1, sizeof(CHUNK_MAGIC), chunk_) != sizeof(CHUNK_MAGIC)) return false;
+  chunk_size_ = sizeof(CHUNK_MAGIC);
+  return true;
+}
+
+bool DatasetWriter::closeChunk()
+{
+  if (!chunk_) return true;
+  std::vector<uint8_t> payload;
+  BufferWriter writer(payload);
+  for (const IndexEntry &entry : index_) {
+    writer.put<uint32_t>(entry.kind);
+    writer.put<uint32_t>(entry.object_index);
+    writer.put<uint64_t>(entry.offset);
+    writer.put<uint64_t>(entry.size);
+  }
+  const uint64_t index_offset = chunk_size_ + RECORD_HEADER_SIZE;
+  bool success = writeRecord(INDEX, 0, payload);
+  success = success && std::fwrite(&index_offset, sizeof(index_offset), 1, chunk_) == 1;
+  success = success && std::fwrite(INDEX_MAGIC, 1, sizeof(INDEX_MAGIC), chunk_) == sizeof(INDEX_MAGIC);
+  success = (std::fclose(chunk_) == 0) && success;
+  chunk_ = NULL;
+  index_.clear();
+  return success;
+}
+
+bool DatasetWriter::writeRecord(uint32_t kind, uint32_t object_index,
+                                const std::vector<uint8_t> &payload)
+{
+  std::vector<uint8_t> header;
+  BufferWriter writer(header);
+  writer.put<uint32_t>(RECORD_MAGIC);
+  writer.put<uint32_t>(kind);
+  writer.put<uint32_t>(object_index);
+  writer.put<uint32_t>(0);
+  writer.put<uint64_t>(payload.size());
+  if (std::fwrite(header.data(), 1, header.size(), chunk_) != header.size()) return false;
+  if (!payload.empty() && std::fwrite(payload.data(), 1, payload.size(), chunk_) != payload.size())
+    return false;
+  if (kind != INDEX) {
+    IndexEntry entry;
+    entry.kind = kind;
+    entry.object_index = object_index;
+    entry.offset = chunk_size_ + RECORD_HEADER_SIZE;
+    entry.size = payload.size();
+    index_.push_back(entry);
+  }
+  chunk_size_ += RECORD_HEADER_SIZE + payload.size();
+  return true;
+}
+
+/** \brief Read only memory map of a chunk file */
+struct DatasetReader::MappedChunk
+{
+  MappedChunk() : data(NULL), size(0) {}
+  ~MappedChunk()
+  {
+    if (data) munmap(const_cast<uint8_t *>(data), size);
+  }
+
+  bool map(const std::string &path)
+  {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void *address = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the file is closed
+    ::close(fd);
+    if (address == MAP_FAILED) return false;
+    data = static_cast<const uint8_t *>(address);
+    size = status.st_size;
+    return true;
+  }
+
+  const uint8_t *data;
+  uint64_t size;
+};
+
+DatasetReader::DatasetReader() : skip_frame_data_(false) {}
+
+DatasetReader::~DatasetReader() {}
+
+bool DatasetReader::open(const std::string &directory)
+{
+  chunks_.clear();
+  frames_.clear();
+  objects_.clear();
+  skip_frame_data_ = false;
+  for (const fs::path &path : listChunks(directory)) addChunk(path.string());
+  return !chunks_.empty();
+}
+
+bool DatasetReader::addChunk(const std::string &path)
+{
+  std::unique_ptr<MappedChunk> chunk(new MappedChunk);
+  if (!chunk->map(path) || chunk->size < sizeof(CHUNK_MAGIC) ||
+      std::memcmp(chunk->data, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0) {
+    return false;
+  }
+  const size_t chunk_index = chunks_.size();
+  const uint8_t *data = chunk->data;
+  const uint64_t size = chunk->size;
+  chunks_.push_back(std::move(chunk));
+
+  // index of a closed chunk
+  if (size >= sizeof(CHUNK_MAGIC) + RECORD_HEADER_SIZE + TRAILER_SIZE &&
+      std::memcmp(data + size - sizeof(INDEX_MAGIC), INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0) {
+    uint64_t index_offset;
+    std::memcpy(&index_offset, data + size - TRAILER_SIZE, sizeof(index_offset));
+    const uint64_t index_end = size - TRAILER_SIZE;
+    if (index_offset <= index_end && (index_end - index_offset) % INDEX_ENTRY_SIZE == 0) {
+      BufferReader reader(data + index_offset, index_end - index_offset);
+      for (uint64_t i = 0; i < (index_end - index_offset) / INDEX_ENTRY_SIZE; i++) {
+        const uint32_t kind = reader.get<uint32_t>();
+        const uint32_t object_index = reader.get<uint32_t>();
+        Record record;
+        record.chunk = chunk_index;
+        record.offset = reader.get<uint64_t>();
+        record.size = reader.get<uint64_t>();
+        if (record.offset > index_offset || record.size > index_offset - record.offset) break;
+        addRecord(kind, object_index, record);
+      }
+      return true;
+    }
+  }
+
+  // chunk of a writer that did not close, scanned up to the first incomplete record
+  uint64_t offset = sizeof(CHUNK_MAGIC);
+  while (offset + RECORD_HEADER_SIZE <= size) {
+    BufferReader reader(data + offset, RECORD_HEADER_SIZE);
+    const uint32_t magic = reader.get<uint32_t>();
+    const uint32_t kind = reader.get<uint32_t>();
+    const uint32_t object_index = reader.get<uint32_t>();
+    reader.get<uint32_t>();
+    Record record;
+    record.chunk = chunk_index;
+    record.offset = offset + RECORD_HEADER_SIZE;
+    record.size = reader.get<uint64_t>();
+    if (magic != RECORD_MAGIC || kind == INDEX || record.size > size - record.offset) break;
+    addRecord(kind, object_index, record);
+    offset = record.offset + record.size;
+  }
+  return true;
+}
+
+void DatasetReader::addRecord(uint32_t kind, uint32_t object_index, const Record &record)
+{
+  if (kind == FRAME) {
+    BufferReader reader(data(record), record.size);
+    reader.get<uint64_t>();
+    const uint32_t object_count = reader.get<uint32_t>();
+    const uint32_t transform_count = reader.get<uint32_t>();
+    reader.getString();
+    Eigen::Vector3d position;
+    Eigen::Quaterniond orientation;
+    for (uint32_t i = 0; i < transform_count && reader.ok(); i++) {
+      reader.getString();
+      reader.getString();
+      reader.getPose(position, orientation);
+    }
+    // a truncated or corrupt record can not hold its objects, it is skipped with its data
+    skip_frame_data_ =
+        !reader.ok() || object_count * MIN_OBJECT_ENTRY_SIZE > reader.remaining();
+    if (skip_frame_data_) return;
+    FrameEntry entry;
+    entry.frame = record;
+    entry.first_object = objects_.size();
+    entry.object_count = object_count;
+    frames_.push_back(entry);
+    for (uint32_t i = 0; i < object_count; i++) {
+      ObjectEntry object;
+      object.frame = frames_.size() - 1;
+      object.index = i;
+      objects_.push_back(object);
+    }
+    return;
+  }
+  // data records belong to the last frame
+  if (frames_.empty() || skip_frame_data_) return;
+  FrameEntry &frame = frames_.back();
+  if (kind == CLOUD) {
+    frame.cloud = record;
+  } else if (kind == IMAGE) {
+    frame.image = record;
+  } else if ((kind == CLUSTER || kind == OBJECT_IMAGE) && object_index < frame.object_count) {
+    ObjectEntry &object = objects_[frame.first_object + object_index];
+    if (kind == CLUSTER) {
+      object.cluster = record;
+    } else {
+      object.image = record;
+    }
+  }
+}
+
+const uint8_t *DatasetReader::data(const Record &record) const
+{
+  return chunks_[record.chunk]->data + record.offset;
+}
+
+bool DatasetReader::readFrameRecord(const FrameEntry &entry, DatasetFrame &frame) const
+{
+  BufferReader reader(data(entry.frame), entry.frame.size);
+  frame = DatasetFrame();
+  frame.stamp_ns = reader.get<uint64_t>();
+  const uint32_t object_count = reader.get<uint32_t>();
+  const uint32_t transform_count = reader.get<uint32_t>();
+  frame.frame_id = reader.getString();
+  for (uint32_t i = 0; i < transform_count && reader.ok(); i++) {
+    DatasetTransform transform;
+    transform.target_frame = reader.getString();
+    transform.source_frame = reader.getString();
+    reader.getPose(transform.translation, transform.rotation);
+    frame.transforms.push_back(transform);
+  }
+  for (uint32_t i = 0; i < object_count && reader.ok(); i++) {
+    DatasetObject object;
+    object.label = reader.getString();
+    reader.getPose(object.position, object.orientation);
+    frame.objects.push_back(object);
+  }
+  return reader.ok();
+}
+
+bool DatasetReader::readFrame(size_t frame_index, DatasetFrame &frame, bool read_data,
+                              bool read_object_data) const
+{
+  if (frame_index >= frames_.size()) return false;
+  const FrameEntry &entry = frames_[frame_index];
+  if (!readFrameRecord(entry, frame)) return false;
+
+  if (read_data) {
+    if (entry.cloud.size > 0) {
+      frame.cloud = decodeCloud(data(entry.cloud), entry.cloud.size);
+      if (!frame.cloud) return false;
+    }
+    if (entry.image.size > 0) frame.image = decodeImage(data(entry.image), entry.image.size);
+  }
+  if (read_object_data) {
+    for (size_t i = 0; i < frame.objects.size(); i++) {
+      const ObjectEntry &object = objects_[entry.first_object + i];
+      if (object.cluster.size > 0) {
+        frame.objects[i].cluster = decodeCloud(data(object.cluster), object.cluster.size);
+      }
+      if (object.image.size > 0) {
+        frame.objects[i].image = decodeImage(data(object.image), object.image.size);
+      }
+    }
+  }
+  return true;
+}
+
+bool DatasetReader::readObject(size_t object_index, DatasetObject &object,
+                               size_t *frame_index) const
+{
+  if (object_index >= objects_.size()) return false;
+  const ObjectEntry &entry = objects_[object_index];
+  DatasetFrame frame;
+  if (!readFrameRecord(frames_[entry.frame], frame) || entry.index >= frame.objects.size()) {
+    return false;
+  }
+  object = frame.objects[entry.index];
+  if (entry.cluster.size > 0) object.cluster = decodeCloud(data(entry.cluster), entry.cluster.size);
+  if (entry.image.size > 0) object.image = decodeImage(data(entry.image), entry.image.size);
+  if (frame_index) *frame_index = entry.frame;
+  return true;
+}
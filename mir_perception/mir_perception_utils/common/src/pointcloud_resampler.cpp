@@ -0,0 +1,248 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include <pcl/common/point_tests.h>
+
+#include <mir_perception_utils/pointcloud_resampler.h>
+
+using namespace mir_perception_utils::pointcloud;
+
+namespace
+{
+const int KEY_BITS = 21;
+const int64_t KEY_OFFSET = static_cast<int64_t>(1) << (KEY_BITS - 1);
+const uint64_t KEY_MASK = (static_cast<uint64_t>(1) << KEY_BITS) - 1;
+// number of grid cells along the largest extent for farthest point sampling
+const int GRID_DIVISIONS = 16;
+
+uint64_t packKey(const Eigen::Vector3f &point, float inverse_size)
+{
+  const int64_t x = static_cast<int64_t>(std::floor(point[0] * inverse_size));
+  const int64_t y = static_cast<int64_t>(std::floor(point[1] * inverse_size));
+  const int64_t z = static_cast<int64_t>(std::floor(point[2] * inverse_size));
+  return (static_cast<uint64_t>(x + KEY_OFFSET) & KEY_MASK) << (2 * KEY_BITS) |
+         (static_cast<uint64_t>(y + KEY_OFFSET) & KEY_MASK) << KEY_BITS |
+         (static_cast<uint64_t>(z + KEY_OFFSET) & KEY_MASK);
+}
+
+float squaredDistanceToBox(const Eigen::Vector3f &point, const Eigen::Vector3f &min,
+                           const Eigen::Vector3f &max)
+{
+  return (min - point).cwiseMax(point - max).cwiseMax(0.0f).squaredNorm();
+}
+}  // namespace
+
+PointCloudResampler::PointCloudResampler(Strategy strategy)
+    : strategy_(strategy), voxel_size_(0.01f), generator_(std::mt19937::default_seed)
+{
+}
+
+void PointCloudResampler::setRandomSeed()
+{
+  std::random_device random_device;
+  generator_.seed(random_device());
+}
+
+bool PointCloudResampler::resample(const PointCloud &cloud_in, int num_points,
+                                   PointCloud &cloud_out)
+{
+  finite_indices_.clear();
+  for (size_t i = 0; i < cloud_in.points.size(); i++) {
+    if (pcl::isFinite(cloud_in.points[i])) finite_indices_.push_back(static_cast<int>(i));
+  }
+  const size_t num_input = finite_indices_.size();
+  if (num_input == 0 || num_points <= 0) return false;
+  const size_t num_output = static_cast<size_t>(num_points);
+
+  // indices_ refer to positions in finite_indices_
+  indices_.clear();
+  if (num_input <= num_output) {
+    indices_.resize(num_input);
+    std::iota(indices_.begin(), indices_.end(), 0);
+    padIndices(num_input, num_output);
+  } else if (strategy_ == VOXEL_STRATIFIED && voxel_size_ > 0.0f) {
+    sampleVoxelStratified(cloud_in, num_output);
+  } else if (strategy_ == FARTHEST_POINT) {
+    sampleFarthestPoint(cloud_in, num_output);
+  } else {
+    sampleRandom(num_input, num_output);
+  }
+
+  cloud_out.header = cloud_in.header;
+  cloud_out.points.resize(num_output);
+  for (size_t i = 0; i < num_output; i++) {
+    cloud_out.points[i] = cloud_in.points[finite_indices_[indices_[i]]];
+  }
+  cloud_out.width = static_cast<uint32_t>(num_output);
+  cloud_out.height = 1;
+  cloud_out.is_dense = true;
+  return true;
+}
+
+void PointCloudResampler::sampleRandom(size_t num_input, size_t num_points)
+{
+  // reservoir sampling, every subset of num_points is equally likely
+  indices_.resize(num_points);
+  std::iota(indices_.begin(), indices_.end(), 0);
+  for (size_t i = num_points; i < num_input; i++) {
+    std::uniform_int_distribution<size_t> distribution(0, i);
+    const size_t j = distribution(generator_);
+    if (j < num_points) indices_[j] = static_cast<int>(i);
+  }
+  // keep the input order
+  std::sort(indices_.begin(), indices_.end());
+}
+
+void PointCloudResampler::sampleVoxelStratified(const PointCloud &cloud_in, size_t num_points)
+{
+  const size_t num_input = finite_indices_.size();
+  const float inverse_size = 1.0f / voxel_size_;
+
+  // group the points by voxel, in random order within each voxel
+  voxel_points_.resize(num_input);
+  for (size_t i = 0; i < num_input; i++) {
+    const Eigen::Vector3f point = cloud_in.points[finite_indices_[i]].getVector3fMap();
+    voxel_points_[i] = std::make_pair(packKey(point, inverse_size), static_cast<int>(i));
+  }
+  std::shuffle(voxel_points_.begin(), voxel_points_.end(), generator_);
+  std::stable_sort(voxel_points_.begin(), voxel_points_.end(),
+                   [](const std::pair<uint64_t, int> &a, const std::pair<uint64_t, int> &b) {
+                     return a.first < b.first;
+                   });
+  voxel_begins_.clear();
+  for (size_t i = 0; i < num_input; i++) {
+    if (i == 0 || voxel_points_[i].first != voxel_points_[i - 1].first)
+      voxel_begins_.push_back(static_cast<int>(i));
+  }
+  voxel_begins_.push_back(static_cast<int>(num_input));
+
+  // visit the voxels in random order, so that the last partial round does
+  // not prefer any region
+  const size_t num_voxels = voxel_begins_.size() - 1;
+  permutation_.resize(num_voxels);
+  std::iota(permutation_.begin(), permutation_.end(), 0);
+  std::shuffle(permutation_.begin(), permutation_.end(), generator_);
+
+  // one point per voxel and round, exhausted voxels are dropped
+  indices_.clear();
+  indices_.reserve(num_points);
+  for (int round = 0; indices_.size() < num_points; round++) {
+    size_t active = 0;
+    for (size_t v = 0; v < permutation_.size() && indices_.size() < num_points; v++) {
+      const int voxel = permutation_[v];
+      const int point = voxel_begins_[voxel] + round;
+      if (point >= voxel_begins_[voxel + 1]) continue;
+      indices_.push_back(voxel_points_[point].second);
+      permutation_[active++] = voxel;
+    }
+    permutation_.resize(active);
+  }
+  std::sort(indices_.begin(), indices_.end());
+}
+
+void PointCloudResampler::sampleFarthestPoint(const PointCloud &cloud_in, size_t num_points)
+{
+  const size_t num_input = finite_indices_.size();
+
+  Eigen::Vector3f min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+  Eigen::Vector3f max = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+  for (size_t i = 0; i < num_input; i++) {
+    const Eigen::Vector3f point = cloud_in.points[finite_indices_[i]].getVector3fMap();
+    min = min.cwiseMin(point);
+    max = max.cwiseMax(point);
+  }
+  const float cell_size = (max - min).maxCoeff() / GRID_DIVISIONS;
+  if (cell_size <= 0.0f) {
+    // all points are the same
+    sampleRandom(num_input, num_points);
+    return;
+  }
+
+  // sort the points into a coarse grid
+  voxel_points_.resize(num_input);
+  for (size_t i = 0; i < num_input; i++) {
+    const Eigen::Vector3f point = cloud_in.points[finite_indices_[i]].getVector3fMap() - min;
+    voxel_points_[i] = std::make_pair(packKey(point, 1.0f / cell_size), static_cast<int>(i));
+  }
+  std::sort(voxel_points_.begin(), voxel_points_.end());
+
+  cells_.clear();
+  for (size_t i = 0; i < num_input; i++) {
+    const Eigen::Vector3f point =
+        cloud_in.points[finite_indices_[voxel_points_[i].second]].getVector3fMap();
+    if (i == 0 || voxel_points_[i].first != voxel_points_[i - 1].first) {
+      Cell cell;
+      cell.begin = static_cast<int>(i);
+      cell.min = point;
+      cell.max = point;
+      cell.max_distance = std::numeric_limits<float>::max();
+      cell.farthest = static_cast<int>(i);
+      cells_.push_back(cell);
+    }
+    Cell &cell = cells_.back();
+    cell.end = static_cast<int>(i) + 1;
+    cell.min = cell.min.cwiseMin(point);
+    cell.max = cell.max.cwiseMax(point);
+  }
+
+  // squared distance of every point to the samples, -1 once it is a sample
+  distances_.assign(num_input, std::numeric_limits<float>::max());
+  indices_.clear();
+  indices_.reserve(num_points);
+  std::uniform_int_distribution<size_t> distribution(0, num_input - 1);
+  int sample = static_cast<int>(distribution(generator_));
+  while (true) {
+    indices_.push_back(voxel_points_[sample].second);
+    distances_[sample] = -1.0f;
+    if (indices_.size() == num_points) break;
+
+    const Eigen::Vector3f sample_point =
+        cloud_in.points[finite_indices_[voxel_points_[sample].second]].getVector3fMap();
+    for (auto &cell : cells_) {
+      // no point in the cell can get closer to the samples than it already is
+      if (cell.farthest != sample &&
+          squaredDistanceToBox(sample_point, cell.min, cell.max) >= cell.max_distance)
+        continue;
+      cell.max_distance = -std::numeric_limits<float>::max();
+      for (int i = cell.begin; i < cell.end; i++) {
+        const Eigen::Vector3f point =
+            cloud_in.points[finite_indices_[voxel_points_[i].second]].getVector3fMap();
+        distances_[i] = std::min(distances_[i], (point - sample_point).squaredNorm());
+        if (distances_[i] > cell.max_distance) {
+          cell.max_distance = distances_[i];
+          cell.farthest = i;
+        }
+      }
+    }
+
+    float max_distance = -std::numeric_limits<float>::max();
+    for (const auto &cell : cells_) {
+      if (cell.max_distance > max_distance) {
+        max_distance = cell.max_distance;
+        sample = cell.farthest;
+      }
+    }
+  }
+}
+
+void PointCloudResampler::padIndices(size_t num_input, size_t num_points)
+{
+  // draw the duplicates from random permutations of the input
+  permutation_.resize(num_input);
+  std::iota(permutation_.begin(), permutation_.end(), 0);
+  while (indices_.size() < num_points) {
+    const size_t count = std::min(num_input, num_points - indices_.size());
+    // partial Fisher-Yates shuffle of the first count elements
+    for (size_t i = 0; i < count; i++) {
+      std::uniform_int_distribution<size_t> distribution(i, num_input - 1);
+      std::swap(permutation_[i], permutation_[distribution(generator_)]);
+      indices_.push_back(permutation_[i]);
+    }
+  }
+}
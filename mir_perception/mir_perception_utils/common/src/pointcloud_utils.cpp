@@ -4,15 +4,48 @@
  * Author: Mohammad Wasil
  *
  */
-#include <random>
 #include <mir_perception_utils/pointcloud_utils.h>
 #include <pcl/PointIndices.h>
 #include <pcl/common/centroid.h>
 #include <pcl/common/io.h>
-#include <pcl/filters/extract_indices.h>
+#include <pcl/features/normal_3d.h>
+#include <pcl/filters/filter.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/registration/icp.h>
+#include <pcl/search/kdtree.h>
 
 using namespace mir_perception_utils;
 
+typedef pcl::PointXYZRGBNormal PointNormalT;
+typedef pcl::PointCloud<PointNormalT> PointCloudNormal;
+
+namespace
+{
+/** Downsample the cloud and estimate normals on the downsampled points */
+void downsampleWithNormals(const PointCloud::ConstPtr &cloud_in, float voxel_size,
+                           PointCloudNormal &cloud_out)
+{
+  PointCloud::Ptr downsampled(new PointCloud);
+  pcl::VoxelGrid<PointT> voxel_grid;
+  voxel_grid.setInputCloud(cloud_in);
+  voxel_grid.setLeafSize(voxel_size, voxel_size, voxel_size);
+  voxel_grid.filter(*downsampled);
+
+  PointCloudN normals;
+  pcl::NormalEstimation<PointT, PointNT> normal_estimation;
+  pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>);
+  normal_estimation.setInputCloud(downsampled);
+  normal_estimation.setSearchMethod(tree);
+  normal_estimation.setRadiusSearch(3.0 * voxel_size);
+  normal_estimation.compute(normals);
+
+  PointCloudNormal with_normals;
+  pcl::concatenateFields(*downsampled, normals, with_normals);
+  std::vector<int> indices;
+  pcl::removeNaNNormalsFromPointCloud(with_normals, cloud_out, indices);
+}
+}
+
 unsigned int pointcloud::centerPointCloud(const PointCloud &cloud_in, PointCloud &centered_cloud)
 {
   if (cloud_in.empty()) return (0);
@@ -49,38 +82,57 @@ unsigned int pointcloud::centerPointCloud(const PointCloud &cloud_in, PointCloud
   return (point_count);
 }
 
-unsigned int pointcloud::padPointCloud(PointCloud::Ptr &cloud_in, int num_points)
+unsigned int pointcloud::padPointCloud(PointCloud::Ptr &cloud_in, int num_points,
+                                       PointCloudResampler::Strategy strategy, float voxel_size,
+                                       int seed)
 {
   if (cloud_in->empty()) return (0);
 
-  unsigned int point_count;
-  point_count = static_cast<unsigned int>(cloud_in->size());
-
-  std::random_device rd;   // get ran
-  std::mt19937 eng(rd());  // seed the generator
-  std::uniform_int_distribution<> distr(0, point_count);
-
-  if (point_count > num_points) {
-    unsigned int point_diff = point_count - num_points;
-
-    pcl::PointIndices::Ptr random_indices(new pcl::PointIndices());
-
-    for (int n = 0; n < num_points; ++n) random_indices->indices.push_back(distr(eng));
-
-    pcl::ExtractIndices<PointT> extract;
-    extract.setInputCloud(cloud_in);
-    extract.setIndices(random_indices);
-    extract.setNegative(false);
-    extract.filter(*cloud_in);
-    cloud_in->width = cloud_in->points.size();
-  } else if (point_count < num_points) {
-    int additional_points = num_points - point_count;
-    for (int i = 0; i < additional_points; i++) {
-      int random_index = distr(eng);
-      cloud_in->points.push_back(cloud_in->points[random_index]);
-    }
-    point_count += additional_points;
-    cloud_in->width = cloud_in->points.size();
+  // one resampler and output buffer per thread, clusters may be padded in parallel
+  thread_local PointCloudResampler resampler;
+  thread_local PointCloud resampled_cloud;
+  resampler.setStrategy(strategy);
+  resampler.setVoxelSize(voxel_size);
+  if (seed >= 0) {
+    resampler.setSeed(static_cast<uint32_t>(seed));
+  } else {
+    resampler.setRandomSeed();
   }
-  return (point_count);
+  if (!resampler.resample(*cloud_in, num_points, resampled_cloud)) return (0);
+
+  // keep the old buffer for the next call
+  cloud_in->points.swap(resampled_cloud.points);
+  cloud_in->width = cloud_in->points.size();
+  cloud_in->height = 1;
+  cloud_in->is_dense = true;
+  return (cloud_in->points.size());
+}
+
+bool pointcloud::registerPointToPlane(const PointCloud::ConstPtr &source, const PointCloud::ConstPtr &target,
+                                      float voxel_size, float max_correspondence_distance,
+                                      int max_iterations, Eigen::Matrix4f &transform)
+{
+  transform = Eigen::Matrix4f::Identity();
+  if (source->empty() || target->empty()) return (false);
+
+  PointCloudNormal::Ptr source_normals(new PointCloudNormal);
+  PointCloudNormal::Ptr target_normals(new PointCloudNormal);
+  downsampleWithNormals(source, voxel_size, *source_normals);
+  downsampleWithNormals(target, voxel_size, *target_normals);
+  if (source_normals->size() < 3 || target_normals->size() < 3) return (false);
+
+  // uses the linear least squares point-to-plane error metric
+  pcl::IterativeClosestPointWithNormals<PointNormalT, PointNormalT> icp;
+  icp.setInputSource(source_normals);
+  icp.setInputTarget(target_normals);
+  icp.setMaxCorrespondenceDistance(max_correspondence_distance);
+  icp.setMaximumIterations(max_iterations);
+  icp.setTransformationEpsilon(1e-8);
+
+  PointCloudNormal aligned;
+  icp.align(aligned);
+  if (!icp.hasConverged()) return (false);
+
+  transform = icp.getFinalTransformation();
+  return (true);
 }
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ * Compares the oriented box estimation of the pcl based pose estimation
+ * (centroid, covariance, eigen solve, transformed cloud and min/max) with
+ * the single pass kernel in principal_axes.h on synthetic clusters, one at
+ * a time and batched as indices into a scene cloud.
+ *
+ * Usage: principal_axes_benchmark <cluster size> <number of clusters> <iterations>
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <Eigen/Eigenvalues>
+
+#include <pcl/common/centroid.h>
+#include <pcl/common/common.h>
+#include <pcl/common/transforms.h>
+
+#include <mir_perception_utils/aliases.h>
+#include <mir_perception_utils/principal_axes.h>
+
+namespace mpu = mir_perception_utils;
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(const Clock::time_point &start, const Clock::time_point &end)
+{
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void estimateBoxPcl(const PointCloud &cloud, Eigen::Matrix3f &axes, Eigen::Vector3f &center)
+{
+  Eigen::Vector4f centroid;
+  pcl::compute3DCentroid(cloud, centroid);
+  Eigen::Matrix3f covariance;
+  pcl::computeCovarianceMatrixNormalized(cloud, centroid, covariance);
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> eigen_solver(covariance,
+                                                              Eigen::ComputeEigenvectors);
+  axes = eigen_solver.eigenvectors();
+  axes.col(0).swap(axes.col(2));
+  axes.col(1) = axes.col(2).cross(axes.col(0));
+
+  Eigen::Matrix4f transform(Eigen::Matrix4f::Identity());
+  transform.block<3, 3>(0, 0) = axes.transpose();
+  transform.block<3, 1>(0, 3) = -(transform.block<3, 3>(0, 0) * centroid.head<3>());
+  PointCloud transformed_cloud;
+  pcl::transformPointCloud(cloud, transformed_cloud, transform);
+  PointT min_point, max_point;
+  pcl::getMinMax3D(transformed_cloud, min_point, max_point);
+  const Eigen::Vector3f mean_diag =
+      (max_point.getVector3fMap() + min_point.getVector3fMap()) / 2.0;
+  center = axes * mean_diag + centroid.head<3>();
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " <cluster size> <number of clusters> <iterations>"
+              << std::endl;
+    return 1;
+  }
+  const int cluster_size = std::max(3, std::atoi(argv[1]));
+  const int num_clusters = std::max(1, std::atoi(argv[2]));
+  const int iterations = std::max(1, std::atoi(argv[3]));
+
+  // elongated, rotated box shaped clusters next to each other on a table
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> unit(-0.5f, 0.5f);
+  PointCloud::Ptr scene(new PointCloud);
+  std::vector<PointCloud::Ptr> clusters;
+  std::vector<pcl::PointIndices> cluster_indices(num_clusters);
+  for (int c = 0; c < num_clusters; c++) {
+    const float angle = 0.3f * c;
+    PointCloud::Ptr cluster(new PointCloud);
+    for (int i = 0; i < cluster_size; i++) {
+      const float x = 0.08f * unit(generator), y = 0.03f * unit(generator);
+      PointT point;
+      point.x = 0.5f + 0.15f * c + std::cos(angle) * x - std::sin(angle) * y;
+      point.y = std::sin(angle) * x + std::cos(angle) * y;
+      point.z = 0.02f + 0.01f * unit(generator);
+      cluster->points.push_back(point);
+      cluster_indices[c].indices.push_back(scene->points.size());
+      scene->points.push_back(point);
+    }
+    cluster->width = cluster->points.size();
+    cluster->height = 1;
+    clusters.push_back(cluster);
+  }
+  scene->width = scene->points.size();
+  scene->height = 1;
+
+  double pcl_ms = 0.0, kernel_ms = 0.0, batch_ms = 0.0, max_center_error = 0.0;
+  mpu::pointcloud::OrientedBoxes boxes;
+  for (int it = 0; it < iterations; it++) {
+    std::vector<Eigen::Vector3f> pcl_centers(num_clusters);
+    Clock::time_point start = Clock::now();
+    for (int c = 0; c < num_clusters; c++) {
+      Eigen::Matrix3f axes;
+      estimateBoxPcl(*clusters[c], axes, pcl_centers[c]);
+    }
+    Clock::time_point end = Clock::now();
+    pcl_ms += elapsedMs(start, end);
+
+    start = Clock::now();
+    mpu::pointcloud::computeOrientedBoxes(clusters, boxes);
+    end = Clock::now();
+    kernel_ms += elapsedMs(start, end);
+
+    start = Clock::now();
+    mpu::pointcloud::computeOrientedBoxes(*scene, cluster_indices, boxes);
+    end = Clock::now();
+    batch_ms += elapsedMs(start, end);
+
+    for (int c = 0; c < num_clusters; c++) {
+      max_center_error =
+          std::max(max_center_error, static_cast<double>((boxes[c].center - pcl_centers[c]).norm()));
+    }
+  }
+
+  std::cout << "clusters: " << num_clusters << ", points per cluster: " << cluster_size
+            << ", iterations: " << iterations << std::endl;
+  std::cout << "pcl              " << pcl_ms / iterations << " ms" << std::endl;
+  std::cout << "kernel clusters  " << kernel_ms / iterations << " ms" << std::endl;
+  std::cout << "kernel indices   " << batch_ms / iterations << " ms" << std::endl;
+  std::cout << "max center difference " << max_center_error << " m" << std::endl;
+  return 0;
+}
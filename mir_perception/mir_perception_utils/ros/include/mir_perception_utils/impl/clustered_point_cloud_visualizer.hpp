@@ -3,12 +3,9 @@
 
 #include <sensor_msgs/PointCloud2.h>
 
-#include <pcl_conversions/pcl_conversions.h>
-
 #include <mir_perception_utils/aliases.h>
 #include <mir_perception_utils/color.h>
-#include <pcl/PCLPointCloud2.h>
-#include <pcl/conversions.h>
+#include <mir_perception_utils/pointcloud_msg_writer.h>
 
 using mir_perception_utils::visualization::Color;
 
@@ -48,30 +45,14 @@ void ClusteredPointCloudVisualizer::publish(
     const std::vector<typename pcl::PointCloud<PointT>::Ptr> &clusters, const std::string &frame_id)
 {
   if (cloud_publisher_.getNumSubscribers() == 0) return;
-  pcl::PointCloud<pcl::PointXYZRGB> composite;
-  size_t color = 0;
-
+  std::vector<float> colors(clusters.size());
   for (size_t i = 0; i < clusters.size(); i++) {
-    const PointCloud::Ptr &cloud = clusters[i];
-    for (size_t j = 0; j < cloud->points.size(); j++) {
-      const PointT &point = cloud->points[j];
-      pcl::PointXYZRGB pt;
-      pt.x = point.x;
-      pt.y = point.y;
-      pt.z = point.z;
-      pt.rgb = float(Color(static_cast<Color::Name>(color)));
-      composite.points.push_back(pt);
-    }
-    color++;
+    colors[i] = float(Color(static_cast<Color::Name>(i)));
   }
-  composite.header.frame_id = frame_id;
-  composite.width = static_cast<uint32_t>(composite.points.size());
-  composite.height = 1;
 
-  pcl::PCLPointCloud2 pc2;
   sensor_msgs::PointCloud2 cloud_msg;
-  pcl::toPCLPointCloud2(composite, pc2);
-  pcl_conversions::fromPCL(pc2, cloud_msg);
+  mir_perception_utils::pointcloud::toPointCloud2Msg<PointT>(clusters, colors, cloud_msg);
+  cloud_msg.header.frame_id = frame_id;
   cloud_publisher_.publish(cloud_msg);
 }
 }
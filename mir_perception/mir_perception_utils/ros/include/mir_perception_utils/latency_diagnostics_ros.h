@@ -0,0 +1,56 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_LATENCY_DIAGNOSTICS_ROS_H
+#define MIR_PERCEPTION_UTILS_LATENCY_DIAGNOSTICS_ROS_H
+
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include <mir_perception_utils/latency_profiler.h>
+
+namespace mir_perception_utils
+{
+/** \brief Periodically publishes the rolling p50/p95/p99 latencies of all stages
+ * of the LatencyProfiler as diagnostic_msgs/DiagnosticArray, one status per stage.
+ *
+ * Parameters, read from the given node handle:
+ * - enable_latency_profiling: record stage latencies (default true)
+ * - latency_publish_period: publish period in seconds (default 1.0)
+ * - latency_window_size: number of samples per stage for the percentiles (default 1000)
+ * - latency_trace_file: Chrome trace JSON written on shutdown, empty disables the trace
+ * - latency_trace_capacity: number of samples kept for the trace (default 100000)
+ */
+class LatencyDiagnosticsROS
+{
+ public:
+  /** \brief Constructor
+   * \param[in] Node handle of the topic and the parameters
+   * \param[in] Prefix of the status names, e.g. the node name
+   * */
+  LatencyDiagnosticsROS(ros::NodeHandle &nh, const std::string &name);
+  /** \brief Destructor, writes the Chrome trace if enabled */
+  virtual ~LatencyDiagnosticsROS();
+
+  /** \brief Write the traced samples as Chrome trace JSON
+   * \return false if the trace is disabled or the file could not be written
+   * */
+  bool writeTrace();
+
+ private:
+  void publish(const ros::WallTimerEvent &event);
+
+  std::string name_;
+  std::string trace_file_;
+  ros::Publisher pub_diagnostics_;
+  ros::WallTimer timer_;
+  std::vector<LatencyStatistics> statistics_;
+  uint64_t last_lost_samples_;
+};
+
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_LATENCY_DIAGNOSTICS_ROS_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_POINTCLOUD_MSG_VIEW_H
+#define MIR_PERCEPTION_UTILS_POINTCLOUD_MSG_VIEW_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <Eigen/Core>
+
+#include <sensor_msgs/PointCloud2.h>
+
+namespace mir_perception_utils
+{
+namespace pointcloud
+{
+/** \brief Read only view of the x, y, z and rgb(a) fields of a sensor_msgs PointCloud2.
+ *
+ * The field offsets are resolved once, the points are read straight from the
+ * message buffer without converting the message first. The view only stays
+ * valid as long as the message it was created from.
+ */
+class PointCloud2View
+{
+ public:
+  /** \brief Constructor
+   * \param[in] sensor_msgs PointCloud2, x, y and z have to be FLOAT32 fields
+   * */
+  explicit PointCloud2View(const sensor_msgs::PointCloud2 &msg)
+      : data_(msg.data.data()),
+        width_(msg.width),
+        height_(msg.height),
+        point_step_(msg.point_step),
+        row_step_(msg.row_step),
+        x_offset_(-1),
+        y_offset_(-1),
+        z_offset_(-1),
+        rgb_offset_(-1)
+  {
+    for (const auto &field : msg.fields) {
+      if (field.datatype != sensor_msgs::PointField::FLOAT32 &&
+          field.datatype != sensor_msgs::PointField::UINT32)
+        continue;
+      if (field.name == "x") x_offset_ = field.offset;
+      else if (field.name == "y") y_offset_ = field.offset;
+      else if (field.name == "z") z_offset_ = field.offset;
+      else if (field.name == "rgb" || field.name == "rgba") rgb_offset_ = field.offset;
+    }
+    // every field is read as 4 bytes and has to lie within the point
+    const auto fits = [this](int offset) {
+      return offset >= 0 && static_cast<uint64_t>(offset) + 4 <= point_step_;
+    };
+    valid_ = !msg.is_bigendian && fits(x_offset_) && fits(y_offset_) && fits(z_offset_) &&
+             (rgb_offset_ < 0 || fits(rgb_offset_)) &&
+             msg.data.size() >= static_cast<size_t>(row_step_) * height_ &&
+             static_cast<size_t>(row_step_) >= static_cast<size_t>(point_step_) * width_;
+  }
+
+  /** \brief True if the message has little endian float x, y and z fields, and all fields
+   * including rgb lie within the point step */
+  bool isValid() const { return valid_; }
+  /** \brief True if the message has an rgb or rgba field */
+  bool hasColor() const { return rgb_offset_ >= 0; }
+
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+  size_t size() const { return static_cast<size_t>(width_) * height_; }
+
+  /** \brief Pointer to the first byte of a point */
+  const uint8_t *point(uint32_t row, uint32_t col) const
+  {
+    return data_ + static_cast<size_t>(row) * row_step_ + static_cast<size_t>(col) * point_step_;
+  }
+
+  /** \brief Read x, y, z of a point as homogeneous coordinates */
+  Eigen::Vector4f getXYZ(const uint8_t *point) const
+  {
+    Eigen::Vector4f xyz;
+    std::memcpy(&xyz[0], point + x_offset_, sizeof(float));
+    std::memcpy(&xyz[1], point + y_offset_, sizeof(float));
+    std::memcpy(&xyz[2], point + z_offset_, sizeof(float));
+    xyz[3] = 1.0f;
+    return xyz;
+  }
+
+  /** \brief Read the packed color of a point, opaque black if there is no color */
+  uint32_t getRGBA(const uint8_t *point) const
+  {
+    uint32_t rgba = 0xff000000;
+    if (rgb_offset_ >= 0) std::memcpy(&rgba, point + rgb_offset_, sizeof(uint32_t));
+    return rgba;
+  }
+
+ private:
+  const uint8_t *data_;
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t point_step_;
+  uint32_t row_step_;
+  int x_offset_;
+  int y_offset_;
+  int z_offset_;
+  int rgb_offset_;
+  bool valid_;
+};
+
+}  // namespace pointcloud
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_POINTCLOUD_MSG_VIEW_H
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_POINTCLOUD_MSG_WRITER_H
+#define MIR_PERCEPTION_UTILS_POINTCLOUD_MSG_WRITER_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <sensor_msgs/PointCloud2.h>
+
+#include <mir_perception_utils/aliases.h>
+
+namespace mir_perception_utils
+{
+namespace pointcloud
+{
+/** \brief Writes x, y, z and rgb points directly into the data buffer of a sensor_msgs PointCloud2.
+ *
+ * The fields are laid out like pcl::PointXYZRGB (x, y, z at 0, 4, 8, rgb at 16, 32 bytes
+ * per point), the same layout pcl::toROSMsg produces, so subscribers keep their fast
+ * conversion path. The buffer is allocated once for all points, the points are written
+ * without a PCLPointCloud2 intermediate.
+ */
+class PointCloud2Writer
+{
+ public:
+  static const uint32_t POINT_STEP = 32;
+  static const uint32_t X_OFFSET = 0;
+  static const uint32_t Y_OFFSET = 4;
+  static const uint32_t Z_OFFSET = 8;
+  static const uint32_t RGB_OFFSET = 16;
+
+  /** \brief Constructor, sets the fields and allocates the buffer of the message
+   * \param[out] sensor_msgs PointCloud2, its header is not changed
+   * \param[in] Number of points per row
+   * \param[in] Number of rows, 1 for unorganized clouds
+   * \param[in] True if the points written are all finite
+   * */
+  PointCloud2Writer(sensor_msgs::PointCloud2 &msg, uint32_t width, uint32_t height = 1,
+                    bool is_dense = true)
+      : msg_(msg)
+  {
+    static const char *names[] = {"x", "y", "z", "rgb"};
+    static const uint32_t offsets[] = {X_OFFSET, Y_OFFSET, Z_OFFSET, RGB_OFFSET};
+    msg.fields.resize(4);
+    for (size_t i = 0; i < 4; ++i) {
+      msg.fields[i].name = names[i];
+      msg.fields[i].offset = offsets[i];
+      msg.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+      msg.fields[i].count = 1;
+    }
+    msg.width = width;
+    msg.height = height;
+    msg.is_bigendian = false;
+    msg.is_dense = is_dense;
+    msg.point_step = POINT_STEP;
+    msg.row_step = POINT_STEP * width;
+    // padding bytes stay zero, the buffer is not copied from an intermediate cloud
+    msg.data.assign(static_cast<size_t>(msg.row_step) * height, 0);
+  }
+
+  size_t size() const { return static_cast<size_t>(msg_.width) * msg_.height; }
+
+  /** \brief Pointer to the first byte of a point */
+  uint8_t *point(size_t index) { return msg_.data.data() + index * POINT_STEP; }
+
+  /** \brief Write a point
+   * \param[in] Index of the point, row * width + col
+   * \param[in] x, y, z
+   * \param[in] Packed color, as in pcl::PointXYZRGB::rgb
+   * */
+  void setPoint(size_t index, float x, float y, float z, float rgb)
+  {
+    uint8_t *p = point(index);
+    std::memcpy(p + X_OFFSET, &x, sizeof(float));
+    std::memcpy(p + Y_OFFSET, &y, sizeof(float));
+    std::memcpy(p + Z_OFFSET, &z, sizeof(float));
+    std::memcpy(p + RGB_OFFSET, &rgb, sizeof(float));
+  }
+
+ private:
+  sensor_msgs::PointCloud2 &msg_;
+};
+
+/** \brief Convert a pcl PointCloud into a sensor_msgs PointCloud2 in one pass,
+ * replaces pcl::toROSMsg, which copies the points into a PCLPointCloud2 first
+ * \param[in] pcl PointCloud input
+ * \param[out] sensor_msgs PointCloud2 output, the header frame_id is taken from the cloud
+ * \param[in] Offset subtracted from every point, e.g. the centroid to center a cluster
+ * */
+inline void toPointCloud2Msg(const PointCloud &cloud, sensor_msgs::PointCloud2 &msg,
+                             const Eigen::Vector3f &offset = Eigen::Vector3f::Zero())
+{
+  msg.header.frame_id = cloud.header.frame_id;
+  msg.header.seq = cloud.header.seq;
+  // pcl stamps are in microseconds
+  msg.header.stamp.fromNSec(cloud.header.stamp * 1000ull);
+
+  // sizes that do not match width * height are written unorganized
+  const bool organized = static_cast<size_t>(cloud.width) * cloud.height == cloud.points.size();
+  PointCloud2Writer writer(msg, organized ? cloud.width : static_cast<uint32_t>(cloud.points.size()),
+                           organized ? cloud.height : 1, cloud.is_dense);
+  for (size_t i = 0; i < cloud.points.size(); ++i) {
+    const PointT &point = cloud.points[i];
+    writer.setPoint(i, point.x - offset[0], point.y - offset[1], point.z - offset[2], point.rgb);
+  }
+}
+
+/** \brief Write clusters into a single sensor_msgs PointCloud2, every point colored with
+ * the color of its cluster
+ * \param[in] Clusters, only x, y and z are used
+ * \param[in] Packed color of each cluster, as in pcl::PointXYZRGB::rgb
+ * \param[out] sensor_msgs PointCloud2 output, the header is not changed
+ * */
+template <typename PointT>
+void toPointCloud2Msg(const std::vector<typename pcl::PointCloud<PointT>::Ptr> &clusters,
+                      const std::vector<float> &colors, sensor_msgs::PointCloud2 &msg)
+{
+  size_t num_points = 0;
+  for (const auto &cluster : clusters) {
+    if (cluster) num_points += cluster->points.size();
+  }
+  PointCloud2Writer writer(msg, static_cast<uint32_t>(num_points), 1, false);
+  size_t index = 0;
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    if (!clusters[i]) continue;
+    const float rgb = colors.empty() ? 0.0f : colors[i % colors.size()];
+    for (const PointT &point : clusters[i]->points) {
+      writer.setPoint(index++, point.x, point.y, point.z, rgb);
+    }
+  }
+}
+
+}  // namespace pointcloud
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_POINTCLOUD_MSG_WRITER_H
@@ -8,6 +8,8 @@
 #ifndef MIR_PERCCEPTION_UTILS_POINTCLOUD_UTILS_ROS_H
 #define MIR_PERCCEPTION_UTILS_POINTCLOUD_UTILS_ROS_H
 
+#include <limits>
+
 #include <ros/ros.h>
 
 #include <pcl_ros/point_cloud.h>
@@ -16,12 +18,76 @@
 #include <tf/transform_listener.h>
 
 #include <mir_perception_utils/aliases.h>
+#include <mir_perception_utils/transform_cache.h>
 #include <sensor_msgs/RegionOfInterest.h>
 
 namespace mir_perception_utils
 {
 namespace pointcloud
 {
+/** \brief Filters applied while a PointCloud2 is converted */
+struct ConversionFilter
+{
+  ConversionFilter()
+      : remove_nans(false),
+        enable_crop_box(false),
+        crop_box_min(Eigen::Vector3f::Constant(-std::numeric_limits<float>::max())),
+        crop_box_max(Eigen::Vector3f::Constant(std::numeric_limits<float>::max()))
+  {
+  }
+  // Drop non finite and cropped points, otherwise they are set to NaN and the cloud stays organized
+  bool remove_nans;
+  // Points outside the crop box are culled in the sensor frame (depth and ray bounds)
+  // before they are transformed, the remaining ones are tested exactly after the transform
+  bool enable_crop_box;
+  // Crop box in the output frame
+  Eigen::Vector3f crop_box_min;
+  Eigen::Vector3f crop_box_max;
+};
+
+/** \brief Convert sensor_msgs PointCloud2 with x, y, z and rgb fields into a pcl PointCloud,
+ * applying the transform and the filters in a single pass over the message buffer
+ * \param[in] sensor_msgs PointCloud2 input
+ * \param[in] Rigid transform applied to every point
+ * \param[out] pcl PointCloud output
+ * \param[in] NaN removal and crop box
+ * \return false if the message has no float x, y, z fields
+ */
+bool convertPointCloudMsg(const sensor_msgs::PointCloud2 &cloud_in, const Eigen::Matrix4f &transform,
+                          PointCloud &cloud_out, const ConversionFilter &filter = ConversionFilter());
+
+/** \brief Transform sensor_msgs PointCloud2 directly into a pcl PointCloud in the target frame,
+ * without intermediate PointCloud2 or PCLPointCloud2 copies
+ * \param[in] Transform listener
+ * \param[in] Target frame id
+ * \param[in] sensor_msgs PointCloud2 input
+ * \param[out] pcl PointCloud output
+ * \param[in] NaN removal and crop box
+ * \param[in] Use the transform at the stamp of the cloud instead of the latest one
+ * \param[in] Maximum time to wait for the transform at the stamp of the cloud, or for the
+ *     transform chain to become available when the latest one is used
+ */
+bool transformPointCloudMsg(const boost::shared_ptr<tf::TransformListener> &tf_listener,
+                            const std::string &target_frame,
+                            const sensor_msgs::PointCloud2 &cloud_in, PointCloud &cloud_out,
+                            const ConversionFilter &filter = ConversionFilter(),
+                            bool use_cloud_stamp = false, double timeout = 1.0);
+
+/** \brief Transform sensor_msgs PointCloud2 directly into a pcl PointCloud in the target frame,
+ * with the transform of the cache instead of a lookup in the transform listener
+ * \param[in] Transform cache
+ * \param[in] Target frame id
+ * \param[in] sensor_msgs PointCloud2 input
+ * \param[out] pcl PointCloud output
+ * \param[in] NaN removal and crop box
+ * \param[in] Use the transform at the stamp of the cloud instead of the latest one
+ * \param[in] Maximum time to poll for the transform, at the stamp of the cloud or the latest one
+ */
+bool transformPointCloudMsg(TransformCache &transform_cache, const std::string &target_frame,
+                            const sensor_msgs::PointCloud2 &cloud_in, PointCloud &cloud_out,
+                            const ConversionFilter &filter = ConversionFilter(),
+                            bool use_cloud_stamp = false, double timeout = 1.0);
+
 /** \brief Transform sensor_msgs PointCloud2
 * \param[in] Transform listener
 * \param[in] Target frame id
@@ -62,6 +128,20 @@ bool transformPointCloud2(const boost::shared_ptr<tf::TransformListener> &tf_lis
 */
 bool getPointCloudROI(const sensor_msgs::RegionOfInterest &roi, const PointCloud::Ptr &cloud_id,
                       PointCloud::Ptr &cloud_roi, float roi_size_adjustment, bool remove_outliers);
+
+/** \brief Get the 3D ROIs of several 2D ROIs in a single row-wise pass over the organized pointcloud
+ * \param[in] Regions of interest (bounding boxes) of the 2D objects
+ * \param[in] Organized pointcloud input
+ * \param[out] 3D pointcloud cluster of each 2D ROI, NULL if the ROI exceeds the pointcloud
+ * \param[in] Adjust the rgb roi proposals (in pixel)
+ * \param[in] Remove 3D ROI outliers, points further from the median point of the ROI than the
+ *            median distance plus outlier_threshold median absolute deviations
+ * \param[in] Outlier threshold in (scaled) median absolute deviations
+ * \return false if the pointcloud is not organized
+*/
+bool getPointCloudROIs(const std::vector<sensor_msgs::RegionOfInterest> &rois,
+                       const PointCloud::ConstPtr &cloud_in, std::vector<PointCloud::Ptr> &clouds_roi,
+                       float roi_size_adjustment, bool remove_outliers, float outlier_threshold = 3.0);
 }
 };
 
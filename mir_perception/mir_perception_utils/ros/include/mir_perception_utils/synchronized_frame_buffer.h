@@ -0,0 +1,164 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_SYNCHRONIZED_FRAME_BUFFER_H
+#define MIR_PERCEPTION_UTILS_SYNCHRONIZED_FRAME_BUFFER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <message_filters/subscriber.h>
+#include <message_filters/sync_policies/approximate_time.h>
+#include <message_filters/synchronizer.h>
+#include <ros/ros.h>
+
+namespace mir_perception_utils
+{
+/** \brief Keeps the latest synchronized pairs of two topics, e.g. an image and a pointcloud.
+ *
+ * The subscribers and the ApproximateTime synchronizer are created once and stay
+ * subscribed, so a request takes a pair that has already been received instead of
+ * subscribing and waiting for the synchronizer. The pairs are kept as shared pointers
+ * in a ring buffer of fixed capacity, the messages are never copied.
+ * All methods are thread safe.
+ */
+template <typename M0, typename M1>
+class SynchronizedFrameBuffer
+{
+ public:
+  typedef boost::shared_ptr<const M0> M0ConstPtr;
+  typedef boost::shared_ptr<const M1> M1ConstPtr;
+  typedef std::function<void(const M0ConstPtr &, const M1ConstPtr &)> Callback;
+
+  /** \brief Constructor, subscribes to both topics
+   * \param[in] Node handle of the topics
+   * \param[in] Topic of the first message
+   * \param[in] Topic of the second message
+   * \param[in] Number of pairs kept
+   * \param[in] Queue size of the ApproximateTime policy
+   * */
+  SynchronizedFrameBuffer(ros::NodeHandle &nh, const std::string &topic0, const std::string &topic1,
+                          size_t capacity = 4, uint32_t sync_queue_size = 10)
+      : frames_(std::max<size_t>(capacity, 1)),
+        next_(0),
+        count_(0),
+        received_(0),
+        sub0_(nh, topic0, 1),
+        sub1_(nh, topic1, 1),
+        sync_(SyncPolicy(sync_queue_size), sub0_, sub1_)
+  {
+    sync_.registerCallback(boost::bind(&SynchronizedFrameBuffer::synchronizedCallback, this, _1, _2));
+  }
+
+  virtual ~SynchronizedFrameBuffer()
+  {
+    sub0_.unsubscribe();
+    sub1_.unsubscribe();
+  }
+
+  /** \brief Set a callback that is called for every pair after it was stored,
+   * in the thread of the subscribers, e.g. to process every frame in a continuous mode */
+  void setCallback(const Callback &callback)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = callback;
+  }
+
+  /** \brief Get the kept pair with the newest stamp. The pairs are not necessarily received in
+   * the order of their stamps (the older stamp of both messages), so all kept pairs are
+   * searched, not only the last one received.
+   * \param[in] Minimum stamp, the older stamp of both messages must not be earlier,
+   *            e.g. the time the arm settled
+   * \param[out] First message
+   * \param[out] Second message
+   * \param[out] Older stamp of both messages (optional)
+   * \return false if no pair is newer than the minimum stamp
+   * */
+  bool getLatest(const ros::Time &min_stamp, M0ConstPtr &msg0, M1ConstPtr &msg1,
+                 ros::Time *stamp = NULL) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Frame *latest = NULL;
+    // the kept pairs are the count_ slots before next_
+    for (size_t i = 1; i <= count_; i++) {
+      const Frame &frame = frames_[(next_ + frames_.size() - i) % frames_.size()];
+      if (frame.stamp < min_stamp) continue;
+      if (!latest || frame.stamp > latest->stamp) latest = &frame;
+    }
+    if (!latest) return false;
+    msg0 = latest->msg0;
+    msg1 = latest->msg1;
+    if (stamp) *stamp = latest->stamp;
+    return true;
+  }
+
+  /** \brief Drop all pairs, e.g. before the sensor moves */
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Frame &frame : frames_) frame = Frame();
+    count_ = 0;
+  }
+
+  /** \brief Number of pairs kept */
+  size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+  }
+
+  /** \brief Number of pairs received since construction */
+  uint64_t getReceivedCount() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return received_;
+  }
+
+ private:
+  typedef message_filters::sync_policies::ApproximateTime<M0, M1> SyncPolicy;
+
+  struct Frame
+  {
+    M0ConstPtr msg0;
+    M1ConstPtr msg1;
+    ros::Time stamp;
+  };
+
+  void synchronizedCallback(const M0ConstPtr &msg0, const M1ConstPtr &msg1)
+  {
+    Callback callback;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Frame &frame = frames_[next_];
+      frame.msg0 = msg0;
+      frame.msg1 = msg1;
+      frame.stamp = std::min(msg0->header.stamp, msg1->header.stamp);
+      next_ = (next_ + 1) % frames_.size();
+      count_ = std::min(count_ + 1, frames_.size());
+      received_++;
+      callback = callback_;
+    }
+    if (callback) callback(msg0, msg1);
+  }
+
+  // declared before the subscribers, which are destroyed first
+  mutable std::mutex mutex_;
+  std::vector<Frame> frames_;
+  size_t next_;
+  size_t count_;
+  uint64_t received_;
+  Callback callback_;
+
+  message_filters::Subscriber<M0> sub0_;
+  message_filters::Subscriber<M1> sub1_;
+  message_filters::Synchronizer<SyncPolicy> sync_;
+};
+
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_SYNCHRONIZED_FRAME_BUFFER_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#ifndef MIR_PERCEPTION_UTILS_TRANSFORM_CACHE_H
+#define MIR_PERCEPTION_UTILS_TRANSFORM_CACHE_H
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <ros/ros.h>
+#include <tf/transform_listener.h>
+
+#include <mir_perception_utils/aliases.h>
+
+namespace mir_perception_utils
+{
+/** \brief Counters of the TransformCache lookups */
+struct TransformCacheStatistics
+{
+  TransformCacheStatistics() : hits(0), static_hits(0), misses(0), timeouts(0) {}
+  // transform of the requested stamp was cached
+  uint64_t hits;
+  // chain only consists of static transforms, which are cached independent of the stamp
+  uint64_t static_hits;
+  // transform was resolved by the transform listener
+  uint64_t misses;
+  // transform was not available before the deadline
+  uint64_t timeouts;
+};
+
+/** \brief Snapshot of the transforms of a transform listener, shared by the
+ * pipeline stages of a node.
+ *
+ * A transform is resolved once per chain and stamp and kept for the following
+ * lookups of the same stamp, e.g. the poses of all objects of one frame. Chains
+ * that only consist of static transforms are resolved once and refreshed
+ * periodically. Lookups never block longer than the given deadline, the
+ * listener is polled instead of waiting for it in waitForTransform.
+ * All methods are thread safe.
+ */
+class TransformCache
+{
+ public:
+  /** \brief Constructor
+   * \param[in] Transform listener
+   * \param[in] Period in seconds after which static chains are resolved again
+   * \param[in] Number of stamps cached per chain
+   * */
+  explicit TransformCache(const boost::shared_ptr<tf::TransformListener> &tf_listener,
+                          double static_refresh_period = 10.0, size_t stamps_per_chain = 8);
+
+  /** \brief Constructor for a listener that is owned by the caller and outlives the cache */
+  explicit TransformCache(tf::TransformListener &tf_listener, double static_refresh_period = 10.0,
+                          size_t stamps_per_chain = 8);
+
+  /** \brief Get the transform from the source to the target frame
+   * \param[in] Target frame id
+   * \param[in] Source frame id
+   * \param[in] Stamp of the transform, ros::Time(0) for the latest common time
+   * \param[out] Transform of points in the source frame into the target frame
+   * \param[in] Wall time until the listener is polled if the transform is not
+   *            available yet, the default only tries once and never blocks
+   * \param[out] Stamp the transform was resolved at (optional), ros::Time(0) for static chains
+   * \return false if the transform is not available before the deadline
+   * */
+  bool lookup(const std::string &target_frame, const std::string &source_frame,
+              const ros::Time &stamp, Eigen::Affine3d &transform,
+              const ros::WallTime &deadline = ros::WallTime(), ros::Time *resolved_stamp = NULL);
+
+  /** \brief Transform a pose into the target frame
+   * \param[in] Target frame id
+   * \param[in] Pose, transformed at its stamp
+   * \param[out] Transformed pose, only set if the transform is available
+   * \param[in] Wall time until the listener is polled
+   * */
+  bool transformPose(const std::string &target_frame, const geometry_msgs::PoseStamped &pose,
+                     geometry_msgs::PoseStamped &transformed_pose,
+                     const ros::WallTime &deadline = ros::WallTime());
+
+  /** \brief Transform a batch of poses into the target frame in place, the
+   * transform is resolved once per distinct source frame and stamp
+   * \param[in] Target frame id
+   * \param[in,out] Poses, the ones without transform are kept unchanged
+   * \param[in] Wall time until the listener is polled
+   * \return false if any pose could not be transformed
+   * */
+  bool transformPoses(const std::string &target_frame, std::vector<geometry_msgs::PoseStamped> &poses,
+                      const ros::WallTime &deadline = ros::WallTime());
+
+  /** \brief Transform all points of a pcl PointCloud at the stamp of its header
+   * \param[in] Target frame id
+   * \param[in] pcl PointCloud input
+   * \param[out] pcl PointCloud output, may be the input
+   * \param[in] Wall time until the listener is polled
+   * */
+  bool transformPointCloud(const std::string &target_frame, const PointCloud &cloud_in,
+                           PointCloud &cloud_out, const ros::WallTime &deadline = ros::WallTime());
+
+  /** \brief Transform a pose with a transform from lookup */
+  static void transformPose(const Eigen::Affine3d &transform, geometry_msgs::Pose &pose);
+
+  TransformCacheStatistics getStatistics() const;
+
+  /** \brief Drop all cached transforms, e.g. after the tf tree was reset */
+  void clear();
+
+ private:
+  struct Chain
+  {
+    Chain() : is_static(false) {}
+    bool is_static;
+    ros::WallTime static_expiry;
+    Eigen::Affine3d static_transform;
+    // most recent stamps last
+    std::deque<std::pair<ros::Time, Eigen::Affine3d>,
+               Eigen::aligned_allocator<std::pair<ros::Time, Eigen::Affine3d>>>
+        stamps;
+  };
+
+  /** \brief Try once to resolve the transform with the listener */
+  bool resolve(const std::string &target_frame, const std::string &source_frame,
+               const ros::Time &stamp, tf::StampedTransform &stamped_transform, bool &is_static,
+               std::string &error);
+
+  boost::shared_ptr<tf::TransformListener> tf_listener_;
+  ros::WallDuration static_refresh_period_;
+  size_t stamps_per_chain_;
+
+  mutable std::mutex mutex_;
+  std::map<std::pair<std::string, std::string>, Chain, std::less<std::pair<std::string, std::string>>,
+           Eigen::aligned_allocator<std::pair<const std::pair<std::string, std::string>, Chain>>>
+      chains_;
+  TransformCacheStatistics statistics_;
+};
+
+typedef std::shared_ptr<TransformCache> TransformCachePtr;
+
+}  // namespace mir_perception_utils
+
+#endif  // MIR_PERCEPTION_UTILS_TRANSFORM_CACHE_H
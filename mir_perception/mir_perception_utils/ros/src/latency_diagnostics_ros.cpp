@@ -0,0 +1,98 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <algorithm>
+#include <sstream>
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+#include <mir_perception_utils/latency_diagnostics_ros.h>
+
+using namespace mir_perception_utils;
+
+namespace
+{
+template <typename T>
+diagnostic_msgs::KeyValue keyValue(const std::string &key, T value)
+{
+  std::ostringstream stream;
+  stream << value;
+  diagnostic_msgs::KeyValue key_value;
+  key_value.key = key;
+  key_value.value = stream.str();
+  return key_value;
+}
+}  // namespace
+
+LatencyDiagnosticsROS::LatencyDiagnosticsROS(ros::NodeHandle &nh, const std::string &name)
+    : name_(name), last_lost_samples_(0)
+{
+  LatencyProfiler &profiler = LatencyProfiler::instance();
+  bool enable;
+  nh.param<bool>("enable_latency_profiling", enable, true);
+  profiler.setEnabled(enable);
+
+  int window_size;
+  nh.param<int>("latency_window_size", window_size, 1000);
+  profiler.setWindowSize(std::max(1, window_size));
+
+  int trace_capacity;
+  nh.param<std::string>("latency_trace_file", trace_file_, "");
+  nh.param<int>("latency_trace_capacity", trace_capacity, 100000);
+  profiler.setTraceCapacity(trace_file_.empty() ? 0 : std::max(0, trace_capacity));
+
+  double period;
+  nh.param<double>("latency_publish_period", period, 1.0);
+  pub_diagnostics_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("latency_diagnostics", 1);
+  if (enable && period > 0.0) {
+    timer_ = nh.createWallTimer(ros::WallDuration(period), &LatencyDiagnosticsROS::publish, this);
+  }
+}
+
+LatencyDiagnosticsROS::~LatencyDiagnosticsROS()
+{
+  timer_.stop();
+  if (!trace_file_.empty()) writeTrace();
+}
+
+bool LatencyDiagnosticsROS::writeTrace()
+{
+  if (trace_file_.empty()) return false;
+  if (!LatencyProfiler::instance().writeChromeTrace(trace_file_)) {
+    ROS_ERROR_STREAM("[" << name_ << "] Could not write latency trace " << trace_file_);
+    return false;
+  }
+  ROS_INFO_STREAM("[" << name_ << "] Latency trace written to " << trace_file_);
+  return true;
+}
+
+void LatencyDiagnosticsROS::publish(const ros::WallTimerEvent &event)
+{
+  LatencyProfiler &profiler = LatencyProfiler::instance();
+  profiler.getStatistics(statistics_);
+  if (statistics_.empty()) return;
+
+  // samples are lost if a thread records faster than the buffers are drained
+  const uint64_t lost_samples = profiler.getLostSamples() - last_lost_samples_;
+  last_lost_samples_ += lost_samples;
+  diagnostic_msgs::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = ros::Time::now();
+  diagnostics.status.reserve(statistics_.size());
+  for (const auto &stage : statistics_) {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = name_ + "/" + stage.stage;
+    status.level = lost_samples > 0 ? diagnostic_msgs::DiagnosticStatus::WARN
+                                    : diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = lost_samples > 0 ? "latency samples lost" : "ok";
+    status.values.push_back(keyValue("p50_ms", stage.p50_ms));
+    status.values.push_back(keyValue("p95_ms", stage.p95_ms));
+    status.values.push_back(keyValue("p99_ms", stage.p99_ms));
+    status.values.push_back(keyValue("max_ms", stage.max_ms));
+    status.values.push_back(keyValue("window", stage.window));
+    status.values.push_back(keyValue("count", stage.count));
+    status.values.push_back(keyValue("lost_samples", lost_samples));
+    diagnostics.status.push_back(status);
+  }
+  pub_diagnostics_.publish(diagnostics);
+}
@@ -21,6 +21,7 @@
 #include <pcl_ros/point_cloud.h>
 
 #include <mir_perception_utils/object_utils_ros.h>
+#include <mir_perception_utils/principal_axes.h>
 #include <mir_perception_utils/impl/helpers.hpp>
 
 using namespace mir_perception_utils;
@@ -103,38 +104,14 @@ PointCloud object::estimatePose(const PointCloud::Ptr &xyz_input_cloud, geometry
     }
   }
 
-  Eigen::Vector4f centroid;
-  pcl::compute3DCentroid(filtered_cloud, centroid);
-
-  Eigen::Matrix3f covariance;
-  pcl::computeCovarianceMatrixNormalized(filtered_cloud, centroid, covariance);
-
-  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> eigen_solver(covariance,
-                                                              Eigen::ComputeEigenvectors);
-  Eigen::Matrix3f eigen_vectors = eigen_solver.eigenvectors();
-
-  // swap largest and second largest eigenvector so that y-axis aligns with
-  // largest eigenvector and z with the second largest
-  eigen_vectors.col(0).swap(eigen_vectors.col(2));
-  eigen_vectors.col(1) = eigen_vectors.col(2).cross(eigen_vectors.col(0));
-
-  Eigen::Matrix4f eigen_vector_transform(Eigen::Matrix4f::Identity());
-  eigen_vector_transform.block<3, 3>(0, 0) = eigen_vectors.transpose();
-  eigen_vector_transform.block<3, 1>(0, 3) =
-      -(eigen_vector_transform.block<3, 3>(0, 0) * centroid.head<3>());
-
-  // transform cloud to eigenvector space
-  pcl::PointCloud<pcl::PointXYZRGB> transformed_cloud;
-  pcl::transformPointCloud(filtered_cloud, transformed_cloud, eigen_vector_transform);
-
-  // find mean diagonal
-  pcl::PointXYZRGB min_point, max_point;
-  pcl::getMinMax3D(transformed_cloud, min_point, max_point);
-  Eigen::Vector3f mean_diag = (max_point.getVector3fMap() + min_point.getVector3fMap()) / 2.0;
-
-  // orientation and position of bounding box of cloud
-  Eigen::Quaternionf orientation(eigen_vectors);
-  Eigen::Vector3f position = eigen_vectors * mean_diag + centroid.head<3>();
+  // orientation and position of the box aligned with the principal axes
+  pointcloud::OrientedBox box;
+  if (!pointcloud::computeOrientedBox(filtered_cloud, box)) {
+    ROS_WARN("[ObjectUtils]: No valid points to estimate the pose from.");
+    return filtered_cloud;
+  }
+  Eigen::Quaternionf orientation(box.axes);
+  const Eigen::Vector3f &position = box.center;
 
   pose.pose.position.x = position(0);
   pose.pose.position.y = position(1);
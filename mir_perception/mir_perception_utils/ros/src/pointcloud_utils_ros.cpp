@@ -4,13 +4,113 @@
  * Author: Mohammad Wasil
  *
  */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <mir_perception_utils/pointcloud_msg_view.h>
 #include <mir_perception_utils/pointcloud_utils_ros.h>
-#include <pcl/filters/statistical_outlier_removal.h>
 #include <pcl_conversions/pcl_conversions.h>
 #include <opencv2/core/core.hpp>
 
 using namespace mir_perception_utils;
 
+namespace
+{
+/** Conservative bounds of the crop box in the sensor frame, used to cull points
+ * before they are transformed. Besides the axis aligned bounds (e.g. the depth
+ * range of an optical frame), the box is bounded by the slopes x/z and y/z of
+ * the rays through its corners, which is what pixel bounds are for a pinhole
+ * camera, without needing the camera intrinsics. */
+struct SensorFrameBounds
+{
+  Eigen::Array4f min;
+  Eigen::Array4f max;
+  bool use_slopes;
+  float slope_x_min, slope_x_max, slope_y_min, slope_y_max;
+
+  SensorFrameBounds(const Eigen::Vector3f &box_min, const Eigen::Vector3f &box_max,
+                    const Eigen::Matrix4f &transform)
+      : min(Eigen::Array4f::Constant(std::numeric_limits<float>::max())),
+        max(Eigen::Array4f::Constant(-std::numeric_limits<float>::max())),
+        use_slopes(true),
+        slope_x_min(std::numeric_limits<float>::max()),
+        slope_x_max(-std::numeric_limits<float>::max()),
+        slope_y_min(std::numeric_limits<float>::max()),
+        slope_y_max(-std::numeric_limits<float>::max())
+  {
+    const Eigen::Matrix4f inverse = transform.inverse();
+    // unbounded axes are clamped so that the corners stay finite in the sensor frame
+    const Eigen::Vector3f lower = box_min.cwiseMax(Eigen::Vector3f::Constant(-1e4f));
+    const Eigen::Vector3f upper = box_max.cwiseMin(Eigen::Vector3f::Constant(1e4f));
+    for (int corner = 0; corner < 8; corner++) {
+      const Eigen::Vector4f target(corner & 1 ? upper[0] : lower[0], corner & 2 ? upper[1] : lower[1],
+                                   corner & 4 ? upper[2] : lower[2], 1.0f);
+      const Eigen::Vector4f sensor = inverse * target;
+      min = min.min(sensor.array());
+      max = max.max(sensor.array());
+      // the slopes only bound the box if it is completely in front of the sensor
+      if (sensor[2] <= 1e-3f) {
+        use_slopes = false;
+        continue;
+      }
+      slope_x_min = std::min(slope_x_min, sensor[0] / sensor[2]);
+      slope_x_max = std::max(slope_x_max, sensor[0] / sensor[2]);
+      slope_y_min = std::min(slope_y_min, sensor[1] / sensor[2]);
+      slope_y_max = std::max(slope_y_max, sensor[1] / sensor[2]);
+    }
+    min[3] = -std::numeric_limits<float>::max();
+    max[3] = std::numeric_limits<float>::max();
+  }
+
+  bool contains(const Eigen::Vector4f &point) const
+  {
+    if ((point.array() < min).any() || (point.array() > max).any()) return false;
+    if (!use_slopes) return true;
+    return point[0] >= slope_x_min * point[2] && point[0] <= slope_x_max * point[2] &&
+           point[1] >= slope_y_min * point[2] && point[1] <= slope_y_max * point[2];
+  }
+};
+/** \brief Median of the values, reorders them */
+float median(std::vector<float> &values)
+{
+  const size_t middle = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + middle, values.end());
+  return values[middle];
+}
+
+/** \brief Remove the points that are further from the median point of the cloud
+ * than the median distance plus threshold scaled median absolute deviations of the
+ * distances, e.g. the background and foreground points in the ROI of a detection.
+ * Robust replacement of the statistical outlier removal, which needs a KdTree. */
+void removeOutliersMAD(PointCloud &cloud, float threshold)
+{
+  const size_t n = cloud.points.size();
+  if (n < 3) return;
+  std::vector<float> values(n);
+  Eigen::Vector3f center;
+  for (int axis = 0; axis < 3; axis++) {
+    for (size_t i = 0; i < n; i++) values[i] = cloud.points[i].getVector3fMap()[axis];
+    center[axis] = median(values);
+  }
+  std::vector<float> distances(n);
+  for (size_t i = 0; i < n; i++) {
+    distances[i] = (cloud.points[i].getVector3fMap() - center).norm();
+  }
+  values = distances;
+  const float median_distance = median(values);
+  for (size_t i = 0; i < n; i++) values[i] = std::fabs(distances[i] - median_distance);
+  // 1.4826 scales the MAD to the standard deviation of normally distributed distances
+  const float max_distance = median_distance + threshold * 1.4826f * median(values);
+
+  size_t kept = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (distances[i] <= max_distance) cloud.points[kept++] = cloud.points[i];
+  }
+  cloud.points.resize(kept);
+}
+}  // namespace
+
 bool pointcloud::transformPointCloudMsg(const boost::shared_ptr<tf::TransformListener> &tf_listener,
                                         const std::string &target_frame,
                                         const sensor_msgs::PointCloud2 &cloud_in,
@@ -21,8 +121,6 @@ bool pointcloud::transformPointCloudMsg(const boost::shared_ptr<tf::TransformLis
       ros::Time common_time;
       tf_listener->getLatestCommonTime(target_frame, cloud_in.header.frame_id, common_time, NULL);
       cloud_in.header.stamp = common_time;
-      tf_listener->waitForTransform(target_frame, cloud_in.header.frame_id, ros::Time::now(),
-                                    ros::Duration(1.0));
       pcl_ros::transformPointCloud(target_frame, cloud_in, cloud_out, *tf_listener);
       cloud_out.header.frame_id = target_frame;
     } catch (tf::TransformException &ex) {
@@ -36,6 +134,123 @@ bool pointcloud::transformPointCloudMsg(const boost::shared_ptr<tf::TransformLis
   return (true);
 }
 
+bool pointcloud::convertPointCloudMsg(const sensor_msgs::PointCloud2 &cloud_in,
+                                      const Eigen::Matrix4f &transform, PointCloud &cloud_out,
+                                      const ConversionFilter &filter)
+{
+  PointCloud2View view(cloud_in);
+  if (!view.isValid()) {
+    ROS_ERROR("PointCloud2 has no float x, y, z fields or is big endian");
+    return (false);
+  }
+
+  const Eigen::Vector4f box_min(filter.crop_box_min[0], filter.crop_box_min[1],
+                                filter.crop_box_min[2], -std::numeric_limits<float>::max());
+  const Eigen::Vector4f box_max(filter.crop_box_max[0], filter.crop_box_max[1],
+                                filter.crop_box_max[2], std::numeric_limits<float>::max());
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  // computed once per call, i.e. once for the transform of this cloud
+  const SensorFrameBounds sensor_bounds(filter.crop_box_min, filter.crop_box_max, transform);
+
+  cloud_out.points.resize(view.size());
+  size_t count = 0;
+  size_t invalid_count = 0;
+  for (uint32_t row = 0; row < view.height(); row++) {
+    for (uint32_t col = 0; col < view.width(); col++) {
+      const uint8_t *src = view.point(row, col);
+      Eigen::Vector4f xyz = view.getXYZ(src);
+      bool valid = std::isfinite(xyz[0]) && std::isfinite(xyz[1]) && std::isfinite(xyz[2]);
+      // most points of a workspace view are floor or background, skip them before transforming
+      if (valid && filter.enable_crop_box) valid = sensor_bounds.contains(xyz);
+      if (valid) {
+        // 4x4 times 4 vector product, vectorized by Eigen
+        xyz = transform * xyz;
+        if (filter.enable_crop_box) {
+          valid = (xyz.array() >= box_min.array()).all() && (xyz.array() <= box_max.array()).all();
+        }
+      }
+      if (!valid) {
+        invalid_count++;
+        if (filter.remove_nans) continue;
+        xyz = Eigen::Vector4f(nan, nan, nan, 1.0f);
+      }
+      PointT &dst = cloud_out.points[count++];
+      dst.getVector4fMap() = xyz;
+      dst.rgba = view.getRGBA(src);
+    }
+  }
+  cloud_out.points.resize(count);
+
+  if (filter.remove_nans) {
+    cloud_out.width = static_cast<uint32_t>(count);
+    cloud_out.height = 1;
+    cloud_out.is_dense = true;
+  } else {
+    cloud_out.width = view.width();
+    cloud_out.height = view.height();
+    cloud_out.is_dense = invalid_count == 0;
+  }
+  pcl_conversions::toPCL(cloud_in.header, cloud_out.header);
+  return (true);
+}
+
+bool pointcloud::transformPointCloudMsg(const boost::shared_ptr<tf::TransformListener> &tf_listener,
+                                        const std::string &target_frame,
+                                        const sensor_msgs::PointCloud2 &cloud_in,
+                                        PointCloud &cloud_out, const ConversionFilter &filter,
+                                        bool use_cloud_stamp, double timeout)
+{
+  if (!tf_listener) {
+    ROS_ERROR_THROTTLE(2.0, "TF listener not initialized.");
+    return (false);
+  }
+
+  Eigen::Matrix4f transform;
+  try {
+    ros::Time stamp = cloud_in.header.stamp;
+    if (use_cloud_stamp) {
+      tf_listener->waitForTransform(target_frame, cloud_in.header.frame_id, stamp,
+                                    ros::Duration(timeout));
+    } else {
+      // returns as soon as any transform of the chain is available
+      tf_listener->waitForTransform(target_frame, cloud_in.header.frame_id, ros::Time(0),
+                                    ros::Duration(timeout));
+      tf_listener->getLatestCommonTime(target_frame, cloud_in.header.frame_id, stamp, NULL);
+    }
+    tf::StampedTransform stamped_transform;
+    tf_listener->lookupTransform(target_frame, cloud_in.header.frame_id, stamp, stamped_transform);
+    pcl_ros::transformAsMatrix(stamped_transform, transform);
+  } catch (tf::TransformException &ex) {
+    ROS_ERROR("PCL transform error: %s", ex.what());
+    return (false);
+  }
+
+  if (!convertPointCloudMsg(cloud_in, transform, cloud_out, filter)) return (false);
+  cloud_out.header.frame_id = target_frame;
+  return (true);
+}
+
+bool pointcloud::transformPointCloudMsg(TransformCache &transform_cache,
+                                        const std::string &target_frame,
+                                        const sensor_msgs::PointCloud2 &cloud_in,
+                                        PointCloud &cloud_out, const ConversionFilter &filter,
+                                        bool use_cloud_stamp, double timeout)
+{
+  const ros::Time stamp = use_cloud_stamp ? cloud_in.header.stamp : ros::Time(0);
+  // the latest transform is waited for as well, e.g. while the chain is not published yet
+  const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout);
+  Eigen::Affine3d transform;
+  if (!transform_cache.lookup(target_frame, cloud_in.header.frame_id, stamp, transform, deadline)) {
+    return (false);
+  }
+
+  if (!convertPointCloudMsg(cloud_in, transform.matrix().cast<float>(), cloud_out, filter)) {
+    return (false);
+  }
+  cloud_out.header.frame_id = target_frame;
+  return (true);
+}
+
 bool pointcloud::transformPointCloud(const boost::shared_ptr<tf::TransformListener> &tf_listener,
                                      const std::string &target_frame, const PointCloud &cloud_in,
                                      PointCloud &cloud_out)
@@ -49,8 +264,6 @@ bool pointcloud::transformPointCloud(const boost::shared_ptr<tf::TransformListen
       pc_header.seq = cloud_in.header.seq;
       pcl_conversions::toPCL(common_time, pc_header.stamp);
       cloud_in.header = pc_header;
-      tf_listener->waitForTransform(target_frame, cloud_in.header.frame_id, ros::Time::now(),
-                                    ros::Duration(1.0));
       pcl_ros::transformPointCloud(target_frame, cloud_in, cloud_out, *tf_listener);
       cloud_out.header.frame_id = target_frame;
     } catch (tf::TransformException &ex) {
@@ -82,8 +295,6 @@ bool pointcloud::transformPointCloud2(const boost::shared_ptr<tf::TransformListe
       pc_header.seq = cloud_in.header.seq;
       pcl_conversions::toPCL(common_time, pc_header.stamp);
       cloud_in.header = pc_header;
-      tf_listener->waitForTransform(target_frame, cloud_in.header.frame_id, ros::Time::now(),
-                                    ros::Duration(1.0));
       pcl_ros::transformPointCloud(target_frame, cloud_in, cloud_out, *tf_listener);
 
       cloud_out.header.frame_id = target_frame;
@@ -103,52 +314,85 @@ bool pointcloud::getPointCloudROI(const sensor_msgs::RegionOfInterest &roi,
                                   const PointCloud::Ptr &cloud_in, PointCloud::Ptr &cloud_roi,
                                   float roi_size_adjustment, bool remove_outliers)
 {
+  std::vector<PointCloud::Ptr> clouds_roi;
+  if (!getPointCloudROIs(std::vector<sensor_msgs::RegionOfInterest>(1, roi), cloud_in, clouds_roi,
+                         roi_size_adjustment, remove_outliers)) {
+    return (false);
+  }
+  if (!clouds_roi[0]) {
+    ROS_ERROR("Pixel location is out of range.");
+    return (false);
+  }
+  cloud_roi->header = clouds_roi[0]->header;
+  cloud_roi->points.insert(cloud_roi->points.end(), clouds_roi[0]->points.begin(),
+                           clouds_roi[0]->points.end());
+  cloud_roi->width = cloud_roi->points.size();
+  cloud_roi->height = 1;
+  return (true);
+}
+
+bool pointcloud::getPointCloudROIs(const std::vector<sensor_msgs::RegionOfInterest> &rois,
+                                   const PointCloud::ConstPtr &cloud_in,
+                                   std::vector<PointCloud::Ptr> &clouds_roi,
+                                   float roi_size_adjustment, bool remove_outliers,
+                                   float outlier_threshold)
+{
+  clouds_roi.assign(rois.size(), PointCloud::Ptr());
   if (cloud_in->height <= 1 || cloud_in->width <= 1) {
     ROS_ERROR("Pointcloud input height is %d and width is %d",cloud_in->height, cloud_in->width );
     return (false);
   }
-  int min_x = roi.x_offset;
-  int min_y = roi.y_offset;
-  int max_x = roi.x_offset + roi.width;
-  int max_y = roi.y_offset + roi.height;
-  // Adjust roi
-  if (roi.x_offset > roi_size_adjustment) min_x = min_x - roi_size_adjustment;
-  if (roi.y_offset > roi_size_adjustment) min_y = min_y - roi_size_adjustment;
-  if (roi.width + roi_size_adjustment < cloud_in->width) min_x = min_x + roi_size_adjustment;
-  if (roi.height + roi_size_adjustment < cloud_in->height) min_y = min_y + roi_size_adjustment;
-
-  std::vector<cv::Point> pixel_loc;
-
-  for (int i = min_x; i < max_x; i++) {
-    for (int j = min_y; j < max_y; j++) {
-      cv::Point loc;
-      loc.x = i;
-      loc.y = j;
-      pixel_loc.push_back(loc);
-    }
+  const int width = static_cast<int>(cloud_in->width);
+  const int height = static_cast<int>(cloud_in->height);
+
+  // Pixel bounds [min, max) of the ROIs, empty if the ROI is out of range
+  std::vector<cv::Rect> bounds(rois.size());
+  int rows_begin = height;
+  int rows_end = 0;
+  for (size_t i = 0; i < rois.size(); i++) {
+    const sensor_msgs::RegionOfInterest &roi = rois[i];
+    int min_x = roi.x_offset;
+    int min_y = roi.y_offset;
+    int max_x = roi.x_offset + roi.width;
+    int max_y = roi.y_offset + roi.height;
+    // Adjust roi
+    if (roi.x_offset > roi_size_adjustment) min_x = min_x - roi_size_adjustment;
+    if (roi.y_offset > roi_size_adjustment) min_y = min_y - roi_size_adjustment;
+    if (roi.width + roi_size_adjustment < cloud_in->width) min_x = min_x + roi_size_adjustment;
+    if (roi.height + roi_size_adjustment < cloud_in->height) min_y = min_y + roi_size_adjustment;
+    if (max_x > width || max_y > height) continue;
+
+    clouds_roi[i].reset(new PointCloud);
+    clouds_roi[i]->header = cloud_in->header;
+    if (min_x >= max_x || min_y >= max_y) continue;
+    clouds_roi[i]->points.reserve((max_x - min_x) * (max_y - min_y));
+    bounds[i] = cv::Rect(min_x, min_y, max_x - min_x, max_y - min_y);
+    rows_begin = std::min(rows_begin, min_y);
+    rows_end = std::max(rows_end, max_y);
   }
-  for (size_t i = 0; i < pixel_loc.size(); i++) {
-    // check cloud_in size
-    if (pixel_loc[i].x >= static_cast<int>(cloud_in->width) || pixel_loc[i].y >= static_cast<int>(cloud_in->height))
-    {
-      ROS_ERROR("Pixel location is out of range.");
-      return (false);
-    }
-    PointT pcl_point = cloud_in->at(pixel_loc[i].x, pixel_loc[i].y);
-    if ((!std::isnan(pcl_point.x)) && (!std::isnan(pcl_point.y)) && (!std::isnan(pcl_point.z)) &&
-        (!std::isnan(pcl_point.r)) && (!std::isnan(pcl_point.g)) && (!std::isnan(pcl_point.b))) {
-      cloud_roi->points.push_back(pcl_point);
+
+  // Single row-wise pass, each row segment of a ROI is read contiguously
+  for (int y = rows_begin; y < rows_end; y++) {
+    const PointT *row = &cloud_in->points[y * width];
+    for (size_t i = 0; i < rois.size(); i++) {
+      const cv::Rect &rect = bounds[i];
+      if (y < rect.y || y >= rect.y + rect.height) continue;
+      PointCloud::VectorType &points = clouds_roi[i]->points;
+      for (int x = rect.x; x < rect.x + rect.width; x++) {
+        const PointT &pcl_point = row[x];
+        if (std::isfinite(pcl_point.x) && std::isfinite(pcl_point.y) && std::isfinite(pcl_point.z)) {
+          points.push_back(pcl_point);
+        }
+      }
     }
   }
-  cloud_roi->header = cloud_in->header;
-  if (remove_outliers) {
-    if (cloud_roi->points.size() > 0) {
-      pcl::StatisticalOutlierRemoval<PointT> sor;
-      sor.setInputCloud(cloud_roi);
-      sor.setMeanK(50);
-      sor.setStddevMulThresh(3.0);
-      sor.filter(*cloud_roi);
-    }
+
+  for (size_t i = 0; i < rois.size(); i++) {
+    if (!clouds_roi[i]) continue;
+    if (remove_outliers) removeOutliersMAD(*clouds_roi[i], outlier_threshold);
+    clouds_roi[i]->width = clouds_roi[i]->points.size();
+    clouds_roi[i]->height = 1;
+    clouds_roi[i]->is_dense = true;
   }
   return (true);
 }
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2021 Bonn-Rhein-Sieg University
+ *
+ */
+#include <algorithm>
+
+#include <pcl/common/transforms.h>
+#include <pcl_conversions/pcl_conversions.h>
+
+#include <mir_perception_utils/transform_cache.h>
+
+using namespace mir_perception_utils;
+
+namespace
+{
+// period in which the listener is polled until the deadline
+const ros::WallDuration POLL_PERIOD(0.001);
+
+void toEigen(const tf::Transform &transform, Eigen::Affine3d &eigen_transform)
+{
+  const tf::Vector3 &origin = transform.getOrigin();
+  const tf::Quaternion rotation = transform.getRotation();
+  eigen_transform = Eigen::Translation3d(origin.x(), origin.y(), origin.z()) *
+                    Eigen::Quaterniond(rotation.w(), rotation.x(), rotation.y(), rotation.z());
+}
+
+void noDelete(tf::TransformListener *) {}
+}  // namespace
+
+TransformCache::TransformCache(const boost::shared_ptr<tf::TransformListener> &tf_listener,
+                               double static_refresh_period, size_t stamps_per_chain)
+    : tf_listener_(tf_listener),
+      static_refresh_period_(static_refresh_period),
+      stamps_per_chain_(std::max<size_t>(stamps_per_chain, 1))
+{
+}
+
+TransformCache::TransformCache(tf::TransformListener &tf_listener, double static_refresh_period,
+                               size_t stamps_per_chain)
+    : TransformCache(boost::shared_ptr<tf::TransformListener>(&tf_listener, &noDelete),
+                     static_refresh_period, stamps_per_chain)
+{
+}
+
+bool TransformCache::lookup(const std::string &target_frame, const std::string &source_frame,
+                            const ros::Time &stamp, Eigen::Affine3d &transform,
+                            const ros::WallTime &deadline, ros::Time *resolved_stamp)
+{
+  if (!tf_listener_) {
+    ROS_ERROR_THROTTLE(2.0, "TF listener not initialized.");
+    return (false);
+  }
+  if (target_frame == source_frame) {
+    transform.setIdentity();
+    if (resolved_stamp) *resolved_stamp = stamp;
+    return (true);
+  }
+
+  const std::pair<std::string, std::string> key(target_frame, source_frame);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = chains_.find(key);
+    if (it != chains_.end()) {
+      const Chain &chain = it->second;
+      if (chain.is_static && ros::WallTime::now() < chain.static_expiry) {
+        transform = chain.static_transform;
+        if (resolved_stamp) *resolved_stamp = ros::Time(0);
+        statistics_.static_hits++;
+        return (true);
+      }
+      // the latest common time moves on, only explicit stamps are looked up
+      if (!stamp.isZero()) {
+        for (auto entry = chain.stamps.rbegin(); entry != chain.stamps.rend(); ++entry) {
+          if (entry->first == stamp) {
+            transform = entry->second;
+            if (resolved_stamp) *resolved_stamp = stamp;
+            statistics_.hits++;
+            return (true);
+          }
+        }
+      }
+    }
+  }
+
+  // resolved without holding the lock, the listener is thread safe
+  tf::StampedTransform stamped_transform;
+  bool is_static = false;
+  std::string error;
+  while (!resolve(target_frame, source_frame, stamp, stamped_transform, is_static, error)) {
+    if (ros::WallTime::now() + POLL_PERIOD > deadline) {
+      ROS_WARN_THROTTLE(2.0, "No transform from %s to %s: %s", source_frame.c_str(),
+                        target_frame.c_str(), error.c_str());
+      std::lock_guard<std::mutex> lock(mutex_);
+      statistics_.timeouts++;
+      return (false);
+    }
+    POLL_PERIOD.sleep();
+  }
+  toEigen(stamped_transform, transform);
+  if (resolved_stamp) *resolved_stamp = stamped_transform.stamp_;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  statistics_.misses++;
+  Chain &chain = chains_[key];
+  chain.is_static = is_static;
+  if (is_static) {
+    chain.static_transform = transform;
+    chain.static_expiry = ros::WallTime::now() + static_refresh_period_;
+  } else {
+    chain.stamps.emplace_back(stamped_transform.stamp_, transform);
+    if (chain.stamps.size() > stamps_per_chain_) chain.stamps.pop_front();
+  }
+  return (true);
+}
+
+bool TransformCache::resolve(const std::string &target_frame, const std::string &source_frame,
+                             const ros::Time &stamp, tf::StampedTransform &stamped_transform,
+                             bool &is_static, std::string &error)
+{
+  ros::Time common_time;
+  if (tf_listener_->getLatestCommonTime(target_frame, source_frame, common_time, &error) !=
+      tf::NO_ERROR) {
+    return (false);
+  }
+  // the latest common time of a chain of static transforms is zero
+  is_static = common_time.isZero();
+  ros::Time lookup_stamp = common_time;
+  if (!is_static && !stamp.isZero()) {
+    if (!tf_listener_->canTransform(target_frame, source_frame, stamp, &error)) return (false);
+    lookup_stamp = stamp;
+  }
+  try {
+    tf_listener_->lookupTransform(target_frame, source_frame, lookup_stamp, stamped_transform);
+  } catch (tf::TransformException &ex) {
+    error = ex.what();
+    return (false);
+  }
+  // requested stamp, so that following lookups of the same stamp are found
+  if (!is_static && !stamp.isZero()) stamped_transform.stamp_ = stamp;
+  return (true);
+}
+
+void TransformCache::transformPose(const Eigen::Affine3d &transform, geometry_msgs::Pose &pose)
+{
+  const Eigen::Vector3d position =
+      transform * Eigen::Vector3d(pose.position.x, pose.position.y, pose.position.z);
+  const Eigen::Quaterniond orientation =
+      Eigen::Quaterniond(transform.rotation()) *
+      Eigen::Quaterniond(pose.orientation.w, pose.orientation.x, pose.orientation.y,
+                         pose.orientation.z);
+  pose.position.x = position.x();
+  pose.position.y = position.y();
+  pose.position.z = position.z();
+  pose.orientation.w = orientation.w();
+  pose.orientation.x = orientation.x();
+  pose.orientation.y = orientation.y();
+  pose.orientation.z = orientation.z();
+}
+
+bool TransformCache::transformPose(const std::string &target_frame,
+                                   const geometry_msgs::PoseStamped &pose,
+                                   geometry_msgs::PoseStamped &transformed_pose,
+                                   const ros::WallTime &deadline)
+{
+  Eigen::Affine3d transform;
+  if (!lookup(target_frame, pose.header.frame_id, pose.header.stamp, transform, deadline)) {
+    return (false);
+  }
+  transformed_pose = pose;
+  transformed_pose.header.frame_id = target_frame;
+  transformPose(transform, transformed_pose.pose);
+  return (true);
+}
+
+bool TransformCache::transformPoses(const std::string &target_frame,
+                                    std::vector<geometry_msgs::PoseStamped> &poses,
+                                    const ros::WallTime &deadline)
+{
+  bool success = true;
+  std::vector<bool> done(poses.size(), false);
+  for (size_t i = 0; i < poses.size(); i++) {
+    if (done[i]) continue;
+    const std_msgs::Header header = poses[i].header;
+    Eigen::Affine3d transform;
+    const bool found = lookup(target_frame, header.frame_id, header.stamp, transform, deadline);
+    success = success && found;
+    // all poses with the same frame and stamp share the transform
+    for (size_t j = i; j < poses.size(); j++) {
+      if (done[j] || poses[j].header.frame_id != header.frame_id ||
+          poses[j].header.stamp != header.stamp) {
+        continue;
+      }
+      done[j] = true;
+      if (!found) continue;
+      transformPose(transform, poses[j].pose);
+      poses[j].header.frame_id = target_frame;
+    }
+  }
+  return (success);
+}
+
+bool TransformCache::transformPointCloud(const std::string &target_frame,
+                                         const PointCloud &cloud_in, PointCloud &cloud_out,
+                                         const ros::WallTime &deadline)
+{
+  ros::Time stamp;
+  pcl_conversions::fromPCL(cloud_in.header.stamp, stamp);
+  Eigen::Affine3d transform;
+  if (!lookup(target_frame, cloud_in.header.frame_id, stamp, transform, deadline)) {
+    return (false);
+  }
+  pcl::transformPointCloud(cloud_in, cloud_out, transform.cast<float>());
+  cloud_out.header.frame_id = target_frame;
+  return (true);
+}
+
+TransformCacheStatistics TransformCache::getStatistics() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+void TransformCache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  chains_.clear();
+}
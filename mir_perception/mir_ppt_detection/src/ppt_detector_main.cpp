@@ -0,0 +1,15 @@
+#include <mir_ppt_detection/ppt_detector.h>
+
+int main (int argc, char** argv)
+{
+    // Initialize ROS
+    ros::init (argc, argv, "ppt_3d_detector");
+    PPTDetector ppt_detector;
+    if ( !ppt_detector.isInitialized() )
+    {
+        ROS_FATAL("Failed to read object_shape_learned_params_file.");
+        return 1;
+    }
+    // Spin
+    ros::spin ();
+}
@@ -0,0 +1,36 @@
+#include <memory>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <mir_ppt_detection/ppt_detector.h>
+
+namespace mir_ppt_detection
+{
+
+/* Runs the PPT detector in a nodelet manager. Parameters and topics are the same as for
+ * the ppt_detector node. The pointcloud is passed without serialization only if the publisher
+ * in the same manager publishes pcl::PointCloud<pcl::PointXYZRGB>, a sensor_msgs::PointCloud2
+ * is still converted. */
+class PPTDetectorNodelet : public nodelet::Nodelet
+{
+    private:
+        void onInit() override
+        {
+            // the manager runs other nodelets as well, so it is not shut down on failure
+            ppt_detector_.reset(new PPTDetector(getPrivateNodeHandle()));
+            if (!ppt_detector_->isInitialized())
+            {
+                NODELET_FATAL("[ppt_detector] Failed to read object_shape_learned_params_file, "
+                              "the detector is inactive");
+                return;
+            }
+            NODELET_INFO("[ppt_detector] nodelet started");
+        }
+
+        std::unique_ptr<PPTDetector> ppt_detector_;
+};
+
+}  // namespace mir_ppt_detection
+
+PLUGINLIB_EXPORT_CLASS(mir_ppt_detection::PPTDetectorNodelet, nodelet::Nodelet)